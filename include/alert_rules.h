@@ -0,0 +1,124 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Alert rules and their evaluation.
+//
+// A rule watches one metric of one channel. evaluateRule() is a handful of
+// comparisons per call; main.cpp keeps a per-channel index so a sample only
+// visits the rules of its own channel. Rules with forSec > 0 must see the
+// condition continuously for that long before they fire (debounce), and
+// hysteresis keeps them from flapping around the threshold. Latched rules
+// stay active until acknowledged (the behaviour of the original alerts).
+
+constexpr size_t MAX_ALERT_RULES = 16;
+constexpr size_t ALERT_NAME_MAX = 24;
+
+enum RuleType : uint8_t {
+  RULE_ABOVE,     // value > threshold, clears at threshold - hysteresis
+  RULE_BELOW,     // value < threshold, clears at threshold + hysteresis
+  RULE_RISE,      // rate of change > threshold per minute
+  RULE_FALL,      // rate of change < -threshold per minute
+  RULE_ABSENT,    // no valid sample for more than threshold seconds
+  RULE_TYPE_COUNT
+};
+
+enum RuleMetric : uint8_t {
+  METRIC_T,       // Temperature (°C)
+  METRIC_H,       // Relative humidity (%)
+  METRIC_DP,      // Dew point (°C), ABOVE/BELOW only
+  METRIC_COUNT
+};
+
+struct AlertRule {
+  bool used;
+  bool enabled;
+  bool latch;
+  RuleType type;
+  RuleMetric metric;
+  uint8_t channel;
+  float threshold;
+  float hysteresis;
+  uint32_t forSec;            // Condition must hold this long before firing
+  char name[ALERT_NAME_MAX];
+};
+
+struct AlertState {
+  bool active;
+  bool acknowledged;
+  bool pending;               // Condition true, waiting for forSec
+  uint32_t pendingSince;
+  uint32_t since;             // Time of the last transition
+  float lastValue;
+};
+
+enum AlertTransition : uint8_t { ALERT_NONE, ALERT_RAISED, ALERT_CLEARED };
+
+inline const char *ruleTypeName(RuleType t) {
+  static const char *const names[] = {"above", "below", "rise", "fall", "absent"};
+  return t < RULE_TYPE_COUNT ? names[t] : "?";
+}
+
+inline const char *ruleMetricName(RuleMetric m) {
+  static const char *const names[] = {"t", "h", "dp"};
+  return m < METRIC_COUNT ? names[m] : "?";
+}
+
+// value is the metric (ABOVE/BELOW), its rate per minute (RISE/FALL) or
+// the seconds since the last valid sample (ABSENT)
+inline AlertTransition evaluateRule(const AlertRule &r, AlertState &s, float value, uint32_t now) {
+  s.lastValue = value;
+
+  bool trip, clear;
+  switch (r.type) {
+    case RULE_BELOW:
+      trip = value < r.threshold;
+      clear = value >= r.threshold + r.hysteresis;
+      break;
+    case RULE_FALL:
+      trip = -value > r.threshold;
+      clear = -value <= r.threshold - r.hysteresis;
+      break;
+    default:   // ABOVE, RISE, ABSENT
+      trip = value > r.threshold;
+      clear = value <= r.threshold - r.hysteresis;
+      break;
+  }
+
+  if (!s.active) {
+    if (!trip) {
+      s.pending = false;
+      return ALERT_NONE;
+    }
+    if (!s.pending) {
+      s.pending = true;
+      s.pendingSince = now;
+    }
+    if (now - s.pendingSince < r.forSec) return ALERT_NONE;
+    s.pending = false;
+    s.active = true;
+    s.acknowledged = false;
+    s.since = now;
+    return ALERT_RAISED;
+  }
+
+  if (clear && !r.latch) {
+    s.active = false;
+    s.since = now;
+    return ALERT_CLEARED;
+  }
+  return ALERT_NONE;
+}
+
+// Acknowledges an alert; latched alerts are cleared by the acknowledgement.
+// Returns true if the rule was active.
+inline bool acknowledgeRule(const AlertRule &r, AlertState &s, uint32_t now) {
+  if (!s.active) return false;
+  s.acknowledged = true;
+  if (r.latch) {
+    s.active = false;
+    s.since = now;
+  }
+  return true;
+}
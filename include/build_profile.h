@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "oversampler.h"   // SampleFilter
+#include "telemetry.h"     // TelemetryEncoding
+
+// Build profiles: the sensor registry and every capacity that sizes a
+// static buffer, as one constexpr value per kind of deployment. main.cpp
+// selects one with -D PROFILE_... (see the PlatformIO envs) and derives its
+// constants from it, so each ring and queue is a template instance of
+// exactly the profile's size and nothing is allocated at run time. The
+// checks next to the selection reject an inconsistent profile at compile
+// time.
+//
+// The behaviour fields at the end are only defaults: they can be changed
+// at run time (/api/settings) and are persisted with the configuration.
+
+enum SensorType : uint8_t { SENSOR_DHT11, SENSOR_DHT22, SENSOR_SHT3X, SENSOR_SIM };
+
+struct SensorConfig {
+  const char *name;     // Channel name shown in the API
+  SensorType type;
+  uint8_t pin;          // DHT data pin, or I2C address for SHT3x
+  uint32_t intervalMs;  // Sample slot length (whole seconds)
+  uint8_t oversample;   // Readings per slot (1 = single reading)
+  SampleFilter filter;  // Median or trimmed mean of the readings
+};
+
+struct BuildProfile {
+  const char *name;
+  const SensorConfig *sensors;      // One channel per entry
+  size_t sensorCount;
+  uint32_t detailedPeriodSec;       // Detailed history kept in RAM
+  uint32_t aggregateSamples;        // 5-minute means kept in RAM per channel
+  uint32_t storageRecords;          // 5-minute means kept in the flash history per channel
+  size_t sampleRingBudget;          // RAM limit for all sample rings (bytes)
+  size_t telemetryQueue;            // Telemetry records staged in RAM
+  size_t telemetryBatch;            // Records per telemetry message
+  TelemetryEncoding telemetryEncoding;
+  size_t notifyQueue;               // Pending alert notifications
+  size_t logRingSlots;              // Log entries waiting for the drain task (power of two)
+  size_t logRecent;                 // Drained log entries kept for /api/logs
+  // Run-time defaults
+  uint32_t telemetryLingerMs;       // Publish a partial batch after this long
+  uint32_t storageSaveSec;          // Full history save interval (without the aggregate log)
+};
+
+// Entries of a registry array, for BuildProfile::sensorCount
+template <size_t N>
+constexpr size_t sensorCount(const SensorConfig (&)[N]) {
+  return N;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <FS.h>
+#include "history_format.h"   // crc32Update()
+
+// Power-fail-safe configuration blob in two alternating slot files.
+//
+//   [ConfigSlotHeader][payload]
+//
+// A commit always rewrites the slot that does not hold the newest valid
+// generation, so the previous configuration stays intact until the new one
+// is completely on flash; a torn write only ever damages the slot being
+// written, which then fails its CRC and is ignored on load. Alternating the
+// slots also halves the erase count per file. The payload is opaque (the
+// firmware stores JSON). Not thread-safe: one writer, reads at boot.
+
+constexpr uint32_t CONFIG_SLOT_MAGIC = 0x47464354;   // "TCFG" little-endian
+
+struct ConfigSlotHeader {
+  uint32_t magic;
+  uint32_t generation;        // Increases with every commit
+  uint32_t length;            // Payload bytes following the header
+  uint32_t crc;               // CRC32 over the payload
+};
+
+class ConfigStore {
+ public:
+  ConfigStore(fs::FS &fs, const char *slotA, const char *slotB) : fs_(fs) {
+    paths_[0] = slotA;
+    paths_[1] = slotB;
+  }
+
+  // Copies the payload of the newest intact slot into buf; returns its
+  // length, or 0 if neither slot is valid (or the payload exceeds cap)
+  size_t load(char *buf, size_t cap) {
+    ConfigSlotHeader hdr[2];
+    bool ok[2];
+    for (int i = 0; i < 2; i++) ok[i] = readHeader(i, hdr[i]);
+    int order[2] = {0, 1};
+    if (ok[1] && (!ok[0] || (int32_t)(hdr[1].generation - hdr[0].generation) > 0)) {
+      order[0] = 1;
+      order[1] = 0;
+    }
+    // Newest first; fall back to the older slot if the newer one is torn
+    for (int k = 0; k < 2; k++) {
+      int i = order[k];
+      if (!ok[i] || hdr[i].length > cap) continue;
+      File f = fs_.open(paths_[i], "r");
+      if (!f) continue;
+      f.seek(sizeof(ConfigSlotHeader));
+      size_t n = f.read((uint8_t *)buf, hdr[i].length);
+      f.close();
+      if (n != hdr[i].length || crc32Update(0, buf, n) != hdr[i].crc) continue;
+      generation_ = hdr[order[0]].generation;   // Never reuse a torn slot's generation
+      current_ = i;
+      return n;
+    }
+    return 0;
+  }
+
+  // Writes data as the next generation into the other slot
+  bool commit(const char *data, size_t len) {
+    int slot = current_ < 0 ? 0 : current_ ^ 1;
+    ConfigSlotHeader hdr = {CONFIG_SLOT_MAGIC, generation_ + 1, (uint32_t)len, crc32Update(0, data, len)};
+    File f = fs_.open(paths_[slot], "w");
+    if (!f) {
+      failures_++;
+      return false;
+    }
+    bool ok = f.write((const uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+              f.write((const uint8_t *)data, len) == len;
+    f.close();
+    if (!ok) {
+      failures_++;
+      return false;
+    }
+    generation_ = hdr.generation;
+    current_ = slot;
+    commits_++;
+    return true;
+  }
+
+  uint32_t generation() const { return generation_; }
+  uint32_t commits() const { return commits_; }
+  uint32_t failures() const { return failures_; }
+
+ private:
+  fs::FS &fs_;
+  const char *paths_[2];
+  int current_ = -1;          // Slot holding the newest valid generation
+  uint32_t generation_ = 0;
+  uint32_t commits_ = 0;
+  uint32_t failures_ = 0;
+
+  bool readHeader(int i, ConfigSlotHeader &hdr) {
+    File f = fs_.open(paths_[i], "r");
+    if (!f) return false;
+    size_t size = f.size();
+    bool ok = f.read((uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr);
+    f.close();
+    return ok && hdr.magic == CONFIG_SLOT_MAGIC && size == sizeof(hdr) + hdr.length;
+  }
+};
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "history_format.h"   // HistoryRecord, crc32Update()
+#include "raw_log.h"          // FlashRegion
+#include "sample_store.h"     // BucketAccumulator
+
+// Power-fail snapshot of the data that only exists in RAM: the recent
+// samples of every channel, the open aggregation buckets and aggregates
+// waiting for their group commit.
+//
+// The image is kept pre-serialized: the sampler updates it in place with
+// every sample, so taking a snapshot is one CRC pass and one flash program
+// into a sector that was erased in advance (no erase, no formatting in the
+// hold-up window). Two sectors alternate; the body is written first and
+// the header, which carries the CRCs, last, so a write cut short leaves
+// either the previous snapshot or nothing valid behind. The caller erases
+// used sectors again (prepare()) once it is clear power did not fail.
+//
+//   sector: [SnapshotHeader][SnapshotImage]
+
+constexpr uint32_t SNAPSHOT_MAGIC = 0x50414E53;   // "SNAP" little-endian
+
+struct SnapshotHeader {
+  uint32_t magic;
+  uint32_t seq;               // Increases with every snapshot written
+  uint32_t ts;                // Wall time when it was taken
+  uint32_t length;            // Image bytes following the header
+  uint8_t reason;             // Caller-defined trigger
+  uint8_t staged;             // Valid entries in SnapshotImage::staged
+  uint16_t reserved;
+  uint32_t bodyCrc;           // CRC32 over the image
+  uint32_t crc;               // CRC32 over the preceding header fields
+};
+
+// Recent samples, in 1/100 units (the sensors resolve 0.1)
+struct SnapshotSample {
+  uint32_t ts;
+  int16_t t;
+  uint16_t h;
+  uint16_t missed;
+  uint16_t jitterMs;
+};
+
+struct SnapshotChannel {
+  BucketAccumulator bucket;   // Open bucket (bucketTs 0 = empty)
+  uint16_t slotsPerBucket;
+  uint16_t samples;           // Valid entries in the sample ring
+  uint16_t next;              // Ring position of the next sample
+  uint16_t reserved;
+};
+
+static_assert(sizeof(SnapshotHeader) == 28, "SnapshotHeader layout changed");
+static_assert(sizeof(SnapshotSample) == 12, "SnapshotSample layout changed");
+
+template <size_t CHANNELS, size_t SAMPLES, size_t STAGED>
+struct SnapshotImage {
+  SnapshotChannel channels[CHANNELS];
+  HistoryRecord staged[STAGED];
+  SnapshotSample samples[CHANNELS][SAMPLES];
+
+  // Calls fn(sample) for the samples of channel c, oldest first
+  template <class Fn>
+  void forEachSample(size_t c, Fn fn) const {
+    const SnapshotChannel &ch = channels[c];
+    for (size_t i = 0; i < ch.samples; i++) {
+      fn(samples[c][(ch.next + SAMPLES - ch.samples + i) % SAMPLES]);
+    }
+  }
+};
+
+template <size_t CHANNELS, size_t SAMPLES, size_t STAGED>
+class EmergencySnapshot {
+ public:
+  typedef SnapshotImage<CHANNELS, SAMPLES, STAGED> Image;
+  static_assert(sizeof(SnapshotHeader) + sizeof(Image) <= FLASH_SECTOR_SIZE, "snapshot exceeds one sector");
+
+  // ---- Image maintenance (sampler) ----
+
+  void sample(size_t c, uint32_t ts, float t, float h, uint16_t missed, uint16_t jitterMs) {
+    SnapshotChannel &ch = image_.channels[c];
+    SnapshotSample &s = image_.samples[c][ch.next];
+    s.ts = ts;
+    s.t = (int16_t)(t * 100.0f + (t < 0 ? -0.5f : 0.5f));
+    s.h = (uint16_t)(h * 100.0f + 0.5f);
+    s.missed = missed;
+    s.jitterMs = jitterMs;
+    ch.next = (ch.next + 1) % SAMPLES;
+    if (ch.samples < SAMPLES) ch.samples++;
+  }
+
+  void bucket(size_t c, const BucketAccumulator &b, uint16_t slotsPerBucket) {
+    image_.channels[c].bucket = b;
+    image_.channels[c].slotsPerBucket = slotsPerBucket;
+  }
+
+  // Moves boot-clock timestamps (below `below`) to wall time
+  void shiftTimestamps(uint32_t below, uint32_t offset) {
+    for (size_t c = 0; c < CHANNELS; c++) {
+      BucketAccumulator &b = image_.channels[c].bucket;
+      if (b.bucketTs && b.bucketTs < below) b.bucketTs += offset;
+      for (size_t i = 0; i < SAMPLES; i++) {
+        if (image_.samples[c][i].ts < below) image_.samples[c][i].ts += offset;
+      }
+    }
+  }
+
+  // ---- Flash area ----
+
+  // Needs two sectors; notes which ones hold data. Does not write.
+  bool begin(FlashRegion &region) {
+    region_ = nullptr;
+    armed_ = -1;
+    if (region.size() < 2 * FLASH_SECTOR_SIZE) return false;
+    region_ = &region;
+    for (int i = 0; i < 2; i++) {
+      dirty_[i] = !sectorErased(i);
+      SnapshotHeader hdr;
+      if (readHeader(i, hdr) && (int32_t)(hdr.seq - seq_) >= 0) seq_ = hdr.seq + 1;
+    }
+    return true;
+  }
+
+  // Newest intact snapshot into out; false if there is none
+  bool load(Image &out, SnapshotHeader &hdr) {
+    if (!region_) return false;
+    SnapshotHeader h[2];
+    bool ok[2];
+    for (int i = 0; i < 2; i++) ok[i] = readHeader(i, h[i]);
+    int order[2] = {0, 1};
+    if (ok[1] && (!ok[0] || (int32_t)(h[1].seq - h[0].seq) > 0)) {
+      order[0] = 1;
+      order[1] = 0;
+    }
+    // Newest first; fall back to the older one if its body does not check out
+    for (int k = 0; k < 2; k++) {
+      int i = order[k];
+      if (!ok[i]) continue;
+      if (region_->read(i * FLASH_SECTOR_SIZE + sizeof(SnapshotHeader), &out, sizeof(Image)) &&
+          crc32Update(0, &out, sizeof(Image)) == h[i].bodyCrc) {
+        hdr = h[i];
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Erases used sectors so the next snapshot finds one ready; slow (one
+  // sector erase each), so never called from the emergency path
+  size_t prepare() {
+    if (!region_) return 0;
+    size_t erased = 0;
+    for (int i = 0; i < 2; i++) {
+      if (!dirty_[i]) continue;
+      if (!region_->erase(i * FLASH_SECTOR_SIZE, FLASH_SECTOR_SIZE)) continue;
+      dirty_[i] = false;
+      erased++;
+    }
+    if (armed_ < 0) armed_ = !dirty_[0] ? 0 : (!dirty_[1] ? 1 : -1);
+    return erased;
+  }
+
+  // The emergency path: program the image into the armed sector. staged
+  // holds the aggregates not yet committed elsewhere (may be nullptr).
+  bool write(uint8_t reason, uint32_t ts, const HistoryRecord *staged, size_t n) {
+    if (!region_ || armed_ < 0) return false;
+    int sector = armed_;
+    if (n > STAGED) n = STAGED;
+    if (n) memcpy(image_.staged, staged, n * sizeof(HistoryRecord));
+    SnapshotHeader hdr = {SNAPSHOT_MAGIC, seq_, ts, (uint32_t)sizeof(Image), reason, (uint8_t)n, 0, 0, 0};
+    hdr.bodyCrc = crc32Update(0, &image_, sizeof(Image));
+    hdr.crc = crc32Update(0, &hdr, offsetof(SnapshotHeader, crc));
+    dirty_[sector] = true;
+    armed_ = !dirty_[sector ^ 1] ? sector ^ 1 : -1;
+    if (!region_->write(sector * FLASH_SECTOR_SIZE + sizeof(SnapshotHeader), &image_, sizeof(Image))) return false;
+    if (!region_->write(sector * FLASH_SECTOR_SIZE, &hdr, sizeof(hdr))) return false;
+    seq_++;
+    return true;
+  }
+
+  bool armed() const { return armed_ >= 0; }
+  bool dirty() const { return dirty_[0] || dirty_[1]; }
+  uint32_t seq() const { return seq_; }
+  Image &image() { return image_; }
+
+ private:
+  Image image_ = {};
+  FlashRegion *region_ = nullptr;
+  int armed_ = -1;            // Erased sector for the next snapshot
+  bool dirty_[2] = {false, false};
+  uint32_t seq_ = 1;
+
+  bool readHeader(int sector, SnapshotHeader &hdr) {
+    return region_->read(sector * FLASH_SECTOR_SIZE, &hdr, sizeof(hdr)) &&
+           hdr.magic == SNAPSHOT_MAGIC && hdr.length == sizeof(Image) &&
+           hdr.crc == crc32Update(0, &hdr, offsetof(SnapshotHeader, crc));
+  }
+
+  bool sectorErased(int sector) {
+    uint32_t buf[64];
+    for (size_t off = 0; off < FLASH_SECTOR_SIZE; off += sizeof(buf)) {
+      if (!region_->read(sector * FLASH_SECTOR_SIZE + off, buf, sizeof(buf))) return false;
+      for (size_t i = 0; i < 64; i++) {
+        if (buf[i] != 0xFFFFFFFF) return false;
+      }
+    }
+    return true;
+  }
+};
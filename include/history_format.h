@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// On-flash layout of the persisted history (HISTORY_FILE).
+//
+//   [HistoryHeader][block]...
+//   block: [HistoryRecord * HISTORY_BLOCK_RECORDS][CRC32 over the records]
+//
+// The header is small and self-checking so setup() can validate the file
+// without touching the records; the records themselves are loaded later
+// (see ensureHistoryLoaded() in main.cpp). The last block may be shorter.
+// Block CRCs confine damage to one block (see history_recovery.h); files
+// older than v4 are a plain record array. Records are grouped by channel,
+// oldest first within each channel; files older than v3 load into channel 0.
+
+constexpr uint32_t HISTORY_MAGIC   = 0x474C4854;  // "THLG" little-endian
+constexpr uint16_t HISTORY_VERSION = 4;         // v2 added n/missed (coverage), v3 channel, v4 block CRCs
+constexpr uint16_t HISTORY_V1_RECORD_SIZE = 12;
+constexpr uint16_t HISTORY_BLOCK_CRC_VERSION = 4;
+constexpr size_t HISTORY_BLOCK_RECORDS = 32;
+
+struct HistoryRecord {
+  uint32_t ts;          // Unix timestamp of the aggregate bucket
+  float t;              // Temperature in Celsius
+  float h;              // Humidity in %
+  uint16_t n;           // Samples in the bucket
+  uint16_t missed;      // Sample slots in the bucket without a reading
+  uint8_t channel;      // Sensor channel index
+  uint8_t flags;        // Reserved, written as 0
+  uint16_t reserved;
+};
+
+struct HistoryHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t recordSize;
+  uint32_t count;       // Number of records following the header
+  uint32_t firstTs;     // Timestamp of the oldest record
+  uint32_t lastTs;      // Timestamp of the newest record
+  uint32_t crc;         // CRC32 over all preceding header fields
+};
+
+static_assert(sizeof(HistoryRecord) == 20, "HistoryRecord layout changed");
+static_assert(sizeof(HistoryHeader) == 24, "HistoryHeader layout changed");
+
+// Plain bitwise CRC32 (IEEE 802.3). Only used on small blocks.
+inline uint32_t crc32Update(uint32_t crc, const void *data, size_t len) {
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+  crc = ~crc;
+  while (len--) {
+    crc ^= *p++;
+    for (int k = 0; k < 8; k++) {
+      crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+inline uint32_t historyHeaderCrc(const HistoryHeader &hdr) {
+  return crc32Update(0, &hdr, offsetof(HistoryHeader, crc));
+}
+
+constexpr bool historyHasBlockCrc(uint16_t version) {
+  return version >= HISTORY_BLOCK_CRC_VERSION;
+}
+
+// File size for count records in the given layout
+constexpr size_t historyFileSize(uint16_t version, uint16_t recordSize, uint32_t count) {
+  return sizeof(HistoryHeader) + (size_t)count * recordSize +
+         (historyHasBlockCrc(version) ? (count + HISTORY_BLOCK_RECORDS - 1) / HISTORY_BLOCK_RECORDS * sizeof(uint32_t) : 0);
+}
+
+// Checks magic, version, record size and CRC (not the file size)
+inline bool historyHeaderIntact(const HistoryHeader &hdr) {
+  if (hdr.magic != HISTORY_MAGIC || hdr.version == 0 || hdr.version > HISTORY_VERSION) return false;
+  if (hdr.recordSize < HISTORY_V1_RECORD_SIZE || hdr.recordSize > sizeof(HistoryRecord)) return false;
+  return hdr.crc == historyHeaderCrc(hdr);
+}
+
+// Intact header and a file size that matches the record count. Files
+// written by older versions (shorter records, no block CRCs) are accepted.
+inline bool historyHeaderValid(const HistoryHeader &hdr, size_t fileSize) {
+  return historyHeaderIntact(hdr) && fileSize == historyFileSize(hdr.version, hdr.recordSize, hdr.count);
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <new>
+#include "num_format.h"
+#include "rolling_stats.h"   // dewPoint(), absoluteHumidity()
+#include "time_format.h"
+
+// JSON text of /api/history points, produced without ArduinoJson.
+//
+// The handler copies the points out of the rings (HistoryPoint, so the
+// rings may keep moving) and formats them in independent slices; each
+// slice goes into its own TextChunks and the slices are sent in order.
+// Nothing here is shared between slices, so two tasks can format two
+// slices at the same time (each with its own DateFormatter).
+
+enum HistoryPointKind : uint8_t { POINT_DETAILED, POINT_AGGREGATED };
+
+struct HistoryPoint {
+  uint32_t ts;
+  float t;
+  float h;
+  uint16_t n;
+  uint16_t missed;        // Gap marker (detailed)
+  uint16_t jitterMs;      // Detailed only
+  uint8_t kind;
+  uint8_t reserved;
+};
+
+struct HistoryJsonOptions {
+  TimeFormat timeFormat;
+  bool datetime;          // Add "datetime" (false for ?time=epoch)
+  bool derived;           // Add dew point and absolute humidity
+  bool typed;             // Add "type" (combined ranges)
+  uint16_t slotsPerBucket;
+};
+
+constexpr size_t HISTORY_POINT_JSON_MAX = 224;   // Longest point object
+
+// One point object; values rounded to 0.01 with trailing zeros dropped
+inline size_t formatHistoryPoint(char *out, const HistoryPoint &p, const HistoryJsonOptions &o, DateFormatter &fmt) {
+  char *w = out;
+  w += formatStr(w, "{\"ts\":");
+  w += formatUint(w, p.ts);
+  struct Field {
+    static char *add(char *w, const char *key, float v) {
+      w += formatStr(w, key);
+      size_t n = formatFixed(w, v, 2);
+      return w + (n ? n : formatStr(w, "null"));
+    }
+  };
+  w = Field::add(w, ",\"t\":", p.t);
+  w = Field::add(w, ",\"h\":", p.h);
+  if (o.derived) {
+    w = Field::add(w, ",\"dp\":", dewPoint(p.t, p.h));
+    w = Field::add(w, ",\"ah\":", absoluteHumidity(p.t, p.h));
+  }
+  if (o.datetime) {
+    w += formatStr(w, ",\"datetime\":\"");
+    w += fmt.format(p.ts, w, o.timeFormat);
+    *w++ = '"';
+  }
+  if (p.kind == POINT_AGGREGATED) {
+    w += formatStr(w, ",\"n\":");
+    w += formatUint(w, p.n);
+    w += formatStr(w, ",\"coverage\":");
+    w += formatUint(w, o.slotsPerBucket ? p.n * 100u / o.slotsPerBucket : 0);
+  } else {
+    w += formatStr(w, ",\"jitter_ms\":");
+    w += formatUint(w, p.jitterMs);
+    if (p.missed) {
+      w += formatStr(w, ",\"gap\":");
+      w += formatUint(w, p.missed);
+    }
+  }
+  if (o.typed) w += formatStr(w, p.kind == POINT_AGGREGATED ? ",\"type\":\"aggregated\"" : ",\"type\":\"detailed\"");
+  *w++ = '}';
+  return w - out;
+}
+
+// Append-only text in fixed heap chunks (no reallocation, no big block)
+class TextChunks {
+ public:
+  static constexpr size_t CHUNK_SIZE = 2048;
+  static constexpr size_t MAX_CHUNKS = 48;
+
+  TextChunks() {}
+  TextChunks(const TextChunks &) = delete;
+  TextChunks &operator=(const TextChunks &) = delete;
+  ~TextChunks() {
+    for (size_t i = 0; i < count_; i++) delete[] chunks_[i];
+  }
+
+  // False once memory ran out; the text is incomplete from then on
+  bool append(const char *s, size_t len) {
+    while (len > 0 && !failed_) {
+      size_t used = size_ % CHUNK_SIZE;
+      if (used == 0 && size_ == count_ * CHUNK_SIZE) {
+        char *chunk = count_ < MAX_CHUNKS ? new (std::nothrow) char[CHUNK_SIZE] : nullptr;
+        if (!chunk) {
+          failed_ = true;
+          break;
+        }
+        chunks_[count_++] = chunk;
+      }
+      size_t k = CHUNK_SIZE - used;
+      if (k > len) k = len;
+      memcpy(chunks_[size_ / CHUNK_SIZE] + used, s, k);
+      size_ += k;
+      s += k;
+      len -= k;
+    }
+    return !failed_;
+  }
+
+  // Copies up to len bytes from offset; returns the count copied
+  size_t read(size_t offset, char *buf, size_t len) const {
+    size_t n = 0;
+    while (n < len && offset < size_) {
+      size_t in = offset % CHUNK_SIZE;
+      size_t k = CHUNK_SIZE - in;
+      if (k > size_ - offset) k = size_ - offset;
+      if (k > len - n) k = len - n;
+      memcpy(buf + n, chunks_[offset / CHUNK_SIZE] + in, k);
+      n += k;
+      offset += k;
+    }
+    return n;
+  }
+
+  size_t size() const { return size_; }
+  bool failed() const { return failed_; }
+
+ private:
+  char *chunks_[MAX_CHUNKS];
+  size_t count_ = 0;
+  size_t size_ = 0;
+  bool failed_ = false;
+};
+
+// Formats points [0, count) as comma-separated objects; leadingComma when
+// the slice continues an earlier one
+inline bool formatHistorySlice(const HistoryPoint *points, size_t count, const HistoryJsonOptions &o,
+                               bool leadingComma, TextChunks &out) {
+  DateFormatter fmt;
+  char buf[HISTORY_POINT_JSON_MAX + 1];
+  for (size_t i = 0; i < count; i++) {
+    char *w = buf;
+    if (i > 0 || leadingComma) *w++ = ',';
+    w += formatHistoryPoint(w, points[i], o, fmt);
+    if (!out.append(buf, w - buf)) return false;
+  }
+  return true;
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "history_format.h"
+
+// Recovery scan of a history file that may be damaged: a save cut short by
+// a reset (truncated file), flipped bits, a torn header.
+//
+// The file is read newest block first and every intact record is handed to
+// the caller; damaged ranges are reported as segments instead of failing
+// the whole file:
+//  - intact header: count and layout are trusted, the file size is not.
+//    A truncated v4 file keeps every complete block with a good CRC; a
+//    truncated v1-v3 file (no CRCs) keeps its whole-record prefix.
+//  - damaged header: the current layout is assumed and each block must
+//    prove itself with its CRC (older files cannot, and are quarantined).
+// Work is bounded by maxBytes (anything beyond is not read) and by the
+// caller's deadline, checked before every block.
+
+constexpr size_t HISTORY_SCAN_SEGMENTS = 8;   // Damaged ranges kept in the report
+
+struct HistorySegment {
+  uint32_t offset;
+  uint32_t length;
+};
+
+struct HistoryScanReport {
+  bool headerIntact;
+  bool sizeMismatch;            // File length differs from what the header announces
+  bool budgetExceeded;          // Deadline or maxBytes hit; older blocks not scanned
+  uint16_t version;             // Layout used for the scan
+  uint32_t fileBytes;
+  uint32_t expected;            // Records announced by the header (0 if unknown)
+  uint32_t recovered;           // Records delivered to the caller
+  uint32_t blocks;
+  uint32_t badBlocks;
+  uint32_t damagedBytes;
+  uint8_t segmentCount;         // Entries in segments (further ones only counted)
+  HistorySegment segments[HISTORY_SCAN_SEGMENTS];
+
+  bool damaged() const { return !headerIntact || sizeMismatch || badBlocks > 0 || damagedBytes > 0; }
+};
+
+// Resumable scan, for loading in steps between other work:
+//   HistoryScanner scan;
+//   scan.begin(reader, maxBytes);          // Header and layout
+//   while (!scan.step(reader, onRecord, expired)) { ...other work... }
+// Reader: size_t size(); bool read(size_t offset, void *buf, size_t len)
+// onRecord(const HistoryRecord &): called newest first
+// expired(): true once this step has to stop, checked before every block
+// after the first, so each step makes progress. The reader may be reopened
+// between steps, the file must not change.
+class HistoryScanner {
+ public:
+  template <class Reader>
+  void begin(Reader &in, size_t maxBytes) {
+    memset(&rep_, 0, sizeof(rep_));
+    size_t fileBytes = in.size();
+    rep_.fileBytes = fileBytes;
+    next_ = 0;
+
+    HistoryHeader hdr;
+    recordSize_ = sizeof(HistoryRecord);
+    rep_.version = HISTORY_VERSION;
+    if (fileBytes >= sizeof(hdr) && in.read(0, &hdr, sizeof(hdr)) && historyHeaderIntact(hdr)) {
+      rep_.headerIntact = true;
+      rep_.version = hdr.version;
+      rep_.expected = hdr.count;
+      recordSize_ = hdr.recordSize;
+    } else {
+      damage(0, fileBytes < sizeof(hdr) ? fileBytes : sizeof(hdr));
+    }
+    if (fileBytes <= sizeof(hdr)) {
+      rep_.sizeMismatch = rep_.headerIntact && rep_.expected > 0;
+      return;
+    }
+
+    // Data range to look at
+    size_t end = fileBytes;
+    if (rep_.headerIntact) {
+      size_t announced = historyFileSize(rep_.version, recordSize_, rep_.expected);
+      rep_.sizeMismatch = fileBytes != announced;
+      if (end > announced) {
+        damage(announced, end - announced);   // Trailing bytes nothing refers to
+        end = announced;
+      }
+    }
+    if (end > maxBytes) {
+      end = maxBytes;
+      rep_.budgetExceeded = true;
+    }
+
+    crc_ = historyHasBlockCrc(rep_.version);
+    blockBytes_ = HISTORY_BLOCK_RECORDS * recordSize_ + (crc_ ? sizeof(uint32_t) : 0);
+    size_t data = end - sizeof(hdr);
+    fullBlocks_ = data / blockBytes_;
+    size_t tail = data % blockBytes_;
+
+    // A short last block is whole records (plus CRC); anything else is torn
+    tailRecords_ = 0;
+    if (tail > 0) {
+      size_t payload = crc_ ? (tail > sizeof(uint32_t) ? tail - sizeof(uint32_t) : 0) : tail;
+      tailRecords_ = payload / recordSize_;
+      size_t used = tailRecords_ ? tailRecords_ * recordSize_ + (crc_ ? sizeof(uint32_t) : 0) : 0;
+      if (crc_ && payload % recordSize_) {
+        tailRecords_ = 0;
+        used = 0;
+      }
+      damage(sizeof(hdr) + fullBlocks_ * blockBytes_ + used, tail - used);
+    }
+    next_ = fullBlocks_ + (tailRecords_ ? 1 : 0);
+  }
+
+  // Scans blocks newest first; true once every block is done
+  template <class Reader, class OnRecord, class Expired>
+  bool step(Reader &in, OnRecord onRecord, Expired expired) {
+    uint8_t buf[HISTORY_BLOCK_RECORDS * sizeof(HistoryRecord) + sizeof(uint32_t)];
+    for (bool first = true; next_ > 0; first = false) {
+      if (!first && expired()) return false;
+      size_t b = --next_;
+      size_t records = b < fullBlocks_ ? HISTORY_BLOCK_RECORDS : tailRecords_;
+      size_t payload = records * recordSize_;
+      size_t len = payload + (crc_ ? sizeof(uint32_t) : 0);
+      size_t offset = sizeof(HistoryHeader) + b * blockBytes_;
+      rep_.blocks++;
+      bool ok = in.read(offset, buf, len);
+      if (ok && crc_) {
+        uint32_t stored;
+        memcpy(&stored, buf + payload, sizeof(stored));
+        ok = stored == crc32Update(0, buf, payload);
+      }
+      if (!ok) {
+        rep_.badBlocks++;
+        damage(offset, len);
+        continue;
+      }
+      for (size_t i = records; i-- > 0;) {
+        // Older versions store shorter records; missing fields read as zero
+        HistoryRecord rec;
+        memset(&rec, 0, sizeof(rec));
+        memcpy(&rec, buf + i * recordSize_, recordSize_);
+        rep_.recovered++;
+        onRecord(rec);
+      }
+    }
+    return true;
+  }
+
+  bool done() const { return next_ == 0; }
+  // Gives up on the blocks not scanned yet (reported as budgetExceeded)
+  void abandon() {
+    if (next_ > 0) rep_.budgetExceeded = true;
+    next_ = 0;
+  }
+  const HistoryScanReport &report() const { return rep_; }
+
+ private:
+  HistoryScanReport rep_;
+  uint16_t recordSize_ = sizeof(HistoryRecord);
+  bool crc_ = false;
+  size_t blockBytes_ = 0;
+  size_t fullBlocks_ = 0;
+  size_t tailRecords_ = 0;
+  size_t next_ = 0;            // Blocks not scanned yet (next one is next_ - 1)
+
+  void damage(size_t offset, size_t length) {
+    if (length == 0) return;
+    rep_.damagedBytes += length;
+    if (rep_.segmentCount < HISTORY_SCAN_SEGMENTS) rep_.segments[rep_.segmentCount++] = {(uint32_t)offset, (uint32_t)length};
+  }
+};
+
+// The whole scan in one call; blocks left when expired() stops it count as
+// budgetExceeded
+template <class Reader, class OnRecord, class Expired>
+HistoryScanReport scanHistory(Reader &in, size_t maxBytes, OnRecord onRecord, Expired expired) {
+  HistoryScanner scan;
+  scan.begin(in, maxBytes);
+  if (!scan.step(in, onRecord, expired)) scan.abandon();
+  return scan.report();
+}
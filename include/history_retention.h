@@ -0,0 +1,123 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "history_format.h"
+
+// Flash retention beyond the RAM rings.
+//
+// The history file keeps a longer window per channel than the RAM
+// aggregate ring (BuildProfile::storageRecords 5-minute buckets). A save
+// writes each channel's RAM ring behind the older records it carries over
+// from the previous file: per channel, the records with from <= ts < before,
+// where `before` is the oldest timestamp the ring holds and `from` the start
+// of the retention window. The old file is read front to back twice (count
+// for the header, then copy), one block at a time, so a save needs one
+// block of RAM however long the window is.
+//
+// Only an intact current-layout (v4) file is carried over (anything else,
+// or a file that cannot be read, carries nothing). Records that
+// would break the file order (channels ascending, time ascending within a
+// channel), unknown channels and blocks failing their CRC are left out by
+// the same rule in both passes, so the planned count is exactly what
+// copy() delivers.
+//
+//   HistoryCarryOver<CHANNELS> carry(from, before);
+//   carry.plan(reader);                     // count(c), firstTs(c), lastTs(c)
+//   ...write the header...
+//   carry.copy(reader, [](const HistoryRecord &rec) { ... });
+// Reader: size_t size(); bool read(size_t offset, void *buf, size_t len)
+
+template <size_t CHANNELS>
+class HistoryCarryOver {
+ public:
+  HistoryCarryOver(const uint32_t (&from)[CHANNELS], const uint32_t (&before)[CHANNELS]) {
+    for (size_t c = 0; c < CHANNELS; c++) {
+      from_[c] = from[c];
+      before_[c] = before[c];
+      count_[c] = 0;
+      firstTs_[c] = 0;
+      lastTs_[c] = 0;
+    }
+  }
+
+  // First pass: what copy() will deliver per channel
+  template <class Reader>
+  void plan(Reader &in) {
+    for (size_t c = 0; c < CHANNELS; c++) count_[c] = 0;
+    usable_ = visit(in, [&](const HistoryRecord &rec) {
+      if (count_[rec.channel]++ == 0) firstTs_[rec.channel] = rec.ts;
+      lastTs_[rec.channel] = rec.ts;
+    });
+    if (!usable_) {
+      for (size_t c = 0; c < CHANNELS; c++) count_[c] = 0;
+    }
+  }
+
+  // Second pass: the planned records in file order; false if the file
+  // could not be read again (the new file is then short and must be
+  // discarded)
+  template <class Reader, class OnRecord>
+  bool copy(Reader &in, OnRecord onRecord) {
+    if (!usable_) return true;
+    uint32_t total = 0;
+    bool ok = visit(in, [&](const HistoryRecord &rec) {
+      total++;
+      onRecord(rec);
+    });
+    return ok && total == this->total();
+  }
+
+  uint32_t count(size_t c) const { return count_[c]; }
+  uint32_t firstTs(size_t c) const { return firstTs_[c]; }   // Valid if count(c) > 0
+  uint32_t lastTs(size_t c) const { return lastTs_[c]; }
+  uint32_t total() const {
+    uint32_t n = 0;
+    for (size_t c = 0; c < CHANNELS; c++) n += count_[c];
+    return n;
+  }
+
+ private:
+  uint32_t from_[CHANNELS];
+  uint32_t before_[CHANNELS];
+  uint32_t count_[CHANNELS];
+  uint32_t firstTs_[CHANNELS];
+  uint32_t lastTs_[CHANNELS];
+  bool usable_ = false;
+
+  // False on a read error (the records delivered so far are incomplete)
+  template <class Reader, class Fn>
+  bool visit(Reader &in, Fn fn) {
+    HistoryHeader hdr;
+    size_t size = in.size();
+    if (size < sizeof(hdr) || !in.read(0, &hdr, sizeof(hdr)) || !historyHeaderValid(hdr, size) ||
+        hdr.version != HISTORY_VERSION || hdr.recordSize != sizeof(HistoryRecord)) {
+      return false;
+    }
+    HistoryRecord block[HISTORY_BLOCK_RECORDS];
+    uint32_t last[CHANNELS];
+    bool seen[CHANNELS] = {};
+    size_t channel = 0;
+    size_t offset = sizeof(hdr);
+    for (uint32_t done = 0; done < hdr.count;) {
+      uint32_t n = hdr.count - done < HISTORY_BLOCK_RECORDS ? hdr.count - done : HISTORY_BLOCK_RECORDS;
+      size_t payload = n * sizeof(HistoryRecord);
+      uint32_t crc;
+      if (!in.read(offset, block, payload) || !in.read(offset + payload, &crc, sizeof(crc))) return false;
+      offset += payload + sizeof(crc);
+      done += n;
+      if (crc != crc32Update(0, block, payload)) continue;
+      for (uint32_t i = 0; i < n; i++) {
+        const HistoryRecord &rec = block[i];
+        size_t c = rec.channel;
+        if (c >= CHANNELS || c < channel) continue;
+        if (rec.ts < from_[c] || rec.ts >= before_[c] || (seen[c] && rec.ts <= last[c])) continue;
+        channel = c;
+        seen[c] = true;
+        last[c] = rec.ts;
+        fn(rec);
+      }
+    }
+    return true;
+  }
+};
@@ -0,0 +1,312 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+
+// Deferred, binary log entries.
+//
+// A log call does not format anything: it stores the format string pointer
+// (the literal stays in flash), a millisecond timestamp and its arguments
+// as tagged binary values in a fixed slot of a lock-free ring. A
+// low-priority task drains the ring, renders the text and writes it to the
+// UART, so a slow or full serial port never stalls the caller. When the
+// ring is full the new entry is dropped and counted.
+//
+// The ring is a bounded multi-producer / single-consumer queue (one
+// sequence number per slot, claimed with a compare-and-swap), so producers
+// on both cores and in interrupts never wait for each other or the drain.
+//
+//   payload: per argument a tag byte, then
+//     'i' int32 / 'u' uint32 / 'f' float   4 bytes little-endian
+//     's' string                           length byte + bytes (no NUL)
+
+enum class LogLevel : uint8_t { Error = 1, Warn = 2, Info = 3, Debug = 4 };
+
+inline const char *logLevelName(uint8_t level) {
+  switch (level) {
+    case (uint8_t)LogLevel::Error: return "error";
+    case (uint8_t)LogLevel::Warn: return "warn";
+    case (uint8_t)LogLevel::Info: return "info";
+    case (uint8_t)LogLevel::Debug: return "debug";
+  }
+  return "?";
+}
+
+constexpr size_t LOG_PAYLOAD_MAX = 80;   // Encoded arguments of one entry
+constexpr size_t LOG_STR_MAX = 48;       // Longest string argument kept
+constexpr uint8_t LOG_TRUNCATED = 0x01;  // Arguments did not fit
+
+struct LogEntry {
+  uint32_t seq;
+  uint32_t ms;
+  const char *fmt;
+  uint8_t level;
+  uint8_t flags;
+  uint8_t len;            // Payload bytes used
+  uint8_t reserved;
+  uint8_t payload[LOG_PAYLOAD_MAX];
+};
+
+namespace log_ring_detail {
+
+struct Writer {
+  uint8_t *p;
+  uint8_t *end;
+  bool full;
+
+  void put(char tag, const void *v) {
+    if (full || end - p < 5) {
+      full = true;
+      return;
+    }
+    *p++ = tag;
+    memcpy(p, v, 4);
+    p += 4;
+  }
+
+  void str(const char *s) {
+    if (!s) s = "(null)";
+    size_t n = 0;
+    while (n < LOG_STR_MAX && s[n]) n++;
+    if (full || (size_t)(end - p) < 2 + n) {
+      full = true;
+      return;
+    }
+    *p++ = 's';
+    *p++ = (uint8_t)n;
+    memcpy(p, s, n);
+    p += n;
+  }
+};
+
+template <class T>
+typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+encode(Writer &w, T v) {
+  int32_t x = (int32_t)v;
+  w.put('i', &x);
+}
+
+template <class T>
+typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+encode(Writer &w, T v) {
+  uint32_t x = (uint32_t)v;
+  w.put('u', &x);
+}
+
+template <class T>
+typename std::enable_if<std::is_floating_point<T>::value>::type
+encode(Writer &w, T v) {
+  float x = (float)v;
+  w.put('f', &x);
+}
+
+template <class T>
+typename std::enable_if<std::is_enum<T>::value>::type
+encode(Writer &w, T v) {
+  encode(w, (typename std::underlying_type<T>::type)v);
+}
+
+inline void encode(Writer &w, const char *s) { w.str(s); }
+inline void encode(Writer &w, char *s) { w.str(s); }
+
+inline void encodeAll(Writer &) {}
+
+template <class T, class... Rest>
+void encodeAll(Writer &w, const T &first, const Rest &...rest) {
+  encode(w, first);
+  encodeAll(w, rest...);
+}
+
+}  // namespace log_ring_detail
+
+template <size_t SLOTS>
+class LogRing {
+  static_assert(SLOTS >= 2 && (SLOTS & (SLOTS - 1)) == 0, "slot count must be a power of two");
+
+ public:
+  LogRing() {
+    for (size_t i = 0; i < SLOTS; i++) slots_[i].seq.store(i, std::memory_order_relaxed);
+  }
+  LogRing(const LogRing &) = delete;
+  LogRing &operator=(const LogRing &) = delete;
+
+  // Any task or ISR; false (and counted) when the ring is full
+  template <class... Args>
+  bool write(LogLevel level, uint32_t ms, const char *fmt, const Args &...args) {
+    uint32_t pos = head_.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;) {
+      slot = &slots_[pos & (SLOTS - 1)];
+      int32_t dif = (int32_t)(slot->seq.load(std::memory_order_acquire) - pos);
+      if (dif == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      } else if (dif < 0) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+    LogEntry &e = slot->entry;
+    log_ring_detail::Writer w = {e.payload, e.payload + LOG_PAYLOAD_MAX, false};
+    log_ring_detail::encodeAll(w, args...);
+    e.seq = pos;
+    e.ms = ms;
+    e.fmt = fmt;
+    e.level = (uint8_t)level;
+    e.flags = w.full ? LOG_TRUNCATED : 0;
+    e.len = (uint8_t)(w.p - e.payload);
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Single consumer; false when nothing is waiting
+  bool read(LogEntry &out) {
+    Slot &slot = slots_[tail_ & (SLOTS - 1)];
+    if (slot.seq.load(std::memory_order_acquire) != tail_ + 1) return false;
+    out = slot.entry;
+    slot.seq.store(tail_ + SLOTS, std::memory_order_release);
+    tail_++;
+    return true;
+  }
+
+  uint32_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+  static constexpr size_t capacity() { return SLOTS; }
+
+ private:
+  struct Slot {
+    std::atomic<uint32_t> seq;
+    LogEntry entry;
+  };
+  Slot slots_[SLOTS];
+  std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> dropped_{0};
+  uint32_t tail_ = 0;
+};
+
+// printf-style rendering of an entry's message (the drain task and the
+// /api/logs text formats). Length modifiers in the format are ignored, the
+// argument tags decide the type. Returns the length; out is NUL-terminated.
+inline size_t renderLogMessage(const LogEntry &e, char *out, size_t cap) {
+  if (cap == 0) return 0;
+  const uint8_t *p = e.payload;
+  const uint8_t *end = e.payload + e.len;
+  size_t n = 0;
+  struct Out {
+    static void add(char *out, size_t cap, size_t &n, const char *s, size_t len) {
+      if (len > cap - 1 - n) len = cap - 1 - n;
+      memcpy(out + n, s, len);
+      n += len;
+    }
+  };
+  for (const char *f = e.fmt; *f && n < cap - 1;) {
+    if (*f != '%') {
+      const char *lit = f;
+      while (*f && *f != '%') f++;
+      Out::add(out, cap, n, lit, f - lit);
+      continue;
+    }
+    if (f[1] == '%') {
+      Out::add(out, cap, n, "%", 1);
+      f += 2;
+      continue;
+    }
+    // Copy flags, width and precision; drop length modifiers
+    char spec[16];
+    size_t s = 0;
+    spec[s++] = *f++;
+    while (*f && strchr("-+ #0123456789.", *f)) {
+      if (s < sizeof(spec) - 3) spec[s++] = *f;
+      f++;
+    }
+    while (*f && strchr("hlzjtL", *f)) f++;
+    char conv = *f ? *f++ : 's';
+
+    char tmp[LOG_STR_MAX + 32];
+    int k;
+    if (p >= end) {
+      k = snprintf(tmp, sizeof(tmp), "?");
+    } else if (*p == 's') {
+      char str[LOG_STR_MAX + 1];
+      size_t len = p[1];
+      memcpy(str, p + 2, len);
+      str[len] = '\0';
+      p += 2 + len;
+      spec[s++] = 's';
+      spec[s] = '\0';
+      k = snprintf(tmp, sizeof(tmp), spec, conv == 's' ? str : "?");
+    } else {
+      char tag = (char)*p;
+      uint8_t raw[4];
+      memcpy(raw, p + 1, 4);
+      p += 5;
+      int32_t i;
+      uint32_t u;
+      float fl;
+      memcpy(&i, raw, 4);
+      memcpy(&u, raw, 4);
+      memcpy(&fl, raw, 4);
+      spec[s++] = conv;
+      spec[s] = '\0';
+      if (strchr("fFeEgGaA", conv)) {
+        k = snprintf(tmp, sizeof(tmp), spec, tag == 'f' ? (double)fl : (tag == 'i' ? (double)i : (double)u));
+      } else if (strchr("di", conv)) {
+        k = snprintf(tmp, sizeof(tmp), spec, tag == 'f' ? (int)fl : (int)i);
+      } else if (strchr("uxXoc", conv)) {
+        k = snprintf(tmp, sizeof(tmp), spec, tag == 'f' ? (unsigned)fl : (unsigned)u);
+      } else {
+        k = snprintf(tmp, sizeof(tmp), "?");
+      }
+    }
+    if (k > 0) Out::add(out, cap, n, tmp, (size_t)k < sizeof(tmp) ? (size_t)k : sizeof(tmp) - 1);
+  }
+  if (e.flags & LOG_TRUNCATED) {
+    // Keep the line break of the format at the end
+    bool nl = n > 0 && out[n - 1] == '\n';
+    if (nl) n--;
+    Out::add(out, cap, n, " ...", 4);
+    if (nl) Out::add(out, cap, n, "\n", 1);
+  }
+  out[n] = '\0';
+  return n;
+}
+
+// Binary dump of entries for tools/log_decode.py (little-endian):
+//   "LGB1", u16 entries, u16 formats, u32 dropped
+//   formats: u8 length + text (no NUL), referenced by index
+//   entries: u32 seq, u32 ms, u8 level, u8 flags, u16 format, u8 length + payload
+constexpr uint32_t LOG_DUMP_MAGIC = 0x3142474C;   // "LGB1" little-endian
+constexpr size_t LOG_DUMP_HEADER = 12;
+constexpr size_t LOG_DUMP_ENTRY_MAX = 13 + LOG_PAYLOAD_MAX;
+
+inline size_t encodeLogDumpHeader(uint8_t *out, uint16_t entries, uint16_t formats, uint32_t dropped) {
+  uint32_t magic = LOG_DUMP_MAGIC;
+  memcpy(out, &magic, 4);
+  memcpy(out + 4, &entries, 2);
+  memcpy(out + 6, &formats, 2);
+  memcpy(out + 8, &dropped, 4);
+  return LOG_DUMP_HEADER;
+}
+
+// Format texts longer than 255 bytes are cut (none of ours are)
+inline size_t encodeLogDumpFormat(uint8_t *out, const char *fmt) {
+  size_t n = strnlen(fmt, 255);
+  out[0] = (uint8_t)n;
+  memcpy(out + 1, fmt, n);
+  return 1 + n;
+}
+
+inline size_t encodeLogDumpEntry(uint8_t *out, const LogEntry &e, uint16_t format) {
+  memcpy(out, &e.seq, 4);
+  memcpy(out + 4, &e.ms, 4);
+  out[8] = e.level;
+  out[9] = e.flags;
+  memcpy(out + 10, &format, 2);
+  out[12] = e.len;
+  memcpy(out + 13, e.payload, e.len);
+  return 13 + e.len;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include "num_format.h"
+
+// OpenMetrics text exposition into a caller-provided buffer.
+//
+// No heap, no printf: integers and gauges go through num_format, gauges as
+// fixed-point values with two decimals, which covers every quantity we
+// export (sensor readings, rates, byte counts). Output that does not fit
+// is cut off at the last complete line and flagged via overflowed().
+//
+//   w.family("thlogger_temperature_celsius", "gauge", "Latest temperature sample");
+//   w.sample("thlogger_temperature_celsius").label("channel", "probe-1").value(23.4f);
+//   w.eof();
+
+class MetricsWriter {
+ public:
+  MetricsWriter(char *buf, size_t cap) : buf_(buf), cap_(cap) {}
+
+  size_t length() const { return committed_; }
+  bool overflowed() const { return overflow_; }
+
+  // "# TYPE" and "# HELP" lines of a metric family
+  void family(const char *name, const char *type, const char *help) {
+    raw("# TYPE ");
+    raw(name);
+    put(' ');
+    raw(type);
+    raw("\n# HELP ");
+    raw(name);
+    put(' ');
+    raw(help);
+    put('\n');
+    commit();
+  }
+
+  // Starts a sample line; follow with label() calls and one value() call
+  MetricsWriter &sample(const char *name, const char *suffix = "") {
+    raw(name);
+    raw(suffix);
+    labels_ = 0;
+    return *this;
+  }
+
+  MetricsWriter &label(const char *key, const char *value) {
+    put(labels_++ ? ',' : '{');
+    raw(key);
+    raw("=\"");
+    for (; *value; value++) {
+      char c = *value;
+      if (c == '"' || c == '\\') {
+        put('\\');
+        put(c);
+      } else if (c == '\n') {
+        raw("\\n");
+      } else {
+        put(c);
+      }
+    }
+    put('"');
+    return *this;
+  }
+
+  MetricsWriter &label(const char *key, uint32_t value) {
+    put(labels_++ ? ',' : '{');
+    raw(key);
+    raw("=\"");
+    u32(value);
+    put('"');
+    return *this;
+  }
+
+  // Gauge value with two decimals (NaN for missing data)
+  void value(float v) {
+    closeLabels();
+    if (isnan(v)) {
+      raw("NaN");
+    } else if (isinf(v)) {
+      raw(v < 0 ? "-Inf" : "+Inf");
+    } else {
+      char tmp[NUM_FORMAT_MAX];
+      putn(tmp, formatFixed(tmp, v, 2, false));
+    }
+    put('\n');
+    commit();
+  }
+
+  void value(uint32_t v) {
+    closeLabels();
+    u32(v);
+    put('\n');
+    commit();
+  }
+
+  void value(bool v) { value((uint32_t)(v ? 1 : 0)); }
+
+  void eof() {
+    raw("# EOF\n");
+    commit();
+  }
+
+ private:
+  char *buf_;
+  size_t cap_;
+  size_t len_ = 0;         // Write position (may run past committed_)
+  size_t committed_ = 0;   // End of the last complete line
+  uint8_t labels_ = 0;
+  bool overflow_ = false;
+
+  void put(char c) {
+    if (len_ < cap_) buf_[len_] = c;
+    len_++;
+  }
+
+  void raw(const char *s) {
+    while (*s) put(*s++);
+  }
+
+  void putn(const char *s, size_t n) {
+    for (size_t i = 0; i < n; i++) put(s[i]);
+  }
+
+  void closeLabels() {
+    if (labels_) put('}');
+    labels_ = 0;
+    put(' ');
+  }
+
+  void u32(uint32_t v) {
+    char tmp[NUM_FORMAT_MAX];
+    putn(tmp, formatUint(tmp, v));
+  }
+
+  // Keeps a line only if it fit completely
+  void commit() {
+    if (len_ <= cap_ && !overflow_) {
+      committed_ = len_;
+    } else {
+      overflow_ = true;
+      len_ = committed_;
+    }
+  }
+};
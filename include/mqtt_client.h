@@ -0,0 +1,186 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Client.h>
+
+// Minimal MQTT 3.1.1 publisher.
+//
+// Only what the uplink needs: CONNECT (clean session, optional user and
+// password), PUBLISH at QoS 0 or 1, PINGREQ and DISCONNECT. QoS 1 publishes
+// block until the broker's PUBACK arrives, so a true return means the
+// broker has taken responsibility for the message. Nothing is subscribed;
+// incoming packets other than CONNACK/PUBACK/PINGRESP are skipped.
+//
+// All calls block for at most timeoutMs and must run on a task that may
+// block (never in loop() or an AsyncTCP handler). Not thread-safe.
+
+class MqttClient {
+ public:
+  explicit MqttClient(Client &net) : net_(net) {}
+
+  uint32_t timeoutMs = 5000;
+
+  bool connect(const char *host, uint16_t port, const char *clientId,
+               const char *user = nullptr, const char *pass = nullptr, uint16_t keepAliveSec = 60) {
+    disconnect();
+    if (!net_.connect(host, port)) return false;
+
+    uint8_t flags = 0x02;   // Clean session
+    size_t len = 10 + 2 + strlen(clientId);
+    if (user && *user) {
+      flags |= 0x80;
+      len += 2 + strlen(user);
+      if (pass) {
+        flags |= 0x40;
+        len += 2 + strlen(pass);
+      }
+    }
+
+    static const uint8_t protocol[] = {0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04};
+    bool ok = writeHeader(0x10, len) && writeAll(protocol, sizeof(protocol)) &&
+              writeByte(flags) && writeByte(keepAliveSec >> 8) && writeByte(keepAliveSec & 0xFF) &&
+              writeString(clientId);
+    if (ok && (flags & 0x80)) ok = writeString(user);
+    if (ok && (flags & 0x40)) ok = writeString(pass);
+
+    uint8_t body[2] = {0, 0xFF};
+    if (!ok || waitFor(0x20, body, sizeof(body)) != 2 || body[1] != 0) {
+      lastReturnCode_ = body[1];
+      net_.stop();
+      return false;
+    }
+    keepAliveMs_ = (uint32_t)keepAliveSec * 1000;
+    lastTxMs_ = millis();
+    connected_ = true;
+    return true;
+  }
+
+  bool connected() { return connected_ && net_.connected(); }
+
+  // CONNACK return code of the last failed connect (0xFF = no answer)
+  uint8_t lastReturnCode() const { return lastReturnCode_; }
+
+  bool publish(const char *topic, const uint8_t *payload, size_t len, uint8_t qos = 1, bool retain = false) {
+    if (!connected()) return false;
+    size_t topicLen = strlen(topic);
+    uint16_t id = 0;
+    size_t remaining = 2 + topicLen + len;
+    if (qos > 0) {
+      id = nextPacketId();
+      remaining += 2;
+    }
+
+    bool ok = writeHeader(0x30 | (qos > 0 ? 0x02 : 0) | (retain ? 0x01 : 0), remaining) && writeString(topic);
+    if (ok && qos > 0) ok = writeByte(id >> 8) && writeByte(id & 0xFF);
+    if (ok) ok = writeAll(payload, len);
+    if (!ok) return fail();
+    lastTxMs_ = millis();
+    if (qos == 0) return true;
+
+    uint8_t ack[2];
+    while (true) {
+      if (waitFor(0x40, ack, sizeof(ack)) != 2) return fail();
+      if (((uint16_t)ack[0] << 8 | ack[1]) == id) return true;   // Stale acks are skipped
+    }
+  }
+
+  // Sends a PINGREQ when the keep-alive interval is half used up
+  bool poll() {
+    if (!connected()) return false;
+    if (millis() - lastTxMs_ < keepAliveMs_ / 2) return true;
+    if (!writeHeader(0xC0, 0)) return fail();
+    lastTxMs_ = millis();
+    return waitFor(0xD0, nullptr, 0) == 0 || fail();
+  }
+
+  void disconnect() {
+    if (connected()) writeHeader(0xE0, 0);
+    connected_ = false;
+    net_.stop();
+  }
+
+ private:
+  Client &net_;
+  bool connected_ = false;
+  uint8_t lastReturnCode_ = 0;
+  uint16_t packetId_ = 0;
+  uint32_t keepAliveMs_ = 60000;
+  uint32_t lastTxMs_ = 0;
+
+  uint16_t nextPacketId() {
+    if (++packetId_ == 0) packetId_ = 1;
+    return packetId_;
+  }
+
+  bool fail() {
+    connected_ = false;
+    net_.stop();
+    return false;
+  }
+
+  bool writeAll(const uint8_t *p, size_t len) {
+    while (len > 0) {
+      size_t n = net_.write(p, len);
+      if (n == 0) return false;
+      p += n;
+      len -= n;
+    }
+    return true;
+  }
+
+  bool writeByte(uint8_t b) { return writeAll(&b, 1); }
+
+  bool writeString(const char *s) {
+    size_t len = strlen(s);
+    return writeByte(len >> 8) && writeByte(len & 0xFF) && writeAll((const uint8_t *)s, len);
+  }
+
+  // Fixed header: packet type/flags and the variable-length remaining length
+  bool writeHeader(uint8_t type, size_t remaining) {
+    uint8_t buf[5];
+    size_t n = 0;
+    buf[n++] = type;
+    do {
+      uint8_t digit = remaining % 128;
+      remaining /= 128;
+      buf[n++] = digit | (remaining > 0 ? 0x80 : 0);
+    } while (remaining > 0 && n < sizeof(buf));
+    return writeAll(buf, n);
+  }
+
+  int readByte(uint32_t startMs) {
+    while (!net_.available()) {
+      if (!net_.connected() || millis() - startMs >= timeoutMs) return -1;
+      delay(1);
+    }
+    return net_.read();
+  }
+
+  // Reads packets until one of the wanted type arrives; copies up to cap
+  // body bytes and returns the body length, or -1 on timeout/disconnect
+  int waitFor(uint8_t type, uint8_t *body, size_t cap) {
+    uint32_t start = millis();
+    while (true) {
+      int header = readByte(start);
+      if (header < 0) return -1;
+
+      size_t remaining = 0;
+      uint32_t multiplier = 1;
+      for (int i = 0; i < 4; i++) {
+        int digit = readByte(start);
+        if (digit < 0) return -1;
+        remaining += (digit & 0x7F) * multiplier;
+        multiplier *= 128;
+        if (!(digit & 0x80)) break;
+      }
+
+      bool wanted = (header & 0xF0) == type;
+      for (size_t i = 0; i < remaining; i++) {
+        int b = readByte(start);
+        if (b < 0) return -1;
+        if (wanted && i < cap) body[i] = b;
+      }
+      if (wanted) return (int)remaining;
+    }
+  }
+};
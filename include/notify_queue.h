@@ -0,0 +1,177 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "alert_rules.h"
+#include "num_format.h"
+
+// Outbound alert notifications.
+//
+// Alert transitions are appended to a fixed-capacity queue; the uplink task
+// sends the oldest entries in batches and removes them only once every
+// configured transport accepted the batch (at-least-once delivery, receivers
+// de-duplicate by seq). When the queue is full the oldest entry is dropped
+// and counted. The queue holds plain records so it can be written to flash
+// as-is (NotifyFileHeader + records).
+
+enum NotifyEvent : uint8_t { NOTIFY_RAISED, NOTIFY_CLEARED, NOTIFY_ACKNOWLEDGED };
+
+struct Notification {
+  uint32_t seq;               // Assigned by the queue, increases across reboots
+  uint32_t ts;                // Time of the transition
+  float value;                // Metric value (or rate / silent seconds) at the transition
+  float threshold;
+  uint8_t event;              // NotifyEvent
+  uint8_t rule;
+  uint8_t channel;
+  uint8_t type;               // RuleType
+  uint8_t metric;             // RuleMetric
+  uint8_t reserved[3];
+  char name[ALERT_NAME_MAX];
+};
+
+static_assert(sizeof(Notification) == 48, "Notification layout changed");
+
+constexpr uint32_t NOTIFY_MAGIC = 0x5946544E;   // "NTFY" little-endian
+constexpr uint16_t NOTIFY_VERSION = 1;
+
+struct NotifyFileHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t recordSize;
+  uint32_t count;
+  uint32_t nextSeq;
+  uint32_t crc;               // CRC32 over the records
+};
+
+template <size_t N>
+class NotifyQueue {
+ public:
+  static constexpr size_t capacity() { return N; }
+  size_t size() const { return count_; }
+  bool empty() const { return count_ == 0; }
+  uint32_t dropped() const { return dropped_; }
+  uint32_t nextSeq() const { return nextSeq_; }
+
+  // i-th oldest entry
+  Notification &at(size_t i) { return items_[(first_ + i) % N]; }
+  const Notification &at(size_t i) const { return items_[(first_ + i) % N]; }
+
+  // Appends a copy of n with the next sequence number; returns that number
+  uint32_t push(const Notification &n) {
+    if (count_ == N) {
+      first_ = (first_ + 1) % N;
+      count_--;
+      dropped_++;
+    }
+    Notification &slot = items_[(first_ + count_) % N];
+    slot = n;
+    slot.seq = nextSeq_++;
+    count_++;
+    return slot.seq;
+  }
+
+  // Copies up to max of the oldest entries; returns how many
+  size_t peek(Notification *out, size_t max) const {
+    size_t n = count_ < max ? count_ : max;
+    for (size_t i = 0; i < n; i++) out[i] = at(i);
+    return n;
+  }
+
+  // Removes delivered entries up to and including seq
+  void ackThrough(uint32_t seq) {
+    while (count_ > 0 && (int32_t)(at(0).seq - seq) <= 0) {
+      first_ = (first_ + 1) % N;
+      count_--;
+    }
+  }
+
+  // Replaces the content with entries read back from flash (oldest first)
+  void restore(const Notification *items, size_t n, uint32_t nextSeq) {
+    clear();
+    if (n > N) {
+      items += n - N;
+      n = N;
+    }
+    for (size_t i = 0; i < n; i++) items_[i] = items[i];
+    count_ = n;
+    nextSeq_ = nextSeq;
+  }
+
+  void clear() {
+    first_ = 0;
+    count_ = 0;
+  }
+
+ private:
+  Notification items_[N];
+  size_t first_ = 0;
+  size_t count_ = 0;
+  uint32_t dropped_ = 0;
+  uint32_t nextSeq_ = 1;
+};
+
+inline const char *notifyEventName(uint8_t e) {
+  static const char *const names[] = {"raised", "cleared", "acknowledged"};
+  return e <= NOTIFY_ACKNOWLEDGED ? names[e] : "?";
+}
+
+// Appends s as a JSON string literal; control characters are dropped
+inline bool appendJsonString(char *&p, const char *end, const char *s) {
+  if (p >= end) return false;
+  *p++ = '"';
+  for (; *s; s++) {
+    unsigned char c = *s;
+    if (c < 0x20) continue;
+    if (c == '"' || c == '\\') {
+      if (p >= end) return false;
+      *p++ = '\\';
+    }
+    if (p >= end) return false;
+    *p++ = c;
+  }
+  if (p >= end) return false;
+  *p++ = '"';
+  return true;
+}
+
+// Formats a batch as {"device":..,"events":[..]} into out (NUL-terminated).
+// Returns the length, or 0 if the batch does not fit into cap.
+inline size_t formatNotifyBatch(char *out, size_t cap, const char *device,
+                                const char *(*channelName)(uint8_t),
+                                const Notification *items, size_t n) {
+  char *p = out;
+  const char *end = out + cap - 1;   // Room for the NUL
+  int w;
+
+#define NOTIFY_APPEND(...)                                   \
+  w = snprintf(p, end - p + 1, __VA_ARGS__);                 \
+  if (w < 0 || w > end - p) return 0;                        \
+  p += w;
+
+  NOTIFY_APPEND("{\"device\":");
+  if (!appendJsonString(p, end, device)) return 0;
+  NOTIFY_APPEND(",\"events\":[");
+  for (size_t i = 0; i < n; i++) {
+    const Notification &e = items[i];
+    NOTIFY_APPEND("%s{\"seq\":%u,\"ts\":%u,\"event\":\"%s\",\"rule\":%u,\"name\":",
+                  i ? "," : "", (unsigned)e.seq, (unsigned)e.ts, notifyEventName(e.event), e.rule);
+    if (!appendJsonString(p, end, e.name)) return 0;
+    NOTIFY_APPEND(",\"channel\":");
+    if (!appendJsonString(p, end, channelName(e.channel))) return 0;
+    NOTIFY_APPEND(",\"metric\":\"%s\",\"type\":\"%s\",\"value\":",
+                  ruleMetricName((RuleMetric)e.metric), ruleTypeName((RuleType)e.type));
+    // NaN (e.g. no rate yet) is not valid JSON
+    char value[NUM_FORMAT_MAX + 1], threshold[NUM_FORMAT_MAX + 1];
+    value[formatFixed(value, e.value, 2, false)] = '\0';
+    threshold[formatFixed(threshold, e.threshold, 2, false)] = '\0';
+    NOTIFY_APPEND("%s,\"threshold\":%s}", value[0] ? value : "null", threshold[0] ? threshold : "null");
+  }
+  NOTIFY_APPEND("]}");
+#undef NOTIFY_APPEND
+
+  *p = '\0';
+  return p - out;
+}
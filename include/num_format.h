@@ -0,0 +1,203 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Number formatting and parsing without printf/strtod.
+//
+// Readings have one decimal (DHT, SHT3x after rounding) and aggregates two,
+// so values are scaled to an integer once and printed digit pairs at a
+// time; no double math, no locale, no format string parsing. The scaling
+// works on the float's mantissa in integer arithmetic, so rounding is exact
+// and matches printf("%.Nf"), ties to even included (but never prints "-0").
+// Magnitudes beyond the 32-bit range fall back to snprintf; text that
+// would not fit NUM_FORMAT_MAX (|v| from about 1e18) is treated like NaN.
+//
+// The format functions write into the caller's buffer (NUM_FORMAT_MAX fits
+// every output), add no terminator and return the number of characters
+// written. The parse functions take a whole NUL-terminated string and
+// reject anything that is not a plain number.
+
+constexpr size_t NUM_FORMAT_MAX = 24;
+
+namespace num_format_detail {
+constexpr char DIGIT_PAIRS[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+constexpr uint32_t POW10[] = {1, 10, 100, 1000, 10000};
+// Exact in float up to 1e10 (5^10 < 2^24)
+constexpr float POW10F[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+}
+
+inline size_t formatUint(char *out, uint32_t v) {
+  char tmp[10];
+  char *p = tmp + sizeof(tmp);
+  while (v >= 100) {
+    const char *d = num_format_detail::DIGIT_PAIRS + (v % 100) * 2;
+    v /= 100;
+    *--p = d[1];
+    *--p = d[0];
+  }
+  if (v >= 10) {
+    const char *d = num_format_detail::DIGIT_PAIRS + v * 2;
+    *--p = d[1];
+    *--p = d[0];
+  } else {
+    *--p = '0' + v;
+  }
+  size_t n = tmp + sizeof(tmp) - p;
+  for (size_t i = 0; i < n; i++) out[i] = p[i];
+  return n;
+}
+
+inline size_t formatInt(char *out, int32_t v) {
+  if (v >= 0) return formatUint(out, (uint32_t)v);
+  *out = '-';
+  return 1 + formatUint(out + 1, 0u - (uint32_t)v);
+}
+
+namespace num_format_detail {
+// Sign, integer part, point and `decimals` fraction digits of units
+inline size_t writeScaled(char *out, bool negative, uint32_t units, uint8_t decimals, bool trim) {
+  uint32_t scale = POW10[decimals];
+  char *p = out;
+  if (negative && units) *p++ = '-';
+  p += formatUint(p, units / scale);
+  uint32_t frac = units % scale;
+  if (decimals == 0 || (trim && frac == 0)) return p - out;
+
+  *p++ = '.';
+  for (uint8_t i = decimals; i-- > 0;) {
+    p[i] = '0' + frac % 10;
+    frac /= 10;
+  }
+  p += decimals;
+  if (trim) {
+    while (p[-1] == '0') p--;
+  }
+  return p - out;
+}
+}
+
+// v with `decimals` (0-4) places; trim drops trailing zeros and a bare
+// point ("21.50" -> "21.5", "21.00" -> "21"). Writes nothing for NaN/inf
+// or a value too large to print (callers decide between "", "null" or a
+// placeholder).
+inline size_t formatFixed(char *out, float v, uint8_t decimals, bool trim = true) {
+  if (!isfinite(v)) return 0;
+  if (decimals > 4) decimals = 4;
+  uint32_t scale = num_format_detail::POW10[decimals];
+
+  // |v| * scale = mant * scale * 2^exp exactly (mant < 2^24, scale < 2^14)
+  uint32_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  uint32_t mant = bits & 0x7FFFFF;
+  int exp = (bits >> 23) & 0xFF;
+  if (exp) mant |= 0x800000;
+  exp = (exp ? exp : 1) - 150;
+  uint64_t prod = (uint64_t)mant * scale;
+  uint64_t scaled;
+  if (exp >= 0) {
+    scaled = exp < 26 ? prod << exp : UINT64_MAX;
+  } else if (exp > -64) {
+    // Round to nearest, ties to even
+    int sh = -exp;
+    scaled = prod >> sh;
+    uint64_t rem = prod & ((1ULL << sh) - 1);
+    uint64_t half = 1ULL << (sh - 1);
+    if (rem > half || (rem == half && (scaled & 1))) scaled++;
+  } else {
+    scaled = 0;
+  }
+  if (scaled > UINT32_MAX) {
+    int n = snprintf(out, NUM_FORMAT_MAX, "%.*f", decimals, v);
+    return n < 0 || n >= (int)NUM_FORMAT_MAX ? 0 : (size_t)n;
+  }
+
+  return num_format_detail::writeScaled(out, v < 0, (uint32_t)scaled, decimals, trim);
+}
+
+// An integer in units of 10^-decimals (0-4), e.g. centi-degrees: (-512, 2)
+// -> "-5.12". Exact, nothing to round.
+inline size_t formatScaled(char *out, int32_t units, uint8_t decimals, bool trim = false) {
+  if (decimals > 4) decimals = 4;
+  bool negative = units < 0;
+  return num_format_detail::writeScaled(out, negative, negative ? 0u - (uint32_t)units : (uint32_t)units, decimals, trim);
+}
+
+// Copies a NUL-terminated string, returns its length
+inline size_t formatStr(char *out, const char *s) {
+  char *p = out;
+  while (*s) *p++ = *s++;
+  return p - out;
+}
+
+// NUL-terminated text of one value, for printf("%s") in log lines:
+//   Serial.printf("%s°C\n", FixedText(t, 1).s);
+// NaN/inf print as "nan".
+struct FixedText {
+  char s[NUM_FORMAT_MAX + 1];
+  FixedText(float v, uint8_t decimals, bool trim = false) {
+    size_t n = formatFixed(s, v, decimals, trim);
+    if (n == 0) n = formatStr(s, "nan");
+    s[n] = '\0';
+  }
+};
+
+// Decimal integer, no sign, no spaces; false on anything else or overflow
+inline bool parseUint(const char *s, uint32_t &out) {
+  if (*s < '0' || *s > '9') return false;
+  uint32_t v = 0;
+  for (; *s >= '0' && *s <= '9'; s++) {
+    uint32_t d = *s - '0';
+    if (v > (UINT32_MAX - d) / 10) return false;
+    v = v * 10 + d;
+  }
+  if (*s) return false;
+  out = v;
+  return true;
+}
+
+// [+-]digits[.digits] (".5" and "5." too), no exponent, no spaces; false
+// on anything else. Up to 7 significant digits (every threshold, reading
+// and hysteresis a client sends) are one integer accumulation and one
+// float division, which is correctly rounded; longer input goes to strtof.
+// Both give the float nearest to the text.
+inline bool parseFixed(const char *s, float &out) {
+  const char *start = s;
+  bool negative = *s == '-';
+  if (*s == '+' || *s == '-') s++;
+  uint32_t mant = 0;
+  uint8_t digits = 0, fracDigits = 0;
+  bool point = false, any = false, precise = true;
+  for (;; s++) {
+    if (*s >= '0' && *s <= '9') {
+      any = true;
+      if (mant == 0 && *s == '0' && !point) continue;   // Leading zeros
+      if (digits < 9) {
+        mant = mant * 10 + (*s - '0');
+        digits++;
+        if (point) fracDigits++;
+      } else if (!point || *s != '0') {
+        precise = false;                                 // Leave it to strtof
+      }
+    } else if (*s == '.' && !point) {
+      point = true;
+    } else {
+      break;
+    }
+  }
+  if (*s || !any) return false;
+  if (precise && mant < (1u << 24) && fracDigits <= 10) {
+    float v = (float)mant / num_format_detail::POW10F[fracDigits];
+    out = negative ? -v : v;
+  } else {
+    out = strtof(start, nullptr);
+  }
+  return true;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+// Burst/oversampling filter: N raw readings of one sample slot in, one
+// clean value per quantity plus a variance estimate out.
+//
+// Outliers are rejected against the median using the median absolute
+// deviation (robust sigma = 1.4826 * MAD). The floor keeps quantized
+// sensors (DHT11: 1 °C / 1 %) from rejecting a single-step difference when
+// most readings are identical and MAD is 0. All buffers live in the object
+// or on the stack; nothing allocates.
+
+constexpr size_t OVERSAMPLE_MAX = 16;
+
+enum class SampleFilter : uint8_t {
+  Median,        // Median of the accepted readings
+  TrimmedMean    // Mean of the accepted readings without the lowest/highest 25 %
+};
+
+struct FilterResult {
+  float value;
+  float variance;    // Sample variance of the accepted readings (0 if only one)
+  uint8_t used;      // Accepted readings
+};
+
+// Insertion sort, fine for N <= OVERSAMPLE_MAX
+inline void sortSamples(float *v, size_t n) {
+  for (size_t i = 1; i < n; i++) {
+    float x = v[i];
+    size_t j = i;
+    while (j > 0 && v[j - 1] > x) {
+      v[j] = v[j - 1];
+      j--;
+    }
+    v[j] = x;
+  }
+}
+
+// Median of a sorted array
+inline float sortedMedian(const float *v, size_t n) {
+  return (n & 1) ? v[n / 2] : 0.5f * (v[n / 2 - 1] + v[n / 2]);
+}
+
+// Filters n (1..OVERSAMPLE_MAX) values; sorts v in place
+inline FilterResult filterSamples(float *v, size_t n, SampleFilter filter, float outlierK, float floor) {
+  sortSamples(v, n);
+  float median = sortedMedian(v, n);
+
+  float dev[OVERSAMPLE_MAX];
+  for (size_t i = 0; i < n; i++) dev[i] = fabsf(v[i] - median);
+  sortSamples(dev, n);
+  float sigma = 1.4826f * sortedMedian(dev, n);
+  float limit = outlierK * (sigma > floor ? sigma : floor);
+
+  // Accepted readings form a contiguous run of the sorted array
+  size_t lo = 0, hi = n;
+  while (lo < hi && median - v[lo] > limit) lo++;
+  while (hi > lo && v[hi - 1] - median > limit) hi--;
+
+  FilterResult r;
+  r.used = hi - lo;
+  if (filter == SampleFilter::Median) {
+    r.value = sortedMedian(v + lo, hi - lo);
+  } else {
+    size_t trim = (hi - lo) / 4;
+    float sum = 0;
+    for (size_t i = lo + trim; i < hi - trim; i++) sum += v[i];
+    r.value = sum / (hi - lo - 2 * trim);
+  }
+
+  float mean = 0;
+  for (size_t i = lo; i < hi; i++) mean += v[i];
+  mean /= r.used;
+  float sq = 0;
+  for (size_t i = lo; i < hi; i++) sq += (v[i] - mean) * (v[i] - mean);
+  r.variance = r.used > 1 ? sq / (r.used - 1) : 0;
+  return r;
+}
+
+// Collects the readings of one slot
+class Oversampler {
+ public:
+  void reset() {
+    count_ = 0;
+    invalid_ = 0;
+  }
+
+  // Valid reading; ignored once OVERSAMPLE_MAX readings are stored
+  void add(float t, float h) {
+    if (count_ >= OVERSAMPLE_MAX) return;
+    t_[count_] = t;
+    h_[count_] = h;
+    count_++;
+  }
+
+  // Failed or out-of-range reading
+  void addInvalid() { invalid_++; }
+
+  uint8_t taken() const { return count_ + invalid_; }
+  uint8_t valid() const { return count_; }
+  uint8_t invalid() const { return invalid_; }
+
+  // False if no valid reading was collected
+  bool finish(SampleFilter filter, float outlierK, float floorT, float floorH,
+              FilterResult &t, FilterResult &h) {
+    if (count_ == 0) return false;
+    t = filterSamples(t_, count_, filter, outlierK, floorT);
+    h = filterSamples(h_, count_, filter, outlierK, floorH);
+    return true;
+  }
+
+ private:
+  float t_[OVERSAMPLE_MAX];
+  float h_[OVERSAMPLE_MAX];
+  uint8_t count_ = 0;
+  uint8_t invalid_ = 0;
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <esp_partition.h>
+#include "raw_log.h"
+
+// FlashRegion over a raw data partition, found by its label in the
+// partition table. Reads and writes go straight to the flash driver; there
+// is no filesystem, cache or wear leveling in between.
+class PartitionRegion : public FlashRegion {
+ public:
+  explicit PartitionRegion(const char *label) : label_(label) {}
+
+  // False if the partition table has no data partition with this label
+  bool begin() {
+    part_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label_);
+    return part_ != nullptr;
+  }
+
+  size_t size() const override { return part_ ? part_->size : 0; }
+
+  bool read(size_t offset, void *buf, size_t len) override {
+    return part_ && esp_partition_read(part_, offset, buf, len) == ESP_OK;
+  }
+
+  bool write(size_t offset, const void *data, size_t len) override {
+    return part_ && esp_partition_write(part_, offset, data, len) == ESP_OK;
+  }
+
+  bool erase(size_t offset, size_t len) override {
+    return part_ && esp_partition_erase_range(part_, offset, len) == ESP_OK;
+  }
+
+ private:
+  const char *label_;
+  const esp_partition_t *part_ = nullptr;
+};
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "history_format.h"   // crc32Update()
+
+// Flash area accessed without a filesystem: a raw data partition on the
+// device, a RAM image in host tests. Offsets are relative to the area,
+// erase() works on whole sectors and write() can only clear bits.
+constexpr size_t FLASH_SECTOR_SIZE = 4096;
+
+class FlashRegion {
+ public:
+  virtual ~FlashRegion() {}
+  virtual size_t size() const = 0;
+  virtual bool read(size_t offset, void *buf, size_t len) = 0;
+  virtual bool write(size_t offset, const void *data, size_t len) = 0;
+  virtual bool erase(size_t offset, size_t len) = 0;
+};
+
+// Circular log of fixed-size records in a FlashRegion.
+//
+//   sector: [RawSectorHeader][slot * slotsPerSector()]
+//   slot:   [T][CRC32 over T]
+//
+// Sectors are filled in order; once the newest sector is full the next one
+// is erased and stamped with the next sequence number, which drops the
+// oldest sector's records. There is no cache: a record is on flash when
+// append() returns. A slot torn by power loss fails its CRC and is skipped
+// by forEach(); the write position always resumes behind the last slot that
+// is not fully erased, so a partly programmed slot is never written again.
+// mount() reads the sector headers plus one sector, so its cost does not
+// grow with the amount of data. Not thread-safe.
+
+constexpr uint32_t RAW_LOG_MAGIC = 0x474F4C52;   // "RLOG" little-endian
+
+struct RawSectorHeader {
+  uint32_t magic;
+  uint32_t seq;               // Increases with every sector started
+  uint16_t recordSize;
+  uint16_t reserved;
+  uint32_t crc;               // CRC32 over the preceding fields
+};
+
+static_assert(sizeof(RawSectorHeader) == 16, "RawSectorHeader layout changed");
+
+template <class T>
+class RawLog {
+ public:
+  static constexpr size_t SLOT_SIZE = sizeof(T) + sizeof(uint32_t);
+
+  explicit RawLog(FlashRegion &region) : region_(region) {}
+
+  static constexpr size_t slotsPerSector() {
+    return (FLASH_SECTOR_SIZE - sizeof(RawSectorHeader)) / SLOT_SIZE;
+  }
+
+  // Records that survive in any case; up to one more sector is kept
+  size_t capacity() const { return sectors_ > 1 ? (sectors_ - 1) * slotsPerSector() : 0; }
+  bool mounted() const { return sectors_ > 1; }
+
+  // Locates the newest sector and the write position. An empty or foreign
+  // region mounts as an empty log; its sectors are erased on first use.
+  bool mount() {
+    sectors_ = region_.size() / FLASH_SECTOR_SIZE;
+    head_ = -1;
+    used_ = 0;
+    writeSlot_ = 0;
+    if (sectors_ < 2) {
+      sectors_ = 0;
+      return false;
+    }
+    uint32_t headSeq = 0;
+    for (size_t i = 0; i < sectors_; i++) {
+      uint32_t seq;
+      if (!readSectorSeq(i, seq)) continue;
+      if (head_ < 0 || (int32_t)(seq - headSeq) > 0) {
+        head_ = (int)i;
+        headSeq = seq;
+      }
+    }
+    if (head_ < 0) return true;
+    headSeq_ = headSeq;
+    // Sectors before the head with consecutive sequence numbers belong to the log
+    used_ = 1;
+    while (used_ < sectors_) {
+      uint32_t seq;
+      size_t prev = (head_ + sectors_ - used_) % sectors_;
+      if (!readSectorSeq(prev, seq) || seq != headSeq - used_) break;
+      used_++;
+    }
+    uint8_t slot[SLOT_SIZE];
+    for (size_t s = 0; s < slotsPerSector(); s++) {
+      if (!region_.read(slotOffset(head_, s), slot, SLOT_SIZE)) return false;
+      if (!erased(slot, SLOT_SIZE)) writeSlot_ = s + 1;
+    }
+    return true;
+  }
+
+  // Appends n records with as few flash writes as possible; false on a
+  // flash error (records before the failing write are kept)
+  bool append(const T *items, size_t n) {
+    if (!mounted()) return false;
+    uint8_t buf[FLASH_WRITE_CHUNK];
+    while (n > 0) {
+      if (head_ < 0 || writeSlot_ >= slotsPerSector()) {
+        if (!startSector()) return false;
+      }
+      // Contiguous run inside the head sector, written in buffer-sized chunks
+      size_t run = slotsPerSector() - writeSlot_;
+      if (run > n) run = n;
+      if (run > sizeof(buf) / SLOT_SIZE) run = sizeof(buf) / SLOT_SIZE;
+      for (size_t k = 0; k < run; k++) {
+        uint32_t crc = crc32Update(0, &items[k], sizeof(T));
+        memcpy(buf + k * SLOT_SIZE, &items[k], sizeof(T));
+        memcpy(buf + k * SLOT_SIZE + sizeof(T), &crc, sizeof(crc));
+      }
+      size_t offset = slotOffset(head_, writeSlot_);
+      writeSlot_ += run;   // Even on failure: the slots may be partly programmed
+      if (!region_.write(offset, buf, run * SLOT_SIZE)) return false;
+      items += run;
+      n -= run;
+    }
+    return true;
+  }
+
+  bool append(const T &item) { return append(&item, 1); }
+
+  // Calls fn(record) for every intact record, oldest first; returns the
+  // number of records delivered. Torn slots are counted in corrupt().
+  template <class Fn>
+  size_t forEach(Fn fn) { return visit(fn, false); }
+
+  // Same, newest record first
+  template <class Fn>
+  size_t forEachNewestFirst(Fn fn) { return visit(fn, true); }
+
+  // Erases every sector of the region
+  bool clear() {
+    if (!mounted()) return false;
+    head_ = -1;
+    used_ = 0;
+    writeSlot_ = 0;
+    return region_.erase(0, sectors_ * FLASH_SECTOR_SIZE);
+  }
+
+  size_t corrupt() const { return corrupt_; }
+  size_t sectorsInUse() const { return used_; }
+
+ private:
+  static constexpr size_t FLASH_WRITE_CHUNK = 256;   // One flash page
+  static_assert(SLOT_SIZE <= FLASH_WRITE_CHUNK, "record too large for RawLog");
+
+  FlashRegion &region_;
+  size_t sectors_ = 0;
+  int head_ = -1;             // Sector receiving appends, -1 while empty
+  uint32_t headSeq_ = 0;
+  size_t used_ = 0;           // Sectors holding records (head and its predecessors)
+  size_t writeSlot_ = 0;      // Next free slot in the head sector
+  size_t corrupt_ = 0;
+
+  template <class Fn>
+  size_t visit(Fn &fn, bool newestFirst) {
+    corrupt_ = 0;
+    if (head_ < 0) return 0;
+    size_t delivered = 0;
+    uint8_t slot[SLOT_SIZE];
+    for (size_t i = 0; i < used_; i++) {
+      size_t back = newestFirst ? i : used_ - 1 - i;   // Sectors behind the head
+      int sector = (int)((head_ + sectors_ - back) % sectors_);
+      size_t slots = sector == head_ ? writeSlot_ : slotsPerSector();
+      for (size_t k = 0; k < slots; k++) {
+        size_t s = newestFirst ? slots - 1 - k : k;
+        if (!region_.read(slotOffset(sector, s), slot, SLOT_SIZE)) {
+          corrupt_++;
+          continue;
+        }
+        uint32_t crc;
+        memcpy(&crc, slot + sizeof(T), sizeof(crc));
+        if (crc != crc32Update(0, slot, sizeof(T))) {
+          if (!erased(slot, SLOT_SIZE)) corrupt_++;
+          continue;
+        }
+        T item;
+        memcpy(&item, slot, sizeof(T));
+        fn(item);
+        delivered++;
+      }
+    }
+    return delivered;
+  }
+
+  size_t slotOffset(int sector, size_t slot) const {
+    return sector * FLASH_SECTOR_SIZE + sizeof(RawSectorHeader) + slot * SLOT_SIZE;
+  }
+
+  static bool erased(const uint8_t *p, size_t len) {
+    while (len--) {
+      if (*p++ != 0xFF) return false;
+    }
+    return true;
+  }
+
+  bool readSectorSeq(size_t sector, uint32_t &seq) {
+    RawSectorHeader hdr;
+    if (!region_.read(sector * FLASH_SECTOR_SIZE, &hdr, sizeof(hdr))) return false;
+    if (hdr.magic != RAW_LOG_MAGIC || hdr.recordSize != sizeof(T) ||
+        hdr.crc != crc32Update(0, &hdr, offsetof(RawSectorHeader, crc))) {
+      return false;
+    }
+    seq = hdr.seq;
+    return true;
+  }
+
+  // Erases the sector after the head and makes it the new head
+  bool startSector() {
+    int next = head_ < 0 ? 0 : (head_ + 1) % (int)sectors_;
+    uint32_t seq = head_ < 0 ? 1 : headSeq_ + 1;
+    if (used_ == sectors_) used_--;   // The oldest sector is about to be dropped
+    if (!region_.erase(next * FLASH_SECTOR_SIZE, FLASH_SECTOR_SIZE)) return false;
+    RawSectorHeader hdr = {RAW_LOG_MAGIC, seq, (uint16_t)sizeof(T), 0, 0};
+    hdr.crc = crc32Update(0, &hdr, offsetof(RawSectorHeader, crc));
+    if (!region_.write(next * FLASH_SECTOR_SIZE, &hdr, sizeof(hdr))) return false;
+    head_ = next;
+    headSeq_ = seq;
+    writeSlot_ = 0;
+    used_++;
+    return true;
+  }
+};
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+// Incremental windowed statistics for temperature and humidity.
+//
+// push() is O(1) amortized: mean, variance and the least-squares slope come
+// from running sums, min/max from monotonic queues. The window is time
+// based (entries older than windowSec are evicted), so missed slots do not
+// stretch it; N only bounds how many samples fit. Float sums drift when
+// values are added and removed, so they are rebuilt from the stored
+// samples once every N pushes, relative to the current oldest sample.
+
+enum StatQuantity : uint8_t { STAT_T = 0, STAT_H = 1 };
+
+template <size_t N>
+class RollingStats {
+ public:
+  void setWindow(uint32_t windowSec) { windowSec_ = windowSec; }
+  uint32_t window() const { return windowSec_; }
+
+  size_t size() const { return count_; }
+  bool empty() const { return count_ == 0; }
+
+  void push(uint32_t ts, float t, float h) {
+    // Evict by age, then by capacity
+    while (count_ > 0 && ts - ts_[slot(head_)] >= windowSec_) popOldest();
+    if (count_ == N) popOldest();
+
+    uint32_t seq = head_ + count_;
+    size_t idx = slot(seq);
+    ts_[idx] = ts;
+    v_[STAT_T][idx] = t;
+    v_[STAT_H][idx] = h;
+    count_++;
+
+    if (count_ == 1 || ++sinceRebuild_ >= N) {
+      rebuild();
+    } else {
+      addSums(idx, 1.0f);
+    }
+    for (int q = 0; q < 2; q++) {
+      pushMin(q, seq);
+      pushMax(q, seq);
+    }
+  }
+
+  float mean(StatQuantity q) const { return count_ ? vBase_[q] + sum_[q] / count_ : NAN; }
+
+  float variance(StatQuantity q) const {
+    if (count_ < 2) return 0;
+    float var = (sumSq_[q] - sum_[q] * sum_[q] / count_) / (count_ - 1);
+    return var > 0 ? var : 0;
+  }
+
+  float minimum(StatQuantity q) const { return count_ ? v_[q][slot(minQ_[q][slot(minHead_[q])])] : NAN; }
+  float maximum(StatQuantity q) const { return count_ ? v_[q][slot(maxQ_[q][slot(maxHead_[q])])] : NAN; }
+
+  // Least-squares trend over the window, per minute; 0 below 2 samples
+  float slopePerMin(StatQuantity q) const {
+    if (count_ < 2) return 0;
+    float den = count_ * sumXX_ - sumX_ * sumX_;
+    if (den <= 0) return 0;
+    return (count_ * sumXY_[q] - sumX_ * sum_[q]) / den * 60.0f;
+  }
+
+  // Seconds between the oldest and newest sample
+  uint32_t span() const { return count_ ? ts_[slot(head_ + count_ - 1)] - ts_[slot(head_)] : 0; }
+
+  // Adds offset to timestamps below minTs (clock re-basing after NTP sync)
+  void shiftTimestamps(uint32_t minTs, uint32_t offset) {
+    for (uint32_t i = 0; i < count_; i++) {
+      size_t idx = slot(head_ + i);
+      if (ts_[idx] < minTs) ts_[idx] += offset;
+    }
+    if (count_) rebuild();
+  }
+
+  void clear() {
+    count_ = 0;
+    for (int q = 0; q < 2; q++) minLen_[q] = maxLen_[q] = 0;
+  }
+
+ private:
+  uint32_t windowSec_ = 600;
+  uint32_t ts_[N];
+  float v_[2][N];
+  uint32_t head_ = 0;          // Sequence number of the oldest sample
+  uint32_t count_ = 0;
+  uint32_t sinceRebuild_ = 0;
+
+  // Sums relative to tBase_ / vBase_ (keeps float cancellation small)
+  uint32_t tBase_ = 0;
+  float vBase_[2] = {0, 0};
+  float sumX_ = 0, sumXX_ = 0;
+  float sum_[2] = {0, 0}, sumSq_[2] = {0, 0}, sumXY_[2] = {0, 0};
+
+  // Monotonic queues of sequence numbers (front = current min/max)
+  uint32_t minQ_[2][N], maxQ_[2][N];
+  uint32_t minHead_[2] = {0, 0}, maxHead_[2] = {0, 0};
+  uint32_t minLen_[2] = {0, 0}, maxLen_[2] = {0, 0};
+
+  static size_t slot(uint32_t seq) { return seq % N; }
+
+  void addSums(size_t idx, float sign) {
+    float x = (float)(int32_t)(ts_[idx] - tBase_);
+    sumX_ += sign * x;
+    sumXX_ += sign * x * x;
+    for (int q = 0; q < 2; q++) {
+      float y = v_[q][idx] - vBase_[q];
+      sum_[q] += sign * y;
+      sumSq_[q] += sign * y * y;
+      sumXY_[q] += sign * x * y;
+    }
+  }
+
+  void rebuild() {
+    sinceRebuild_ = 0;
+    size_t oldest = slot(head_);
+    tBase_ = ts_[oldest];
+    sumX_ = sumXX_ = 0;
+    for (int q = 0; q < 2; q++) {
+      vBase_[q] = v_[q][oldest];
+      sum_[q] = sumSq_[q] = sumXY_[q] = 0;
+    }
+    for (uint32_t i = 0; i < count_; i++) addSums(slot(head_ + i), 1.0f);
+  }
+
+  void popOldest() {
+    addSums(slot(head_), -1.0f);
+    for (int q = 0; q < 2; q++) {
+      if (minLen_[q] && minQ_[q][slot(minHead_[q])] == head_) { minHead_[q]++; minLen_[q]--; }
+      if (maxLen_[q] && maxQ_[q][slot(maxHead_[q])] == head_) { maxHead_[q]++; maxLen_[q]--; }
+    }
+    head_++;
+    count_--;
+  }
+
+  void pushMin(int q, uint32_t seq) {
+    float x = v_[q][slot(seq)];
+    while (minLen_[q] && v_[q][slot(minQ_[q][slot(minHead_[q] + minLen_[q] - 1)])] >= x) minLen_[q]--;
+    minQ_[q][slot(minHead_[q] + minLen_[q])] = seq;
+    minLen_[q]++;
+  }
+
+  void pushMax(int q, uint32_t seq) {
+    float x = v_[q][slot(seq)];
+    while (maxLen_[q] && v_[q][slot(maxQ_[q][slot(maxHead_[q] + maxLen_[q] - 1)])] <= x) maxLen_[q]--;
+    maxQ_[q][slot(maxHead_[q] + maxLen_[q])] = seq;
+    maxLen_[q]++;
+  }
+};
+
+// Dew point in °C (Magnus formula, Sonntag coefficients)
+inline float dewPoint(float t, float rh) {
+  if (rh <= 0) return NAN;
+  const float a = 17.62f, b = 243.12f;
+  float gamma = logf(rh / 100.0f) + a * t / (b + t);
+  return b * gamma / (a - gamma);
+}
+
+// Absolute humidity in g/m³
+inline float absoluteHumidity(float t, float rh) {
+  float saturation = 6.112f * expf(17.62f * t / (243.12f + t));   // hPa
+  return 216.7f * (rh / 100.0f * saturation) / (273.15f + t);
+}
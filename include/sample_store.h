@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Fixed-capacity sample ring in structure-of-arrays layout.
+//
+// Every field lives in its own array, so a consumer that only needs
+// timestamps and temperatures never pulls humidity or bookkeeping fields
+// through the cache, and each channel owns separate arrays. Storage is
+// allocated statically; pushing never touches the heap and overwrites the
+// oldest entry once the ring is full.
+template <size_t N>
+class SampleRing {
+ public:
+  uint32_t ts[N];         // Slot timestamp (seconds)
+  float t[N];             // Temperature in Celsius
+  float h[N];             // Humidity in %
+  uint16_t n[N];          // Samples behind the value (1 for detailed data)
+  uint16_t missed[N];     // Gap marker / empty slots in the bucket
+  uint16_t jitterMs[N];   // Delay after the slot boundary (worst in bucket)
+
+  static constexpr size_t capacity() { return N; }
+  size_t size() const { return count_; }
+  bool empty() const { return count_ == 0; }
+  bool full() const { return count_ == N; }
+
+  // Physical index of the i-th oldest entry (0 = oldest)
+  size_t at(size_t i) const { return (first_ + i) % N; }
+  size_t newest() const { return at(count_ - 1); }
+
+  // Appends a sample, dropping the oldest when full. Returns its index.
+  size_t push(uint32_t ts_, float t_, float h_, uint16_t n_, uint16_t missed_, uint16_t jitter_) {
+    size_t idx;
+    if (count_ < N) {
+      idx = at(count_);
+      count_++;
+    } else {
+      idx = first_;
+      first_ = (first_ + 1) % N;
+    }
+    set(idx, ts_, t_, h_, n_, missed_, jitter_);
+    return idx;
+  }
+
+  // Inserts a sample older than everything stored; false if the ring is full
+  bool pushFront(uint32_t ts_, float t_, float h_, uint16_t n_, uint16_t missed_, uint16_t jitter_) {
+    if (count_ == N) return false;
+    first_ = (first_ + N - 1) % N;
+    count_++;
+    set(first_, ts_, t_, h_, n_, missed_, jitter_);
+    return true;
+  }
+
+  // Drops the k oldest entries
+  void dropOldest(size_t k) {
+    if (k > count_) k = count_;
+    first_ = (first_ + k) % N;
+    count_ -= k;
+  }
+
+  void clear() {
+    first_ = 0;
+    count_ = 0;
+  }
+
+ private:
+  size_t first_ = 0;
+  size_t count_ = 0;
+
+  void set(size_t idx, uint32_t ts_, float t_, float h_, uint16_t n_, uint16_t missed_, uint16_t jitter_) {
+    ts[idx] = ts_;
+    t[idx] = t_;
+    h[idx] = h_;
+    n[idx] = n_;
+    missed[idx] = missed_;
+    jitterMs[idx] = jitter_;
+  }
+};
+
+// Running rollup of the aggregation bucket that is currently being filled.
+// O(1) per sample; the bucket is closed when a sample slot of a later
+// bucket is reached.
+struct BucketAccumulator {
+  uint32_t bucketTs = 0;   // Start of the bucket (0 = nothing accumulated yet)
+  float sumT = 0;
+  float sumH = 0;
+  uint16_t n = 0;
+  uint16_t maxJitterMs = 0;
+
+  void add(float t, float h, uint16_t jitterMs) {
+    sumT += t;
+    sumH += h;
+    n++;
+    if (jitterMs > maxJitterMs) maxJitterMs = jitterMs;
+  }
+
+  void reset(uint32_t ts) {
+    bucketTs = ts;
+    sumT = sumH = 0;
+    n = 0;
+    maxJitterMs = 0;
+  }
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <DHT.h>
+#include "sensor_driver.h"
+
+// DHT11/DHT22 on a single-wire data pin (Adafruit DHT library).
+// Each read bit-bangs ~5 ms with interrupts off; DHT11 resolution is 1 °C / 1 %.
+class DhtSensor : public SensorDriver {
+ public:
+  DhtSensor(uint8_t pin, uint8_t type) : dht_(pin, type), type_(type) {}
+
+  bool begin() override {
+    dht_.begin();
+    return true;   // The DHT protocol has no presence check
+  }
+
+  bool read(float &t, float &h) override {
+    float temperature = dht_.readTemperature();
+    float humidity = dht_.readHumidity();
+    if (isnan(temperature) || isnan(humidity)) return false;
+    t = temperature;
+    h = humidity;
+    return true;
+  }
+
+  const char *model() const override { return type_ == DHT11 ? "DHT11" : "DHT22"; }
+  // The library returns its cached value for reads less than 2 s apart
+  static constexpr uint32_t MIN_INTERVAL_MS = 2000;
+  uint32_t minIntervalMs() const override { return MIN_INTERVAL_MS; }
+  // Needs ~2 s after power-up before it answers reliably
+  uint32_t warmupMs() const override { return 2000; }
+
+ private:
+  DHT dht_;
+  uint8_t type_;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+
+// Interface between the sampler and a temperature/humidity sensor.
+//
+// The sampler calls read() at most once per channel slot from loop(), so
+// drivers must not block for long: start conversions in begin() or run the
+// sensor in periodic mode and only fetch the latest result in read().
+class SensorDriver {
+ public:
+  virtual ~SensorDriver() {}
+
+  // Initializes the sensor; false if it does not respond
+  virtual bool begin() = 0;
+
+  // Latest reading; false (values untouched) if no valid data is available
+  virtual bool read(float &t, float &h) = 0;
+
+  // Model name for logs and the API, e.g. "DHT11"
+  virtual const char *model() const = 0;
+
+  // Shortest supported sample interval in milliseconds
+  virtual uint32_t minIntervalMs() const = 0;
+
+  // Time after begin() before the first reading is valid
+  virtual uint32_t warmupMs() const { return 0; }
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Wire.h>
+#include "sensor_driver.h"
+
+// Sensirion SHT30/31/35 over I2C (0.01 °C / 0.01 % resolution).
+//
+// The sensor runs in periodic mode (2 measurements per second, high
+// repeatability), so read() only fetches the latest result: one short I2C
+// transaction, no conversion wait. Both words are CRC-8 checked.
+class Sht3xSensor : public SensorDriver {
+ public:
+  explicit Sht3xSensor(uint8_t address = 0x44, TwoWire &wire = Wire) : addr_(address), wire_(wire) {}
+
+  bool begin() override {
+    if (!command(CMD_SOFT_RESET)) return false;
+    delay(2);
+    return command(CMD_PERIODIC_2MPS_HIGH);
+  }
+
+  bool read(float &t, float &h) override {
+    if (!command(CMD_FETCH_DATA)) return false;
+    if (wire_.requestFrom(addr_, (uint8_t)6) != 6) return false;   // NACK: no new data yet
+
+    uint8_t buf[6];
+    for (int i = 0; i < 6; i++) buf[i] = wire_.read();
+    if (crc8(buf, 2) != buf[2] || crc8(buf + 3, 2) != buf[5]) return false;
+
+    uint16_t rawT = (uint16_t)(buf[0] << 8) | buf[1];
+    uint16_t rawH = (uint16_t)(buf[3] << 8) | buf[4];
+    t = -45.0f + 175.0f * rawT / 65535.0f;
+    h = 100.0f * rawH / 65535.0f;
+    return true;
+  }
+
+  const char *model() const override { return "SHT3x"; }
+  static constexpr uint32_t MIN_INTERVAL_MS = 1000;   // 1 mps periodic mode
+  uint32_t minIntervalMs() const override { return MIN_INTERVAL_MS; }
+  // First periodic result after one measurement period
+  uint32_t warmupMs() const override { return 500; }
+
+  // CRC-8, polynomial 0x31, init 0xFF (datasheet section 4.12)
+  static uint8_t crc8(const uint8_t *data, int len) {
+    uint8_t crc = 0xFF;
+    for (int i = 0; i < len; i++) {
+      crc ^= data[i];
+      for (int b = 0; b < 8; b++) {
+        crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+      }
+    }
+    return crc;
+  }
+
+ private:
+  static constexpr uint16_t CMD_SOFT_RESET = 0x30A2;
+  static constexpr uint16_t CMD_PERIODIC_2MPS_HIGH = 0x2236;
+  static constexpr uint16_t CMD_FETCH_DATA = 0xE000;
+
+  uint8_t addr_;
+  TwoWire &wire_;
+
+  bool command(uint16_t cmd) {
+    wire_.beginTransmission(addr_);
+    wire_.write((uint8_t)(cmd >> 8));
+    wire_.write((uint8_t)(cmd & 0xFF));
+    return wire_.endTransmission() == 0;
+  }
+};
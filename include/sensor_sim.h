@@ -0,0 +1,40 @@
+#pragma once
+
+#include <math.h>
+#include "sensor_driver.h"
+
+// Simulated sensor for bench setups without hardware and for host builds.
+// Produces a slow daily-ish wave plus deterministic noise (xorshift32), so
+// runs are reproducible for a given seed. No Arduino dependencies.
+class SimulatedSensor : public SensorDriver {
+ public:
+  explicit SimulatedSensor(uint32_t seed = 1, uint32_t intervalMs = 1000)
+      : state_(seed ? seed : 1), intervalMs_(intervalMs) {}
+
+  bool begin() override { return true; }
+
+  bool read(float &t, float &h) override {
+    float phase = (float)(reads_++ % PERIOD_READS) / PERIOD_READS * 6.2831853f;
+    t = 22.0f + 3.0f * sinf(phase) + noise() * 0.2f;
+    h = 50.0f - 10.0f * sinf(phase) + noise() * 1.0f;
+    return true;
+  }
+
+  const char *model() const override { return "SIM"; }
+  uint32_t minIntervalMs() const override { return intervalMs_; }
+
+ private:
+  static constexpr uint32_t PERIOD_READS = 3600;
+
+  uint32_t state_;
+  uint32_t intervalMs_;
+  uint32_t reads_ = 0;
+
+  // Uniform noise in [-1, 1)
+  float noise() {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 17;
+    state_ ^= state_ << 5;
+    return (float)(state_ >> 8) / 8388608.0f - 1.0f;
+  }
+};
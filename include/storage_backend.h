@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <FS.h>
+
+// Filesystem that holds the persisted state (history, configuration,
+// queues). All file formats are plain byte streams, so any VFS that
+// arduino-esp32 provides can carry them; the backend only adds the
+// partition-level operations the firmware needs. Implementations must never
+// format implicitly: mount() on an unformatted or foreign partition fails
+// and leaves the flash untouched.
+class StorageBackend {
+ public:
+  virtual ~StorageBackend() {}
+
+  // Name for logs and the API, e.g. "littlefs"
+  virtual const char *name() const = 0;
+
+  // Filesystem object; only valid while mounted
+  virtual fs::FS &fs() = 0;
+
+  virtual bool mount() = 0;
+  virtual void unmount() = 0;
+
+  // Erases the partition and creates an empty filesystem (unmounted first)
+  virtual bool format() = 0;
+
+  virtual size_t totalBytes() = 0;
+  virtual size_t usedBytes() = 0;
+};
+
+// Backend over one of the arduino-esp32 VFS wrappers (SPIFFSFS, LittleFSFS);
+// both share the begin(formatOnFail, ...)/end()/format() interface
+template <class F>
+class VfsBackend : public StorageBackend {
+ public:
+  VfsBackend(F &vfs, const char *name) : vfs_(vfs), name_(name) {}
+
+  const char *name() const override { return name_; }
+  fs::FS &fs() override { return vfs_; }
+  bool mount() override { return vfs_.begin(false); }
+  void unmount() override { vfs_.end(); }
+
+  bool format() override {
+    vfs_.end();
+    return vfs_.format();
+  }
+
+  size_t totalBytes() override { return vfs_.totalBytes(); }
+  size_t usedBytes() override { return vfs_.usedBytes(); }
+
+ private:
+  F &vfs_;
+  const char *name_;
+};
@@ -0,0 +1,449 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <FS.h>
+#include "num_format.h"
+
+// Telemetry uplink records, RAM staging queue, flash backlog and payload
+// encoders.
+//
+// Every stored sample and every closed 5-minute rollup becomes one 16-byte
+// record with a sequence number. Records wait in a RAM queue until the
+// uplink publishes them; while the broker is unreachable the uplink spills
+// the oldest ones into a flash backlog (TelemetryLog) and drains that first
+// once the broker is back, so consumers get records in seq order.
+
+enum TelemetryKind : uint8_t { TELEMETRY_SAMPLE, TELEMETRY_ROLLUP };
+
+struct TelemetryRecord {
+  uint32_t seq;
+  uint32_t ts;          // Slot / bucket timestamp (Unix seconds, or seconds since boot)
+  int16_t t;            // Temperature in 0.01 °C
+  uint16_t h;           // Humidity in 0.01 %
+  uint16_t n;           // Samples behind the value (1 for samples)
+  uint8_t channel;
+  uint8_t kind;         // TelemetryKind
+};
+
+static_assert(sizeof(TelemetryRecord) == 16, "TelemetryRecord layout changed");
+
+constexpr size_t TELEMETRY_ROW_MAX = 64;   // One JSON record, ",[ts,ch,kind,t,h,n]"
+
+enum class TelemetryEncoding : uint8_t {
+  Json,       // {"dev":..,"seq":first,"rec":[[ts,ch,kind,t,h,n],..]}
+  Binary      // "TL" + version + count + first seq + 12-byte records (little-endian)
+};
+
+// Fixed-capacity FIFO of records waiting in RAM; drops the oldest when full
+template <size_t N>
+class TelemetryQueue {
+ public:
+  static constexpr size_t capacity() { return N; }
+  size_t size() const { return count_; }
+  bool empty() const { return count_ == 0; }
+  uint32_t dropped() const { return dropped_; }
+
+  TelemetryRecord &at(size_t i) { return items_[(first_ + i) % N]; }
+  const TelemetryRecord &at(size_t i) const { return items_[(first_ + i) % N]; }
+
+  void push(const TelemetryRecord &r) {
+    if (count_ == N) {
+      first_ = (first_ + 1) % N;
+      count_--;
+      dropped_++;
+    }
+    items_[(first_ + count_) % N] = r;
+    count_++;
+  }
+
+  size_t peek(TelemetryRecord *out, size_t max) const {
+    size_t n = count_ < max ? count_ : max;
+    for (size_t i = 0; i < n; i++) out[i] = at(i);
+    return n;
+  }
+
+  // Removes published entries up to and including seq (entries dropped
+  // in the meantime are simply gone)
+  void popThrough(uint32_t seq) {
+    while (count_ > 0 && (int32_t)(at(0).seq - seq) <= 0) {
+      first_ = (first_ + 1) % N;
+      count_--;
+    }
+  }
+
+ private:
+  TelemetryRecord items_[N];
+  size_t first_ = 0;
+  size_t count_ = 0;
+  uint32_t dropped_ = 0;
+};
+
+// Flash backlog: two append-only segment files of raw records plus a small
+// state file (acked and reserved sequence numbers). Appends go to the
+// current segment; when it is full the older segment is deleted and the
+// roles swap, so the backlog keeps the newest one to two segments.
+// Also used for the outage journal, where readers fetch by sequence number
+// (readAfter/ackThrough) instead of peek/consume. Not thread-safe.
+class TelemetryLog {
+ public:
+  TelemetryLog(fs::FS &fs, const char *segA, const char *segB, const char *statePath, size_t segmentRecords)
+      : fs_(fs), statePath_(statePath), segmentRecords_(segmentRecords) {
+    paths_[0] = segA;
+    paths_[1] = segB;
+  }
+
+  // Reads the state file and locates the first unacked record
+  void begin() {
+    State st;
+    File f = fs_.open(statePath_, "r");
+    if (f && f.read((uint8_t *)&st, sizeof(st)) == sizeof(st) && st.magic == STATE_MAGIC) {
+      ackedSeq_ = st.ackedSeq;
+      reservedSeq_ = st.reservedSeq;
+    }
+    if (f) f.close();
+
+    for (int i = 0; i < 2; i++) {
+      count_[i] = 0;
+      firstSeq_[i] = 0;
+      File seg = fs_.open(paths_[i], "r");
+      if (!seg) continue;
+      count_[i] = seg.size() / sizeof(TelemetryRecord);   // A torn tail record is ignored
+      TelemetryRecord r;
+      if (count_[i] > 0 && seg.read((uint8_t *)&r, sizeof(r)) == sizeof(r)) firstSeq_[i] = r.seq;
+      if (count_[i] > 0) {
+        seg.seek((count_[i] - 1) * sizeof(TelemetryRecord));
+        if (seg.read((uint8_t *)&r, sizeof(r)) == sizeof(r) && (int32_t)(r.seq - lastSeq_) > 0) lastSeq_ = r.seq;
+      }
+      seg.close();
+    }
+    // The segment with the newer records is the one being appended to
+    cur_ = (count_[1] > 0 && (count_[0] == 0 || (int32_t)(firstSeq_[1] - firstSeq_[0]) > 0)) ? 1 : 0;
+
+    // Position the read cursor after the acked records (binary search, seqs increase)
+    readSeg_ = count_[cur_ ^ 1] > 0 ? cur_ ^ 1 : cur_;
+    readPos_ = 0;
+    for (int pass = 0; pass < 2; pass++) {
+      readPos_ = firstUnacked(readSeg_);
+      if (readPos_ < count_[readSeg_] || readSeg_ == cur_) break;
+      readSeg_ = cur_;
+    }
+  }
+
+  // Records waiting in flash
+  size_t pending() const {
+    size_t n = count_[readSeg_] - readPos_;
+    if (readSeg_ != cur_) n += count_[cur_];
+    return n;
+  }
+
+  uint32_t ackedSeq() const { return ackedSeq_; }
+  uint32_t lastSeq() const { return lastSeq_; }
+  uint32_t dropped() const { return dropped_; }
+
+  // First sequence number that is safe to hand out after a reboot
+  uint32_t resumeSeq() const {
+    uint32_t seq = lastSeq_ + 1;
+    if ((int32_t)(ackedSeq_ + 1 - seq) > 0) seq = ackedSeq_ + 1;
+    if ((int32_t)(reservedSeq_ - seq) > 0) seq = reservedSeq_;
+    return seq;
+  }
+
+  bool append(const TelemetryRecord *r, size_t n) {
+    while (n > 0) {
+      if (count_[cur_] >= segmentRecords_) rotate();
+      size_t room = segmentRecords_ - count_[cur_];
+      size_t k = n < room ? n : room;
+      File f = fs_.open(paths_[cur_], "a");
+      if (!f) return false;
+      size_t bytes = k * sizeof(TelemetryRecord);
+      bool ok = f.write((const uint8_t *)r, bytes) == bytes;
+      f.close();
+      if (!ok) return false;
+      if (count_[cur_] == 0) firstSeq_[cur_] = r[0].seq;
+      count_[cur_] += k;
+      lastSeq_ = r[k - 1].seq;
+      r += k;
+      n -= k;
+    }
+    return true;
+  }
+
+  // Copies up to max of the oldest unacked records
+  size_t peek(TelemetryRecord *out, size_t max) {
+    size_t avail = count_[readSeg_] - readPos_;
+    size_t n = avail < max ? avail : max;
+    if (n == 0) return 0;
+    File f = fs_.open(paths_[readSeg_], "r");
+    if (!f) return 0;
+    f.seek(readPos_ * sizeof(TelemetryRecord));
+    size_t got = f.read((uint8_t *)out, n * sizeof(TelemetryRecord)) / sizeof(TelemetryRecord);
+    f.close();
+    return got;
+  }
+
+  // Marks the n records returned by peek() as delivered
+  void consume(size_t n, uint32_t lastSeq) {
+    readPos_ += n;
+    ackedSeq_ = lastSeq;
+    if (readPos_ >= count_[readSeg_] && readSeg_ != cur_) {
+      fs_.remove(paths_[readSeg_]);
+      count_[readSeg_] = 0;
+      readSeg_ = cur_;
+      readPos_ = 0;
+    }
+    if (readSeg_ == cur_ && readPos_ >= count_[cur_]) {
+      // Backlog drained: start over with empty segments
+      fs_.remove(paths_[cur_]);
+      count_[cur_] = 0;
+      readPos_ = 0;
+    }
+    saveState();
+  }
+
+  // Copies up to max unacked records with seq > afterSeq, oldest first,
+  // without consuming them (resumable reads by sequence number)
+  size_t readAfter(uint32_t afterSeq, TelemetryRecord *out, size_t max) {
+    size_t got = 0;
+    for (int pass = 0; pass < 2 && got < max; pass++) {
+      int seg = pass == 0 ? readSeg_ : cur_;
+      if (pass == 1 && seg == readSeg_) break;
+      size_t start = pass == 0 ? readPos_ : 0;
+      if (start >= count_[seg]) continue;
+      File f = fs_.open(paths_[seg], "r");
+      if (!f) continue;
+      size_t pos = firstAfter(f, start, count_[seg], afterSeq);
+      size_t n = count_[seg] - pos;
+      if (n > max - got) n = max - got;
+      if (n > 0) {
+        f.seek(pos * sizeof(TelemetryRecord));
+        got += f.read((uint8_t *)(out + got), n * sizeof(TelemetryRecord)) / sizeof(TelemetryRecord);
+      }
+      f.close();
+    }
+    return got;
+  }
+
+  // Acknowledges every record up to and including seq (clamped to the
+  // newest record, so a bogus seq cannot swallow future records)
+  void ackThrough(uint32_t seq) {
+    if ((int32_t)(seq - lastSeq_) > 0) seq = lastSeq_;
+    if ((int32_t)(seq - ackedSeq_) <= 0) return;
+    for (int pass = 0; pass < 2; pass++) {
+      File f = fs_.open(paths_[readSeg_], "r");
+      if (!f) break;
+      size_t pos = firstAfter(f, readPos_, count_[readSeg_], seq);
+      f.close();
+      bool older = readSeg_ != cur_;
+      consume(pos - readPos_, seq);
+      if (!older || readSeg_ != cur_) break;   // Stopped inside the older segment
+    }
+  }
+
+  // Persists a sequence number the producer will not pass before the next
+  // reservation, so numbers are never reused after a reboot
+  void reserve(uint32_t seq) {
+    reservedSeq_ = seq;
+    saveState();
+  }
+  uint32_t reservedSeq() const { return reservedSeq_; }
+
+ private:
+  static constexpr uint32_t STATE_MAGIC = 0x54534C54;   // "TLST"
+  struct State {
+    uint32_t magic;
+    uint32_t ackedSeq;
+    uint32_t reservedSeq;
+  };
+
+  fs::FS &fs_;
+  const char *paths_[2];
+  const char *statePath_;
+  size_t segmentRecords_;
+  size_t count_[2] = {0, 0};
+  uint32_t firstSeq_[2] = {0, 0};
+  int cur_ = 0;
+  int readSeg_ = 0;
+  size_t readPos_ = 0;
+  uint32_t ackedSeq_ = 0;
+  uint32_t reservedSeq_ = 0;
+  uint32_t lastSeq_ = 0;
+  uint32_t dropped_ = 0;
+
+  void rotate() {
+    int old = cur_ ^ 1;
+    if (count_[old] > 0) {
+      if (readSeg_ == old) {
+        dropped_ += count_[old] - readPos_;   // Unsent records of the oldest segment are lost
+        readSeg_ = cur_;
+        readPos_ = 0;
+      }
+      fs_.remove(paths_[old]);
+    }
+    count_[old] = 0;
+    cur_ = old;
+  }
+
+  size_t firstUnacked(int seg) {
+    File f = fs_.open(paths_[seg], "r");
+    if (!f) return count_[seg];
+    size_t pos = firstAfter(f, 0, count_[seg], ackedSeq_);
+    f.close();
+    return pos;
+  }
+
+  // First record index in [lo, hi) with a seq newer than seq (binary search)
+  size_t firstAfter(File &f, size_t lo, size_t hi, uint32_t seq) {
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      TelemetryRecord r;
+      f.seek(mid * sizeof(TelemetryRecord));
+      if (f.read((uint8_t *)&r, sizeof(r)) != sizeof(r)) break;
+      if ((int32_t)(r.seq - seq) <= 0) lo = mid + 1;
+      else hi = mid;
+    }
+    return lo;
+  }
+
+  void saveState() {
+    State st = {STATE_MAGIC, ackedSeq_, reservedSeq_};
+    File f = fs_.open(statePath_, "w");
+    if (!f) return;
+    f.write((const uint8_t *)&st, sizeof(st));
+    f.close();
+  }
+};
+
+// Records collected in RAM for one flash append (the outage journal).
+// Records stamped with the boot clock (ts < minValidTs) are held back until
+// rebase() has moved them to wall time, because nothing on flash is ever
+// rebased; while the stage is full of them the oldest is dropped.
+template <size_t N>
+class TelemetryStage {
+ public:
+  explicit TelemetryStage(uint32_t minValidTs) : minValidTs_(minValidTs) {}
+
+  static constexpr size_t capacity() { return N; }
+  size_t size() const { return count_; }
+  bool full() const { return count_ == N; }
+  uint32_t dropped() const { return dropped_; }
+  const TelemetryRecord &at(size_t i) const { return items_[i]; }
+
+  void add(const TelemetryRecord &r) {
+    if (count_ == N) {
+      memmove(items_, items_ + 1, (N - 1) * sizeof(TelemetryRecord));
+      count_--;
+      dropped_++;
+    }
+    items_[count_++] = r;
+  }
+
+  // Leading records with a wall-clock timestamp (the ones flush() writes)
+  size_t ready() const {
+    size_t n = 0;
+    while (n < count_ && items_[n].ts >= minValidTs_) n++;
+    return n;
+  }
+
+  // Appends the ready records; they leave the stage even if the write
+  // fails (the caller counts them as lost)
+  bool flush(TelemetryLog &log) {
+    size_t n = ready();
+    if (n == 0) return true;
+    bool ok = log.append(items_, n);
+    memmove(items_, items_ + n, (count_ - n) * sizeof(TelemetryRecord));
+    count_ -= n;
+    return ok;
+  }
+
+  // Moves boot-clock timestamps to wall time; returns how many
+  size_t rebase(uint32_t offset) {
+    size_t n = 0;
+    for (size_t i = 0; i < count_; i++) {
+      if (items_[i].ts < minValidTs_) {
+        items_[i].ts += offset;
+        n++;
+      }
+    }
+    return n;
+  }
+
+ private:
+  TelemetryRecord items_[N];
+  size_t count_ = 0;
+  uint32_t dropped_ = 0;
+  uint32_t minValidTs_;
+};
+
+// Encodes up to n records with consecutive seq numbers starting at items[0];
+// stops at the first gap. Returns the number of records encoded (0 if not
+// even one fits) and the payload length in len.
+inline size_t encodeTelemetry(TelemetryEncoding enc, const char *device, const TelemetryRecord *items, size_t n,
+                              uint8_t *out, size_t cap, size_t &len) {
+  size_t used = 1;
+  while (used < n && items[used].seq == items[used - 1].seq + 1) used++;
+
+  if (enc == TelemetryEncoding::Binary) {
+    const size_t HEADER = 8, RECORD = 12;
+    if (cap < HEADER + RECORD) return 0;
+    if (used > (cap - HEADER) / RECORD) used = (cap - HEADER) / RECORD;
+    if (used > 255) used = 255;
+    uint8_t *p = out;
+    *p++ = 'T';
+    *p++ = 'L';
+    *p++ = 1;                       // Format version
+    *p++ = (uint8_t)used;
+    memcpy(p, &items[0].seq, 4);    // ESP32 and every consumer we care about are little-endian
+    p += 4;
+    for (size_t i = 0; i < used; i++) {
+      const TelemetryRecord &r = items[i];
+      memcpy(p, &r.ts, 4);
+      memcpy(p + 4, &r.t, 2);
+      memcpy(p + 6, &r.h, 2);
+      memcpy(p + 8, &r.n, 2);
+      p[10] = r.channel;
+      p[11] = r.kind;
+      p += RECORD;
+    }
+    len = p - out;
+    return used;
+  }
+
+  char *p = (char *)out;
+  char *end = p + cap - 1;
+  int w = snprintf(p, end - p + 1, "{\"dev\":\"%s\",\"seq\":%u,\"rec\":[", device, (unsigned)items[0].seq);
+  if (w < 0 || w > end - p) return 0;
+  p += w;
+  size_t done = 0;
+  for (; done < used; done++) {
+    const TelemetryRecord &r = items[done];
+    // Fixed-point values are printed as decimals without going through float
+    char row[TELEMETRY_ROW_MAX];
+    char *q = row;
+    if (done) *q++ = ',';
+    *q++ = '[';
+    q += formatUint(q, r.ts);
+    *q++ = ',';
+    q += formatUint(q, r.channel);
+    *q++ = ',';
+    q += formatUint(q, r.kind);
+    *q++ = ',';
+    q += formatScaled(q, r.t, 2);
+    *q++ = ',';
+    q += formatScaled(q, r.h, 2);
+    *q++ = ',';
+    q += formatUint(q, r.n);
+    *q++ = ']';
+    if (q - row > end - p - 2) break;   // Keep room for "]}"
+    memcpy(p, row, q - row);
+    p += q - row;
+  }
+  if (done == 0) return 0;
+  *p++ = ']';
+  *p++ = '}';
+  *p = '\0';
+  len = p - (char *)out;
+  return done;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+// Incremental timestamp formatter.
+//
+// Readings only store integer timestamps; text is produced on output. The
+// formatter caches the local date/hour prefix of the last local hour it saw
+// (one localtime_r() per hour of data) and only renders minutes and seconds
+// arithmetically for every other call. Output goes straight into the
+// caller's buffer, no String/strftime involved.
+//
+// Not thread-safe: use one instance per task (a local instance in a web
+// handler is cheap).
+
+enum class TimeFormat : uint8_t {
+  Local,     // "2024-01-15 14:30:15" (same as the former strftime output)
+  Iso8601,   // "2024-01-15T14:30:15+01:00"
+  Epoch      // "1705325415"
+};
+
+constexpr size_t TIME_FORMAT_MAX = 32;           // Buffer size that fits every mode
+constexpr uint32_t TIME_FORMAT_MIN_EPOCH = 1000000000; // Smaller values are seconds since boot
+
+class DateFormatter {
+ public:
+  // Writes ts (NUL-terminated) into out, returns the length without NUL.
+  // Timestamps below TIME_FORMAT_MIN_EPOCH are rendered as "Boot+Ns".
+  size_t format(uint32_t ts, char *out, TimeFormat mode = TimeFormat::Local) {
+    if (ts < TIME_FORMAT_MIN_EPOCH) {
+      char *p = out;
+      *p++ = 'B'; *p++ = 'o'; *p++ = 'o'; *p++ = 't'; *p++ = '+';
+      p += writeUint(ts, p);
+      *p++ = 's';
+      *p = '\0';
+      return p - out;
+    }
+    if (mode == TimeFormat::Epoch) {
+      size_t n = writeUint(ts, out);
+      out[n] = '\0';
+      return n;
+    }
+
+    if (ts < windowStart_ || ts >= windowStart_ + 3600) {
+      refresh(ts);
+    }
+
+    // "YYYY-MM-DD" + separator + "HH" from the cache, then MM:SS
+    char *p = out;
+    for (int i = 0; i < 10; i++) *p++ = date_[i];
+    *p++ = (mode == TimeFormat::Iso8601) ? 'T' : ' ';
+    *p++ = hour_[0];
+    *p++ = hour_[1];
+    uint32_t inHour = ts - windowStart_;
+    *p++ = ':';
+    p = write2(inHour / 60, p);
+    *p++ = ':';
+    p = write2(inHour % 60, p);
+
+    if (mode == TimeFormat::Iso8601) {
+      int32_t off = offset_;
+      *p++ = off < 0 ? '-' : '+';
+      if (off < 0) off = -off;
+      p = write2(off / 3600, p);
+      *p++ = ':';
+      p = write2((off % 3600) / 60, p);
+    }
+    *p = '\0';
+    return p - out;
+  }
+
+  // Forces the next call to re-read the timezone (e.g. after configTime())
+  void invalidate() { windowStart_ = 0; }
+
+ private:
+  uint32_t windowStart_ = 0;   // UTC timestamp where the cached local hour starts
+  int32_t offset_ = 0;         // Local time minus UTC for the cached hour, seconds
+  char date_[10];              // "YYYY-MM-DD"
+  char hour_[2];               // "HH"
+
+  // Slow path, once per local hour: derive offset and date/hour fields
+  void refresh(uint32_t ts) {
+    time_t t = ts;
+    struct tm tmLocal;
+    localtime_r(&t, &tmLocal);
+
+    int64_t localSec = (int64_t)daysFromCivil(tmLocal.tm_year + 1900, tmLocal.tm_mon + 1, tmLocal.tm_mday) * 86400 +
+                       tmLocal.tm_hour * 3600 + tmLocal.tm_min * 60 + tmLocal.tm_sec;
+    offset_ = (int32_t)(localSec - (int64_t)ts);
+    windowStart_ = ts - (tmLocal.tm_min * 60 + tmLocal.tm_sec);
+
+    int year = tmLocal.tm_year + 1900;
+    date_[0] = '0' + (year / 1000) % 10;
+    date_[1] = '0' + (year / 100) % 10;
+    date_[2] = '0' + (year / 10) % 10;
+    date_[3] = '0' + year % 10;
+    date_[4] = '-';
+    write2(tmLocal.tm_mon + 1, date_ + 5);
+    date_[7] = '-';
+    write2(tmLocal.tm_mday, date_ + 8);
+    write2(tmLocal.tm_hour, hour_);
+  }
+
+  static char *write2(uint32_t v, char *p) {
+    p[0] = '0' + v / 10;
+    p[1] = '0' + v % 10;
+    return p + 2;
+  }
+
+  static size_t writeUint(uint32_t v, char *out) {
+    char tmp[10];
+    size_t n = 0;
+    do {
+      tmp[n++] = '0' + v % 10;
+      v /= 10;
+    } while (v);
+    for (size_t i = 0; i < n; i++) out[i] = tmp[n - 1 - i];
+    return n;
+  }
+
+  // Days since 1970-01-01 for a proleptic Gregorian date (H. Hinnant)
+  static int32_t daysFromCivil(int y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const int era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = (unsigned)(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int32_t)doe - 719468;
+  }
+};
@@ -4,13 +4,39 @@
 #include <AsyncTCP.h>
 #include <ESPAsyncWebServer.h>
 #include <ArduinoJson.h>
-#include <SPIFFS.h>
+#include <LittleFS.h>
+#include <SPIFFS.h>         // Backend of older builds, migrated once
 #include <DHT.h>
+#include <Wire.h>
+#include <HTTPClient.h>     // Alert webhook delivery
 #include <ESPmDNS.h>        // Added for network discovery
 #include <time.h>           // For NTP time synchronization
-#include <deque>
-#include <vector>
-#include <map>
+#include <sys/time.h>       // gettimeofday() for millisecond slot alignment
+#include <esp_sntp.h>       // SNTP sync notification callback
+#include <memory>           // std::shared_ptr for streamed responses
+#include "alert_rules.h"
+#include "build_profile.h"
+#include "config_store.h"
+#include "emergency_snapshot.h"
+#include "history_format.h"
+#include "history_json.h"
+#include "history_recovery.h"
+#include "history_retention.h"
+#include "log_ring.h"
+#include "metrics_writer.h"
+#include "mqtt_client.h"
+#include "notify_queue.h"
+#include "oversampler.h"
+#include "partition_region.h"
+#include "raw_log.h"
+#include "rolling_stats.h"
+#include "sample_store.h"
+#include "sensor_dht.h"
+#include "sensor_sht3x.h"
+#include "sensor_sim.h"
+#include "storage_backend.h"
+#include "telemetry.h"
+#include "time_format.h"
 
 // ---------- CONFIG ----------
 constexpr bool USE_ETH   = true;     // set false if 3V3 < 3.25 V
@@ -18,16 +44,129 @@ const char *SSID    = "RUT_F5DA_2G";
 const char *PASS    = "i1V5FvDp";
 const char *HOSTNAME = "tr-cam1-t-h-sensor";    // Device hostname for easy discovery
 constexpr int   DHTPIN   = 4;        // GPIO4 for DHT11 data pin
-constexpr int   DHTTYPE  = DHT11;
+constexpr int   DHT2_PIN = 32;       // IO32 (CFG) for a second DHT probe (multi-sensor profile)
+constexpr int   I2C_SDA_PIN = 14;    // I2C bus for SHT3x probes
+constexpr int   I2C_SCL_PIN = 15;
 constexpr int   LED_PIN  = 2;        // Built-in LED for status indication
+constexpr int   POWER_FAIL_PIN = -1; // Supply supervisor output, low on power loss (-1 = none)
 constexpr uint32_t SAMPLE_MS = 30000UL;    // 30-second measurement interval (DHT11 needs time)
-constexpr uint32_t NETWORK_CHECK_MS = 30000UL;  // Check network every 30 seconds
+constexpr uint32_t NETWORK_CHECK_MS = 30000UL;  // Retry WiFi every 30 seconds while offline
+
+// Sensor registries - one channel per probe. Add entries for more probes;
+// each channel gets its own sample rings, rollups and sample interval.
+// Build with -D SIMULATED_SENSORS to replace every probe by a simulated one.
+// oversample > 1 takes that many readings per slot (spaced by the sensor's
+// minimum interval) and stores one filtered sample.
+constexpr SensorConfig STANDARD_SENSORS[] = {
+  {"probe-1", SENSOR_DHT11, DHTPIN, SAMPLE_MS, 3, SampleFilter::Median},
+  // {"probe-2", SENSOR_SHT3X, 0x44, 1000, 1, SampleFilter::Median},     // 1 Hz I2C probe
+};
+constexpr SensorConfig HIGH_RATE_SENSORS[] = {
+  {"probe-1", SENSOR_SHT3X, 0x44, 1000, 1, SampleFilter::Median},        // 1 Hz I2C probe
+};
+constexpr SensorConfig MULTI_SENSORS[] = {
+  {"probe-1", SENSOR_DHT11, DHTPIN, SAMPLE_MS, 3, SampleFilter::Median},
+  {"probe-2", SENSOR_DHT22, DHT2_PIN, SAMPLE_MS, 3, SampleFilter::Median},
+  {"probe-3", SENSOR_SHT3X, 0x44, 10000, 3, SampleFilter::TrimmedMean},
+  {"probe-4", SENSOR_SHT3X, 0x45, 10000, 3, SampleFilter::TrimmedMean},
+};
+
+// Build profiles (include/build_profile.h), selected by the PlatformIO env:
+//   standard      one DHT11, 30 min detailed + 24 h of 5-minute means
+//   low-memory    -D PROFILE_LOW_MEMORY: halved windows and queues, binary telemetry
+//   high-rate     -D PROFILE_HIGH_RATE: one SHT3x at 1 Hz, larger telemetry and log queues
+//                 (loop() must never block for a whole slot: the status LED and
+//                 the history checkpoint are serviced without delay())
+//   multi-sensor  -D PROFILE_MULTI_SENSOR: four probes on DHT and I2C
+constexpr BuildProfile STANDARD_PROFILE = {
+  "standard", STANDARD_SENSORS, sensorCount(STANDARD_SENSORS),
+  1800, 288, 2016, 96 * 1024,                 // 30 min detailed, 24 h in RAM, 7 days on flash
+  256, 32, TelemetryEncoding::Json,
+  32, 64, 32,
+  60000, 3600,
+};
+constexpr BuildProfile LOW_MEMORY_PROFILE = {
+  "low-memory", STANDARD_SENSORS, sensorCount(STANDARD_SENSORS),
+  900, 144, 1008, 32 * 1024,                  // 15 min detailed, 12 h in RAM, 3.5 days on flash
+  64, 16, TelemetryEncoding::Binary,
+  16, 32, 16,
+  60000, 3600,
+};
+constexpr BuildProfile HIGH_RATE_PROFILE = {
+  "high-rate", HIGH_RATE_SENSORS, sensorCount(HIGH_RATE_SENSORS),
+  1800, 288, 2016, 96 * 1024,                 // 1800 detailed samples
+  512, 64, TelemetryEncoding::Binary,         // One sample per second: a batch a minute
+  32, 128, 32,
+  10000, 3600,
+};
+constexpr BuildProfile MULTI_SENSOR_PROFILE = {
+  "multi-sensor", MULTI_SENSORS, sensorCount(MULTI_SENSORS),
+  1800, 288, 2016, 96 * 1024,
+  512, 32, TelemetryEncoding::Json,
+  64, 64, 32,
+  60000, 3600,
+};
+#if defined(PROFILE_LOW_MEMORY)
+constexpr BuildProfile PROFILE = LOW_MEMORY_PROFILE;
+#elif defined(PROFILE_HIGH_RATE)
+constexpr BuildProfile PROFILE = HIGH_RATE_PROFILE;
+#elif defined(PROFILE_MULTI_SENSOR)
+constexpr BuildProfile PROFILE = MULTI_SENSOR_PROFILE;
+#else
+constexpr BuildProfile PROFILE = STANDARD_PROFILE;
+#endif
+constexpr const SensorConfig *SENSORS = PROFILE.sensors;
+constexpr size_t CHANNEL_COUNT = PROFILE.sensorCount;
 
 // Data retention configuration
-constexpr uint32_t DETAILED_PERIOD_SEC = 1800;   // Keep 30 minutes of detailed data
+constexpr uint32_t DETAILED_PERIOD_SEC = PROFILE.detailedPeriodSec;
 constexpr uint32_t AGGREGATE_INTERVAL_SEC = 300; // 5-minute aggregation for older data
-constexpr uint32_t MAX_DETAILED_SAMPLES = DETAILED_PERIOD_SEC / (SAMPLE_MS / 1000); // 60 samples
-constexpr uint32_t MAX_AGGREGATE_SAMPLES = 288;  // ~24 hours of 5-minute data
+constexpr uint32_t MAX_AGGREGATE_SAMPLES = PROFILE.aggregateSamples;
+constexpr uint32_t MAX_HISTORY_POINTS = 120;     // Detailed points per response; faster channels are decimated
+constexpr size_t HISTORY_PARALLEL_MIN_POINTS = 64; // From this size /api/history is formatted on both cores
+constexpr size_t EXPORT_FLASH_BLOCK = HISTORY_BLOCK_RECORDS; // History records read from flash at once by /api/export
+constexpr size_t EXPORT_LINE_MAX = 224;           // One CSV/NDJSON export row (worst case 209)
+constexpr size_t EXPORT_NAME_MAX = 32;            // Channel name characters in an export row
+constexpr uint32_t ANALYTICS_WINDOW_SEC = 600;    // Rolling stats over the last 10 minutes of samples
+constexpr uint32_t ANALYTICS_LONG_SEC = 3600;     // ...and over the last hour of 5-minute means
+constexpr float OVERSAMPLE_OUTLIER_K = 3.0f;     // Reject readings beyond 3 robust sigmas from the median
+constexpr float OVERSAMPLE_FLOOR_T = 0.5f;       // Minimum sigma (°C) so 1-step DHT11 differences survive
+constexpr float OVERSAMPLE_FLOOR_H = 2.0f;       // Minimum sigma (% RH)
+
+// Registry checks (C++11 constexpr recursion over SENSORS)
+constexpr uint32_t minSampleMs(size_t i = 0) {
+  return i + 1 >= CHANNEL_COUNT ? SENSORS[i].intervalMs
+       : (SENSORS[i].intervalMs < minSampleMs(i + 1) ? SENSORS[i].intervalMs : minSampleMs(i + 1));
+}
+// Shortest interval the real probe supports (simulated builds check it too,
+// so a profile does not start failing once the sensors are attached)
+constexpr uint32_t sensorMinIntervalMs(SensorType type) {
+  return type == SENSOR_DHT11 || type == SENSOR_DHT22 ? DhtSensor::MIN_INTERVAL_MS
+       : type == SENSOR_SHT3X ? Sht3xSensor::MIN_INTERVAL_MS : 1000;
+}
+constexpr bool sensorIntervalsSupported(size_t i = 0) {
+  return i >= CHANNEL_COUNT ||
+         (SENSORS[i].intervalMs >= sensorMinIntervalMs(SENSORS[i].type) && sensorIntervalsSupported(i + 1));
+}
+constexpr bool sampleIntervalsValid(size_t i = 0) {
+  return i >= CHANNEL_COUNT ||
+         (SENSORS[i].intervalMs >= 1000 && SENSORS[i].intervalMs % 1000 == 0 &&
+          (AGGREGATE_INTERVAL_SEC * 1000) % SENSORS[i].intervalMs == 0 &&
+          SENSORS[i].oversample >= 1 && SENSORS[i].oversample <= OVERSAMPLE_MAX && sampleIntervalsValid(i + 1));
+}
+
+// Detailed rings are sized for the fastest channel; slower channels keep
+// the same 30-minute window and leave the rest unused
+constexpr uint32_t MAX_DETAILED_SAMPLES = DETAILED_PERIOD_SEC * 1000 / minSampleMs(); // 60 samples at 30 s
+constexpr uint32_t ANALYTICS_WINDOW_SAMPLES = ANALYTICS_WINDOW_SEC * 1000 / minSampleMs();
+constexpr uint32_t ANALYTICS_LONG_SAMPLES = ANALYTICS_LONG_SEC / AGGREGATE_INTERVAL_SEC;
+static_assert(CHANNEL_COUNT > 0 && CHANNEL_COUNT <= 8, "1-8 sensor channels supported");
+static_assert(sampleIntervalsValid(), "Sample slots must tile whole seconds and aggregation buckets, oversample 1-16");
+static_assert(sensorIntervalsSupported(), "Sample interval below the sensor's minimum (DHT 2 s, SHT3x 1 s)");
+static_assert(CHANNEL_COUNT * (sizeof(SampleRing<MAX_DETAILED_SAMPLES>) + sizeof(SampleRing<MAX_AGGREGATE_SAMPLES>)) <=
+              PROFILE.sampleRingBudget, "Sample rings exceed the profile's RAM budget");
+static_assert(MAX_AGGREGATE_SAMPLES * AGGREGATE_INTERVAL_SEC >= ANALYTICS_LONG_SEC, "Aggregate ring shorter than the long analytics window");
+static_assert(PROFILE.storageRecords >= MAX_AGGREGATE_SAMPLES, "Flash history must hold the RAM aggregates");
 
 // NTP Time Configuration - Multiple sources for better reliability
 const char* NTP_SERVERS[] = {
@@ -40,126 +179,620 @@ const char* NTP_SERVERS[] = {
 const int NTP_SERVER_COUNT = sizeof(NTP_SERVERS) / sizeof(NTP_SERVERS[0]);
 const long  GMT_OFFSET_SEC = 3600;           // Germany: UTC+1 (3600 seconds)
 const int   DAYLIGHT_OFFSET_SEC = 3600;      // Daylight saving time offset
+constexpr uint32_t NTP_ROTATE_MS = 15000UL;  // Try the next server set if not synced within 15 s
+constexpr uint32_t MIN_VALID_EPOCH = 1000000000; // Smaller timestamps are seconds since boot
+
+// Alert notifications - leave a transport empty to disable it
+const char *NOTIFY_WEBHOOK_URL = "";          // e.g. "http://192.168.1.10:8080/alerts" (JSON POST, plain HTTP)
+const char *MQTT_BROKER = "";                 // e.g. "192.168.1.10"
+constexpr uint16_t MQTT_PORT = 1883;
+const char *MQTT_USER = "";
+const char *MQTT_PASS = "";
+const char *MQTT_TOPIC_PREFIX = "thlogger";   // Alerts go to <prefix>/<hostname>/alerts (QoS 1)
+
+// MQTT telemetry (needs MQTT_BROKER): every sample and 5-minute rollup is
+// published in batches to <prefix>/<hostname>/telemetry (QoS 1)
+constexpr bool MQTT_TELEMETRY = true;
+constexpr size_t TELEMETRY_BATCH = PROFILE.telemetryBatch;               // Records per message
+constexpr TelemetryEncoding TELEMETRY_ENCODING = PROFILE.telemetryEncoding; // Json or Binary
 // -----------------------------
 
 // Memory management and persistence configuration
 constexpr uint32_t EMERGENCY_AGGREGATION_THRESHOLD = 80; // Start emergency aggregation at 80% RAM usage
 constexpr uint32_t CRITICAL_MEMORY_THRESHOLD = 90;       // Critical memory usage (force cleanup)
-constexpr uint32_t SPIFFS_SAVE_INTERVAL_SEC = 3600;      // Save to flash every hour
-constexpr uint32_t MAX_SPIFFS_RECORDS = 2016;            // 7 days * 24h * 12 (5-min intervals)
-const char* SPIFFS_DATA_FILE = "/sensor_data.json";
-const char* SPIFFS_CONFIG_FILE = "/config.json";
+constexpr uint32_t STORAGE_CHECKPOINT_SEC = 12 * 3600;   // ... every 12 h while the aggregate log is active
+constexpr uint32_t MAX_STORAGE_RECORDS = PROFILE.storageRecords; // 2016 = 7 days * 24h * 12 (5-min intervals)
+constexpr uint32_t STORAGE_RETENTION_SEC = MAX_STORAGE_RECORDS * AGGREGATE_INTERVAL_SEC; // Window kept in the history file
+const char* STORAGE_HISTORY_FILE = "/history.bin";
+const char* STORAGE_HISTORY_TMP = "/history.tmp";         // Saves go here first, then replace the file
+const char* STORAGE_HISTORY_QUARANTINE = "/history.bad";  // Damaged history file, kept for inspection
+const char* STORAGE_DATA_QUARANTINE = "/sensor_data.bad"; // Legacy JSON history that failed to parse
+constexpr uint32_t HISTORY_LOAD_STEP_MS = 10;           // History read per loop() pass while loading
+constexpr uint32_t HISTORY_SCAN_BUDGET_MS = 2000;        // Longest a forced (pre-save) load may block
+constexpr size_t HISTORY_SCAN_MAX_BYTES =                // Largest history file a scan reads
+    historyFileSize(HISTORY_VERSION, sizeof(HistoryRecord), MAX_STORAGE_RECORDS * 8);
+const char* STORAGE_DATA_FILE = "/sensor_data.json";    // Legacy JSON history, imported once
+const char* STORAGE_CONFIG_FILE = "/config.json";       // Thresholds of older firmware, imported once
+const char* STORAGE_ALERTS_FILE = "/alerts.json";       // Rule table of earlier builds, imported once
+const char* STORAGE_CONFIG_SLOT_A = "/cfg_a.bin";        // Configuration, two alternating slots
+const char* STORAGE_CONFIG_SLOT_B = "/cfg_b.bin";
+constexpr uint32_t CONFIG_SAVE_DELAY_MS = 2000;          // Changes within this window share one write
+constexpr size_t CONFIG_MAX_BYTES = 6144;                // Serialized configuration
+const char* STORAGE_NOTIFY_FILE = "/notify.bin";         // Undelivered alert notifications
+constexpr size_t NOTIFY_QUEUE_SIZE = PROFILE.notifyQueue; // Pending notifications, oldest dropped when full
+constexpr uint32_t NOTIFY_SAVE_DELAY_MS = 10000;         // Coalesce notification queue writes
+constexpr size_t NOTIFY_BATCH_MAX = 8;                   // Notifications per webhook call / MQTT message
+constexpr size_t NOTIFY_PAYLOAD_MAX = 2048;
+constexpr uint32_t NOTIFY_TIMEOUT_MS = 5000;             // Connect/response timeout per delivery
+constexpr uint32_t NOTIFY_BACKOFF_MIN_MS = 2000;         // Retry delay after the first failure, doubled per failure
+constexpr uint32_t NOTIFY_BACKOFF_MAX_MS = 300000;
+const char* STORAGE_TELEMETRY_SEGMENT_A = "/tlm_a.bin";  // Telemetry backlog while the broker is unreachable
+const char* STORAGE_TELEMETRY_SEGMENT_B = "/tlm_b.bin";
+const char* STORAGE_TELEMETRY_STATE = "/tlm_state.bin";  // Acked / reserved sequence numbers
+constexpr size_t TELEMETRY_QUEUE_SIZE = PROFILE.telemetryQueue; // Records staged in RAM (16 bytes each)
+constexpr size_t TELEMETRY_SEGMENT_RECORDS = 4096;       // 64 KB per backlog segment, two segments
+constexpr size_t TELEMETRY_PAYLOAD_MAX = 2048;
+constexpr uint32_t TELEMETRY_SEQ_RESERVE = 1024;         // Sequence numbers reserved per state write
+static_assert(TELEMETRY_BATCH <= TELEMETRY_QUEUE_SIZE / 4, "Telemetry batch must fit the spill margin");
+const char* STORAGE_OUTAGE_SEGMENT_A = "/outage_a.bin";  // Full-resolution samples taken while offline
+const char* STORAGE_OUTAGE_SEGMENT_B = "/outage_b.bin";
+const char* STORAGE_OUTAGE_STATE = "/outage_state.bin";  // Last replayed (acked) sequence number
+constexpr size_t OUTAGE_SEGMENT_RECORDS = 4096;          // 64 KB per journal segment, two segments
+constexpr size_t OUTAGE_STAGE_RECORDS = 32;              // Samples collected in RAM per flash append
+constexpr uint32_t OUTAGE_FLUSH_MS = 60000;              // Longest a sample waits in RAM
+constexpr uint32_t OUTAGE_BOOT_GRACE_MS = 60000;         // No link this long after boot counts as an outage
+constexpr size_t OUTAGE_REPLAY_BLOCK = 32;               // Journal records read per replay step
+const char* RAW_LOG_PARTITION = "rawlog";               // Raw data partition (partitions.csv), no filesystem
+constexpr size_t STORAGE_MIGRATE_MAX_BYTES = 96 * 1024;  // RAM budget for the one-time SPIFFS -> LittleFS move
+constexpr size_t AGG_STAGE_RECORDS = 32;                 // Closed aggregates held in RAM between commits
+constexpr size_t AGG_COMMIT_BYTES = 256;                 // Commit once a flash page of log slots is staged
+constexpr uint32_t AGG_COMMIT_MS = 60000;                // ... or once the oldest staged aggregate waited this long
+const char* SNAPSHOT_PARTITION = "snapshot";            // Power-fail snapshot (partitions.csv), two sectors
+constexpr uint32_t SNAPSHOT_STAGE_WAIT_MS = 10;          // Wait for a running aggregate commit before snapshotting
+constexpr uint32_t SNAPSHOT_REARM_MS = 2000;             // Supply back this long after a power-fail snapshot: erase it
+constexpr uint32_t STORAGE_REMOUNT_MS = 300000;          // Retry a failed mount (never auto-format)
+constexpr uint32_t STORAGE_REFRESH_MS = 10000;           // Free space refresh for status endpoints
+constexpr uint32_t STORAGE_LOW_SPACE_PERCENT = 90;       // Health "low_space" from this fill level
+constexpr uint32_t STORAGE_DEGRADED_ERRORS = 3;          // Health "write_errors" after this many failures in a row
+constexpr size_t METRICS_BUFFER_SIZE = 2048 + 2560 * CHANNEL_COUNT + 192 * MAX_ALERT_RULES; // One /metrics scrape
+constexpr uint32_t METRICS_BUSY_TIMEOUT_MS = 5000;       // Reclaim the buffer if a client stalls mid-response
+constexpr size_t LOG_RING_SLOTS = PROFILE.logRingSlots;  // Log entries waiting for the drain task (power of two)
+constexpr size_t LOG_RECENT = PROFILE.logRecent;         // Drained entries kept for /api/logs
+constexpr uint32_t LOG_DRAIN_MS = 20;                    // Drain task poll interval
+constexpr size_t LOG_TEXT_MAX = 192;                     // One rendered log line
+constexpr uint32_t LOG_REPEAT_MS = 300000;               // Repeating conditions are logged at most this often
+
+// Logging: entries are queued in RAM and printed by logTask(), so a busy
+// UART never blocks the caller. Sites above LOG_LEVEL_MAX (build flag,
+// 0 = none, 1 = errors ... 4 = debug) are compiled out.
+#ifndef LOG_LEVEL_MAX
+#define LOG_LEVEL_MAX 3
+#endif
+
+// Run-time subset of the build profile: changed through /api/settings and
+// saved with the configuration. Read without a lock; a stale value is harmless.
+struct RuntimeSettings {
+  uint8_t logLevel;             // Highest level logged, at most LOG_LEVEL_MAX
+  uint32_t telemetryLingerMs;
+  uint32_t storageSaveSec;
+};
+constexpr RuntimeSettings DEFAULT_SETTINGS = {LOG_LEVEL_MAX, PROFILE.telemetryLingerMs, PROFILE.storageSaveSec};
+RuntimeSettings settings = DEFAULT_SETTINGS;
+
+LogRing<LOG_RING_SLOTS> logRing;
+#define LOG_AT(level, ...)                                                                \
+  do {                                                                                    \
+    if ((uint8_t)(level) <= settings.logLevel) logRing.write(level, millis(), __VA_ARGS__); \
+  } while (0)
+// Disabled sites are still type-checked, but dead code: no call, no format string
+#define LOG_OFF(level, ...) do { if (false) LOG_AT(level, __VA_ARGS__); } while (0)
+#if LOG_LEVEL_MAX >= 1
+#define LOGE(...) LOG_AT(LogLevel::Error, __VA_ARGS__)
+#else
+#define LOGE(...) LOG_OFF(LogLevel::Error, __VA_ARGS__)
+#endif
+#if LOG_LEVEL_MAX >= 2
+#define LOGW(...) LOG_AT(LogLevel::Warn, __VA_ARGS__)
+#else
+#define LOGW(...) LOG_OFF(LogLevel::Warn, __VA_ARGS__)
+#endif
+#if LOG_LEVEL_MAX >= 3
+#define LOGI(...) LOG_AT(LogLevel::Info, __VA_ARGS__)
+#else
+#define LOGI(...) LOG_OFF(LogLevel::Info, __VA_ARGS__)
+#endif
+#if LOG_LEVEL_MAX >= 4
+#define LOGD(...) LOG_AT(LogLevel::Debug, __VA_ARGS__)
+#else
+#define LOGD(...) LOG_OFF(LogLevel::Debug, __VA_ARGS__)
+#endif
+// Runs the log statement at most once per `ms` at this call site
+#define LOG_EVERY(ms, statement)                                        \
+  do {                                                                  \
+    static uint32_t lastLogMs_ = 0;                                     \
+    static bool loggedOnce_ = false;                                    \
+    if (!loggedOnce_ || millis() - lastLogMs_ >= (ms)) {                \
+      loggedOnce_ = true;                                               \
+      lastLogMs_ = millis();                                            \
+      statement;                                                        \
+    }                                                                   \
+  } while (0)
 
 // Memory usage tracking
 uint32_t lastMemoryCheck = 0;
-uint32_t lastSPIFFSSave = 0;
+uint32_t lastStorageSave = 0;
 bool emergencyMode = false;
 
-struct Reading { 
-  uint32_t ts;          // Unix timestamp (seconds since 1970)
-  float t;              // Temperature in Celsius
-  float h;              // Humidity in %
-  String datetime;      // Human-readable date/time string
+// Persistence backend: LittleFS unless built with -D STORAGE_BACKEND_SPIFFS.
+// A LittleFS build that finds the partition still holding SPIFFS moves the
+// files over once (migrateFromSpiffs()).
+#ifdef STORAGE_BACKEND_SPIFFS
+VfsBackend<SPIFFSFS> storageBackend(SPIFFS, "spiffs");
+#else
+VfsBackend<LittleFSFS> storageBackend(LittleFS, "littlefs");
+#endif
+fs::FS &storageFs = storageBackend.fs();
+
+// Storage service state, maintained by the storage functions below
+struct StorageStatus {
+  bool mounted;
+  bool migrated;                          // Files were moved over from SPIFFS at this boot
+  uint16_t migratedFiles;
+  uint16_t droppedFiles;                  // Did not fit the migration budget
+  uint32_t mountAttempts;
+  uint32_t lastMountMs;
+  uint32_t mountUs;                       // Duration of the last mount attempt
+  size_t totalBytes;
+  size_t usedBytes;
+  uint32_t lastRefreshMs;
+  uint32_t writes;                        // Write operations (file rewrites, appends, commits)
+  uint32_t writeErrors;
+  uint32_t consecutiveErrors;
+  uint32_t lastWriteUs;
+  uint32_t maxWriteUs;
+  uint64_t totalWriteUs;
+};
+StorageStatus storageStatus = {};
+SemaphoreHandle_t storageMutex = nullptr;   // Write statistics are updated from several tasks
+volatile bool storageFormatRequested = false;
+
+// Aggregate log: closed buckets are staged here and group-committed to the
+// raw log partition (loop(), /api/save and the shutdown handler)
+enum AggCommitReason : uint8_t { AGG_COMMIT_TIME, AGG_COMMIT_SIZE, AGG_COMMIT_SAVE, AGG_COMMIT_SHUTDOWN, AGG_COMMIT_REASONS };
+const char *const AGG_COMMIT_REASON_NAMES[AGG_COMMIT_REASONS] = {"time", "size", "save", "shutdown"};
+struct AggLogStats {
+  uint32_t commits;
+  uint32_t records;                       // Aggregates committed since boot
+  uint32_t failures;
+  uint32_t dropped;                       // Staged aggregates lost (failed write, stage full before NTP)
+  uint32_t replayed;                      // Aggregates restored from the log at boot
+  uint32_t lastCommitUs;
+  uint32_t reasons[AGG_COMMIT_REASONS];
+};
+PartitionRegion aggRegion(RAW_LOG_PARTITION);
+RawLog<HistoryRecord> aggLog(aggRegion);
+SemaphoreHandle_t aggMutex = nullptr;
+HistoryRecord aggStage[AGG_STAGE_RECORDS];
+size_t aggStaged = 0;
+uint32_t aggStagedSince = 0;
+size_t aggCommitRecords = AGG_COMMIT_BYTES / RawLog<HistoryRecord>::SLOT_SIZE;   // 1 after a brown-out reset
+bool aggLogReady = false;
+bool aggLogHealthy = false;               // Large enough and writable: history file only needs checkpoints
+bool aggLogReplayPending = false;
+AggLogStats aggLogStats = {};
+
+// Power-fail snapshot: recent samples, open buckets and staged aggregates,
+// kept as a flash-ready image and programmed into a pre-erased sector when
+// the supply fails (POWER_FAIL_PIN) or the firmware restarts
+constexpr size_t snapshotSamples() {
+  return (FLASH_SECTOR_SIZE - sizeof(SnapshotHeader) - AGG_STAGE_RECORDS * sizeof(HistoryRecord) -
+          CHANNEL_COUNT * sizeof(SnapshotChannel)) / (CHANNEL_COUNT * sizeof(SnapshotSample)) < MAX_DETAILED_SAMPLES
+         ? (FLASH_SECTOR_SIZE - sizeof(SnapshotHeader) - AGG_STAGE_RECORDS * sizeof(HistoryRecord) -
+            CHANNEL_COUNT * sizeof(SnapshotChannel)) / (CHANNEL_COUNT * sizeof(SnapshotSample))
+         : MAX_DETAILED_SAMPLES;
+}
+constexpr size_t SNAPSHOT_SAMPLES = snapshotSamples();   // Newest detailed samples per channel in the image
+enum SnapshotReason : uint8_t { SNAPSHOT_POWER_FAIL, SNAPSHOT_RESTART, SNAPSHOT_REASONS };
+const char *const SNAPSHOT_REASON_NAMES[SNAPSHOT_REASONS] = {"power_fail", "restart"};
+struct SnapshotStats {
+  uint32_t writes;
+  uint32_t failures;
+  uint32_t skipped;                       // Triggers without an erased sector
+  uint32_t lastWriteUs;                   // Freeze to header programmed
+  uint32_t maxWriteUs;
+  uint32_t lastWriteMs;                   // millis() of the last snapshot, 0 = none
+  uint8_t lastReason;
+  bool recovered;                         // A snapshot was restored at this boot
+  uint8_t recoveredReason;
+  uint32_t recoveredTs;
+  uint32_t recoveredSamples;
+  uint32_t recoveredAggregates;
+};
+PartitionRegion snapshotRegion(SNAPSHOT_PARTITION);
+EmergencySnapshot<CHANNEL_COUNT, SNAPSHOT_SAMPLES, AGG_STAGE_RECORDS> snapshot;
+portMUX_TYPE snapshotMux = portMUX_INITIALIZER_UNLOCKED;
+volatile bool snapshotFrozen = false;     // Image being written: sampler updates are dropped
+bool snapshotReady = false;
+TaskHandle_t snapshotTaskHandle = nullptr;
+SnapshotStats snapshotStats = {};
+
+// Deferred history loading: setup() only validates the header, the records
+// are loaded from loop() once sampling and the web server are running. A
+// file that fails the check is recovered block by block (HISTORY_DAMAGED).
+enum HistoryLoadState { HISTORY_NONE, HISTORY_PENDING, HISTORY_LEGACY_PENDING, HISTORY_DAMAGED, HISTORY_LOADED };
+HistoryLoadState historyState = HISTORY_NONE;
+HistoryHeader historyHeader = {};
+HistoryScanReport historyScan = {};       // Last load of the history file
+HistoryScanner historyScanner;            // Load in progress, one step per loop() pass
+bool historyScanStarted = false;
+uint32_t historyScanMs = 0;               // Time spent in the scan steps
+uint32_t historyLoadStartMs = 0;
+uint32_t historyLoadedRecords = 0;
+bool historyQuarantined = false;          // Damaged file moved to STORAGE_HISTORY_QUARANTINE
+bool historyRepairPending = false;        // Rewrite the file from RAM after a recovery
+
+// Boot timing (milliseconds since reset), reported via /api/current
+uint32_t bootToHttpReadyMs = 0;
+uint32_t bootToFirstSampleMs = 0;
+uint32_t historyLoadMs = 0;
+
+// Per-channel state. Sample data lives in statically sized SoA rings:
+// detailed = last 30 minutes of slot samples, aggregated = 5-minute rollups.
+// Timestamps are slot starts (Unix seconds, or seconds since boot until NTP
+// has synced). Detailed entries: n = 1, missed = empty slots right before
+// the sample (gap marker), jitterMs = delay after the slot boundary.
+// Aggregates: n = samples in bucket, missed = empty slots, jitterMs = worst.
+struct Channel {
+  const SensorConfig *cfg;
+  SensorDriver *driver;
+  uint32_t intervalMs;               // Slot length
+  uint32_t staggerMs;                // Offset of this channel's slots
+  uint16_t slotsPerBucket;           // Slots per aggregation bucket
+  uint16_t detailedLimit;            // Detailed entries covering DETAILED_PERIOD_SEC
+  SampleRing<MAX_DETAILED_SAMPLES> detailed;
+  SampleRing<MAX_AGGREGATE_SAMPLES> aggregated;
+  BucketAccumulator bucket;          // Rollup of the bucket being filled
+  RollingStats<ANALYTICS_WINDOW_SAMPLES> recent;   // Edge analytics over recent samples
+  RollingStats<ANALYTICS_LONG_SAMPLES> hourly;     // ...and over recent 5-minute means
+  
+  // Deadline-based sampler: one sample per intervalMs slot, locked to
+  // wall-clock boundaries once NTP has synced, offset by staggerMs
+  bool samplerStarted;
+  uint32_t lastSampleSlot;           // Slot index of the last sampling attempt
+  uint32_t pendingMissedSlots;       // Slots without a valid sample since the last stored one
+  uint32_t totalMissedSlots;
+  uint32_t totalSamples;
+  uint32_t lastJitterMs;
+  uint32_t maxJitterMs;
+  uint32_t readyAtMs;                // millis() after the sensor's warm-up; the first slot waits for it
+  
+  // Oversampling burst of the current slot
+  Oversampler burst;
+  uint8_t burstTarget;               // Readings per slot (clamped to fit the slot)
+  uint32_t burstSpacingMs;           // Time between readings of a burst
+  bool burstActive;
+  uint64_t burstNextMs;              // Sample clock time of the next reading
+  uint32_t burstSlotTs;
+  uint32_t burstJitterMs;
+  uint32_t totalRejected;            // Readings dropped as invalid or outlier
+  uint32_t lastValidTs;              // Slot timestamp of the last stored sample
+  float lastStdT;                    // Spread of the last burst (standard deviation)
+  float lastStdH;
+};
+Channel channels[CHANNEL_COUNT];
+
+// Alert rule table. Rules 0 and 1 back the original temperature/humidity
+// alert endpoints and cannot be deleted. The per-channel index lists the
+// sample-driven rules of each channel; absence rules are checked from loop().
+constexpr uint8_t RULE_LEGACY_T = 0;
+constexpr uint8_t RULE_LEGACY_H = 1;
+AlertRule alertRules[MAX_ALERT_RULES];
+AlertState alertStates[MAX_ALERT_RULES];
+uint8_t channelRules[CHANNEL_COUNT][MAX_ALERT_RULES];
+uint8_t channelRuleCount[CHANNEL_COUNT];
+uint8_t absenceRules[MAX_ALERT_RULES];
+uint8_t absenceRuleCount = 0;
+SemaphoreHandle_t alertMutex = nullptr;   // Web handlers edit rules while loop() evaluates them
+uint32_t lastAbsenceCheck = 0;
+
+// Configuration: the rule table above is the in-RAM copy, configTask commits it
+ConfigStore configStore(storageFs, STORAGE_CONFIG_SLOT_A, STORAGE_CONFIG_SLOT_B);
+TaskHandle_t configTaskHandle = nullptr;
+char configBuffer[CONFIG_MAX_BYTES];      // Serialized configuration (configTask, setup())
+uint32_t configCommitMs = 0;              // Duration of the last commit
+
+// /api/history formatting worker (second core)
+struct HistoryFormatJob {
+  const HistoryPoint *points;
+  size_t count;
+  const HistoryJsonOptions *options;
+  TextChunks *out;
+  bool ok;
+};
+HistoryFormatJob historyJob = {};
+TaskHandle_t historyWorkerHandle = nullptr;
+SemaphoreHandle_t historyWorkerMutex = nullptr;   // One job at a time
+SemaphoreHandle_t historyJobDone = nullptr;
+
+// Outbound notification queue, drained by uplinkTask()
+NotifyQueue<NOTIFY_QUEUE_SIZE> notifyQueue;
+SemaphoreHandle_t notifyMutex = nullptr;
+TaskHandle_t uplinkTaskHandle = nullptr;
+volatile bool notifyDirty = false;
+uint32_t notifyDirtySince = 0;
+WiFiClient mqttNet;
+MqttClient mqtt(mqttNet);                 // Only used by uplinkTask()
+struct UplinkStats {
+  uint32_t delivered;
+  uint32_t lastDeliveredSeq;
+  uint32_t failures;
+  uint32_t backoffMs;                     // Current retry delay (0 = no failure pending)
+  int lastHttpCode;
+  bool mqttConnected;
 };
+UplinkStats uplinkStats = {};
 
-// Alert system variables
-float alertThreshold = 40.0;     // Default alert temperature in Celsius
-float humidityAlertThreshold = 90.0;  // Default alert humidity in %
-bool alertActive = false;        // Is an alert currently active?
-bool alertAcknowledged = true;   // Has the current alert been acknowledged?
-bool humidityAlertActive = false;        // Is a humidity alert currently active?
-bool humidityAlertAcknowledged = true;   // Has the current humidity alert been acknowledged?
-uint32_t lastAlertCheck = 0;
+// Telemetry staging queue (filled by loop()) and flash backlog (uplink task only)
+TelemetryQueue<TELEMETRY_QUEUE_SIZE> telemetryQueue;
+SemaphoreHandle_t telemetryMutex = nullptr;
+uint32_t telemetryNextSeq = 1;
+uint32_t telemetryOldestMs = 0;           // When the queue last became non-empty / was published
+TelemetryLog telemetryLog(storageFs, STORAGE_TELEMETRY_SEGMENT_A, STORAGE_TELEMETRY_SEGMENT_B,
+                          STORAGE_TELEMETRY_STATE, TELEMETRY_SEGMENT_RECORDS);
+struct TelemetryStats {
+  uint32_t published;
+  uint32_t ackedSeq;
+};
+TelemetryStats telemetryStats = {};
 
-std::deque<Reading> detailedBuffer;     // 10 minutes of 10-second data
-std::vector<Reading> aggregatedBuffer;   // Older data aggregated to 5-minute intervals
+// Outage journal (appended by loop(), read by the replay handlers)
+TelemetryLog outageJournal(storageFs, STORAGE_OUTAGE_SEGMENT_A, STORAGE_OUTAGE_SEGMENT_B,
+                           STORAGE_OUTAGE_STATE, OUTAGE_SEGMENT_RECORDS);
+SemaphoreHandle_t journalMutex = nullptr;
+TelemetryStage<OUTAGE_STAGE_RECORDS> journalStage(MIN_VALID_EPOCH);   // Boot-clock samples wait for the rebase
+uint32_t journalStagedSince = 0;
+uint32_t journalNextSeq = 1;
+bool journalReady = false;                // Journal state read from flash
+struct OutageStats {
+  bool active;
+  uint32_t count;                         // Outages since boot
+  uint32_t startTs;                       // Start of the current / last outage
+  uint32_t endTs;                         // End of the last outage (0 while active)
+  uint32_t journaled;                     // Samples written to the journal since boot
+  uint32_t writeErrors;
+};
+OutageStats outageStats = {};
 
-DHT dht(DHTPIN, DHTTYPE);
 AsyncWebServer server(80);
-uint32_t lastSample = 0;
 uint32_t lastNetworkCheck = 0;
 bool isConnected = false;
 
+// Link state, written by the WiFi/ETH event callbacks (event task) and
+// consumed by checkNetworkStatus() in loop()
+volatile bool ethConnected = false;
+volatile bool wifiConnected = false;
+volatile bool networkChanged = false;
+bool networkServicesStarted = false;
+
 // Forward declarations
-void aggregateOldData();
+void closeBucket(Channel &ch);
+void initChannels();
+void runIngestBenchmark();
 void emergencyDataCompression();
 void saveToPersistentStorage();
-void loadFromPersistentStorage();
-void saveConfigToPersistentStorage();
+bool loadHistoryStep(uint32_t budgetMs);
+void importLegacyHistory();
+void validatePersistentStorage();
+bool historyLoadPending();
+void serviceHistoryLoad(uint32_t budgetMs = HISTORY_LOAD_STEP_MS);
+void ensureHistoryLoaded();
 void loadConfigFromPersistentStorage();
+bool storageReady();
+bool storageMount();
+void storageRecordWrite(uint32_t startUs, bool ok);
+void onStorageMounted();
+void serviceStorage();
 uint32_t getMemoryUsagePercent();
 void checkMemoryUsage();
 void setupNTP();
-String getCurrentDateTime();
+uint64_t sampleClockMs();
+bool runSampler();
+uint32_t msUntilNextSample();
+void addReading(Channel &ch, float t, float h, uint32_t now, uint32_t jitterMs);
+void checkTimeSync();
+bool rebaseBootTimestamps();
 uint32_t getCurrentTimestamp();
-void checkTemperatureAlert(float temperature);
-void checkHumidityAlert(float humidity);
+void setDefaultAlertRules();
+void rebuildAlertIndex();
+void evaluateAlerts(size_t c, uint32_t now, float t, float h);
+void checkAbsenceAlerts();
+void markConfigDirty();
+void commitConfig();
+void configTask(void *);
+void loadConfig();
+void queueNotification(size_t i, NotifyEvent event, uint32_t now);
+void uplinkTask(void *);
+void flushNotifyQueue();
+void loadNotifyQueue();
+bool notifyTransportConfigured();
+bool telemetryEnabled();
+void queueTelemetry(size_t c, TelemetryKind kind, uint32_t ts, float t, float h, uint16_t n);
+void beginOutage();
+void endOutage();
+void journalSample(size_t c, uint32_t ts, float t, float h);
+void flushOutageJournal();
+void stageAggregate(size_t c, uint32_t ts, float t, float h, uint16_t n, uint16_t missed);
+void snapshotSample(size_t c, uint32_t ts, float t, float h, uint16_t missed, uint16_t jitterMs);
+void snapshotBucket(const Channel &ch);
+bool writeEmergencySnapshot(SnapshotReason reason);
+bool commitAggregates(AggCommitReason reason, TickType_t wait = portMAX_DELAY);
+void serviceOutageJournal();
 void handleSetAlert(AsyncWebServerRequest *req);
 void handleSetHumidityAlert(AsyncWebServerRequest *req);
 void handleAckAlert(AsyncWebServerRequest *req);
 void handleAckHumidityAlert(AsyncWebServerRequest *req);
 void handleGetAlert(AsyncWebServerRequest *req);
 void handleGetHumidityAlert(AsyncWebServerRequest *req);
+void handleListAlerts(AsyncWebServerRequest *req);
+void handleAddAlert(AsyncWebServerRequest *req);
+void handleUpdateAlert(AsyncWebServerRequest *req);
+void handleDeleteAlert(AsyncWebServerRequest *req);
+void handleAckRule(AsyncWebServerRequest *req);
+void handleNotifyStatus(AsyncWebServerRequest *req);
+void handleTelemetryStatus(AsyncWebServerRequest *req);
+void handleOutageStatus(AsyncWebServerRequest *req);
+void handleOutageAck(AsyncWebServerRequest *req);
+void handleOutageReplay(AsyncWebServerRequest *req);
+void handleMetrics(AsyncWebServerRequest *req);
+void handleLogs(AsyncWebServerRequest *req);
+void handleStorageStatus(AsyncWebServerRequest *req);
+void handleStorageFormat(AsyncWebServerRequest *req);
+int parseChannel(AsyncWebServerRequest *req);
+float round2(float v);
 void handleCurrent(AsyncWebServerRequest *req);
 void handleHistory(AsyncWebServerRequest *req);
+void handleExport(AsyncWebServerRequest *req);
 void handleRoot(AsyncWebServerRequest *req);
 
+// Formatter for log output from loop(); web handlers use their own instance
+DateFormatter logTimeFormatter;
+
+// NTP state - SNTP runs in the background, nothing here ever blocks
+volatile bool timeSyncPending = false;   // Set by the SNTP callback, consumed in loop()
+bool timeSynced = false;
+bool ntpStarted = false;
+int ntpServerIndex = 0;                  // First server of the currently configured set
+uint32_t ntpConfiguredAt = 0;
+
+// Runs on the lwIP task when SNTP has set the system clock
+void onTimeSync(struct timeval *tv) {
+  timeSyncPending = true;
+}
+
+// Configures up to three servers starting at ntpServerIndex
+void configureNTPServers() {
+  const char *s0 = NTP_SERVERS[ntpServerIndex % NTP_SERVER_COUNT];
+  const char *s1 = NTP_SERVER_COUNT > 1 ? NTP_SERVERS[(ntpServerIndex + 1) % NTP_SERVER_COUNT] : nullptr;
+  const char *s2 = NTP_SERVER_COUNT > 2 ? NTP_SERVERS[(ntpServerIndex + 2) % NTP_SERVER_COUNT] : nullptr;
+  
+  configTime(GMT_OFFSET_SEC, DAYLIGHT_OFFSET_SEC, s0, s1, s2);
+  ntpConfiguredAt = millis();
+  LOGI("NTP servers: %s, %s, %s\n", s0, s1 ? s1 : "-", s2 ? s2 : "-");
+}
+
 // NTP Time Functions
 void setupNTP() {
-  Serial.println("Setting up NTP time synchronization...");
-  
-  // Try multiple NTP servers for better reliability
-  bool timeSet = false;
-  for (int attempt = 0; attempt < 3 && !timeSet; attempt++) {
-    Serial.printf("NTP attempt %d/3\n", attempt + 1);
-    
-    // Configure NTP with multiple servers
-    if (NTP_SERVER_COUNT >= 3) {
-      configTime(GMT_OFFSET_SEC, DAYLIGHT_OFFSET_SEC, 
-                 NTP_SERVERS[0], NTP_SERVERS[1], NTP_SERVERS[2]);
-    } else if (NTP_SERVER_COUNT >= 2) {
-      configTime(GMT_OFFSET_SEC, DAYLIGHT_OFFSET_SEC, 
-                 NTP_SERVERS[0], NTP_SERVERS[1]);
-    } else {
-      configTime(GMT_OFFSET_SEC, DAYLIGHT_OFFSET_SEC, NTP_SERVERS[0]);
+  Serial.println("Setting up NTP time synchronization (background)...");
+  sntp_set_time_sync_notification_cb(onTimeSync);
+  ntpServerIndex = 0;
+  configureNTPServers();
+  ntpStarted = true;
+}
+
+// Called from loop(): handles sync completion and rotates through all servers
+void checkTimeSync() {
+  if (timeSyncPending) {
+    if (!timeSynced) {
+      // The samplers switch clocks with timeSynced, so it is only set once
+      // everything has been moved; an implausible clock is retried next pass
+      if (!rebaseBootTimestamps()) return;
+      timeSynced = true;
+      char dt[TIME_FORMAT_MAX];
+      logTimeFormatter.invalidate();
+      logTimeFormatter.format(getCurrentTimestamp(), dt);
+      LOGI("✅ NTP time synchronized after %d ms: %s\n",
+           millis() - ntpConfiguredAt, dt);
+      LOGI("Timezone: UTC%+d (DST: %+d)\n", 
+           GMT_OFFSET_SEC/3600, DAYLIGHT_OFFSET_SEC/3600);
     }
+    timeSyncPending = false;
+    return;
+  }
   
-  // Wait for time to be set
-    Serial.print("Waiting for NTP sync");
-  int timeout = 0;
-    while (!time(nullptr) && timeout < 15) {
-    delay(1000);
-    Serial.print(".");
-    timeout++;
+  if (ntpStarted && !timeSynced && millis() - ntpConfiguredAt >= NTP_ROTATE_MS) {
+    LOGW("⚠️ NTP sync pending, trying next server set...\n");
+    ntpServerIndex = (ntpServerIndex + 3) % NTP_SERVER_COUNT;
+    configureNTPServers();
   }
+}
+
+// Moves samples taken on the seconds-since-boot fallback clock to wall time.
+// Returns false (and changes nothing) while the wall clock is not yet valid.
+bool rebaseBootTimestamps() {
+  uint32_t wallNow = getCurrentTimestamp();
+  uint32_t uptime = millis() / 1000;
+  if (wallNow < MIN_VALID_EPOCH) return false;
+  uint32_t offset = wallNow - uptime;
   
-  if (time(nullptr)) {
-      timeSet = true;
-      Serial.println("\n✅ NTP time synchronized!");
-    Serial.printf("Current time: %s\n", getCurrentDateTime().c_str());
-      Serial.printf("Timezone: UTC%+d (DST: %+d)\n", 
-                   GMT_OFFSET_SEC/3600, DAYLIGHT_OFFSET_SEC/3600);
-  } else {
-      Serial.println("\n⚠️ NTP sync failed, trying next attempt...");
-      delay(2000);
+  int rebased = 0;
+  for (Channel &ch : channels) {
+    for (size_t i = 0; i < ch.detailed.size(); i++) {
+      size_t idx = ch.detailed.at(i);
+      if (ch.detailed.ts[idx] < MIN_VALID_EPOCH) {
+        ch.detailed.ts[idx] += offset;
+        rebased++;
+      }
+    }
+    for (size_t i = 0; i < ch.aggregated.size(); i++) {
+      size_t idx = ch.aggregated.at(i);
+      if (ch.aggregated.ts[idx] < MIN_VALID_EPOCH) {
+        ch.aggregated.ts[idx] += offset;
+        rebased++;
+      }
+    }
+    
+    ch.recent.shiftTimestamps(MIN_VALID_EPOCH, offset);
+    ch.hourly.shiftTimestamps(MIN_VALID_EPOCH, offset);
+    if (ch.lastValidTs < MIN_VALID_EPOCH) ch.lastValidTs += offset;
+    
+    // The open bucket keeps its samples; realign its start to the new grid
+    if (ch.bucket.n > 0 && ch.bucket.bucketTs < MIN_VALID_EPOCH) {
+      ch.bucket.bucketTs = ((ch.bucket.bucketTs + offset) / AGGREGATE_INTERVAL_SEC) * AGGREGATE_INTERVAL_SEC;
+      snapshotBucket(ch);
+    }
+    
+    // Move the sampler (and a running burst) to the wall-clock slot grid
+    if (ch.burstActive) {
+      ch.burstNextMs += (uint64_t)offset * 1000;
+      if (ch.burstSlotTs < MIN_VALID_EPOCH) ch.burstSlotTs += offset;
+    }
+    if (ch.samplerStarted) {
+      ch.lastSampleSlot = (uint32_t)(((uint64_t)ch.lastSampleSlot * ch.intervalMs + (uint64_t)offset * 1000) / ch.intervalMs);
     }
   }
+  if (lastStorageSave < MIN_VALID_EPOCH) lastStorageSave += offset;
+  portENTER_CRITICAL(&snapshotMux);
+  snapshot.shiftTimestamps(MIN_VALID_EPOCH, offset);
+  portEXIT_CRITICAL(&snapshotMux);
   
-  if (!timeSet) {
-    Serial.println("❌ All NTP attempts failed - using system millis() for timestamps");
-    Serial.println("Time display will show relative time from boot");
+  // Alert timers and queued notifications use the same clock
+  xSemaphoreTake(alertMutex, portMAX_DELAY);
+  for (AlertState &st : alertStates) {
+    if (st.pendingSince < MIN_VALID_EPOCH) st.pendingSince += offset;
+    if (st.since && st.since < MIN_VALID_EPOCH) st.since += offset;
   }
-}
-
-String getCurrentDateTime() {
-  time_t now;
-  struct tm timeinfo;
-  time(&now);
-  localtime_r(&now, &timeinfo);
+  xSemaphoreGive(alertMutex);
+  xSemaphoreTake(notifyMutex, portMAX_DELAY);
+  for (size_t i = 0; i < notifyQueue.size(); i++) {
+    if (notifyQueue.at(i).ts < MIN_VALID_EPOCH) notifyQueue.at(i).ts += offset;
+  }
+  xSemaphoreGive(notifyMutex);
+  xSemaphoreTake(telemetryMutex, portMAX_DELAY);
+  for (size_t i = 0; i < telemetryQueue.size(); i++) {
+    if (telemetryQueue.at(i).ts < MIN_VALID_EPOCH) telemetryQueue.at(i).ts += offset;
+  }
+  xSemaphoreGive(telemetryMutex);
+  journalStage.rebase(offset);
+  xSemaphoreTake(aggMutex, portMAX_DELAY);
+  for (size_t i = 0; i < aggStaged; i++) {
+    if (aggStage[i].ts < MIN_VALID_EPOCH) aggStage[i].ts += offset;
+  }
+  xSemaphoreGive(aggMutex);
+  if (outageStats.startTs && outageStats.startTs < MIN_VALID_EPOCH) outageStats.startTs += offset;
+  if (outageStats.endTs && outageStats.endTs < MIN_VALID_EPOCH) outageStats.endTs += offset;
   
-  char buffer[64];
-  strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &timeinfo);
-  return String(buffer);
+  LOGI("🕒 Re-based %d boot-clock samples to wall time (offset %u s)\n", rebased, offset);
+  return true;
 }
 
 uint32_t getCurrentTimestamp() {
@@ -175,212 +808,382 @@ void setupNetworkDiscovery() {
   
   // Setup mDNS for .local domain access
   if (MDNS.begin(HOSTNAME)) {
-    Serial.printf("mDNS responder started: http://%s.local\n", HOSTNAME);
+    LOGI("mDNS responder started: http://%s.local\n", HOSTNAME);
     
     // Add service advertisement
     MDNS.addService("http", "tcp", 80);
     MDNS.addServiceTxt("http", "tcp", "device", "temperature-sensor");
     MDNS.addServiceTxt("http", "tcp", "version", "1.0");
   } else {
-    Serial.println("Error setting up mDNS responder!");
+    LOGE("Error setting up mDNS responder!\n");
   }
 }
 
 void printNetworkInfo() {
-  Serial.println("\n==================================================");
-  Serial.println("NETWORK CONNECTION SUCCESS!");
-  Serial.println("==================================================");
+  LOGI("\n==================================================\n");
+  LOGI("NETWORK CONNECTION SUCCESS!\n");
+  LOGI("==================================================\n");
   
   if (ETH.linkUp()) {
-    Serial.println("Connection Type: Ethernet");
-    Serial.printf("IP Address: %s\n", ETH.localIP().toString().c_str());
-    Serial.printf("Gateway: %s\n", ETH.gatewayIP().toString().c_str());
-    Serial.printf("Subnet: %s\n", ETH.subnetMask().toString().c_str());
+    LOGI("Connection Type: Ethernet\n");
+    LOGI("IP Address: %s\n", ETH.localIP().toString().c_str());
+    LOGI("Gateway: %s\n", ETH.gatewayIP().toString().c_str());
+    LOGI("Subnet: %s\n", ETH.subnetMask().toString().c_str());
   } else if (WiFi.status() == WL_CONNECTED) {
-    Serial.println("Connection Type: WiFi");
-    Serial.printf("IP Address: %s\n", WiFi.localIP().toString().c_str());
-    Serial.printf("Gateway: %s\n", WiFi.gatewayIP().toString().c_str());
-    Serial.printf("Subnet: %s\n", WiFi.subnetMask().toString().c_str());
-    Serial.printf("WiFi RSSI: %d dBm\n", WiFi.RSSI());
+    LOGI("Connection Type: WiFi\n");
+    LOGI("IP Address: %s\n", WiFi.localIP().toString().c_str());
+    LOGI("Gateway: %s\n", WiFi.gatewayIP().toString().c_str());
+    LOGI("Subnet: %s\n", WiFi.subnetMask().toString().c_str());
+    LOGI("WiFi RSSI: %d dBm\n", WiFi.RSSI());
   }
   
-  Serial.println("\nEASY ACCESS OPTIONS:");
-  Serial.println("┌─────────────────────────────────────────┐");
-  Serial.printf("│ 1. Browser:  http://%s.local       │\n", HOSTNAME);
+  LOGI("\nEASY ACCESS OPTIONS:\n");
+  LOGI("┌─────────────────────────────────────────┐\n");
+  LOGI("│ 1. Browser:  http://%s.local       │\n", HOSTNAME);
   if (ETH.linkUp()) {
-    Serial.printf("│ 2. Direct:   http://%-15s │\n", ETH.localIP().toString().c_str());
+    LOGI("│ 2. Direct:   http://%-15s │\n", ETH.localIP().toString().c_str());
   } else {
-    Serial.printf("│ 2. Direct:   http://%-15s │\n", WiFi.localIP().toString().c_str());
+    LOGI("│ 2. Direct:   http://%-15s │\n", WiFi.localIP().toString().c_str());
   }
-  Serial.printf("│ 3. Hostname: %s                │\n", HOSTNAME);
-  Serial.println("└─────────────────────────────────────────┘");
-  Serial.println("\nTIP: Use option 1 on most networks!");
-  Serial.println("==================================================\n");
+  LOGI("│ 3. Hostname: %s                │\n", HOSTNAME);
+  LOGI("└─────────────────────────────────────────┘\n");
+  LOGI("\nTIP: Use option 1 on most networks!\n");
+  LOGI("==================================================\n\n");
 }
 
+// Status LED pattern, advanced by serviceStatusLED() from loop()
+uint16_t ledPhasesLeft = 0;   // On/off edges still to come
+uint16_t ledPhaseMs = 0;
+uint32_t ledPhaseStartMs = 0;
+
+// Starts a blink pattern (replacing a running one); never blocks
 void blinkStatusLED(int blinks, int delayMs = 200) {
+  if (blinks <= 0) return;
   pinMode(LED_PIN, OUTPUT);
-  for (int i = 0; i < blinks; i++) {
-    digitalWrite(LED_PIN, HIGH);
-    delay(delayMs);
-    digitalWrite(LED_PIN, LOW);
-    delay(delayMs);
+  digitalWrite(LED_PIN, HIGH);
+  ledPhasesLeft = blinks * 2 - 1;
+  ledPhaseMs = delayMs;
+  ledPhaseStartMs = millis();
+}
+
+// Milliseconds until the LED changes next (UINT32_MAX when idle)
+uint32_t msUntilStatusLED() {
+  if (!ledPhasesLeft) return UINT32_MAX;
+  uint32_t elapsed = millis() - ledPhaseStartMs;
+  return elapsed >= ledPhaseMs ? 0 : ledPhaseMs - elapsed;
+}
+
+void serviceStatusLED() {
+  if (msUntilStatusLED() != 0) return;
+  ledPhasesLeft--;
+  ledPhaseStartMs = millis();
+  digitalWrite(LED_PIN, (ledPhasesLeft & 1) ? HIGH : LOW);
+}
+
+// Runs on the Arduino event task - only record state, never block here
+void onNetworkEvent(WiFiEvent_t event) {
+  switch (event) {
+    case ARDUINO_EVENT_ETH_START:
+      ETH.setHostname(HOSTNAME);
+      break;
+    case ARDUINO_EVENT_ETH_GOT_IP:
+      ethConnected = true;
+      networkChanged = true;
+      break;
+    case ARDUINO_EVENT_ETH_DISCONNECTED:
+    case ARDUINO_EVENT_ETH_STOP:
+      ethConnected = false;
+      networkChanged = true;
+      break;
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+      wifiConnected = true;
+      networkChanged = true;
+      break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+    case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+      wifiConnected = false;
+      networkChanged = true;
+      break;
+    default:
+      break;
+  }
+}
+
+// Starts Ethernet and WiFi concurrently without waiting for either link.
+// WiFi stays up as a hot standby, so losing one link fails over at once.
+void startNetwork() {
+  WiFi.onEvent(onNetworkEvent);
+  
+  if (USE_ETH) {
+    Serial.println("Initializing Ethernet...");
+    ETH.begin();
   }
+  
+  Serial.println("Initializing WiFi...");
+  WiFi.mode(WIFI_STA);
+  WiFi.setHostname(HOSTNAME);
+  WiFi.setAutoReconnect(true);
+  WiFi.begin(SSID, PASS);
 }
 
 void checkNetworkStatus() {
-  bool currentlyConnected = false;
+  if (networkChanged) {
+    networkChanged = false;
+    bool currentlyConnected = ethConnected || wifiConnected;
+    
+    if (currentlyConnected != isConnected) {
+      isConnected = currentlyConnected;
+      if (isConnected) {
+        LOGI("Network connected via %s\n", ethConnected ? "Ethernet" : "WiFi");
+        
+        // mDNS and NTP need a live interface - start them on the first link
+        if (!networkServicesStarted) {
+          networkServicesStarted = true;
+          setupNetworkDiscovery();
+          setupNTP();
+        }
+        blinkStatusLED(3, 100);  // 3 quick blinks = connected
+        printNetworkInfo();
+        endOutage();
+      } else {
+        LOGI("Network disconnected\n");
+        beginOutage();
+        blinkStatusLED(1, 1000); // 1 long blink = disconnected
+      }
+    } else if (isConnected) {
+      LOGI("Network failover: now using %s\n", ethConnected ? "Ethernet" : "WiFi");
+    }
+  }
   
-  if (USE_ETH && ETH.linkUp()) {
-    currentlyConnected = true;
-  } else if (WiFi.status() == WL_CONNECTED) {
-    currentlyConnected = true;
+  // Auto-reconnect gives up on some failure reasons - nudge WiFi while offline
+  if (!wifiConnected && millis() - lastNetworkCheck >= NETWORK_CHECK_MS) {
+    lastNetworkCheck = millis();
+    wl_status_t status = WiFi.status();
+    if (status == WL_DISCONNECTED || status == WL_CONNECT_FAILED || status == WL_NO_SSID_AVAIL) {
+      WiFi.reconnect();
+    }
+  }
+}
+
+// Sampling clock in milliseconds: wall time once NTP synced, boot time before.
+// Switching domains is handled by rebaseBootTimestamps().
+uint64_t sampleClockMs() {
+  if (timeSynced) {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+  }
+  return millis();
+}
+
+// Plausibility check for a single raw reading
+bool readingValid(float t, float h) {
+  return !isnan(t) && !isnan(h) && t >= -40 && t <= 80 && h >= 0 && h <= 100;
+}
+
+// One raw reading of the running burst
+void takeBurstReading(Channel &ch) {
+  float temperature = NAN;
+  float humidity = NAN;
+  ch.driver->read(temperature, humidity);
+  
+  LOGD("🔍 [%s] Raw %s values (%d/%d): T=%s°C, H=%s%%\n", ch.cfg->name, ch.driver->model(),
+       ch.burst.taken() + 1, ch.burstTarget, FixedText(temperature, 2).s, FixedText(humidity, 2).s);
+  if (readingValid(temperature, humidity)) {
+    ch.burst.add(temperature, humidity);
+  } else {
+    ch.burst.addInvalid();
+  }
+}
+
+// Filters the burst into one sample; a burst without valid readings counts
+// as a missed slot
+void finishBurst(Channel &ch) {
+  ch.burstActive = false;
+  FilterResult t, h;
+  if (!ch.burst.finish(ch.cfg->filter, OVERSAMPLE_OUTLIER_K, OVERSAMPLE_FLOOR_T, OVERSAMPLE_FLOOR_H, t, h)) {
+    ch.totalRejected += ch.burst.invalid();
+    addReading(ch, NAN, NAN, ch.burstSlotTs, ch.burstJitterMs);
+    return;
   }
   
-  if (currentlyConnected != isConnected) {
-    isConnected = currentlyConnected;
-    if (isConnected) {
-      Serial.println("Network reconnected");
-      blinkStatusLED(3, 100);  // 3 quick blinks = connected
-      printNetworkInfo();
+  uint8_t used = t.used < h.used ? t.used : h.used;
+  ch.totalRejected += ch.burst.taken() - used;
+  ch.lastStdT = sqrtf(t.variance);
+  ch.lastStdH = sqrtf(h.variance);
+  if (ch.burst.taken() > 1) {
+    LOGD("🧮 [%s] Burst %d/%d readings used, σT=%s, σH=%s\n",
+         ch.cfg->name, used, ch.burst.taken(), FixedText(ch.lastStdT, 2).s, FixedText(ch.lastStdH, 2).s);
+  }
+  addReading(ch, t.value, h.value, ch.burstSlotTs, ch.burstJitterMs);
+}
+
+// Takes one sample per slot and channel; the schedule never drifts because
+// slots are derived from the clock, not from when the previous read ended.
+// Each channel has its own slot length and is due staggerMs after its slot
+// boundary. Oversampling channels take their remaining burst readings on
+// later calls. At most one sensor is read per call, so reads never pile up.
+// Returns true if a sensor was read.
+bool runSampler() {
+  uint64_t nowMs = sampleClockMs();
+  
+  for (size_t c = 0; c < CHANNEL_COUNT; c++) {
+    Channel &ch = channels[c];
+    if (!ch.samplerStarted && (int32_t)(millis() - ch.readyAtMs) < 0) continue;   // Sensor warming up
+    uint64_t offsetMs = ch.staggerMs;
+    if (nowMs < offsetMs) continue;
+    uint32_t slot = (nowMs - offsetMs) / ch.intervalMs;
+    bool newSlot = !ch.samplerStarted || slot > ch.lastSampleSlot;  // Also ignores small NTP steps backwards
+    
+    if (ch.burstActive) {
+      if (newSlot) {
+        finishBurst(ch);   // Slow loop or clock step: use what the burst has so far
+      } else if (nowMs >= ch.burstNextMs) {
+        takeBurstReading(ch);
+        ch.burstNextMs += ch.burstSpacingMs;
+        if (ch.burst.taken() >= ch.burstTarget) finishBurst(ch);
+        return true;
+      }
+    }
+    if (!newSlot) continue;
+    
+    if (ch.samplerStarted && slot > ch.lastSampleSlot + 1) {
+      uint32_t missed = slot - ch.lastSampleSlot - 1;
+      ch.pendingMissedSlots += missed;
+      ch.totalMissedSlots += missed;
+      LOGW("⚠️ [%s] Sampler missed %d slot(s)\n", ch.cfg->name, missed);
+    }
+    ch.samplerStarted = true;
+    ch.lastSampleSlot = slot;
+    
+    uint32_t jitterMs = nowMs - offsetMs - (uint64_t)slot * ch.intervalMs;
+    ch.lastJitterMs = jitterMs;
+    if (jitterMs > ch.maxJitterMs) ch.maxJitterMs = jitterMs;
+    
+    // A slot in a later bucket closes the current one, even if this read fails
+    uint32_t slotTs = (uint64_t)slot * ch.intervalMs / 1000;
+    if (ch.bucket.n > 0 && slotTs / AGGREGATE_INTERVAL_SEC != ch.bucket.bucketTs / AGGREGATE_INTERVAL_SEC) {
+      closeBucket(ch);
+    }
+    
+    ch.burst.reset();
+    ch.burstSlotTs = slotTs;
+    ch.burstJitterMs = jitterMs;
+    takeBurstReading(ch);
+    if (ch.burstTarget > 1) {
+      ch.burstActive = true;
+      ch.burstNextMs = nowMs + ch.burstSpacingMs;
     } else {
-      Serial.println("Network disconnected");
-      blinkStatusLED(1, 1000); // 1 long blink = disconnected
+      finishBurst(ch);
+    }
+    return true;
+  }
+  return false;
+}
+
+// Milliseconds until the next channel is due (for loop() sleeping)
+uint32_t msUntilNextSample() {
+  uint64_t nowMs = sampleClockMs();
+  uint32_t best = SAMPLE_MS;
+  for (const Channel &ch : channels) {
+    if (!ch.samplerStarted) {
+      int32_t warmup = (int32_t)(ch.readyAtMs - millis());
+      if (warmup > 0) {
+        if ((uint32_t)warmup < best) best = warmup;
+        continue;
+      }
+    }
+    if (ch.burstActive) {
+      uint32_t wait = ch.burstNextMs > nowMs ? ch.burstNextMs - nowMs : 0;
+      if (wait < best) best = wait;
+    }
+    uint64_t offsetMs = ch.staggerMs;
+    if (nowMs < offsetMs) {
+      uint32_t wait = offsetMs - nowMs;
+      if (wait < best) best = wait;
+      continue;
     }
+    uint32_t wait = ch.intervalMs - (uint32_t)((nowMs - offsetMs) % ch.intervalMs);
+    if (wait < best) best = wait;
   }
+  return best;
 }
 
 // Helper functions
-void addReading(float t, float h) {
+void addReading(Channel &ch, float t, float h, uint32_t now, uint32_t jitterMs) {
   if (isnan(t) || isnan(h)) {
-    Serial.printf("❌ DHT sensor read failed - T:%.2f, H:%.2f\n", t, h);
+    LOGE("❌ [%s] Sensor read failed - T:%s, H:%s\n", ch.cfg->name, FixedText(t, 2).s, FixedText(h, 2).s);
+    ch.pendingMissedSlots++;
+    ch.totalMissedSlots++;
     return;
   }
   
   // Additional validation
-  if (t < -40 || t > 80 || h < 0 || h > 100) {
-    Serial.printf("❌ DHT sensor values out of range - T:%.2f, H:%.2f\n", t, h);
+  if (!readingValid(t, h)) {
+    LOGE("❌ [%s] Sensor values out of range - T:%s, H:%s\n", ch.cfg->name, FixedText(t, 2).s, FixedText(h, 2).s);
+    ch.pendingMissedSlots++;
+    ch.totalMissedSlots++;
     return;
   }
   
-  // Get current timestamp and formatted date/time
-  uint32_t now = getCurrentTimestamp();
-  String datetime = getCurrentDateTime();
+  // Slot timestamps before the first NTP sync are seconds since boot;
+  // rebaseBootTimestamps() moves them to wall time once the clock is set
   
-  // If NTP failed, fall back to millis-based timestamp with boot offset
-  if (now == 0 || now < 1000000000) {
-    static uint32_t bootTime = millis() / 1000;
-    now = bootTime + (millis() / 1000);
-    datetime = "Boot+" + String(millis() / 1000) + "s";
+  // Add to the detailed ring, carrying the gap marker for skipped slots
+  uint16_t missed = ch.pendingMissedSlots > 0xFFFF ? 0xFFFF : ch.pendingMissedSlots;
+  uint16_t jitter = jitterMs > 0xFFFF ? 0xFFFF : jitterMs;
+  ch.detailed.push(now, t, h, 1, missed, jitter);
+  if (ch.detailed.size() > ch.detailedLimit) ch.detailed.dropOldest(1);
+  snapshotSample(ch.cfg - SENSORS, now, t, h, missed, jitter);
+  ch.pendingMissedSlots = 0;
+  ch.totalSamples++;
+  if (bootToFirstSampleMs == 0) {
+    bootToFirstSampleMs = millis();
   }
   
-  // Add to detailed buffer (10-second intervals)
-  detailedBuffer.push_back({now, t, h, datetime});
-  
-  // Keep only 10 minutes of detailed data
-  while (detailedBuffer.size() > MAX_DETAILED_SAMPLES) {
-    detailedBuffer.pop_front();
+  // Incremental 5-minute rollup
+  if (ch.bucket.n == 0) {
+    ch.bucket.reset((now / AGGREGATE_INTERVAL_SEC) * AGGREGATE_INTERVAL_SEC);
   }
+  ch.bucket.add(t, h, jitter);
+  snapshotBucket(ch);
+  ch.recent.push(now, t, h);
+  ch.lastValidTs = now;
+  queueTelemetry(ch.cfg - SENSORS, TELEMETRY_SAMPLE, now, t, h, 1);
+  journalSample(ch.cfg - SENSORS, now, t, h);
   
-  Serial.printf("✅ Reading [%s]: %.1f°C, %.0f%% RH (detailed: %d samples)\n", 
-                datetime.c_str(), t, h, detailedBuffer.size());
+  char datetime[TIME_FORMAT_MAX];
+  logTimeFormatter.format(now, datetime);
+  LOGI("✅ [%s] Reading [%s]: %s°C, %s%% RH (detailed: %d samples, jitter %d ms)\n", 
+       ch.cfg->name, datetime, FixedText(t, 1).s, FixedText(h, 0).s, ch.detailed.size(), jitterMs);
   
-  // Check for temperature and humidity alerts
-  checkTemperatureAlert(t);
-  checkHumidityAlert(h);
+  // Evaluate the alert rules of this channel
+  evaluateAlerts(ch.cfg - SENSORS, now, t, h);
   
   // Check memory usage every reading
   checkMemoryUsage();
-  
-  // Aggregate old data every 5 minutes (or sooner if in emergency mode)
-  static uint32_t lastAggregation = 0;
-  uint32_t aggregationInterval = emergencyMode ? (AGGREGATE_INTERVAL_SEC / 2) : AGGREGATE_INTERVAL_SEC;
-  if ((now - lastAggregation) >= aggregationInterval) {
-    aggregateOldData();
-    lastAggregation = now;
-  }
-  
-  // Save to persistent storage periodically
-  if ((now - lastSPIFFSSave) >= SPIFFS_SAVE_INTERVAL_SEC) {
-    saveToPersistentStorage();
-    lastSPIFFSSave = now;
-  }
 }
 
-void aggregateOldData() {
-  // Only aggregate if we have enough detailed data
-  if (detailedBuffer.empty()) return;
-  
-  // Get current time
-  uint32_t now = getCurrentTimestamp();
-  if (now == 0 || now < 1000000000) {
-    now = millis() / 1000;
-  }
-  
-  // Find data older than DETAILED_PERIOD_SEC (10 minutes)
-  uint32_t cutoffTime = now - DETAILED_PERIOD_SEC;
-  
-  // Group old data into 5-minute buckets for aggregation
-  std::map<uint32_t, std::vector<Reading>> buckets;
+// Turns the open bucket into an aggregated record with its coverage count
+void closeBucket(Channel &ch) {
+  if (ch.bucket.n == 0) return;
   
-  auto it = detailedBuffer.begin();
-  while (it != detailedBuffer.end() && it->ts < cutoffTime) {
-    // Round timestamp to 5-minute boundary
-    uint32_t bucketTime = (it->ts / AGGREGATE_INTERVAL_SEC) * AGGREGATE_INTERVAL_SEC;
-    buckets[bucketTime].push_back(*it);
-    ++it;
-  }
-  
-  // Create aggregated readings from buckets
-  for (const auto& bucket : buckets) {
-    if (bucket.second.empty()) continue;
-    
-    float avgTemp = 0, avgHum = 0;
-    for (const Reading& reading : bucket.second) {
-      avgTemp += reading.t;
-      avgHum += reading.h;
-    }
-    avgTemp /= bucket.second.size();
-    avgHum /= bucket.second.size();
-    
-    // Create datetime string for aggregated data
-    time_t bucketTimeT = bucket.first;
-    struct tm timeinfo;
-    localtime_r(&bucketTimeT, &timeinfo);
-    char datetimeStr[64];
-    strftime(datetimeStr, sizeof(datetimeStr), "%Y-%m-%d %H:%M:%S", &timeinfo);
-    
-    // Add to aggregated buffer if not already present
-    bool exists = false;
-    for (const Reading& existing : aggregatedBuffer) {
-      if (abs((int)existing.ts - (int)bucket.first) < 60) { // Within 1 minute tolerance
-        exists = true;
-        break;
-      }
-    }
-    
-    if (!exists) {
-      aggregatedBuffer.push_back({bucket.first, avgTemp, avgHum, String(datetimeStr)});
-      Serial.printf("Aggregated %d samples to 5-min avg: %.1f°C, %.0f%% RH [%s]\n", 
-                   bucket.second.size(), avgTemp, avgHum, datetimeStr);
-    }
-  }
+  float avgTemp = ch.bucket.sumT / ch.bucket.n;
+  float avgHum = ch.bucket.sumH / ch.bucket.n;
+  uint16_t n = ch.bucket.n;
+  uint16_t missed = n < ch.slotsPerBucket ? ch.slotsPerBucket - n : 0;
+  ch.aggregated.push(ch.bucket.bucketTs, avgTemp, avgHum, n, missed, ch.bucket.maxJitterMs);
+  ch.hourly.push(ch.bucket.bucketTs, avgTemp, avgHum);
+  stageAggregate(ch.cfg - SENSORS, ch.bucket.bucketTs, avgTemp, avgHum, n, missed);
+  queueTelemetry(ch.cfg - SENSORS, TELEMETRY_ROLLUP, ch.bucket.bucketTs, avgTemp, avgHum, n);
   
-  // Keep only ~24 hours of aggregated data
-  while (aggregatedBuffer.size() > MAX_AGGREGATE_SAMPLES) {
-    aggregatedBuffer.erase(aggregatedBuffer.begin());
-  }
-  
-  // Remove old detailed data that was aggregated
-  it = detailedBuffer.begin();
-  while (it != detailedBuffer.end() && it->ts < cutoffTime) {
-    it = detailedBuffer.erase(it);
-  }
+  char datetime[TIME_FORMAT_MAX];
+  logTimeFormatter.format(ch.bucket.bucketTs, datetime);
+  LOGI("[%s] Aggregated %d/%d samples to 5-min avg: %s°C, %s%% RH [%s]\n", 
+       ch.cfg->name, n, ch.slotsPerBucket, FixedText(avgTemp, 1).s, FixedText(avgHum, 0).s, datetime);
   
-  if (!buckets.empty()) {
-    Serial.printf("Data aggregation complete: %d detailed + %d aggregated samples\n", 
-                 detailedBuffer.size(), aggregatedBuffer.size());
-  }
+  ch.bucket.reset(0);
+  snapshotBucket(ch);
 }
 
 // Memory management and persistent storage functions
@@ -395,279 +1198,1991 @@ void checkMemoryUsage() {
   uint32_t memUsage = getMemoryUsagePercent();
   
   if (memUsage >= CRITICAL_MEMORY_THRESHOLD) {
-    Serial.printf("🚨 CRITICAL MEMORY: %d%% used - Emergency cleanup!\n", memUsage);
+    LOG_EVERY(LOG_REPEAT_MS, LOGW("🚨 CRITICAL MEMORY: %d%% used - Emergency cleanup!\n", memUsage));
     emergencyDataCompression();
     emergencyMode = true;
   } else if (memUsage >= EMERGENCY_AGGREGATION_THRESHOLD) {
     if (!emergencyMode) {
-      Serial.printf("⚠️ HIGH MEMORY: %d%% used - Starting emergency aggregation\n", memUsage);
+      LOGW("⚠️ HIGH MEMORY: %d%% used - Starting emergency aggregation\n", memUsage);
       emergencyDataCompression();
       emergencyMode = true;
     }
   } else {
     if (emergencyMode) {
-      Serial.printf("✅ Memory normal: %d%% used - Exiting emergency mode\n", memUsage);
+      LOGI("✅ Memory normal: %d%% used - Exiting emergency mode\n", memUsage);
       emergencyMode = false;
     }
   }
 }
 
 void emergencyDataCompression() {
-  Serial.println("🔄 Emergency data compression starting...");
+  LOGI("🔄 Emergency heap check starting...\n");
   
-  // Aggressively reduce detailed buffer
-  while (detailedBuffer.size() > (MAX_DETAILED_SAMPLES / 2)) {
-    detailedBuffer.pop_front();
-  }
-  
-  // Reduce aggregated buffer if still critical
-  while (aggregatedBuffer.size() > (MAX_AGGREGATE_SAMPLES / 2) && getMemoryUsagePercent() > CRITICAL_MEMORY_THRESHOLD) {
-    aggregatedBuffer.erase(aggregatedBuffer.begin());
-  }
-  
-  // Force garbage collection
+  // Sample rings are statically allocated, so trimming them would lose data
+  // without freeing heap; only verify the heap here
   heap_caps_check_integrity_all(true);
   
-  Serial.printf("✅ Emergency compression complete: %d detailed + %d aggregated samples remain\n", 
-                detailedBuffer.size(), aggregatedBuffer.size());
+  LOGI("✅ Emergency check complete: %d KB free heap\n", ESP.getFreeHeap() / 1024);
 }
 
-void saveToPersistentStorage() {
-  if (!SPIFFS.begin(true)) {
-    Serial.println("❌ SPIFFS mount failed - data not saved");
-    return;
+// Storage service: the filesystem is mounted once at boot and never
+// formatted implicitly - a mount failure leaves the data on the partition
+// untouched and is retried every STORAGE_REMOUNT_MS; formatting needs an
+// explicit POST /api/storage/format. Health, free space and write latency
+// are kept in storageStatus so status endpoints never touch flash.
+bool storageReady() {
+  return storageStatus.mounted;
+}
+
+const char *storageHealthName() {
+  if (!storageStatus.mounted) return "unmounted";
+  if (storageStatus.consecutiveErrors >= STORAGE_DEGRADED_ERRORS) return "write_errors";
+  if (storageStatus.totalBytes > 0 &&
+      storageStatus.usedBytes * 100 >= (uint64_t)storageStatus.totalBytes * STORAGE_LOW_SPACE_PERCENT) {
+    return "low_space";
   }
+  return "ok";
+}
+
+void refreshStorageUsage() {
+  if (!storageStatus.mounted) return;
+  storageStatus.totalBytes = storageBackend.totalBytes();
+  storageStatus.usedBytes = storageBackend.usedBytes();
+  storageStatus.lastRefreshMs = millis();
+}
+
+#ifndef STORAGE_BACKEND_SPIFFS
+// Files carried over from SPIFFS, most important first. The telemetry and
+// outage segments go last: they are the only ones that can exceed the RAM
+// budget and are dropped (with their backlog) if they do.
+const char *const MIGRATED_FILES[] = {
+  STORAGE_CONFIG_SLOT_A, STORAGE_CONFIG_SLOT_B, STORAGE_CONFIG_FILE, STORAGE_ALERTS_FILE,
+  STORAGE_HISTORY_FILE, STORAGE_DATA_FILE, STORAGE_NOTIFY_FILE,
+  STORAGE_TELEMETRY_STATE, STORAGE_OUTAGE_STATE,
+  STORAGE_TELEMETRY_SEGMENT_A, STORAGE_TELEMETRY_SEGMENT_B,
+  STORAGE_OUTAGE_SEGMENT_A, STORAGE_OUTAGE_SEGMENT_B,
+};
+constexpr size_t MIGRATED_FILE_COUNT = sizeof(MIGRATED_FILES) / sizeof(MIGRATED_FILES[0]);
+
+// One-time move from SPIFFS to LittleFS on the same partition: read every
+// known file into RAM, format the partition as LittleFS and write the files
+// back byte for byte. Legacy files (/sensor_data.json, /config.json) move
+// along unchanged and are imported by the usual loaders afterwards. Returns
+// true with LittleFS mounted; a partition that is not SPIFFS either, or a
+// failed read, leaves the flash untouched.
+bool migrateFromSpiffs() {
+  if (!SPIFFS.begin(false)) return false;
+  LOGI("📦 Partition holds SPIFFS - migrating files to LittleFS\n");
   
-  Serial.println("💾 Saving data to persistent storage...");
-  
-  // Create JSON document for aggregated data only (detailed data is temporary)
-  DynamicJsonDocument doc(32768); // 32KB for JSON
-  JsonArray dataArray = doc.createNestedArray("aggregated_data");
-  
-  // Save last MAX_SPIFFS_RECORDS of aggregated data
-  size_t startIdx = 0;
-  if (aggregatedBuffer.size() > MAX_SPIFFS_RECORDS) {
-    startIdx = aggregatedBuffer.size() - MAX_SPIFFS_RECORDS;
+  std::unique_ptr<uint8_t[]> data[MIGRATED_FILE_COUNT];
+  size_t lengths[MIGRATED_FILE_COUNT] = {};
+  size_t budget = STORAGE_MIGRATE_MAX_BYTES;
+  uint16_t dropped = 0;
+  for (size_t i = 0; i < MIGRATED_FILE_COUNT; i++) {
+    File f = SPIFFS.open(MIGRATED_FILES[i], "r");
+    if (!f) continue;
+    size_t len = f.size();
+    if (len <= budget) data[i].reset(new (std::nothrow) uint8_t[len ? len : 1]);
+    if (!data[i]) {
+      LOGW("⚠️ Migration: %s (%u bytes) exceeds the RAM budget - dropped\n", MIGRATED_FILES[i], len);
+      f.close();
+      dropped++;
+      continue;
+    }
+    bool ok = f.read(data[i].get(), len) == len;
+    f.close();
+    if (!ok) {
+      LOGE("❌ Migration: reading %s failed - keeping SPIFFS untouched\n", MIGRATED_FILES[i]);
+      SPIFFS.end();
+      return false;
+    }
+    lengths[i] = len;
+    budget -= len;
   }
+  SPIFFS.end();
   
-  for (size_t i = startIdx; i < aggregatedBuffer.size(); i++) {
-    JsonObject reading = dataArray.createNestedObject();
-    reading["ts"] = aggregatedBuffer[i].ts;
-    reading["t"] = aggregatedBuffer[i].t;
-    reading["h"] = aggregatedBuffer[i].h;
-    reading["dt"] = aggregatedBuffer[i].datetime;
+  if (!storageBackend.format() || !storageBackend.mount()) {
+    LOGE("❌ Migration: LittleFS format failed\n");
+    return false;
   }
-  
-  // Add metadata
-  doc["last_save"] = getCurrentTimestamp();
-  doc["version"] = "1.0";
-  doc["total_records"] = dataArray.size();
-  
-  // Write to file
-  File file = SPIFFS.open(SPIFFS_DATA_FILE, "w");
-  if (!file) {
-    Serial.println("❌ Failed to open data file for writing");
-    return;
+  uint16_t written = 0;
+  for (size_t i = 0; i < MIGRATED_FILE_COUNT; i++) {
+    if (!data[i]) continue;
+    File f = storageFs.open(MIGRATED_FILES[i], "w");
+    bool ok = f && f.write(data[i].get(), lengths[i]) == lengths[i];
+    if (f) f.close();
+    if (ok) {
+      written++;
+    } else {
+      LOGE("❌ Migration: writing %s failed\n", MIGRATED_FILES[i]);
+      dropped++;
+    }
+  }
+  storageStatus.migrated = true;
+  storageStatus.migratedFiles = written;
+  storageStatus.droppedFiles = dropped;
+  LOGI("✅ Migrated %d files to LittleFS (%d dropped)\n", written, dropped);
+  return true;
+}
+#endif
+
+bool storageMount() {
+  storageStatus.mountAttempts++;
+  storageStatus.lastMountMs = millis();
+  uint32_t start = micros();
+  storageStatus.mounted = storageBackend.mount();   // Never formats on failure
+#ifndef STORAGE_BACKEND_SPIFFS
+  if (!storageStatus.mounted) storageStatus.mounted = migrateFromSpiffs();
+#endif
+  storageStatus.mountUs = micros() - start;
+  if (storageStatus.mounted) {
+    storageStatus.consecutiveErrors = 0;
+    refreshStorageUsage();
+  }
+  return storageStatus.mounted;
+}
+
+// Latency and outcome of one write operation; called from every task that
+// writes flash (loop(), configTask, uplinkTask)
+void storageRecordWrite(uint32_t startUs, bool ok) {
+  uint32_t us = micros() - startUs;
+  xSemaphoreTake(storageMutex, portMAX_DELAY);
+  storageStatus.writes++;
+  storageStatus.lastWriteUs = us;
+  if (us > storageStatus.maxWriteUs) storageStatus.maxWriteUs = us;
+  storageStatus.totalWriteUs += us;
+  if (ok) {
+    storageStatus.consecutiveErrors = 0;
+  } else {
+    storageStatus.writeErrors++;
+    storageStatus.consecutiveErrors++;
+  }
+  xSemaphoreGive(storageMutex);
+}
+
+// Opens persistent state once storage is available (boot or a late mount)
+void onStorageMounted() {
+  // Validate the history index only; records are loaded after startup
+  validatePersistentStorage();
+  loadConfig();
+  loadNotifyQueue();
+  if (telemetryEnabled()) {
+    telemetryLog.begin();
+    telemetryNextSeq = telemetryLog.resumeSeq();
+    LOGI("📂 Telemetry resumes at #%u (%d records waiting in flash)\n",
+         telemetryNextSeq, telemetryLog.pending());
+  }
+  xSemaphoreTake(journalMutex, portMAX_DELAY);
+  outageJournal.begin();
+  journalNextSeq = outageJournal.resumeSeq();
+  journalReady = true;
+  xSemaphoreGive(journalMutex);
+  if (outageJournal.pending() > 0) {
+    LOGI("📼 Outage journal: %d samples waiting for replay\n", outageJournal.pending());
   }
-  
-  size_t written = serializeJson(doc, file);
-  file.close();
-  
-  Serial.printf("✅ Saved %d aggregated records (%d bytes) to persistent storage\n", 
-                dataArray.size(), written);
-  
-  // Save configuration too
-  saveConfigToPersistentStorage();
 }
 
-void loadFromPersistentStorage() {
-  if (!SPIFFS.begin(true)) {
-    Serial.println("⚠️ SPIFFS mount failed - no persistent data loaded");
+// Called from loop(): usage refresh, mount retries and requested formats
+void serviceStorage() {
+  if (storageFormatRequested) {
+    storageFormatRequested = false;
+    LOGW("⚠️ Formatting storage on request - all persisted data is erased\n");
+    storageStatus.mounted = false;
+    bool ok = storageBackend.format();
+    if (ok && storageMount()) {
+      onStorageMounted();
+      LOGI("✅ Storage formatted and mounted\n");
+    } else {
+      LOGE("❌ Storage format failed\n");
+    }
     return;
   }
   
-  // Load historical data
-  File file = SPIFFS.open(SPIFFS_DATA_FILE, "r");
-  if (!file) {
-    Serial.println("ℹ️ No previous data file found - starting fresh");
+  if (!storageStatus.mounted) {
+    if (millis() - storageStatus.lastMountMs >= STORAGE_REMOUNT_MS) {
+      if (storageMount()) {
+        LOGI("✅ Storage mounted on retry\n");
+        onStorageMounted();
+      } else {
+        LOGE("❌ Storage mount retry failed - persistent data not available\n");
+      }
+    }
     return;
   }
+  if (millis() - storageStatus.lastRefreshMs >= STORAGE_REFRESH_MS) {
+    refreshStorageUsage();
+  }
   
-  Serial.println("📂 Loading data from persistent storage...");
+  // Save the history periodically; with the aggregate log the full rewrite
+  // is only a checkpoint. Waits for the deferred load rather than forcing it.
+  uint32_t now = sampleClockMs() / 1000;
+  uint32_t saveInterval = aggLogHealthy ? STORAGE_CHECKPOINT_SEC : settings.storageSaveSec;
+  if (!historyLoadPending() && (now - lastStorageSave) >= saveInterval) {
+    saveToPersistentStorage();
+    lastStorageSave = now;
+  }
+}
+
+void handleStorageStatus(AsyncWebServerRequest *req) {
+  StaticJsonDocument<3072> doc;
+  doc["backend"] = storageBackend.name();
+  doc["mounted"] = storageStatus.mounted;
+  doc["health"] = storageHealthName();
+  doc["total_bytes"] = storageStatus.totalBytes;
+  doc["used_bytes"] = storageStatus.usedBytes;
+  doc["free_bytes"] = storageStatus.totalBytes - storageStatus.usedBytes;
+  doc["used_percent"] = storageStatus.totalBytes ? storageStatus.usedBytes * 100 / storageStatus.totalBytes : 0;
+  doc["mount_attempts"] = storageStatus.mountAttempts;
+  doc["mount_us"] = storageStatus.mountUs;
   
-  DynamicJsonDocument doc(32768);
-  DeserializationError error = deserializeJson(doc, file);
-  file.close();
+  xSemaphoreTake(storageMutex, portMAX_DELAY);
+  doc["writes"] = storageStatus.writes;
+  doc["write_errors"] = storageStatus.writeErrors;
+  doc["consecutive_errors"] = storageStatus.consecutiveErrors;
+  doc["last_write_us"] = storageStatus.lastWriteUs;
+  doc["max_write_us"] = storageStatus.maxWriteUs;
+  doc["avg_write_us"] = storageStatus.writes ? (uint32_t)(storageStatus.totalWriteUs / storageStatus.writes) : 0;
+  xSemaphoreGive(storageMutex);
   
-  if (error) {
-    Serial.printf("❌ Failed to parse data file: %s\n", error.c_str());
-    return;
+  JsonObject aggregates = doc.createNestedObject("aggregate_log");
+  aggregates["available"] = aggLogReady;
+  aggregates["healthy"] = aggLogHealthy;
+  aggregates["capacity"] = aggLog.capacity();
+  aggregates["staged"] = aggStaged;
+  aggregates["commit_records"] = aggCommitRecords;
+  aggregates["commits"] = aggLogStats.commits;
+  aggregates["records"] = aggLogStats.records;
+  aggregates["failures"] = aggLogStats.failures;
+  aggregates["dropped"] = aggLogStats.dropped;
+  aggregates["replayed"] = aggLogStats.replayed;
+  aggregates["last_commit_us"] = aggLogStats.lastCommitUs;
+  JsonObject reasons = aggregates.createNestedObject("triggers");
+  for (size_t i = 0; i < AGG_COMMIT_REASONS; i++) {
+    reasons[AGG_COMMIT_REASON_NAMES[i]] = aggLogStats.reasons[i];
   }
   
-  // Load aggregated data
-  JsonArray dataArray = doc["aggregated_data"];
-  int loadedCount = 0;
-  
-  for (JsonObject reading : dataArray) {
-    uint32_t ts = reading["ts"];
-    float t = reading["t"];
-    float h = reading["h"];
-    String dt = reading["dt"].as<String>();
-    
-    // Only load data that's not too old (within 7 days)
-  uint32_t now = getCurrentTimestamp();
-    if (now == 0) now = millis() / 1000; // Fallback to boot time
-    
-    if ((now - ts) <= (7 * 24 * 3600)) { // Within 7 days
-      aggregatedBuffer.push_back({ts, t, h, dt});
-      loadedCount++;
+  JsonObject history = doc.createNestedObject("history");
+  history["format_version"] = historyScan.version;
+  history["records"] = historyScan.expected;
+  history["recovered"] = historyScan.recovered;
+  history["blocks"] = historyScan.blocks;
+  history["bad_blocks"] = historyScan.badBlocks;
+  history["damaged"] = historyScan.damaged();
+  history["scan_ms"] = historyScanMs;
+  history["scan_incomplete"] = historyScan.budgetExceeded;
+  if (historyScan.damaged()) {
+    history["header_intact"] = historyScan.headerIntact;
+    history["damaged_bytes"] = historyScan.damagedBytes;
+    history["quarantine"] = historyQuarantined ? STORAGE_HISTORY_QUARANTINE : "";
+    JsonArray segments = history.createNestedArray("segments");
+    for (size_t i = 0; i < historyScan.segmentCount; i++) {
+      JsonObject seg = segments.createNestedObject();
+      seg["offset"] = historyScan.segments[i].offset;
+      seg["length"] = historyScan.segments[i].length;
     }
   }
   
-  Serial.printf("✅ Loaded %d historical records from persistent storage\n", loadedCount);
+  JsonObject snap = doc.createNestedObject("snapshot");
+  snap["armed"] = snapshotReady && snapshot.armed();
+  snap["trigger"] = POWER_FAIL_PIN >= 0 ? "gpio" : "restart";
+  snap["bytes"] = sizeof(SnapshotHeader) + sizeof(decltype(snapshot)::Image);
+  snap["writes"] = snapshotStats.writes;
+  snap["failures"] = snapshotStats.failures;
+  snap["skipped"] = snapshotStats.skipped;
+  snap["last_write_us"] = snapshotStats.lastWriteUs;
+  snap["max_write_us"] = snapshotStats.maxWriteUs;
+  if (snapshotStats.recovered) {
+    JsonObject rec = snap.createNestedObject("recovered");
+    rec["reason"] = snapshotStats.recoveredReason < SNAPSHOT_REASONS ? SNAPSHOT_REASON_NAMES[snapshotStats.recoveredReason] : "unknown";
+    rec["ts"] = snapshotStats.recoveredTs;
+    rec["samples"] = snapshotStats.recoveredSamples;
+    rec["aggregates"] = snapshotStats.recoveredAggregates;
+  }
   
-  // Load configuration
-  loadConfigFromPersistentStorage();
-}
-
-void saveConfigToPersistentStorage() {
-  if (!SPIFFS.begin(true)) return;
+  if (storageStatus.migrated) {
+    JsonObject migration = doc.createNestedObject("migration");
+    migration["from"] = "spiffs";
+    migration["files"] = storageStatus.migratedFiles;
+    migration["dropped"] = storageStatus.droppedFiles;
+  }
   
-  DynamicJsonDocument doc(512);
-  doc["alert_threshold"] = alertThreshold;
-  doc["humidity_alert_threshold"] = humidityAlertThreshold;
-  doc["last_save"] = getCurrentTimestamp();
-  doc["version"] = "1.0";
+  JsonObject config = doc.createNestedObject("config");
+  config["generation"] = configStore.generation();
+  config["commits"] = configStore.commits();
+  config["failures"] = configStore.failures();
+  config["last_commit_ms"] = configCommitMs;
   
-  File file = SPIFFS.open(SPIFFS_CONFIG_FILE, "w");
-  if (file) {
-    serializeJson(doc, file);
-    file.close();
-    Serial.println("💾 Configuration saved to persistent storage");
-  }
+  String output;
+  serializeJson(doc, output);
+  req->send(200, "application/json", output);
 }
 
-void loadConfigFromPersistentStorage() {
-  if (!SPIFFS.begin(true)) return;
-  
-  File file = SPIFFS.open(SPIFFS_CONFIG_FILE, "r");
-  if (!file) return;
-  
-  DynamicJsonDocument doc(512);
-  DeserializationError error = deserializeJson(doc, file);
-  file.close();
-  
-  if (!error) {
-    if (doc.containsKey("alert_threshold")) {
-      alertThreshold = doc["alert_threshold"];
-      Serial.printf("📂 Loaded temperature alert threshold: %.1f°C from persistent storage\n", alertThreshold);
-    }
-    if (doc.containsKey("humidity_alert_threshold")) {
-      humidityAlertThreshold = doc["humidity_alert_threshold"];
-      Serial.printf("📂 Loaded humidity alert threshold: %.1f%% from persistent storage\n", humidityAlertThreshold);
-    }
+// Erases the partition; the format itself runs in loop()
+void handleStorageFormat(AsyncWebServerRequest *req) {
+  if (!req->hasParam("confirm") || req->getParam("confirm")->value() != "erase") {
+    req->send(400, "application/json", "{\"error\":\"confirm=erase required\"}");
+    return;
   }
+  storageFormatRequested = true;
+  req->send(202, "application/json", "{\"status\":\"format scheduled\"}");
 }
 
-// Alert system functions
-void checkTemperatureAlert(float temperature) {
-  if (temperature > alertThreshold) {
-    if (!alertActive) {
-      // New alert triggered
-      alertActive = true;
-      alertAcknowledged = false;
-      Serial.printf("TEMPERATURE ALERT! Current: %.1f°C, Threshold: %.1f°C\n", temperature, alertThreshold);
-    }
+// ---------- Aggregate log ----------
+// Closed 5-minute aggregates are staged in RAM and appended to the raw log
+// partition in groups: once a flash page worth is staged, once the oldest
+// has waited AGG_COMMIT_MS, on /api/save and from the shutdown handler
+// (esp_restart()). An append returns only after the data is on flash, so a
+// committed aggregate survives any later reset; the full history file is
+// then only rewritten as a checkpoint every STORAGE_CHECKPOINT_SEC.
+
+void onShutdownCommit() {
+  commitAggregates(AGG_COMMIT_SHUTDOWN, pdMS_TO_TICKS(100));
+  writeEmergencySnapshot(SNAPSHOT_RESTART);
+}
+
+void beginAggregateLog() {
+  if (!aggRegion.begin() || !aggLog.mount()) {
+    Serial.printf("ℹ️ No \"%s\" partition - closed aggregates are only saved with the history file\n",
+                  RAW_LOG_PARTITION);
+    return;
+  }
+  aggLogReady = true;
+  aggLogReplayPending = aggLog.sectorsInUse() > 0;
+  // The log must cover everything since the last checkpoint
+  aggLogHealthy = aggLog.capacity() >= CHANNEL_COUNT * (STORAGE_CHECKPOINT_SEC / AGGREGATE_INTERVAL_SEC);
+  if (!aggLogHealthy) {
+    Serial.println("⚠️ Aggregate log too small for the channel count - keeping hourly history saves");
   }
-  // Remove the automatic clearing - alert stays active until acknowledged
-  // Only check for new alerts if no alert is currently active
+  if (esp_reset_reason() == ESP_RST_BROWNOUT) {
+    aggCommitRecords = 1;
+    Serial.println("⚡ Brown-out reset - committing every closed aggregate immediately");
+  }
+  Serial.printf("📒 Aggregate log: %d sectors in use, room for %d records\n",
+                aggLog.sectorsInUse(), aggLog.capacity());
 }
 
-void checkHumidityAlert(float humidity) {
-  if (humidity > humidityAlertThreshold) {
-    if (!humidityAlertActive) {
-      // New humidity alert triggered
-      humidityAlertActive = true;
-      humidityAlertAcknowledged = false;
-      Serial.printf("HUMIDITY ALERT! Current: %.1f%%, Threshold: %.1f%%\n", humidity, humidityAlertThreshold);
-    }
+void stageAggregate(size_t c, uint32_t ts, float t, float h, uint16_t n, uint16_t missed) {
+  if (!aggLogReady) return;
+  xSemaphoreTake(aggMutex, portMAX_DELAY);
+  if (aggStaged == AGG_STAGE_RECORDS) {
+    // Only reachable while the clock is unset (nothing can be committed)
+    memmove(aggStage, aggStage + 1, (AGG_STAGE_RECORDS - 1) * sizeof(HistoryRecord));
+    aggStaged--;
+    aggLogStats.dropped++;
   }
-  // Remove the automatic clearing - alert stays active until acknowledged
-  // Only check for new alerts if no alert is currently active
+  HistoryRecord &rec = aggStage[aggStaged];
+  rec = {ts, t, h, n, missed, (uint8_t)c, 0, 0};
+  if (aggStaged++ == 0) aggStagedSince = millis();
+  bool full = aggStaged >= aggCommitRecords;
+  xSemaphoreGive(aggMutex);
+  if (full) commitAggregates(AGG_COMMIT_SIZE);
 }
 
-void handleSetAlert(AsyncWebServerRequest *req) {
-  if (req->hasParam("threshold")) {
-    float newThreshold = req->getParam("threshold")->value().toFloat();
-    if (newThreshold > 0 && newThreshold < 100) {
-      alertThreshold = newThreshold;
-      Serial.printf("Temperature alert threshold set to: %.1f°C\n", alertThreshold);
-      saveConfigToPersistentStorage(); // Save config immediately
-      req->send(200, "application/json", "{\"status\":\"ok\",\"threshold\":" + String(alertThreshold) + "}");
+// One append for everything staged. Aggregates still stamped with the boot
+// clock wait until rebaseBootTimestamps() has moved them to wall time.
+bool commitAggregates(AggCommitReason reason, TickType_t wait) {
+  if (!aggLogReady || xSemaphoreTake(aggMutex, wait) != pdTRUE) return false;
+  size_t n = 0;
+  while (n < aggStaged && aggStage[n].ts >= MIN_VALID_EPOCH) n++;
+  bool ok = true;
+  if (n > 0) {
+    uint32_t writeStart = micros();
+    ok = aggLog.append(aggStage, n);
+    aggLogStats.lastCommitUs = micros() - writeStart;
+    storageRecordWrite(writeStart, ok);
+    if (ok) {
+      aggLogStats.commits++;
+      aggLogStats.records += n;
+      aggLogStats.reasons[reason]++;
     } else {
-      req->send(400, "application/json", "{\"error\":\"Invalid threshold range (0-100°C)\"}");
+      // Still in the RAM ring; the next history save covers them
+      aggLogStats.failures++;
+      aggLogStats.dropped += n;
+      aggLogHealthy = false;
     }
+    memmove(aggStage, aggStage + n, (aggStaged - n) * sizeof(HistoryRecord));
+    aggStaged -= n;
+    aggStagedSince = millis();
+  }
+  xSemaphoreGive(aggMutex);
+  if (!ok) LOGE("❌ Aggregate log write failed - %d aggregates wait for the next history save\n", n);
+  return ok;
+}
+
+// Called from loop()
+void serviceAggregateLog() {
+  if (aggStaged > 0 && millis() - aggStagedSince >= AGG_COMMIT_MS) {
+    commitAggregates(AGG_COMMIT_TIME);
+  }
+}
+
+// Inserts a persisted aggregate in front of its channel's ring. Callers feed
+// records newest first; anything not older than the ring's oldest entry is
+// already there (rollups since boot, or the log's copy of a file record).
+bool pushStoredAggregate(const HistoryRecord &rec) {
+  SampleRing<MAX_AGGREGATE_SAMPLES> &agg = channels[rec.channel].aggregated;
+  if (!agg.empty()) {
+    uint32_t oldest = agg.ts[agg.at(0)];
+    if (oldest >= MIN_VALID_EPOCH && rec.ts >= oldest) return false;
+  }
+  return agg.pushFront(rec.ts, rec.t, rec.h, rec.n, rec.missed, 0);
+}
+
+// Restores the aggregates committed since the last checkpoint; runs before
+// the history file is read, which then only fills in older records
+void replayAggregateLog() {
+  aggLogReplayPending = false;
+  uint32_t now = getCurrentTimestamp();
+  bool checkAge = (now >= MIN_VALID_EPOCH);
+  uint32_t restored = 0;
+  xSemaphoreTake(aggMutex, portMAX_DELAY);
+  aggLog.forEachNewestFirst([&](const HistoryRecord &rec) {
+    if (rec.channel >= CHANNEL_COUNT) return;
+    if (checkAge && (now - rec.ts) > STORAGE_RETENTION_SEC) return;
+    if (pushStoredAggregate(rec)) restored++;
+  });
+  size_t corrupt = aggLog.corrupt();
+  xSemaphoreGive(aggMutex);
+  aggLogStats.replayed = restored;
+  LOGI("📒 Restored %d aggregates from the aggregate log (%d torn slots skipped)\n", restored, corrupt);
+}
+
+// ---------- Power-fail snapshot ----------
+// The sampler mirrors every sample and open bucket into the snapshot image,
+// so the emergency path only adds the staged aggregates, computes two CRCs
+// and programs one pre-erased sector - no allocation, erase or filesystem
+// call while the supply is collapsing. Triggers: the supervisor interrupt
+// on POWER_FAIL_PIN (served by a top-priority task) and the restart hook.
+// A brown-out reset cannot be intercepted; it is detected at the next boot.
+// The snapshot is restored at the next boot and then erased.
+
+void snapshotSample(size_t c, uint32_t ts, float t, float h, uint16_t missed, uint16_t jitterMs) {
+  portENTER_CRITICAL(&snapshotMux);
+  if (!snapshotFrozen) snapshot.sample(c, ts, t, h, missed, jitterMs);
+  portEXIT_CRITICAL(&snapshotMux);
+}
+
+void snapshotBucket(const Channel &ch) {
+  portENTER_CRITICAL(&snapshotMux);
+  if (!snapshotFrozen) snapshot.bucket(ch.cfg - SENSORS, ch.bucket, ch.slotsPerBucket);
+  portEXIT_CRITICAL(&snapshotMux);
+}
+
+// Freezes the image and programs it; safe to call from any task
+bool writeEmergencySnapshot(SnapshotReason reason) {
+  if (!snapshotReady) return false;
+  portENTER_CRITICAL(&snapshotMux);
+  bool busy = snapshotFrozen;
+  snapshotFrozen = true;
+  portEXIT_CRITICAL(&snapshotMux);
+  if (busy) return false;
+  
+  uint32_t start = micros();
+  bool ok = false;
+  if (!snapshot.armed()) {
+    snapshotStats.skipped++;
   } else {
-    req->send(400, "application/json", "{\"error\":\"Missing threshold parameter\"}");
+    // A commit in progress finishes first (the mutex lends it our priority);
+    // if it takes too long the snapshot goes out without the staged aggregates
+    size_t staged = 0;
+    if (aggMutex && xSemaphoreTake(aggMutex, pdMS_TO_TICKS(SNAPSHOT_STAGE_WAIT_MS)) == pdTRUE) {
+      staged = aggStaged;
+      ok = snapshot.write(reason, getCurrentTimestamp(), aggStage, staged);
+      xSemaphoreGive(aggMutex);
+    } else {
+      ok = snapshot.write(reason, getCurrentTimestamp(), nullptr, 0);
+    }
+    uint32_t us = micros() - start;
+    snapshotStats.lastWriteUs = us;
+    if (us > snapshotStats.maxWriteUs) snapshotStats.maxWriteUs = us;
+    snapshotStats.lastWriteMs = millis();
+    if (!snapshotStats.lastWriteMs) snapshotStats.lastWriteMs = 1;
+    snapshotStats.lastReason = reason;
+    if (ok) snapshotStats.writes++;
+    else snapshotStats.failures++;
   }
+  
+  portENTER_CRITICAL(&snapshotMux);
+  snapshotFrozen = false;
+  portEXIT_CRITICAL(&snapshotMux);
+  return ok;
 }
 
-void handleSetHumidityAlert(AsyncWebServerRequest *req) {
-  if (req->hasParam("threshold")) {
-    float newThreshold = req->getParam("threshold")->value().toFloat();
-    if (newThreshold > 0 && newThreshold <= 100) {
-      humidityAlertThreshold = newThreshold;
-      Serial.printf("Humidity alert threshold set to: %.1f%%\n", humidityAlertThreshold);
-      saveConfigToPersistentStorage(); // Save config immediately
-      req->send(200, "application/json", "{\"status\":\"ok\",\"threshold\":" + String(humidityAlertThreshold) + "}");
+void IRAM_ATTR onPowerFail() {
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(snapshotTaskHandle, &woken);
+  if (woken) portYIELD_FROM_ISR();
+}
+
+void snapshotTask(void *) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    writeEmergencySnapshot(SNAPSHOT_POWER_FAIL);
+  }
+}
+
+// Brings back what the last snapshot held: staged aggregates and the open
+// buckets (as partial aggregates) go to the aggregate log, or straight into
+// the rings without one; recent samples refill the detailed rings
+void restoreEmergencySnapshot(const SnapshotHeader &hdr, const decltype(snapshot)::Image &img) {
+  HistoryRecord recs[AGG_STAGE_RECORDS + CHANNEL_COUNT];
+  size_t n = 0;
+  for (size_t i = 0; i < hdr.staged && i < AGG_STAGE_RECORDS; i++) {
+    const HistoryRecord &rec = img.staged[i];
+    if (rec.channel < CHANNEL_COUNT && rec.ts >= MIN_VALID_EPOCH) recs[n++] = rec;
+  }
+  for (size_t c = 0; c < CHANNEL_COUNT; c++) {
+    const SnapshotChannel &sc = img.channels[c];
+    const BucketAccumulator &b = sc.bucket;
+    if (b.n == 0 || b.bucketTs < MIN_VALID_EPOCH) continue;
+    uint16_t missed = b.n < sc.slotsPerBucket ? sc.slotsPerBucket - b.n : 0;
+    recs[n++] = {b.bucketTs, b.sumT / b.n, b.sumH / b.n, b.n, missed, (uint8_t)c, 0, 0};
+  }
+  
+  if (n > 0) {
+    if (aggLogReady && aggLog.append(recs, n)) {
+      aggLogReplayPending = true;
+    } else {
+      for (size_t i = 0; i < n; i++) {
+        channels[recs[i].channel].aggregated.push(recs[i].ts, recs[i].t, recs[i].h, recs[i].n, recs[i].missed, 0);
+      }
+    }
+  }
+  
+  // Samples on the previous boot's clock cannot be placed in time
+  uint32_t samples = 0;
+  for (size_t c = 0; c < CHANNEL_COUNT; c++) {
+    Channel &ch = channels[c];
+    img.forEachSample(c, [&](const SnapshotSample &x) {
+      if (x.ts < MIN_VALID_EPOCH) return;
+      float t = x.t / 100.0f;
+      float h = x.h / 100.0f;
+      ch.detailed.push(x.ts, t, h, 1, x.missed, x.jitterMs);
+      if (ch.detailed.size() > ch.detailedLimit) ch.detailed.dropOldest(1);
+      snapshot.sample(c, x.ts, t, h, x.missed, x.jitterMs);
+      samples++;
+    });
+  }
+  
+  snapshotStats.recovered = true;
+  snapshotStats.recoveredReason = hdr.reason;
+  snapshotStats.recoveredTs = hdr.ts;
+  snapshotStats.recoveredSamples = samples;
+  snapshotStats.recoveredAggregates = n;
+  Serial.printf("⚡ Restored %s snapshot #%u: %u samples, %u aggregates\n",
+                hdr.reason < SNAPSHOT_REASONS ? SNAPSHOT_REASON_NAMES[hdr.reason] : "unknown",
+                hdr.seq, samples, n);
+}
+
+// Called from setup() after beginAggregateLog() and before the first sample
+void beginEmergencySnapshot() {
+  if (!snapshotRegion.begin() || !snapshot.begin(snapshotRegion)) {
+    Serial.printf("ℹ️ No \"%s\" partition - no power-fail snapshot\n", SNAPSHOT_PARTITION);
+    return;
+  }
+  typedef decltype(snapshot)::Image SnapshotImageT;
+  std::unique_ptr<SnapshotImageT> img(new (std::nothrow) SnapshotImageT());
+  SnapshotHeader hdr;
+  if (img && snapshot.load(*img, hdr)) restoreEmergencySnapshot(hdr, *img);
+  img.reset();
+  
+  // Erase used sectors now so the emergency path only has to program
+  snapshot.prepare();
+  snapshotReady = snapshot.armed();
+  if (!snapshotReady) {
+    Serial.println("❌ Snapshot partition could not be erased - power-fail snapshot disabled");
+    return;
+  }
+  if (POWER_FAIL_PIN >= 0) {
+    xTaskCreatePinnedToCore(snapshotTask, "snapshot", 3072, nullptr, configMAX_PRIORITIES - 1, &snapshotTaskHandle, 1);
+    pinMode(POWER_FAIL_PIN, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(POWER_FAIL_PIN), onPowerFail, FALLING);
+  }
+  Serial.printf("⚡ Power-fail snapshot armed (%u bytes, %u samples per channel%s)\n",
+                sizeof(SnapshotHeader) + sizeof(SnapshotImageT), SNAPSHOT_SAMPLES,
+                POWER_FAIL_PIN >= 0 ? ", supervisor interrupt" : ", restart hook only");
+}
+
+// Called from loop(): the supply came back after a power-fail snapshot, so
+// the data is still in RAM - erase the snapshot to have a sector ready again
+void serviceEmergencySnapshot() {
+  if (!snapshotReady || !snapshot.dirty() || snapshotFrozen) return;
+  if (!snapshotStats.lastWriteMs || millis() - snapshotStats.lastWriteMs < SNAPSHOT_REARM_MS) return;
+  if (POWER_FAIL_PIN >= 0 && digitalRead(POWER_FAIL_PIN) == LOW) return;
+  snapshot.prepare();
+  LOGI("⚡ Supply recovered - power-fail snapshot re-armed\n");
+}
+
+// Positional reads for HistoryScanner and HistoryCarryOver
+struct HistoryFileReader {
+  File &file;
+  size_t size() { return file.size(); }
+  bool read(size_t offset, void *buf, size_t len) {
+    return file.seek(offset) && file.read((uint8_t*)buf, len) == len;
+  }
+};
+
+void saveToPersistentStorage() {
+  if (!storageReady()) {
+    LOGE("❌ Storage not mounted - data not saved\n");
+    return;
+  }
+  
+  // Never overwrite history that has not been loaded into RAM yet
+  ensureHistoryLoaded();
+  
+  LOGI("💾 Saving data to persistent storage...\n");
+  
+  // Save the aggregated rings (detailed data is temporary), each behind the
+  // older records of the previous file that are still within
+  // STORAGE_RETENTION_SEC of the channel's newest aggregate
+  uint32_t from[CHANNEL_COUNT], before[CHANNEL_COUNT];
+  for (size_t c = 0; c < CHANNEL_COUNT; c++) {
+    const SampleRing<MAX_AGGREGATE_SAMPLES> &agg = channels[c].aggregated;
+    from[c] = MIN_VALID_EPOCH;       // Boot-clock records of an earlier boot are dropped
+    before[c] = UINT32_MAX;
+    if (agg.empty()) continue;
+    uint32_t oldest = agg.ts[agg.at(0)];
+    uint32_t newest = agg.ts[agg.newest()];
+    // A ring starting on the boot clock overlaps nothing in the file
+    if (oldest >= MIN_VALID_EPOCH) before[c] = oldest;
+    if (newest >= MIN_VALID_EPOCH + STORAGE_RETENTION_SEC) from[c] = newest - STORAGE_RETENTION_SEC + 1;
+  }
+  uint32_t writeStart = micros();
+  File previous = storageFs.open(STORAGE_HISTORY_FILE, "r");
+  HistoryFileReader reader = {previous};
+  HistoryCarryOver<CHANNEL_COUNT> carry(from, before);
+  if (previous) carry.plan(reader);
+  
+  HistoryHeader hdr = {};
+  hdr.magic = HISTORY_MAGIC;
+  hdr.version = HISTORY_VERSION;
+  hdr.recordSize = sizeof(HistoryRecord);
+  hdr.firstTs = UINT32_MAX;
+  for (size_t c = 0; c < CHANNEL_COUNT; c++) {
+    const SampleRing<MAX_AGGREGATE_SAMPLES> &agg = channels[c].aggregated;
+    hdr.count += carry.count(c) + agg.size();
+    if (carry.count(c) > 0) {
+      if (carry.firstTs(c) < hdr.firstTs) hdr.firstTs = carry.firstTs(c);
+      if (carry.lastTs(c) > hdr.lastTs) hdr.lastTs = carry.lastTs(c);
+    }
+    if (agg.empty()) continue;
+    uint32_t oldest = agg.ts[agg.at(0)];
+    uint32_t newest = agg.ts[agg.newest()];
+    if (oldest < hdr.firstTs) hdr.firstTs = oldest;
+    if (newest > hdr.lastTs) hdr.lastTs = newest;
+  }
+  if (hdr.count == 0) hdr.firstTs = 0;
+  hdr.crc = historyHeaderCrc(hdr);
+  
+  // Written to a temporary file that replaces the old one once complete,
+  // so a reset (or a full partition) mid-save leaves the previous file intact
+  File file = storageFs.open(STORAGE_HISTORY_TMP, "w");
+  if (!file) {
+    if (previous) previous.close();
+    storageRecordWrite(writeStart, false);
+    LOGE("❌ Failed to open data file for writing\n");
+    return;
+  }
+  
+  // Records in blocks, each followed by its CRC32
+  HistoryRecord block[HISTORY_BLOCK_RECORDS];
+  size_t blockLen = 0;
+  size_t written = file.write((const uint8_t*)&hdr, sizeof(hdr));
+  auto flushBlock = [&]() {
+    uint32_t crc = crc32Update(0, block, blockLen * sizeof(HistoryRecord));
+    written += file.write((const uint8_t*)block, blockLen * sizeof(HistoryRecord));
+    written += file.write((const uint8_t*)&crc, sizeof(crc));
+    blockLen = 0;
+  };
+  auto addRecord = [&](const HistoryRecord &rec) {
+    block[blockLen++] = rec;
+    if (blockLen == HISTORY_BLOCK_RECORDS) flushBlock();
+  };
+  // Rings of the channels before `upTo` that are not written yet
+  size_t nextRing = 0;
+  auto addRings = [&](size_t upTo) {
+    for (; nextRing < upTo; nextRing++) {
+      const SampleRing<MAX_AGGREGATE_SAMPLES> &agg = channels[nextRing].aggregated;
+      for (size_t i = 0; i < agg.size(); i++) {
+        size_t idx = agg.at(i);
+        addRecord({agg.ts[idx], agg.t[idx], agg.h[idx], agg.n[idx], agg.missed[idx], (uint8_t)nextRing, 0, 0});
+      }
+    }
+  };
+  // The carried records come channel by channel, each ring right behind its own
+  bool carried = carry.copy(reader, [&](const HistoryRecord &rec) {
+    addRings(rec.channel);
+    addRecord(rec);
+  });
+  addRings(CHANNEL_COUNT);
+  if (blockLen > 0) flushBlock();
+  file.close();
+  if (previous) previous.close();
+  
+  bool ok = carried && written == historyFileSize(hdr.version, hdr.recordSize, hdr.count);
+  if (ok && !storageFs.rename(STORAGE_HISTORY_TMP, STORAGE_HISTORY_FILE)) {
+    // SPIFFS does not rename over an existing file
+    storageFs.remove(STORAGE_HISTORY_FILE);
+    ok = storageFs.rename(STORAGE_HISTORY_TMP, STORAGE_HISTORY_FILE);
+  }
+  storageRecordWrite(writeStart, ok);
+  if (!ok) {
+    storageFs.remove(STORAGE_HISTORY_TMP);
+    LOGE("❌ History save failed after %d bytes - previous file kept\n", written);
+    return;
+  }
+  historyHeader = hdr;
+  
+  // The binary file supersedes the legacy JSON history
+  if (storageFs.exists(STORAGE_DATA_FILE)) {
+    storageFs.remove(STORAGE_DATA_FILE);
+  }
+  
+  LOGI("✅ Saved %d aggregated records from %d channel(s) (%d bytes, %d carried from flash) to persistent storage\n", 
+       hdr.count, CHANNEL_COUNT, written, carry.total());
+}
+
+// Boot-time check: reads only the history header, records are loaded later
+void validatePersistentStorage() {
+  // A leftover temporary file is a save that did not finish (the file it
+  // was meant to replace still exists) or one that finished but was not
+  // renamed yet (SPIFFS removes the old file first)
+  if (storageFs.exists(STORAGE_HISTORY_TMP)) {
+    if (storageFs.exists(STORAGE_HISTORY_FILE)) {
+      storageFs.remove(STORAGE_HISTORY_TMP);
+    } else {
+      storageFs.rename(STORAGE_HISTORY_TMP, STORAGE_HISTORY_FILE);
+    }
+  }
+  
+  File file = storageFs.open(STORAGE_HISTORY_FILE, "r");
+  if (!file) {
+    if (storageFs.exists(STORAGE_DATA_FILE)) {
+      LOGI("📂 Legacy JSON history found - will be imported after startup\n");
+      historyState = HISTORY_LEGACY_PENDING;
+    } else {
+      LOGI("ℹ️ No previous data file found - starting fresh\n");
+      historyState = HISTORY_LOADED;
+    }
+    return;
+  }
+  
+  size_t fileSize = file.size();
+  size_t n = file.read((uint8_t*)&historyHeader, sizeof(historyHeader));
+  file.close();
+  
+  if (n != sizeof(historyHeader) || !historyHeaderValid(historyHeader, fileSize)) {
+    LOGW("⚠️ History file damaged (%d bytes) - intact blocks will be recovered after startup\n", fileSize);
+    historyState = HISTORY_DAMAGED;
+    return;
+  }
+  
+  LOGI("📂 History index OK: %d records pending load\n", historyHeader.count);
+  historyState = HISTORY_PENDING;
+}
+
+bool historyLoadPending() {
+  return historyState == HISTORY_PENDING || historyState == HISTORY_LEGACY_PENDING ||
+         historyState == HISTORY_DAMAGED || aggLogReplayPending;
+}
+
+// Loads the history validated at boot in steps: one per loop() pass, each
+// at most budgetMs of file reads, so sampling and HTTP keep their timing.
+// The aggregate log replay and the one-time legacy JSON import are one
+// step each.
+void serviceHistoryLoad(uint32_t budgetMs) {
+  if (!historyLoadPending()) return;
+  if (!historyLoadStartMs) historyLoadStartMs = millis();
+  bool legacy = (historyState == HISTORY_LEGACY_PENDING);
+  
+  // The log holds the newest aggregates, so it goes in front first
+  if (aggLogReplayPending) {
+    replayAggregateLog();
+  } else if (legacy) {
+    historyState = HISTORY_LOADED;
+    importLegacyHistory();
+  } else if (loadHistoryStep(budgetMs)) {
+    historyState = HISTORY_LOADED;
+  }
+  if (historyLoadPending()) return;
+  
+  historyLoadMs = millis() - historyLoadStartMs;
+  LOGI("✅ History %sload took %d ms (%d ms reading)\n", legacy ? "import " : "", historyLoadMs, historyScanMs);
+  
+  // Replace a damaged file by what was recovered right away
+  if (historyRepairPending) {
+    historyRepairPending = false;
+    saveToPersistentStorage();
+  }
+}
+
+// Finishes a load still in progress (before the history file is rewritten),
+// blocking for at most HISTORY_SCAN_BUDGET_MS of reads
+void ensureHistoryLoaded() {
+  uint32_t start = millis();
+  while (historyLoadPending()) {
+    uint32_t spent = millis() - start;
+    if (spent >= HISTORY_SCAN_BUDGET_MS && historyScanStarted) historyScanner.abandon();
+    serviceHistoryLoad(spent < HISTORY_SCAN_BUDGET_MS ? HISTORY_SCAN_BUDGET_MS - spent : 0);
+  }
+}
+
+// One step of the history file scan; true once the file is done (or
+// cannot be read). The file is reopened per step and not written meanwhile:
+// every save finishes the load first.
+bool loadHistoryStep(uint32_t budgetMs) {
+  File file;
+  if (storageReady()) file = storageFs.open(STORAGE_HISTORY_FILE, "r");
+  if (!file) {
+    if (!storageReady()) LOGW("⚠️ Storage not mounted - no persistent data loaded\n");
+    historyScanStarted = false;
+    return true;
+  }
+  
+  // Only keep data within the retention window; skip the check until the clock is valid
+  uint32_t now = getCurrentTimestamp();
+  bool checkAge = (now >= MIN_VALID_EPOCH);
+  
+  // The rings already hold the rollups made since boot, which are newer than
+  // anything on flash, so stored records are inserted in front of them. The
+  // file is therefore read newest-first, in blocks, and loading stops for a
+  // channel once its ring is full. Every block is checked against its CRC;
+  // damaged ones are skipped and reported, never the whole file.
+  uint32_t stepStart = millis();
+  HistoryFileReader reader = {file};
+  if (!historyScanStarted) {
+    LOGI("📂 Loading data from persistent storage...\n");
+    historyScanner.begin(reader, HISTORY_SCAN_MAX_BYTES);
+    historyScanStarted = true;
+  }
+  bool done = historyScanner.step(reader,
+    [&](const HistoryRecord &rec) {
+      if (rec.channel >= CHANNEL_COUNT) return;
+      if (checkAge && (now - rec.ts) > STORAGE_RETENTION_SEC) return;
+      if (pushStoredAggregate(rec)) historyLoadedRecords++;
+    },
+    [&]() { return millis() - stepStart >= budgetMs; });
+  file.close();
+  historyScanMs += millis() - stepStart;
+  historyScan = historyScanner.report();
+  if (!done) return false;
+  
+  historyScanStarted = false;
+  if (historyScan.budgetExceeded) {
+    LOGW("⚠️ History scan stopped after %d ms / %d blocks - older records not loaded\n",
+         historyScanMs, historyScan.blocks);
+  }
+  if (historyScan.damaged()) {
+    LOGW("⚠️ History file damaged: %d of %d records recovered, %d bad blocks, %d damaged bytes%s\n",
+         historyScan.recovered, historyScan.expected, historyScan.badBlocks, historyScan.damagedBytes,
+         historyScan.headerIntact ? "" : " (header lost)");
+    // Keep the damaged file for inspection; the recovered records are
+    // written back as a fresh file
+    storageFs.remove(STORAGE_HISTORY_QUARANTINE);
+    historyQuarantined = storageFs.rename(STORAGE_HISTORY_FILE, STORAGE_HISTORY_QUARANTINE);
+    if (!historyQuarantined) storageFs.remove(STORAGE_HISTORY_FILE);
+    historyRepairPending = true;
+  }
+  LOGI("✅ Loaded %d historical records from persistent storage\n", historyLoadedRecords);
+  return true;
+}
+
+// One-time import of the JSON history written by older firmware
+void importLegacyHistory() {
+  if (!storageReady()) {
+    LOGW("⚠️ Storage not mounted - no persistent data loaded\n");
+    return;
+  }
+  File file = storageFs.open(STORAGE_DATA_FILE, "r");
+  if (!file) return;
+  
+  LOGI("📂 Importing legacy JSON history...\n");
+  
+  DynamicJsonDocument doc(32768);
+  DeserializationError error = deserializeJson(doc, file);
+  file.close();
+  
+  if (error) {
+    // Set aside so the next save does not delete it
+    LOGE("❌ Failed to parse data file: %s - moved to %s\n", error.c_str(), STORAGE_DATA_QUARANTINE);
+    storageFs.remove(STORAGE_DATA_QUARANTINE);
+    storageFs.rename(STORAGE_DATA_FILE, STORAGE_DATA_QUARANTINE);
+    return;
+  }
+  
+  uint32_t now = getCurrentTimestamp();
+  bool checkAge = (now >= MIN_VALID_EPOCH);
+  JsonArray dataArray = doc["aggregated_data"];
+  for (int i = dataArray.size() - 1; i >= 0; i--) {
+    JsonObject reading = dataArray[i];
+    uint32_t ts = reading["ts"];
+    if (checkAge && (now - ts) > STORAGE_RETENTION_SEC) continue;
+    HistoryRecord rec = {ts, reading["t"], reading["h"], 0, 0, 0, 0, 0};
+    if (pushStoredAggregate(rec)) historyLoadedRecords++;
+  }
+  
+  LOGI("✅ Loaded %d historical records from persistent storage\n", historyLoadedRecords);
+}
+
+void loadConfigFromPersistentStorage() {
+  if (!storageReady()) return;
+  
+  File file = storageFs.open(STORAGE_CONFIG_FILE, "r");
+  if (!file) return;
+  
+  DynamicJsonDocument doc(512);
+  DeserializationError error = deserializeJson(doc, file);
+  file.close();
+  
+  if (!error) {
+    if (doc.containsKey("alert_threshold")) {
+      alertRules[RULE_LEGACY_T].threshold = doc["alert_threshold"];
+      LOGI("📂 Loaded temperature alert threshold: %s°C from persistent storage\n", FixedText(alertRules[RULE_LEGACY_T].threshold, 1).s);
+    }
+    if (doc.containsKey("humidity_alert_threshold")) {
+      alertRules[RULE_LEGACY_H].threshold = doc["humidity_alert_threshold"];
+      LOGI("📂 Loaded humidity alert threshold: %s%% from persistent storage\n", FixedText(alertRules[RULE_LEGACY_H].threshold, 1).s);
+    }
+  }
+}
+
+// Alert system functions
+void setDefaultAlertRules() {
+  memset(alertRules, 0, sizeof(alertRules));
+  memset(alertStates, 0, sizeof(alertStates));
+  
+  // Same behaviour as the original alerts: latched until acknowledged
+  alertRules[RULE_LEGACY_T] = {true, true, true, RULE_ABOVE, METRIC_T, 0, 40.0f, 0.0f, 0, "temperature"};
+  alertRules[RULE_LEGACY_H] = {true, true, true, RULE_ABOVE, METRIC_H, 0, 90.0f, 0.0f, 0, "humidity"};
+  
+  for (AlertState &st : alertStates) st.acknowledged = true;
+}
+
+// Rebuilds the per-channel rule lists; call with alertMutex held
+void rebuildAlertIndex() {
+  memset(channelRuleCount, 0, sizeof(channelRuleCount));
+  absenceRuleCount = 0;
+  for (size_t i = 0; i < MAX_ALERT_RULES; i++) {
+    const AlertRule &r = alertRules[i];
+    if (!r.used || !r.enabled || r.channel >= CHANNEL_COUNT) continue;
+    if (r.type == RULE_ABSENT) {
+      absenceRules[absenceRuleCount++] = i;
+    } else {
+      channelRules[r.channel][channelRuleCount[r.channel]++] = i;
+    }
+  }
+}
+
+void onAlertTransition(size_t i, AlertTransition transition, uint32_t now) {
+  const AlertRule &r = alertRules[i];
+  LOGI("%s %s ALERT [%s] rule %d '%s': %s %s %s (value %s)\n",
+       transition == ALERT_RAISED ? "🚨" : "✅", transition == ALERT_RAISED ? "RAISED" : "CLEARED",
+       SENSORS[r.channel].name, i, r.name, ruleMetricName(r.metric), ruleTypeName(r.type),
+       FixedText(r.threshold, 2).s, FixedText(alertStates[i].lastValue, 2).s);
+  markConfigDirty();
+  queueNotification(i, transition == ALERT_RAISED ? NOTIFY_RAISED : NOTIFY_CLEARED, now);
+}
+
+// Sample-driven rules of one channel; cost depends only on that channel's rules
+void evaluateAlerts(size_t c, uint32_t now, float t, float h) {
+  const Channel &ch = channels[c];
+  float dp = NAN;
+  
+  xSemaphoreTake(alertMutex, portMAX_DELAY);
+  for (uint8_t k = 0; k < channelRuleCount[c]; k++) {
+    uint8_t i = channelRules[c][k];
+    const AlertRule &r = alertRules[i];
+    float value;
+    if (r.type == RULE_RISE || r.type == RULE_FALL) {
+      value = ch.recent.slopePerMin(r.metric == METRIC_H ? STAT_H : STAT_T);
+    } else if (r.metric == METRIC_DP) {
+      if (isnan(dp)) dp = dewPoint(t, h);
+      value = dp;
+    } else {
+      value = (r.metric == METRIC_H) ? h : t;
+    }
+    AlertTransition transition = evaluateRule(r, alertStates[i], value, now);
+    if (transition != ALERT_NONE) onAlertTransition(i, transition, now);
+  }
+  xSemaphoreGive(alertMutex);
+}
+
+// Absence rules: seconds since the channel's last valid sample, once a second
+void checkAbsenceAlerts() {
+  if (millis() - lastAbsenceCheck < 1000) return;
+  lastAbsenceCheck = millis();
+  uint32_t now = sampleClockMs() / 1000;
+  
+  xSemaphoreTake(alertMutex, portMAX_DELAY);
+  for (uint8_t k = 0; k < absenceRuleCount; k++) {
+    uint8_t i = absenceRules[k];
+    const Channel &ch = channels[alertRules[i].channel];
+    float silent = now > ch.lastValidTs ? (float)(now - ch.lastValidTs) : 0.0f;
+    AlertTransition transition = evaluateRule(alertRules[i], alertStates[i], silent, now);
+    if (transition != ALERT_NONE) onAlertTransition(i, transition, now);
+  }
+  xSemaphoreGive(alertMutex);
+}
+
+// Wakes configTask; every change made until it runs goes into one commit
+void markConfigDirty() {
+  if (configTaskHandle) xTaskNotifyGive(configTaskHandle);
+}
+
+// Rule table, alert state and the built-in thresholds as one JSON document
+size_t serializeConfig(char *buf, size_t cap) {
+  DynamicJsonDocument doc(6144);
+  doc["version"] = 2;
+  JsonArray rules = doc.createNestedArray("rules");
+  xSemaphoreTake(alertMutex, portMAX_DELAY);
+  doc["alert_threshold"] = alertRules[RULE_LEGACY_T].threshold;
+  doc["humidity_alert_threshold"] = alertRules[RULE_LEGACY_H].threshold;
+  JsonObject stored = doc.createNestedObject("settings");
+  stored["log_level"] = settings.logLevel;
+  stored["telemetry_linger_ms"] = settings.telemetryLingerMs;
+  stored["save_interval_sec"] = settings.storageSaveSec;
+  for (size_t i = 0; i < MAX_ALERT_RULES; i++) {
+    const AlertRule &r = alertRules[i];
+    if (!r.used) continue;
+    const AlertState &st = alertStates[i];
+    JsonObject obj = rules.createNestedObject();
+    obj["id"] = i;
+    obj["name"] = (char*)r.name;   // Copied, the table may change before serialization
+    obj["type"] = (int)r.type;
+    obj["metric"] = (int)r.metric;
+    obj["channel"] = r.channel;
+    obj["threshold"] = r.threshold;
+    obj["hysteresis"] = r.hysteresis;
+    obj["for"] = r.forSec;
+    obj["latch"] = r.latch;
+    obj["enabled"] = r.enabled;
+    obj["active"] = st.active;
+    obj["acknowledged"] = st.acknowledged;
+    obj["since"] = st.since;
+  }
+  xSemaphoreGive(alertMutex);
+  
+  size_t len = measureJson(doc);
+  if (len >= cap) return 0;
+  return serializeJson(doc, buf, cap);
+}
+
+// Snapshot of the in-RAM configuration, written to the older config slot
+void commitConfig() {
+  uint32_t start = millis();
+  size_t len = serializeConfig(configBuffer, sizeof(configBuffer));
+  if (len == 0) {
+    LOGE("❌ Configuration does not fit CONFIG_MAX_BYTES - not saved\n");
+    return;
+  }
+  uint32_t writeStart = micros();
+  bool ok = storageReady() && configStore.commit(configBuffer, len);
+  storageRecordWrite(writeStart, ok);
+  if (!ok) {
+    LOGE("❌ Configuration commit failed - previous configuration kept\n");
+    return;
+  }
+  configCommitMs = millis() - start;
+  LOGI("💾 Configuration generation %u saved (%d bytes, %u ms)\n",
+       configStore.generation(), len, configCommitMs);
+}
+
+// Handlers only touch RAM; this task turns bursts of changes into one write
+void configTask(void *) {
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    vTaskDelay(pdMS_TO_TICKS(CONFIG_SAVE_DELAY_MS));   // Let the rest of the burst arrive
+    ulTaskNotifyTake(pdTRUE, 0);                       // Included in this snapshot
+    commitConfig();
+  }
+}
+
+// Checks run-time settings; returns an error message or nullptr
+const char *validateSettings(const RuntimeSettings &s) {
+  if (s.logLevel > LOG_LEVEL_MAX) return "log_level above the LOG_LEVEL_MAX of this build";
+  if (s.telemetryLingerMs < 1000 || s.telemetryLingerMs > 3600000) return "telemetry_linger_ms must be 1000-3600000";
+  if (s.storageSaveSec < 300 || s.storageSaveSec > 86400) return "save_interval_sec must be 300-86400";
+  return nullptr;
+}
+
+// Applies the rules and settings of a configuration document (slot store
+// or the rule file of earlier builds)
+void applyConfig(JsonDocument &doc) {
+  JsonObject stored = doc["settings"];
+  if (!stored.isNull()) {
+    RuntimeSettings s = settings;
+    s.logLevel = stored["log_level"] | s.logLevel;
+    s.telemetryLingerMs = stored["telemetry_linger_ms"] | s.telemetryLingerMs;
+    s.storageSaveSec = stored["save_interval_sec"] | s.storageSaveSec;
+    if (s.logLevel > LOG_LEVEL_MAX) s.logLevel = LOG_LEVEL_MAX;   // Saved by a build with more levels
+    if (!validateSettings(s)) settings = s;
+  }
+  
+  xSemaphoreTake(alertMutex, portMAX_DELAY);
+  int loaded = 0;
+  for (JsonObject obj : doc["rules"].as<JsonArray>()) {
+    size_t i = obj["id"] | MAX_ALERT_RULES;
+    if (i >= MAX_ALERT_RULES) continue;
+    AlertRule &r = alertRules[i];
+    r.used = true;
+    r.type = (RuleType)(obj["type"] | 0);
+    r.metric = (RuleMetric)(obj["metric"] | 0);
+    r.channel = obj["channel"] | 0;
+    r.threshold = obj["threshold"] | 0.0f;
+    r.hysteresis = obj["hysteresis"] | 0.0f;
+    r.forSec = obj["for"] | 0;
+    r.latch = obj["latch"] | false;
+    r.enabled = obj["enabled"] | true;
+    strlcpy(r.name, obj["name"] | "", sizeof(r.name));
+    if (r.type >= RULE_TYPE_COUNT || r.metric >= METRIC_COUNT || r.channel >= CHANNEL_COUNT) {
+      r.used = false;   // Written by a build with more channels or rule types
+      continue;
+    }
+    
+    AlertState &st = alertStates[i];
+    st.active = obj["active"] | false;
+    st.acknowledged = obj["acknowledged"] | true;
+    st.since = obj["since"] | 0;
+    loaded++;
+  }
+  
+  // The built-in rules always exist
+  alertRules[RULE_LEGACY_T].used = true;
+  alertRules[RULE_LEGACY_H].used = true;
+  rebuildAlertIndex();
+  xSemaphoreGive(alertMutex);
+  
+  LOGI("📂 Loaded %d alert rules from persistent storage\n", loaded);
+}
+
+// Loads the newest intact configuration slot. Without one, whatever older
+// firmware left behind is imported and committed to the slots right away.
+void loadConfig() {
+  DynamicJsonDocument doc(6144);
+  size_t len = configStore.load(configBuffer, sizeof(configBuffer));
+  if (len > 0) {
+    DeserializationError error = deserializeJson(doc, (const char*)configBuffer, len);
+    if (error) {
+      LOGE("❌ Failed to parse configuration: %s - using defaults\n", error.c_str());
+      return;
+    }
+    applyConfig(doc);
+    LOGI("📂 Configuration generation %u loaded\n", configStore.generation());
+    return;
+  }
+  
+  File file = storageFs.open(STORAGE_ALERTS_FILE, "r");
+  if (file) {
+    DeserializationError error = deserializeJson(doc, file);
+    file.close();
+    if (error) {
+      LOGE("❌ Failed to parse alert rules: %s - using defaults\n", error.c_str());
     } else {
-      req->send(400, "application/json", "{\"error\":\"Invalid threshold range (0-100%)\"}");
+      applyConfig(doc);
     }
   } else {
-    req->send(400, "application/json", "{\"error\":\"Missing threshold parameter\"}");
+    // Without a rule table the built-in rules take their thresholds from the legacy config file
+    loadConfigFromPersistentStorage();
+  }
+  commitConfig();
+  if (configStore.generation() > 0 && storageFs.exists(STORAGE_ALERTS_FILE)) {
+    storageFs.remove(STORAGE_ALERTS_FILE);   // Superseded by the slots
   }
 }
 
-void handleAckAlert(AsyncWebServerRequest *req) {
-  if (alertActive) {
-    alertActive = false;
-    alertAcknowledged = true;
-    Serial.println("Temperature alert acknowledged by user - alert cleared");
+// Applies the rule fields present in the request; returns an error message or nullptr
+const char *applyRuleParams(AsyncWebServerRequest *req, AlertRule &r) {
+  if (req->hasParam("type")) {
+    const String &value = req->getParam("type")->value();
+    int type = -1;
+    for (int k = 0; k < RULE_TYPE_COUNT; k++) {
+      if (value == ruleTypeName((RuleType)k)) type = k;
+    }
+    if (type < 0) return "type must be above, below, rise, fall or absent";
+    r.type = (RuleType)type;
+  }
+  if (req->hasParam("metric")) {
+    const String &value = req->getParam("metric")->value();
+    int metric = -1;
+    for (int k = 0; k < METRIC_COUNT; k++) {
+      if (value == ruleMetricName((RuleMetric)k)) metric = k;
+    }
+    if (metric < 0) return "metric must be t, h or dp";
+    r.metric = (RuleMetric)metric;
+  }
+  if (req->hasParam("channel")) {
+    int c = parseChannel(req);
+    if (c < 0) return "unknown channel";
+    r.channel = c;
+  }
+  if (req->hasParam("threshold") && !parseFixed(req->getParam("threshold")->value().c_str(), r.threshold)) {
+    return "threshold must be a number";
+  }
+  if (req->hasParam("hysteresis") && !parseFixed(req->getParam("hysteresis")->value().c_str(), r.hysteresis)) {
+    return "hysteresis must be a number";
+  }
+  if (req->hasParam("for") && !parseUint(req->getParam("for")->value().c_str(), r.forSec)) {
+    return "for must be 0-86400 seconds";
+  }
+  if (req->hasParam("latch")) r.latch = req->getParam("latch")->value() == "true";
+  if (req->hasParam("enabled")) r.enabled = req->getParam("enabled")->value() != "false";
+  if (req->hasParam("name")) strlcpy(r.name, req->getParam("name")->value().c_str(), sizeof(r.name));
+  
+  if (r.hysteresis < 0) return "hysteresis must be >= 0";
+  if (r.forSec > 86400) return "for must be 0-86400 seconds";
+  if ((r.type == RULE_RISE || r.type == RULE_FALL) && r.metric == METRIC_DP) return "rate rules support t and h only";
+  if ((r.type == RULE_RISE || r.type == RULE_FALL || r.type == RULE_ABSENT) && r.threshold <= 0) {
+    return "threshold must be > 0";
+  }
+  return nullptr;
+}
+
+// Rule index from ?id=, -1 if missing or unused; call with alertMutex held
+int parseRuleId(AsyncWebServerRequest *req) {
+  if (!req->hasParam("id")) return -1;
+  uint32_t i;
+  if (!parseUint(req->getParam("id")->value().c_str(), i)) return -1;
+  if (i >= MAX_ALERT_RULES || !alertRules[i].used) return -1;
+  return i;
+}
+
+void sendAlertError(AsyncWebServerRequest *req, int code, const char *message) {
+  req->send(code, "application/json", String("{\"error\":\"") + message + "\"}");
+}
+
+void handleListAlerts(AsyncWebServerRequest *req) {
+  DynamicJsonDocument doc(6144);
+  doc["max_rules"] = MAX_ALERT_RULES;
+  JsonArray rules = doc.createNestedArray("rules");
+  
+  xSemaphoreTake(alertMutex, portMAX_DELAY);
+  for (size_t i = 0; i < MAX_ALERT_RULES; i++) {
+    const AlertRule &r = alertRules[i];
+    if (!r.used) continue;
+    const AlertState &st = alertStates[i];
+    JsonObject obj = rules.createNestedObject();
+    obj["id"] = i;
+    obj["name"] = (char*)r.name;
+    obj["type"] = ruleTypeName(r.type);
+    obj["metric"] = ruleMetricName(r.metric);
+    obj["channel"] = SENSORS[r.channel].name;
+    obj["threshold"] = r.threshold;
+    obj["hysteresis"] = r.hysteresis;
+    obj["for"] = r.forSec;
+    obj["latch"] = r.latch;
+    obj["enabled"] = r.enabled;
+    obj["active"] = st.active;
+    obj["acknowledged"] = st.acknowledged;
+    obj["pending"] = st.pending;
+    obj["since"] = st.since;
+    obj["last_value"] = round2(st.lastValue);
+  }
+  xSemaphoreGive(alertMutex);
+  
+  String output;
+  serializeJson(doc, output);
+  req->send(200, "application/json", output);
+}
+
+void handleAddAlert(AsyncWebServerRequest *req) {
+  AlertRule r = {true, true, false, RULE_ABOVE, METRIC_T, 0, 0.0f, 0.0f, 0, ""};
+  const char *error = applyRuleParams(req, r);
+  if (error) {
+    sendAlertError(req, 400, error);
+    return;
+  }
+  
+  xSemaphoreTake(alertMutex, portMAX_DELAY);
+  int slot = -1;
+  for (size_t i = 0; i < MAX_ALERT_RULES && slot < 0; i++) {
+    if (!alertRules[i].used) slot = i;
+  }
+  if (slot >= 0) {
+    alertRules[slot] = r;
+    alertStates[slot] = {false, true, false, 0, 0, 0.0f};
+    rebuildAlertIndex();
+  }
+  xSemaphoreGive(alertMutex);
+  
+  if (slot < 0) {
+    sendAlertError(req, 507, "rule table full");
+    return;
+  }
+  markConfigDirty();
+  LOGI("Alert rule %d '%s' added\n", slot, r.name);
+  req->send(200, "application/json", "{\"status\":\"ok\",\"id\":" + String(slot) + "}");
+}
+
+void handleUpdateAlert(AsyncWebServerRequest *req) {
+  xSemaphoreTake(alertMutex, portMAX_DELAY);
+  int i = parseRuleId(req);
+  const char *error = "unknown rule id";
+  if (i >= 0) {
+    AlertRule r = alertRules[i];
+    error = applyRuleParams(req, r);
+    if (!error) {
+      alertRules[i] = r;
+      alertStates[i] = {false, true, false, 0, 0, 0.0f};   // Re-arm with the new condition
+      rebuildAlertIndex();
+    }
+  }
+  xSemaphoreGive(alertMutex);
+  
+  if (error) {
+    sendAlertError(req, i < 0 ? 404 : 400, error);
+    return;
+  }
+  markConfigDirty();
+  req->send(200, "application/json", "{\"status\":\"ok\",\"id\":" + String(i) + "}");
+}
+
+void handleDeleteAlert(AsyncWebServerRequest *req) {
+  // Looked up under the lock, so a concurrent delete/add cannot reuse the slot
+  xSemaphoreTake(alertMutex, portMAX_DELAY);
+  int i = parseRuleId(req);
+  bool builtIn = (i == RULE_LEGACY_T || i == RULE_LEGACY_H);
+  if (i >= 0 && !builtIn) {
+    alertRules[i].used = false;
+    rebuildAlertIndex();
+  }
+  xSemaphoreGive(alertMutex);
+  
+  if (i < 0) {
+    sendAlertError(req, 404, "unknown rule id");
+    return;
+  }
+  if (builtIn) {
+    sendAlertError(req, 400, "built-in rules can only be disabled");
+    return;
+  }
+  markConfigDirty();
+  req->send(200, "application/json", "{\"status\":\"deleted\"}");
+}
+
+// Acknowledges rule i, or the rule named by the "id" parameter for
+// RULE_FROM_REQUEST (looked up under the lock); shared with the legacy endpoints
+constexpr int RULE_FROM_REQUEST = -1;
+
+void acknowledgeAlert(AsyncWebServerRequest *req, int i) {
+  uint32_t now = sampleClockMs() / 1000;
+  char name[sizeof(AlertRule::name)];
+  bool wasActive = false;
+  xSemaphoreTake(alertMutex, portMAX_DELAY);
+  if (i == RULE_FROM_REQUEST) i = parseRuleId(req);
+  if (i >= 0) {
+    wasActive = acknowledgeRule(alertRules[i], alertStates[i], now);
+    if (wasActive) queueNotification(i, NOTIFY_ACKNOWLEDGED, now);
+    memcpy(name, alertRules[i].name, sizeof(name));
+  }
+  xSemaphoreGive(alertMutex);
+  
+  if (i < 0) {
+    sendAlertError(req, 404, "unknown rule id");
+  } else if (wasActive) {
+    LOGI("Alert '%s' acknowledged by user\n", name);
+    markConfigDirty();
     req->send(200, "application/json", "{\"status\":\"acknowledged\"}");
   } else {
     req->send(200, "application/json", "{\"status\":\"no_active_alert\"}");
   }
 }
 
-void handleAckHumidityAlert(AsyncWebServerRequest *req) {
-  if (humidityAlertActive) {
-    humidityAlertActive = false;
-    humidityAlertAcknowledged = true;
-    Serial.println("Humidity alert acknowledged by user - alert cleared");
-    req->send(200, "application/json", "{\"status\":\"acknowledged\"}");
+void handleAckRule(AsyncWebServerRequest *req) {
+  acknowledgeAlert(req, RULE_FROM_REQUEST);
+}
+
+// The original single-threshold endpoints operate on the built-in rules
+void setLegacyThreshold(AsyncWebServerRequest *req, int i, float maxValue, const char *rangeError) {
+  if (req->hasParam("threshold")) {
+    float newThreshold = 0;   // Not a number fails the range check
+    parseFixed(req->getParam("threshold")->value().c_str(), newThreshold);
+    if (newThreshold > 0 && newThreshold <= maxValue) {
+      xSemaphoreTake(alertMutex, portMAX_DELAY);
+      alertRules[i].threshold = newThreshold;
+      xSemaphoreGive(alertMutex);
+      LOGI("Alert '%s' threshold set to: %s\n", alertRules[i].name, FixedText(newThreshold, 1).s);
+      markConfigDirty();
+      char body[48 + NUM_FORMAT_MAX];
+      char *w = body;
+      w += formatStr(w, "{\"status\":\"ok\",\"threshold\":");
+      w += formatFixed(w, newThreshold, 2, false);   // String(float) gave two decimals
+      w += formatStr(w, "}");
+      *w = '\0';
+      req->send(200, "application/json", body);
+    } else {
+      req->send(400, "application/json", rangeError);
+    }
   } else {
-    req->send(200, "application/json", "{\"status\":\"no_active_alert\"}");
+    req->send(400, "application/json", "{\"error\":\"Missing threshold parameter\"}");
   }
 }
 
-void handleGetAlert(AsyncWebServerRequest *req) {
-  StaticJsonDocument<256> doc;
-  doc["threshold"] = alertThreshold;
-  doc["active"] = alertActive;
-  doc["acknowledged"] = alertAcknowledged;
-  doc["needs_attention"] = (alertActive && !alertAcknowledged);
+void sendLegacyAlert(AsyncWebServerRequest *req, int i) {
+  StaticJsonDocument<200> doc;
+  xSemaphoreTake(alertMutex, portMAX_DELAY);
+  doc["threshold"] = alertRules[i].threshold;
+  doc["active"] = alertStates[i].active;
+  doc["acknowledged"] = alertStates[i].acknowledged;
+  doc["needs_attention"] = (alertStates[i].active && !alertStates[i].acknowledged);
+  xSemaphoreGive(alertMutex);
   
   String output;
   serializeJson(doc, output);
   req->send(200, "application/json", output);
 }
 
+void handleSetAlert(AsyncWebServerRequest *req) {
+  setLegacyThreshold(req, RULE_LEGACY_T, 100, "{\"error\":\"Invalid threshold range (0-100°C)\"}");
+}
+
+void handleSetHumidityAlert(AsyncWebServerRequest *req) {
+  setLegacyThreshold(req, RULE_LEGACY_H, 100, "{\"error\":\"Invalid threshold range (0-100%)\"}");
+}
+
+void handleAckAlert(AsyncWebServerRequest *req) {
+  acknowledgeAlert(req, RULE_LEGACY_T);
+}
+
+void handleAckHumidityAlert(AsyncWebServerRequest *req) {
+  acknowledgeAlert(req, RULE_LEGACY_H);
+}
+
+void handleGetAlert(AsyncWebServerRequest *req) {
+  sendLegacyAlert(req, RULE_LEGACY_T);
+}
+
 void handleGetHumidityAlert(AsyncWebServerRequest *req) {
-  StaticJsonDocument<256> doc;
-  doc["threshold"] = humidityAlertThreshold;
-  doc["active"] = humidityAlertActive;
-  doc["acknowledged"] = humidityAlertAcknowledged;
-  doc["needs_attention"] = (humidityAlertActive && !humidityAlertAcknowledged);
+  sendLegacyAlert(req, RULE_LEGACY_H);
+}
+
+// Build profile: the compiled capacities, and the run-time settings
+void handleGetSettings(AsyncWebServerRequest *req) {
+  StaticJsonDocument<1024> doc;
+  doc["profile"] = PROFILE.name;
+  JsonObject current = doc.createNestedObject("settings");
+  current["log_level"] = settings.logLevel;
+  current["telemetry_linger_ms"] = settings.telemetryLingerMs;
+  current["save_interval_sec"] = settings.storageSaveSec;
+  JsonObject defaults = doc.createNestedObject("defaults");
+  defaults["log_level"] = DEFAULT_SETTINGS.logLevel;
+  defaults["telemetry_linger_ms"] = DEFAULT_SETTINGS.telemetryLingerMs;
+  defaults["save_interval_sec"] = DEFAULT_SETTINGS.storageSaveSec;
+  
+  JsonObject build = doc.createNestedObject("build");
+  build["channels"] = CHANNEL_COUNT;
+  build["detailed_samples"] = MAX_DETAILED_SAMPLES;
+  build["aggregate_samples"] = MAX_AGGREGATE_SAMPLES;
+  build["storage_records"] = MAX_STORAGE_RECORDS;
+  build["telemetry_queue"] = TELEMETRY_QUEUE_SIZE;
+  build["telemetry_batch"] = TELEMETRY_BATCH;
+  build["telemetry_encoding"] = TELEMETRY_ENCODING == TelemetryEncoding::Json ? "json" : "binary";
+  build["notify_queue"] = NOTIFY_QUEUE_SIZE;
+  build["log_ring"] = LOG_RING_SLOTS;
+  build["log_recent"] = LOG_RECENT;
+  build["log_level_max"] = LOG_LEVEL_MAX;
+  
+  String output;
+  serializeJson(doc, output);
+  req->send(200, "application/json", output);
+}
+
+// Changes the settings given as parameters (reset=true restores the
+// profile defaults first); all or nothing, saved like the rule table
+void handleSetSettings(AsyncWebServerRequest *req) {
+  RuntimeSettings s = settings;
+  if (req->hasParam("reset") && req->getParam("reset")->value() == "true") s = DEFAULT_SETTINGS;
+  struct Field {
+    const char *name;
+    uint32_t *value;
+  };
+  uint32_t logLevel = s.logLevel;
+  const Field fields[] = {
+    {"log_level", &logLevel},
+    {"telemetry_linger_ms", &s.telemetryLingerMs},
+    {"save_interval_sec", &s.storageSaveSec},
+  };
+  for (const Field &f : fields) {
+    if (req->hasParam(f.name) && !parseUint(req->getParam(f.name)->value().c_str(), *f.value)) {
+      sendAlertError(req, 400, (String(f.name) + " must be a number").c_str());
+      return;
+    }
+  }
+  s.logLevel = logLevel > 255 ? 255 : logLevel;
+  const char *error = validateSettings(s);
+  if (error) {
+    sendAlertError(req, 400, error);
+    return;
+  }
+  
+  settings = s;
+  markConfigDirty();
+  LOGI("⚙️ Settings: log level %u, telemetry linger %u ms, save interval %u s\n",
+       settings.logLevel, settings.telemetryLingerMs, settings.storageSaveSec);
+  handleGetSettings(req);
+}
+
+// Outbound notifications. Alert transitions are queued here (cheap, under
+// notifyMutex) and delivered by uplinkTask(), which may block on the network.
+const char *channelName(uint8_t c) {
+  return c < CHANNEL_COUNT ? SENSORS[c].name : "?";
+}
+
+bool notifyTransportConfigured() {
+  return NOTIFY_WEBHOOK_URL[0] || MQTT_BROKER[0];
+}
+
+bool telemetryEnabled() {
+  return MQTT_TELEMETRY && MQTT_BROKER[0];
+}
+
+// Stages a sample or rollup for the MQTT uplink (fixed point, 0.01 units)
+void queueTelemetry(size_t c, TelemetryKind kind, uint32_t ts, float t, float h, uint16_t n) {
+  if (!telemetryEnabled()) return;
+  TelemetryRecord r;
+  r.ts = ts;
+  r.t = (int16_t)lroundf(t * 100);
+  r.h = (uint16_t)lroundf(h * 100);
+  r.n = n;
+  r.channel = c;
+  r.kind = kind;
+  
+  xSemaphoreTake(telemetryMutex, portMAX_DELAY);
+  if (telemetryQueue.empty()) telemetryOldestMs = millis();
+  r.seq = telemetryNextSeq++;
+  telemetryQueue.push(r);
+  xSemaphoreGive(telemetryMutex);
+}
+
+void markNotifyDirty() {
+  if (!notifyDirty) notifyDirtySince = millis();
+  notifyDirty = true;
+}
+
+// Queues an event for rule i; call with alertMutex held
+void queueNotification(size_t i, NotifyEvent event, uint32_t now) {
+  if (!notifyTransportConfigured()) return;
+  const AlertRule &r = alertRules[i];
+  Notification n = {};
+  n.ts = now;
+  n.value = alertStates[i].lastValue;
+  n.threshold = r.threshold;
+  n.event = event;
+  n.rule = i;
+  n.channel = r.channel;
+  n.type = r.type;
+  n.metric = r.metric;
+  memcpy(n.name, r.name, sizeof(n.name));
+  
+  xSemaphoreTake(notifyMutex, portMAX_DELAY);
+  notifyQueue.push(n);
+  markNotifyDirty();
+  xSemaphoreGive(notifyMutex);
+  if (uplinkTaskHandle) xTaskNotifyGive(uplinkTaskHandle);
+}
+
+bool deliverWebhook(const char *payload, size_t len) {
+  WiFiClient net;
+  HTTPClient http;
+  http.setConnectTimeout(NOTIFY_TIMEOUT_MS);
+  http.setTimeout(NOTIFY_TIMEOUT_MS);
+  if (!http.begin(net, NOTIFY_WEBHOOK_URL)) return false;
+  http.addHeader("Content-Type", "application/json");
+  int code = http.POST((uint8_t*)payload, len);
+  http.end();
+  uplinkStats.lastHttpCode = code;
+  return code >= 200 && code < 300;
+}
+
+// Connects on demand; failed attempts back off like notification delivery
+bool ensureMqtt() {
+  static uint32_t failedAt = 0;
+  static uint32_t backoffMs = 0;
+  if (mqtt.connected()) return true;
+  if (backoffMs && millis() - failedAt < backoffMs) return false;
+  
+  if (!mqtt.connect(MQTT_BROKER, MQTT_PORT, HOSTNAME, MQTT_USER, MQTT_PASS)) {
+    backoffMs = backoffMs ? backoffMs * 2 : NOTIFY_BACKOFF_MIN_MS;
+    if (backoffMs > NOTIFY_BACKOFF_MAX_MS) backoffMs = NOTIFY_BACKOFF_MAX_MS;
+    failedAt = millis();
+    uplinkStats.mqttConnected = false;
+    LOGE("❌ MQTT connect to %s:%d failed (code %d), retry in %d ms\n",
+         MQTT_BROKER, MQTT_PORT, mqtt.lastReturnCode(), backoffMs);
+    return false;
+  }
+  backoffMs = 0;
+  uplinkStats.mqttConnected = true;
+  LOGI("📡 MQTT connected to %s:%d\n", MQTT_BROKER, MQTT_PORT);
+  return true;
+}
+
+bool deliverMqtt(const char *topic, const char *payload, size_t len) {
+  bool ok = ensureMqtt() && mqtt.publish(topic, (const uint8_t*)payload, len, 1);
+  uplinkStats.mqttConnected = mqtt.connected();
+  return ok;
+}
+
+// Sends the oldest batch of notifyQueue. The batch is removed once every
+// configured transport accepted it; failures back off exponentially (with
+// jitter) up to NOTIFY_BACKOFF_MAX_MS. Returns true if more are waiting.
+bool deliverNotifications(const char *alertTopic) {
+  static char payload[NOTIFY_PAYLOAD_MAX];
+  static Notification batch[NOTIFY_BATCH_MAX];
+  static uint32_t failedAt = 0;
+  if (uplinkStats.backoffMs && millis() - failedAt < uplinkStats.backoffMs) return false;
+  
+  xSemaphoreTake(notifyMutex, portMAX_DELAY);
+  size_t n = notifyQueue.peek(batch, NOTIFY_BATCH_MAX);
+  xSemaphoreGive(notifyMutex);
+  if (n == 0) return false;
+  
+  // Shrink the batch until it fits; a single event always does
+  size_t len;
+  while ((len = formatNotifyBatch(payload, sizeof(payload), HOSTNAME, channelName, batch, n)) == 0 && n > 1) n--;
+  
+  bool ok = len > 0;
+  if (ok && NOTIFY_WEBHOOK_URL[0]) ok = deliverWebhook(payload, len);
+  if (ok && MQTT_BROKER[0]) ok = deliverMqtt(alertTopic, payload, len);
+  
+  if (!ok) {
+    uint32_t backoff = uplinkStats.backoffMs ? uplinkStats.backoffMs * 2 : NOTIFY_BACKOFF_MIN_MS;
+    if (backoff > NOTIFY_BACKOFF_MAX_MS) backoff = NOTIFY_BACKOFF_MAX_MS;
+    uplinkStats.backoffMs = backoff + esp_random() % (backoff / 4);
+    uplinkStats.failures++;
+    failedAt = millis();
+    LOGE("❌ Notification delivery failed (HTTP %d), retry in %d ms\n",
+         uplinkStats.lastHttpCode, uplinkStats.backoffMs);
+    return false;
+  }
+  
+  xSemaphoreTake(notifyMutex, portMAX_DELAY);
+  notifyQueue.ackThrough(batch[n - 1].seq);
+  bool more = !notifyQueue.empty();
+  markNotifyDirty();
+  xSemaphoreGive(notifyMutex);
+  uplinkStats.delivered += n;
+  uplinkStats.lastDeliveredSeq = batch[n - 1].seq;
+  uplinkStats.backoffMs = 0;
+  LOGI("📨 Delivered %d alert notification(s) up to #%u\n", n, batch[n - 1].seq);
+  return more;
+}
+
+// Publishes telemetry: the flash backlog first (seq order), then the RAM
+// queue once a full batch is waiting or the oldest record has lingered
+// long enough. Without a broker the RAM queue is spilled to flash before
+// it overflows. Returns true if a full batch is ready to go right away.
+bool serviceTelemetry(const char *topic, bool online) {
+  static TelemetryRecord batch[TELEMETRY_BATCH];
+  static uint8_t payload[TELEMETRY_PAYLOAD_MAX];
+  
+  // Keep the persisted reservation ahead of the producer
+  if ((int32_t)(telemetryNextSeq + TELEMETRY_SEQ_RESERVE / 4 - telemetryLog.reservedSeq()) >= 0) {
+    telemetryLog.reserve(telemetryNextSeq + TELEMETRY_SEQ_RESERVE);
+  }
+  
+  online = online && ensureMqtt();
+  bool fromLog = telemetryLog.pending() > 0;
+  size_t n = 0;
+  if (online && fromLog) {
+    n = telemetryLog.peek(batch, TELEMETRY_BATCH);
+  } else if (online) {
+    xSemaphoreTake(telemetryMutex, portMAX_DELAY);
+    size_t queued = telemetryQueue.size();
+    if (queued >= TELEMETRY_BATCH || (queued > 0 && millis() - telemetryOldestMs >= settings.telemetryLingerMs)) {
+      n = telemetryQueue.peek(batch, TELEMETRY_BATCH);
+    }
+    xSemaphoreGive(telemetryMutex);
+  }
+  
+  if (n > 0) {
+    size_t len;
+    size_t used = encodeTelemetry(TELEMETRY_ENCODING, HOSTNAME, batch, n, payload, sizeof(payload), len);
+    if (used > 0 && mqtt.publish(topic, payload, len, 1)) {
+      uint32_t lastSeq = batch[used - 1].seq;
+      if (fromLog) {
+        telemetryLog.consume(used, lastSeq);
+      } else {
+        xSemaphoreTake(telemetryMutex, portMAX_DELAY);
+        telemetryQueue.popThrough(lastSeq);
+        telemetryOldestMs = millis();   // Partial batches linger again
+        xSemaphoreGive(telemetryMutex);
+      }
+      telemetryStats.published += used;
+      telemetryStats.ackedSeq = lastSeq;
+      return fromLog || telemetryQueue.size() >= TELEMETRY_BATCH;
+    }
+    uplinkStats.mqttConnected = false;
+    online = false;
+  }
+  
+  // Offline: move the oldest records to flash before the RAM queue overflows.
+  // Records still stamped with the boot clock stay in RAM until
+  // rebaseBootTimestamps() has moved them to wall time; the flash backlog
+  // is never rebased.
+  if (!online) {
+    xSemaphoreTake(telemetryMutex, portMAX_DELAY);
+    size_t queued = telemetryQueue.size();
+    xSemaphoreGive(telemetryMutex);
+    if (queued <= TELEMETRY_QUEUE_SIZE / 2) return false;
+    
+    while (queued > TELEMETRY_QUEUE_SIZE / 4) {
+      xSemaphoreTake(telemetryMutex, portMAX_DELAY);
+      size_t k = telemetryQueue.peek(batch, TELEMETRY_BATCH);
+      xSemaphoreGive(telemetryMutex);
+      size_t synced = 0;
+      while (synced < k && batch[synced].ts >= MIN_VALID_EPOCH) synced++;
+      if (synced == 0) break;
+      k = synced;
+      uint32_t writeStart = micros();
+      bool ok = storageReady() && telemetryLog.append(batch, k);
+      storageRecordWrite(writeStart, ok);
+      if (!ok) {
+        LOGE("❌ Telemetry backlog write failed\n");
+        break;
+      }
+      xSemaphoreTake(telemetryMutex, portMAX_DELAY);
+      telemetryQueue.popThrough(batch[k - 1].seq);
+      queued = telemetryQueue.size();
+      xSemaphoreGive(telemetryMutex);
+    }
+  }
+  return false;
+}
+
+// Runs the network side of alerts and telemetry so timeouts never stall
+// loop(). Woken early by queueNotification().
+void uplinkTask(void *) {
+  char alertTopic[96];
+  char telemetryTopic[96];
+  snprintf(alertTopic, sizeof(alertTopic), "%s/%s/alerts", MQTT_TOPIC_PREFIX, HOSTNAME);
+  snprintf(telemetryTopic, sizeof(telemetryTopic), "%s/%s/telemetry", MQTT_TOPIC_PREFIX, HOSTNAME);
+  mqtt.timeoutMs = NOTIFY_TIMEOUT_MS;
+  bool more = false;
+  
+  for (;;) {
+    if (!more) ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+    
+    bool online = ethConnected || wifiConnected;
+    if (online && MQTT_BROKER[0] && mqtt.connected()) uplinkStats.mqttConnected = mqtt.poll();   // Keep-alive
+    more = online && deliverNotifications(alertTopic);
+    if (telemetryEnabled()) more = serviceTelemetry(telemetryTopic, online) || more;
+  }
+}
+
+// Writes the pending notifications, coalesced like the alert state
+void saveNotifyQueue() {
+  static Notification items[NOTIFY_QUEUE_SIZE];
+  NotifyFileHeader hdr = {NOTIFY_MAGIC, NOTIFY_VERSION, sizeof(Notification), 0, 0, 0};
+  
+  xSemaphoreTake(notifyMutex, portMAX_DELAY);
+  notifyDirty = false;
+  hdr.count = notifyQueue.peek(items, NOTIFY_QUEUE_SIZE);
+  hdr.nextSeq = notifyQueue.nextSeq();
+  xSemaphoreGive(notifyMutex);
+  hdr.crc = crc32Update(0, items, hdr.count * sizeof(Notification));
+  
+  if (!storageReady()) return;
+  uint32_t writeStart = micros();
+  File file = storageFs.open(STORAGE_NOTIFY_FILE, "w");
+  if (!file) {
+    storageRecordWrite(writeStart, false);
+    return;
+  }
+  size_t bytes = hdr.count * sizeof(Notification);
+  bool ok = file.write((const uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+            file.write((const uint8_t*)items, bytes) == bytes;
+  file.close();
+  storageRecordWrite(writeStart, ok);
+}
+
+void flushNotifyQueue() {
+  if (notifyDirty && millis() - notifyDirtySince >= NOTIFY_SAVE_DELAY_MS) {
+    saveNotifyQueue();
+  }
+}
+
+void loadNotifyQueue() {
+  static Notification items[NOTIFY_QUEUE_SIZE];
+  File file = storageFs.open(STORAGE_NOTIFY_FILE, "r");
+  if (!file) return;
+  
+  NotifyFileHeader hdr;
+  bool ok = file.read((uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+            hdr.magic == NOTIFY_MAGIC && hdr.version == NOTIFY_VERSION &&
+            hdr.recordSize == sizeof(Notification) && hdr.count <= NOTIFY_QUEUE_SIZE &&
+            file.read((uint8_t*)items, hdr.count * sizeof(Notification)) == hdr.count * sizeof(Notification) &&
+            hdr.crc == crc32Update(0, items, hdr.count * sizeof(Notification));
+  file.close();
+  if (!ok) {
+    LOGE("❌ Notification queue file invalid - discarded\n");
+    return;
+  }
+  
+  xSemaphoreTake(notifyMutex, portMAX_DELAY);
+  notifyQueue.restore(items, hdr.count, hdr.nextSeq);
+  xSemaphoreGive(notifyMutex);
+  LOGI("📂 Restored %d pending alert notifications\n", hdr.count);
+}
+
+void handleTelemetryStatus(AsyncWebServerRequest *req) {
+  StaticJsonDocument<512> doc;
+  doc["enabled"] = telemetryEnabled();
+  doc["encoding"] = TELEMETRY_ENCODING == TelemetryEncoding::Json ? "json" : "binary";
+  doc["batch"] = TELEMETRY_BATCH;
+  doc["linger_ms"] = settings.telemetryLingerMs;
+  doc["mqtt_connected"] = uplinkStats.mqttConnected;
+  
+  xSemaphoreTake(telemetryMutex, portMAX_DELAY);
+  doc["queued"] = telemetryQueue.size();
+  doc["queue_capacity"] = TELEMETRY_QUEUE_SIZE;
+  doc["queue_dropped"] = telemetryQueue.dropped();
+  doc["next_seq"] = telemetryNextSeq;
+  xSemaphoreGive(telemetryMutex);
+  
+  // Owned by the uplink task; plain counters, a stale read is harmless
+  doc["backlog"] = telemetryLog.pending();
+  doc["backlog_dropped"] = telemetryLog.dropped();
+  doc["published"] = telemetryStats.published;
+  doc["acked_seq"] = telemetryStats.ackedSeq;
+  
+  String output;
+  serializeJson(doc, output);
+  req->send(200, "application/json", output);
+}
+
+// Outage journal: while the link is down every stored sample is also kept
+// at full resolution in flash, until a client has replayed and acked it
+void beginOutage() {
+  if (outageStats.active) return;
+  outageStats.active = true;
+  outageStats.count++;
+  outageStats.startTs = getCurrentTimestamp();
+  outageStats.endTs = 0;
+  LOGI("📼 Outage journal started (outage #%u)\n", outageStats.count);
+}
+
+void endOutage() {
+  if (!outageStats.active) return;
+  outageStats.active = false;
+  outageStats.endTs = getCurrentTimestamp();
+  flushOutageJournal();
+  xSemaphoreTake(journalMutex, portMAX_DELAY);
+  size_t pending = outageJournal.pending();
+  xSemaphoreGive(journalMutex);
+  LOGI("📼 Outage ended after %u s - %d samples waiting for replay\n",
+       outageStats.endTs - outageStats.startTs, pending);
+}
+
+void journalSample(size_t c, uint32_t ts, float t, float h) {
+  if (!outageStats.active || !journalReady) return;
+  TelemetryRecord r;
+  r.seq = journalNextSeq++;
+  r.ts = ts;
+  r.t = (int16_t)lroundf(t * 100);
+  r.h = (uint16_t)lroundf(h * 100);
+  r.n = 1;
+  r.channel = c;
+  r.kind = TELEMETRY_SAMPLE;
+  if (journalStage.size() == 0) journalStagedSince = millis();
+  journalStage.add(r);
+  if (journalStage.full()) flushOutageJournal();
+}
+
+// One append per staged batch instead of one flash write per sample.
+// Samples taken before the first NTP sync stay staged until
+// rebaseBootTimestamps() has moved them to wall time.
+void flushOutageJournal() {
+  size_t n = journalStage.ready();
+  if (n == 0) return;
+  uint32_t writeStart = micros();
+  xSemaphoreTake(journalMutex, portMAX_DELAY);
+  bool ok = journalStage.flush(outageJournal);
+  xSemaphoreGive(journalMutex);
+  storageRecordWrite(writeStart, ok);
+  if (ok) {
+    outageStats.journaled += n;
+  } else {
+    outageStats.writeErrors++;
+    LOGE("❌ Outage journal write failed - %d samples lost\n", n);
+  }
+  journalStagedSince = millis();
+}
+
+// Called from loop(): boot without a link counts as an outage, and staged
+// samples never wait longer than OUTAGE_FLUSH_MS
+void serviceOutageJournal() {
+  if (!isConnected && !outageStats.active && !networkServicesStarted && millis() >= OUTAGE_BOOT_GRACE_MS) {
+    beginOutage();
+  }
+  if (journalStage.ready() > 0 && millis() - journalStagedSince >= OUTAGE_FLUSH_MS) {
+    flushOutageJournal();
+  }
+}
+
+void handleOutageStatus(AsyncWebServerRequest *req) {
+  StaticJsonDocument<512> doc;
+  doc["active"] = outageStats.active;
+  doc["outages"] = outageStats.count;
+  doc["start"] = outageStats.startTs;
+  doc["end"] = outageStats.endTs;
+  doc["journaled"] = outageStats.journaled;
+  doc["staged"] = journalStage.size();
+  doc["unsynced_dropped"] = journalStage.dropped();
+  doc["write_errors"] = outageStats.writeErrors;
+  
+  xSemaphoreTake(journalMutex, portMAX_DELAY);
+  doc["pending"] = outageJournal.pending();
+  doc["acked_seq"] = outageJournal.ackedSeq();
+  doc["last_seq"] = outageJournal.lastSeq();
+  doc["dropped"] = outageJournal.dropped();
+  xSemaphoreGive(journalMutex);
+  doc["capacity"] = 2 * OUTAGE_SEGMENT_RECORDS;
+  
+  String output;
+  serializeJson(doc, output);
+  req->send(200, "application/json", output);
+}
+
+// Frees replayed records; replay?after= keeps working for anything newer
+void handleOutageAck(AsyncWebServerRequest *req) {
+  if (!req->hasParam("seq")) {
+    req->send(400, "application/json", "{\"error\":\"seq required\"}");
+    return;
+  }
+  uint32_t seq;
+  if (!parseUint(req->getParam("seq")->value().c_str(), seq)) {
+    req->send(400, "application/json", "{\"error\":\"seq must be a number\"}");
+    return;
+  }
+  xSemaphoreTake(journalMutex, portMAX_DELAY);
+  outageJournal.ackThrough(seq);
+  uint32_t acked = outageJournal.ackedSeq();
+  size_t pending = outageJournal.pending();
+  xSemaphoreGive(journalMutex);
+  
+  char body[64];
+  snprintf(body, sizeof(body), "{\"acked_seq\":%u,\"pending\":%u}", (unsigned)acked, (unsigned)pending);
+  req->send(200, "application/json", body);
+}
+
+void handleNotifyStatus(AsyncWebServerRequest *req) {
+  StaticJsonDocument<512> doc;
+  doc["webhook"] = NOTIFY_WEBHOOK_URL[0] != 0;
+  doc["mqtt"] = MQTT_BROKER[0] != 0;
+  doc["mqtt_connected"] = uplinkStats.mqttConnected;
+  
+  xSemaphoreTake(notifyMutex, portMAX_DELAY);
+  doc["pending"] = notifyQueue.size();
+  doc["capacity"] = NOTIFY_QUEUE_SIZE;
+  doc["dropped"] = notifyQueue.dropped();
+  doc["next_seq"] = notifyQueue.nextSeq();
+  xSemaphoreGive(notifyMutex);
+  
+  doc["delivered"] = uplinkStats.delivered;
+  doc["last_delivered_seq"] = uplinkStats.lastDeliveredSeq;
+  doc["failures"] = uplinkStats.failures;
+  doc["backoff_ms"] = uplinkStats.backoffMs;
+  doc["last_http_code"] = uplinkStats.lastHttpCode;
   
   String output;
   serializeJson(doc, output);
@@ -675,11 +3190,12 @@ void handleGetHumidityAlert(AsyncWebServerRequest *req) {
 }
 
 void handleSaveData(AsyncWebServerRequest *req) {
+  commitAggregates(AGG_COMMIT_SAVE);
   saveToPersistentStorage();
   StaticJsonDocument<256> doc;
   doc["status"] = "success";
   doc["message"] = "Data saved to persistent storage";
-  doc["records_saved"] = aggregatedBuffer.size();
+  doc["records_saved"] = historyHeader.count;
   doc["memory_usage"] = getMemoryUsagePercent();
   
   String output;
@@ -687,99 +3203,1037 @@ void handleSaveData(AsyncWebServerRequest *req) {
   req->send(200, "application/json", output);
 }
 
+float round2(float v) {
+  return roundf(v * 100.0f) / 100.0f;
+}
+
+// Rolling statistics of one window; rates are per minute over the window
+template <size_t N>
+void addWindowStats(JsonObject obj, const RollingStats<N> &stats) {
+  obj["window_sec"] = stats.window();
+  obj["samples"] = stats.size();
+  if (stats.empty()) return;
+  obj["mean_t"] = round2(stats.mean(STAT_T));
+  obj["std_t"] = round2(sqrtf(stats.variance(STAT_T)));
+  obj["min_t"] = stats.minimum(STAT_T);
+  obj["max_t"] = stats.maximum(STAT_T);
+  obj["rate_t_per_min"] = round2(stats.slopePerMin(STAT_T));
+  obj["mean_h"] = round2(stats.mean(STAT_H));
+  obj["std_h"] = round2(sqrtf(stats.variance(STAT_H)));
+  obj["min_h"] = stats.minimum(STAT_H);
+  obj["max_h"] = stats.maximum(STAT_H);
+  obj["rate_h_per_min"] = round2(stats.slopePerMin(STAT_H));
+}
+
+// Parses ?channel=<index|name>; defaults to channel 0, -1 if unknown
+int parseChannel(AsyncWebServerRequest *req) {
+  if (!req->hasParam("channel")) return 0;
+  const String &value = req->getParam("channel")->value();
+  for (size_t c = 0; c < CHANNEL_COUNT; c++) {
+    if (value == SENSORS[c].name) return c;
+  }
+  uint32_t c;
+  if (parseUint(value.c_str(), c) && c < CHANNEL_COUNT) return c;
+  return -1;
+}
+
 void handleCurrent(AsyncWebServerRequest *req) {
-  if (detailedBuffer.empty()) {
+  int c = parseChannel(req);
+  if (c < 0) {
+    req->send(404, "application/json", "{\"error\":\"unknown channel\"}");
+    return;
+  }
+  const Channel &ch = channels[c];
+  if (ch.detailed.empty()) {
     req->send(503, "application/json", "{\"error\":\"no data\"}");
     return;
   }
   
-  StaticJsonDocument<256> doc;
-  Reading last = detailedBuffer.back();
-  doc["t"] = last.t;
-  doc["h"] = last.h;
-  doc["timestamp"] = last.ts;
-  doc["datetime"] = last.datetime;
-  doc["time_source"] = (last.ts > 1000000000) ? "NTP" : "boot_time";
-  doc["sample_interval"] = SAMPLE_MS / 1000;
-  doc["detailed_samples"] = detailedBuffer.size();
-  doc["aggregated_samples"] = aggregatedBuffer.size();
+  StaticJsonDocument<1536 + 192 * CHANNEL_COUNT> doc;
+  size_t last = ch.detailed.newest();
+  uint32_t lastTs = ch.detailed.ts[last];
+  doc["channel"] = ch.cfg->name;
+  doc["t"] = ch.detailed.t[last];
+  doc["h"] = ch.detailed.h[last];
+  doc["timestamp"] = lastTs;
+  char datetime[TIME_FORMAT_MAX];
+  DateFormatter formatter;
+  formatter.format(lastTs, datetime);
+  doc["datetime"] = datetime;
+  doc["time_source"] = (lastTs >= MIN_VALID_EPOCH) ? "NTP" : "boot_time";
+  doc["ntp_synced"] = timeSynced;
+  doc["sample_interval"] = ch.intervalMs / 1000;
+  doc["sensor"] = ch.driver->model();
+  
+  JsonObject sampler = doc.createNestedObject("sampler");
+  sampler["samples"] = ch.totalSamples;
+  sampler["missed_slots"] = ch.totalMissedSlots;
+  sampler["last_jitter_ms"] = ch.lastJitterMs;
+  sampler["max_jitter_ms"] = ch.maxJitterMs;
+  sampler["oversample"] = ch.burstTarget;
+  sampler["rejected_readings"] = ch.totalRejected;
+  sampler["last_std_t"] = ch.lastStdT;
+  sampler["last_std_h"] = ch.lastStdH;
+  doc["detailed_samples"] = ch.detailed.size();
+  doc["aggregated_samples"] = ch.aggregated.size();
   doc["memory_usage_percent"] = getMemoryUsagePercent();
   doc["free_heap_kb"] = ESP.getFreeHeap() / 1024;
   doc["emergency_mode"] = emergencyMode;
-  doc["persistent_storage"] = SPIFFS.begin(false);
+  doc["persistent_storage"] = storageReady();
   doc["uptime_seconds"] = millis() / 1000;  // Add actual uptime in seconds since boot
+  doc["history_loaded"] = (historyState == HISTORY_LOADED);
+  
+  JsonObject analytics = doc.createNestedObject("analytics");
+  analytics["dew_point"] = round2(dewPoint(ch.detailed.t[last], ch.detailed.h[last]));
+  analytics["abs_humidity"] = round2(absoluteHumidity(ch.detailed.t[last], ch.detailed.h[last]));
+  addWindowStats(analytics.createNestedObject("recent"), ch.recent);
+  addWindowStats(analytics.createNestedObject("hourly"), ch.hourly);
+  
+  // Latest value of every channel
+  JsonArray list = doc.createNestedArray("channels");
+  for (const Channel &other : channels) {
+    JsonObject obj = list.createNestedObject();
+    obj["name"] = other.cfg->name;
+    if (other.detailed.empty()) continue;
+    size_t idx = other.detailed.newest();
+    obj["t"] = other.detailed.t[idx];
+    obj["h"] = other.detailed.h[idx];
+    obj["timestamp"] = other.detailed.ts[idx];
+  }
+  
+  JsonObject boot = doc.createNestedObject("boot");
+  boot["http_ready_ms"] = bootToHttpReadyMs;
+  boot["first_sample_ms"] = bootToFirstSampleMs;
+  boot["history_load_ms"] = historyLoadMs;
   
   String output;
   serializeJson(doc, output);
   req->send(200, "application/json", output);
 }
 
+// Parses ?time=local|iso|epoch; epoch omits the datetime strings entirely
+TimeFormat parseTimeFormat(AsyncWebServerRequest *req) {
+  if (req->hasParam("time")) {
+    const String &mode = req->getParam("time")->value();
+    if (mode == "iso") return TimeFormat::Iso8601;
+    if (mode == "epoch") return TimeFormat::Epoch;
+  }
+  return TimeFormat::Local;
+}
+
+// Copies ring entries into the point list handed to the formatter
+template <size_t N>
+void addHistoryPoint(HistoryPoint *points, size_t &count, const SampleRing<N> &ring, size_t idx, HistoryPointKind kind) {
+  points[count++] = {ring.ts[idx], ring.t[idx], ring.h[idx], ring.n[idx], ring.missed[idx], ring.jitterMs[idx], kind, 0};
+}
+
+// Detailed points of fast channels are decimated to MAX_HISTORY_POINTS,
+// always keeping the newest sample
+void addDetailedPoints(HistoryPoint *points, size_t &count, const Channel &ch) {
+  size_t total = ch.detailed.size();
+  size_t step = (total + MAX_HISTORY_POINTS - 1) / MAX_HISTORY_POINTS;
+  if (step == 0) return;
+  for (size_t i = (total - 1) % step; i < total; i += step) {
+    addHistoryPoint(points, count, ch.detailed, ch.detailed.at(i), POINT_DETAILED);
+  }
+}
+
+// History JSON formatting: large responses are split in two halves, the
+// second formatted by historyWorkerTask on the other core while the web
+// task formats the first; the halves are then streamed in order
+void historyWorkerTask(void *) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    historyJob.ok = formatHistorySlice(historyJob.points, historyJob.count, *historyJob.options, true, *historyJob.out);
+    xSemaphoreGive(historyJobDone);
+  }
+}
+
+bool formatHistoryPoints(const HistoryPoint *points, size_t count, const HistoryJsonOptions &options, TextChunks *parts) {
+  // Small responses, or the worker busy with another request: one slice here
+  if (count < HISTORY_PARALLEL_MIN_POINTS || !historyWorkerHandle ||
+      xSemaphoreTake(historyWorkerMutex, 0) != pdTRUE) {
+    return formatHistorySlice(points, count, options, false, parts[0]);
+  }
+  size_t split = count / 2;
+  historyJob = {points + split, count - split, &options, &parts[1], false};
+  xTaskNotifyGive(historyWorkerHandle);
+  bool ok = formatHistorySlice(points, split, options, false, parts[0]);
+  xSemaphoreTake(historyJobDone, portMAX_DELAY);
+  ok = ok && historyJob.ok;
+  xSemaphoreGive(historyWorkerMutex);
+  return ok;
+}
+
+// Response body: head, the formatted slices, tail
+struct HistoryResponse {
+  String head;
+  TextChunks parts[2];
+  String tail;
+  
+  size_t fill(uint8_t *buf, size_t maxLen, size_t index) {
+    size_t n = 0;
+    size_t offset = index;
+    auto copy = [&](const char *src, size_t len) {
+      if (offset >= len) {
+        offset -= len;
+        return;
+      }
+      size_t k = len - offset;
+      if (k > maxLen - n) k = maxLen - n;
+      memcpy(buf + n, src + offset, k);
+      n += k;
+      offset = 0;
+    };
+    copy(head.c_str(), head.length());
+    for (const TextChunks &part : parts) {
+      if (n == maxLen) break;
+      if (offset >= part.size()) {
+        offset -= part.size();
+        continue;
+      }
+      size_t k = part.read(offset, (char *)buf + n, maxLen - n);
+      n += k;
+      offset = 0;
+    }
+    if (n < maxLen) copy(tail.c_str(), tail.length());
+    return n;
+  }
+};
+
 void handleHistory(AsyncWebServerRequest *req) {
   String range = "detailed";
   if (req->hasParam("range")) {
     range = req->getParam("range")->value();
   }
+  int c = parseChannel(req);
+  if (c < 0) {
+    req->send(404, "application/json", "{\"error\":\"unknown channel\"}");
+    return;
+  }
+  const Channel &ch = channels[c];
+  TimeFormat timeFormat = parseTimeFormat(req);
+  
+  // ?series=derived adds dew point and absolute humidity to every point
+  bool derived = req->hasParam("series") && req->getParam("series")->value() == "derived";
+  HistoryJsonOptions options = {timeFormat, timeFormat != TimeFormat::Epoch, derived, false, ch.slotsPerBucket};
+  
+  // Copy the points first; the rings keep moving while the text is formatted
+  size_t capacity = ch.aggregated.size() + MAX_HISTORY_POINTS + 1;
+  std::unique_ptr<HistoryPoint[]> points(new (std::nothrow) HistoryPoint[capacity]);
+  std::shared_ptr<HistoryResponse> response(new (std::nothrow) HistoryResponse());
+  if (!points || !response) {
+    req->send(503, "application/json", "{\"error\":\"out of memory\"}");
+    return;
+  }
+  size_t count = 0;
   
-  DynamicJsonDocument doc(16384); // 16KB for JSON response
-  JsonArray data = doc.createNestedArray("data");
-  doc["sample_info"] = JsonObject();
+  StaticJsonDocument<512> info;
+  info["channel"] = ch.cfg->name;
+  info["history_loaded"] = (historyState == HISTORY_LOADED);
   
   if (range == "detailed" || range == "10min") {
-    // Return detailed 10-second data (last 10 minutes)
-    doc["sample_info"]["type"] = "detailed";
-    doc["sample_info"]["interval_seconds"] = SAMPLE_MS / 1000;
-    doc["sample_info"]["max_age_minutes"] = DETAILED_PERIOD_SEC / 60;
+    // Return detailed 30-second data (last 30 minutes)
+    info["type"] = "detailed";
+    info["interval_seconds"] = ch.intervalMs / 1000;
+    info["max_age_minutes"] = DETAILED_PERIOD_SEC / 60;
+    info["step"] = (ch.detailed.size() + MAX_HISTORY_POINTS - 1) / MAX_HISTORY_POINTS;
     
-    for (const auto& reading : detailedBuffer) {
-      JsonObject obj = data.createNestedObject();
-      obj["ts"] = reading.ts;
-      obj["t"] = reading.t;
-      obj["h"] = reading.h;
-      obj["datetime"] = reading.datetime;
-    }
+    addDetailedPoints(points.get(), count, ch);
   } else if (range == "aggregated" || range == "24h") {
     // Return aggregated 5-minute data
-    doc["sample_info"]["type"] = "aggregated";
-    doc["sample_info"]["interval_seconds"] = AGGREGATE_INTERVAL_SEC;
-    doc["sample_info"]["max_age_hours"] = (MAX_AGGREGATE_SAMPLES * AGGREGATE_INTERVAL_SEC) / 3600;
+    info["type"] = "aggregated";
+    info["interval_seconds"] = AGGREGATE_INTERVAL_SEC;
+    info["slots_per_bucket"] = ch.slotsPerBucket;
+    info["max_age_hours"] = (MAX_AGGREGATE_SAMPLES * AGGREGATE_INTERVAL_SEC) / 3600;
     
-    for (const auto& reading : aggregatedBuffer) {
-      JsonObject obj = data.createNestedObject();
-      obj["ts"] = reading.ts;
-      obj["t"] = reading.t;
-      obj["h"] = reading.h;
-      obj["datetime"] = reading.datetime;
+    for (size_t i = 0; i < ch.aggregated.size() && count < capacity; i++) {
+      addHistoryPoint(points.get(), count, ch.aggregated, ch.aggregated.at(i), POINT_AGGREGATED);
     }
   } else if (range == "all") {
-    // Return combined data (aggregated + detailed)
-    doc["sample_info"]["type"] = "combined";
-    doc["sample_info"]["detailed_count"] = detailedBuffer.size();
-    doc["sample_info"]["aggregated_count"] = aggregatedBuffer.size();
+    // Return combined data: aggregates older than the detailed window, then
+    // the detailed data (both rings cover the last 30 minutes)
+    uint32_t detailedStart = ch.detailed.empty() ? UINT32_MAX : ch.detailed.ts[ch.detailed.at(0)];
+    size_t aggregatedCount = 0;
+    for (size_t i = 0; i < ch.aggregated.size() && count < capacity - MAX_HISTORY_POINTS - 1; i++) {
+      size_t idx = ch.aggregated.at(i);
+      if (ch.aggregated.ts[idx] + AGGREGATE_INTERVAL_SEC > detailedStart) break;
+      addHistoryPoint(points.get(), count, ch.aggregated, idx, POINT_AGGREGATED);
+      aggregatedCount++;
+    }
+    addDetailedPoints(points.get(), count, ch);
+    options.typed = true;
+    info["type"] = "combined";
+    info["detailed_count"] = ch.detailed.size();
+    info["aggregated_count"] = aggregatedCount;
+  }
+  
+  if (!formatHistoryPoints(points.get(), count, options, response->parts)) {
+    req->send(503, "application/json", "{\"error\":\"out of memory\"}");
+    return;
+  }
+  points.reset();
+  response->head = "{\"data\":[";
+  response->tail = "],\"sample_info\":";
+  serializeJson(info, response->tail);
+  response->tail += "}";
+  
+  req->send(req->beginChunkedResponse("application/json",
+      [response](uint8_t *buf, size_t maxLen, size_t index) -> size_t { return response->fill(buf, maxLen, index); }));
+}
+
+// Bulk export: CSV or NDJSON rows streamed with chunked transfer encoding.
+// Per channel, rows come from the flash history, then the aggregated ring,
+// then the detailed ring, oldest first. The cursor only remembers the last
+// timestamp sent per channel (the rings keep moving while the client
+// reads), so memory stays constant however long the export is.
+enum ExportFormat : uint8_t { EXPORT_CSV, EXPORT_NDJSON };
+enum ExportStage : uint8_t { EXPORT_FLASH, EXPORT_AGGREGATED, EXPORT_DETAILED };
+
+// Line buffer shared by the streamed text responses
+struct LineStream {
+  char line[EXPORT_LINE_MAX];
+  size_t lineLen;
+  size_t linePos;
+  size_t bytes;
+};
+
+struct ExportCursor : LineStream {
+  ExportFormat format;
+  TimeFormat timeFormat;
+  uint8_t channel;
+  uint8_t lastChannel;
+  ExportStage stage;
+  bool headerSent;
+  uint32_t from;
+  uint32_t to;
+  uint32_t nextTs;            // Rows of the current channel must not be older
+  File file;                  // Flash history, read once front to back
+  uint32_t flashRemaining;
+  uint16_t recordSize;
+  bool blockCrc;              // v4 file: EXPORT_FLASH_BLOCK records + CRC32 per block
+  uint8_t blockLen;
+  uint8_t blockPos;
+  uint8_t block[EXPORT_FLASH_BLOCK * sizeof(HistoryRecord) + sizeof(uint32_t)];
+  DateFormatter formatter;
+  uint32_t rows;
+  uint32_t startMs;
+};
+
+// First ring position with a timestamp >= ts (rings are sorted by time)
+template <size_t N>
+size_t ringLowerBound(const SampleRing<N> &ring, uint32_t ts) {
+  size_t lo = 0, hi = ring.size();
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (ring.ts[ring.at(mid)] < ts) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+// Next record of the flash history without consuming it; false at the end
+bool peekExportRecord(ExportCursor &cur, HistoryRecord &rec) {
+  while (cur.blockPos == cur.blockLen) {
+    if (!cur.file || cur.flashRemaining == 0) return false;
+    uint32_t chunk = cur.flashRemaining < EXPORT_FLASH_BLOCK ? cur.flashRemaining : EXPORT_FLASH_BLOCK;
+    size_t payload = (size_t)chunk * cur.recordSize;
+    size_t want = payload + (cur.blockCrc ? sizeof(uint32_t) : 0);
+    if (cur.file.read(cur.block, want) != want) {
+      cur.flashRemaining = 0;   // File shrank or was rewritten; RAM tiers still follow
+      return false;
+    }
+    cur.flashRemaining -= chunk;
+    cur.blockPos = 0;
+    cur.blockLen = chunk;
+    if (cur.blockCrc) {
+      // A damaged block is left out of the export
+      uint32_t crc;
+      memcpy(&crc, cur.block + payload, sizeof(crc));
+      if (crc != crc32Update(0, cur.block, payload)) cur.blockLen = 0;
+    }
+  }
+  // Older versions store shorter records; missing fields read as zero
+  memset(&rec, 0, sizeof(rec));
+  memcpy(&rec, cur.block + (size_t)cur.blockPos * cur.recordSize, cur.recordSize);
+  return true;
+}
+
+// Empty (CSV) or null (NDJSON) for missing values
+size_t formatExportFloat(const ExportCursor &cur, char *out, float v) {
+  size_t n = formatFixed(out, v, 2, false);   // Same text as "%.2f"
+  if (n == 0 && cur.format == EXPORT_NDJSON) n = formatStr(out, "null");
+  return n;
+}
+
+// Rows are assembled with the num_format writers instead of snprintf; the
+// longest fields (10-digit numbers, a 31-character time, EXPORT_NAME_MAX of
+// name, two 24-character floats) still fit EXPORT_LINE_MAX
+void formatExportRow(ExportCursor &cur, uint32_t ts, float t, float h, uint16_t n, uint16_t missed, uint32_t interval) {
+  const char *name = channels[cur.channel].cfg->name;
+  size_t nameLen = strnlen(name, EXPORT_NAME_MAX);
+  char *w = cur.line;
+  if (cur.format == EXPORT_CSV) {
+    w += formatUint(w, ts);
+    *w++ = ',';
+    w += cur.formatter.format(ts, w, cur.timeFormat);
+    *w++ = ',';
+    memcpy(w, name, nameLen);
+    w += nameLen;
+    *w++ = ',';
+    w += formatUint(w, interval);
+    *w++ = ',';
+    w += formatExportFloat(cur, w, t);
+    *w++ = ',';
+    w += formatExportFloat(cur, w, h);
+    *w++ = ',';
+    w += formatUint(w, n);
+    *w++ = ',';
+    w += formatUint(w, missed);
+    *w++ = '\n';
+  } else {
+    w += formatStr(w, "{\"ts\":");
+    w += formatUint(w, ts);
+    w += formatStr(w, ",\"time\":\"");
+    w += cur.formatter.format(ts, w, cur.timeFormat);
+    w += formatStr(w, "\",\"channel\":\"");
+    memcpy(w, name, nameLen);
+    w += nameLen;
+    w += formatStr(w, "\",\"interval\":");
+    w += formatUint(w, interval);
+    w += formatStr(w, ",\"t\":");
+    w += formatExportFloat(cur, w, t);
+    w += formatStr(w, ",\"h\":");
+    w += formatExportFloat(cur, w, h);
+    w += formatStr(w, ",\"n\":");
+    w += formatUint(w, n);
+    w += formatStr(w, ",\"missed\":");
+    w += formatUint(w, missed);
+    w += formatStr(w, "}\n");
+  }
+  cur.lineLen = w - cur.line;
+  cur.linePos = 0;
+  cur.nextTs = ts + 1;
+  cur.rows++;
+}
+
+// Formats the next line into cur.line; false once the export is complete
+bool nextExportLine(ExportCursor &cur) {
+  if (!cur.headerSent) {
+    cur.headerSent = true;
+    if (cur.format == EXPORT_CSV) {
+      cur.lineLen = snprintf(cur.line, sizeof(cur.line), "ts,time,channel,interval_s,t,h,n,missed\n");
+      cur.linePos = 0;
+      return true;
+    }
+  }
+  
+  while (cur.channel <= cur.lastChannel) {
+    const Channel &ch = channels[cur.channel];
+    uint32_t start = cur.nextTs > cur.from ? cur.nextTs : cur.from;
+    uint32_t detailedStart = ch.detailed.empty() ? UINT32_MAX : ch.detailed.ts[ch.detailed.at(0)];
+    
+    if (cur.stage == EXPORT_FLASH) {
+      // Only what the aggregated ring no longer (or not yet) holds
+      uint32_t cutoff = ch.aggregated.empty() ? detailedStart : ch.aggregated.ts[ch.aggregated.at(0)];
+      HistoryRecord rec;
+      while (peekExportRecord(cur, rec)) {
+        if (rec.channel > cur.channel) break;   // Records are grouped by channel
+        cur.blockPos++;
+        if (rec.channel < cur.channel) continue;
+        if (rec.ts < start || rec.ts >= cutoff || rec.ts > cur.to) continue;
+        formatExportRow(cur, rec.ts, rec.t, rec.h, rec.n, rec.missed, AGGREGATE_INTERVAL_SEC);
+        return true;
+      }
+      cur.stage = EXPORT_AGGREGATED;
+    }
     
-    // Add aggregated data first (older)
-    for (const auto& reading : aggregatedBuffer) {
-      JsonObject obj = data.createNestedObject();
-      obj["ts"] = reading.ts;
-      obj["t"] = reading.t;
-      obj["h"] = reading.h;
-      obj["datetime"] = reading.datetime;
-      obj["type"] = "aggregated";
+    if (cur.stage == EXPORT_AGGREGATED) {
+      const SampleRing<MAX_AGGREGATE_SAMPLES> &agg = ch.aggregated;
+      size_t i = ringLowerBound(agg, start);
+      if (i < agg.size()) {
+        size_t idx = agg.at(i);
+        if (agg.ts[idx] + AGGREGATE_INTERVAL_SEC <= detailedStart && agg.ts[idx] <= cur.to) {
+          formatExportRow(cur, agg.ts[idx], agg.t[idx], agg.h[idx], agg.n[idx], agg.missed[idx], AGGREGATE_INTERVAL_SEC);
+          return true;
+        }
+      }
+      cur.stage = EXPORT_DETAILED;
     }
     
-    // Add detailed data last (newer)
-    for (const auto& reading : detailedBuffer) {
-      JsonObject obj = data.createNestedObject();
-      obj["ts"] = reading.ts;
-      obj["t"] = reading.t;
-      obj["h"] = reading.h;
-      obj["datetime"] = reading.datetime;
-      obj["type"] = "detailed";
+    const SampleRing<MAX_DETAILED_SAMPLES> &det = ch.detailed;
+    size_t i = ringLowerBound(det, start);
+    if (i < det.size()) {
+      size_t idx = det.at(i);
+      if (det.ts[idx] <= cur.to) {
+        formatExportRow(cur, det.ts[idx], det.t[idx], det.h[idx], det.n[idx], det.missed[idx], ch.intervalMs / 1000);
+        return true;
+      }
     }
+    cur.channel++;
+    cur.stage = EXPORT_FLASH;
+    cur.nextTs = 0;
   }
   
-  String output;
-  serializeJson(doc, output);
-  req->send(200, "application/json", output);
+  if (cur.file) cur.file.close();
+  uint32_t ms = millis() - cur.startMs;
+  LOGI("📤 Export finished: %u rows, %u bytes in %u ms\n",
+       (unsigned)cur.rows, (unsigned)cur.bytes, (unsigned)ms);
+  return false;
+}
+
+// AsyncTCP filler: copies whole and partial lines until the chunk is full;
+// next() formats the following line and returns false at the end
+template <typename Cursor>
+size_t fillLines(Cursor &cur, bool (*next)(Cursor &), uint8_t *buf, size_t maxLen) {
+  size_t n = 0;
+  while (n < maxLen) {
+    if (cur.linePos == cur.lineLen && !next(cur)) break;
+    size_t k = cur.lineLen - cur.linePos;
+    if (k > maxLen - n) k = maxLen - n;
+    memcpy(buf + n, cur.line + cur.linePos, k);
+    cur.linePos += k;
+    n += k;
+  }
+  cur.bytes += n;
+  return n;
+}
+
+void handleExport(AsyncWebServerRequest *req) {
+  std::shared_ptr<ExportCursor> cur(new (std::nothrow) ExportCursor());
+  if (!cur) {
+    req->send(503, "application/json", "{\"error\":\"out of memory\"}");
+    return;
+  }
+  cur->format = EXPORT_CSV;
+  if (req->hasParam("format")) {
+    const String &format = req->getParam("format")->value();
+    if (format == "ndjson") {
+      cur->format = EXPORT_NDJSON;
+    } else if (format != "csv") {
+      req->send(400, "application/json", "{\"error\":\"format must be csv or ndjson\"}");
+      return;
+    }
+  }
+  // ISO 8601 unless ?time= asks for something else
+  cur->timeFormat = req->hasParam("time") ? parseTimeFormat(req) : TimeFormat::Iso8601;
+  cur->from = 0;
+  cur->to = UINT32_MAX;
+  if ((req->hasParam("from") && !parseUint(req->getParam("from")->value().c_str(), cur->from)) ||
+      (req->hasParam("to") && !parseUint(req->getParam("to")->value().c_str(), cur->to))) {
+    req->send(400, "application/json", "{\"error\":\"from and to must be Unix timestamps\"}");
+    return;
+  }
+  cur->lastChannel = CHANNEL_COUNT - 1;
+  if (req->hasParam("channel")) {
+    int c = parseChannel(req);
+    if (c < 0) {
+      req->send(404, "application/json", "{\"error\":\"unknown channel\"}");
+      return;
+    }
+    cur->channel = c;
+    cur->lastChannel = c;
+  }
+  
+  if (historyState != HISTORY_DAMAGED) {
+    cur->file = storageFs.open(STORAGE_HISTORY_FILE, "r");
+    HistoryHeader hdr;
+    if (cur->file && cur->file.read((uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+        historyHeaderValid(hdr, cur->file.size())) {
+      cur->flashRemaining = hdr.count;
+      cur->recordSize = hdr.recordSize;
+      cur->blockCrc = historyHasBlockCrc(hdr.version);
+    } else if (cur->file) {
+      cur->file.close();
+    }
+  }
+  cur->startMs = millis();
+  
+  bool csv = cur->format == EXPORT_CSV;
+  AsyncWebServerResponse *response = req->beginChunkedResponse(
+      csv ? "text/csv" : "application/x-ndjson",
+      [cur](uint8_t *buf, size_t maxLen, size_t index) -> size_t { return fillLines(*cur, nextExportLine, buf, maxLen); });
+  response->addHeader("Content-Disposition", csv ? "attachment; filename=\"thlogger-export.csv\""
+                                                 : "attachment; filename=\"thlogger-export.ndjson\"");
+  req->send(response);
+}
+
+// Outage replay: journal records with seq > after, streamed like the export.
+// A client stores the last seq it received and resumes from there.
+struct ReplayCursor : LineStream {
+  ExportFormat format;
+  TimeFormat timeFormat;
+  bool headerSent;
+  uint32_t afterSeq;
+  uint32_t limit;
+  uint32_t rows;
+  size_t blockLen;
+  size_t blockPos;
+  TelemetryRecord block[OUTAGE_REPLAY_BLOCK];
+  DateFormatter formatter;
+};
+
+bool nextReplayLine(ReplayCursor &cur) {
+  if (!cur.headerSent) {
+    cur.headerSent = true;
+    if (cur.format == EXPORT_CSV) {
+      cur.lineLen = snprintf(cur.line, sizeof(cur.line), "seq,ts,time,channel,t,h\n");
+      cur.linePos = 0;
+      return true;
+    }
+  }
+  if (cur.rows >= cur.limit) return false;
+  if (cur.blockPos == cur.blockLen) {
+    xSemaphoreTake(journalMutex, portMAX_DELAY);
+    cur.blockLen = outageJournal.readAfter(cur.afterSeq, cur.block, OUTAGE_REPLAY_BLOCK);
+    xSemaphoreGive(journalMutex);
+    cur.blockPos = 0;
+    if (cur.blockLen == 0) return false;
+  }
+  
+  // Journal values are centi-units already; printed without float math
+  const TelemetryRecord &r = cur.block[cur.blockPos++];
+  const char *name = r.channel < CHANNEL_COUNT ? channels[r.channel].cfg->name : "?";
+  size_t nameLen = strnlen(name, EXPORT_NAME_MAX);
+  char *w = cur.line;
+  if (cur.format == EXPORT_CSV) {
+    w += formatUint(w, r.seq);
+    *w++ = ',';
+    w += formatUint(w, r.ts);
+    *w++ = ',';
+    w += cur.formatter.format(r.ts, w, cur.timeFormat);
+    *w++ = ',';
+    memcpy(w, name, nameLen);
+    w += nameLen;
+    *w++ = ',';
+    w += formatScaled(w, r.t, 2);
+    *w++ = ',';
+    w += formatScaled(w, r.h, 2);
+    *w++ = '\n';
+  } else {
+    w += formatStr(w, "{\"seq\":");
+    w += formatUint(w, r.seq);
+    w += formatStr(w, ",\"ts\":");
+    w += formatUint(w, r.ts);
+    w += formatStr(w, ",\"time\":\"");
+    w += cur.formatter.format(r.ts, w, cur.timeFormat);
+    w += formatStr(w, "\",\"channel\":\"");
+    memcpy(w, name, nameLen);
+    w += nameLen;
+    w += formatStr(w, "\",\"t\":");
+    w += formatScaled(w, r.t, 2);
+    w += formatStr(w, ",\"h\":");
+    w += formatScaled(w, r.h, 2);
+    w += formatStr(w, "}\n");
+  }
+  cur.lineLen = w - cur.line;
+  cur.linePos = 0;
+  cur.afterSeq = r.seq;
+  cur.rows++;
+  return true;
+}
+
+void handleOutageReplay(AsyncWebServerRequest *req) {
+  std::shared_ptr<ReplayCursor> cur(new (std::nothrow) ReplayCursor());
+  if (!cur) {
+    req->send(503, "application/json", "{\"error\":\"out of memory\"}");
+    return;
+  }
+  cur->format = EXPORT_NDJSON;
+  if (req->hasParam("format")) {
+    const String &format = req->getParam("format")->value();
+    if (format == "csv") {
+      cur->format = EXPORT_CSV;
+    } else if (format != "ndjson") {
+      req->send(400, "application/json", "{\"error\":\"format must be csv or ndjson\"}");
+      return;
+    }
+  }
+  cur->timeFormat = req->hasParam("time") ? parseTimeFormat(req) : TimeFormat::Iso8601;
+  cur->afterSeq = 0;
+  cur->limit = UINT32_MAX;
+  if (req->hasParam("after") && !parseUint(req->getParam("after")->value().c_str(), cur->afterSeq)) {
+    req->send(400, "application/json", "{\"error\":\"after must be a number\"}");
+    return;
+  }
+  if (req->hasParam("limit") && !parseUint(req->getParam("limit")->value().c_str(), cur->limit)) {
+    req->send(400, "application/json", "{\"error\":\"limit must be a number\"}");
+    return;
+  }
+  
+  bool csv = cur->format == EXPORT_CSV;
+  AsyncWebServerResponse *response = req->beginChunkedResponse(
+      csv ? "text/csv" : "application/x-ndjson",
+      [cur](uint8_t *buf, size_t maxLen, size_t index) -> size_t { return fillLines(*cur, nextReplayLine, buf, maxLen); });
+  req->send(response);
+}
+
+// OpenMetrics exposition for Prometheus. Rendered straight from the live
+// state into one static buffer (no JSON document, no String); the buffer is
+// held until the response has been sent, concurrent scrapes get a 503.
+char metricsBuffer[METRICS_BUFFER_SIZE];
+size_t metricsLength = 0;
+bool metricsBusy = false;                 // Only touched on the AsyncTCP task
+uint32_t metricsBusySince = 0;
+uint32_t metricsRenderUs = 0;             // Render time of the previous scrape
+
+enum WindowMetric { WINDOW_MEAN, WINDOW_STDDEV, WINDOW_MIN, WINDOW_MAX, WINDOW_RATE };
+
+template <size_t N>
+void addWindowMetric(MetricsWriter &w, const char *name, WindowMetric which,
+                     const char *window, RollingStats<N> Channel::*member) {
+  for (const Channel &ch : channels) {
+    const RollingStats<N> &stats = ch.*member;
+    for (int q = 0; q < 2; q++) {
+      StatQuantity sq = q ? STAT_H : STAT_T;
+      float v;
+      switch (which) {
+        case WINDOW_MEAN: v = stats.mean(sq); break;
+        case WINDOW_STDDEV: v = stats.empty() ? NAN : sqrtf(stats.variance(sq)); break;
+        case WINDOW_MIN: v = stats.minimum(sq); break;
+        case WINDOW_MAX: v = stats.maximum(sq); break;
+        default: v = stats.empty() ? NAN : stats.slopePerMin(sq); break;
+      }
+      w.sample(name).label("channel", ch.cfg->name).label("window", window)
+       .label("quantity", q ? "humidity" : "temperature").value(v);
+    }
+  }
+}
+
+void addWindowFamily(MetricsWriter &w, const char *name, const char *help, WindowMetric which) {
+  w.family(name, "gauge", help);
+  addWindowMetric(w, name, which, "recent", &Channel::recent);
+  addWindowMetric(w, name, which, "hourly", &Channel::hourly);
+}
+
+void renderMetrics(MetricsWriter &w) {
+  w.family("thlogger_temperature_celsius", "gauge", "Latest temperature sample");
+  for (const Channel &ch : channels) {
+    if (ch.detailed.empty()) continue;
+    w.sample("thlogger_temperature_celsius").label("channel", ch.cfg->name).value(ch.detailed.t[ch.detailed.newest()]);
+  }
+  w.family("thlogger_humidity_percent", "gauge", "Latest relative humidity sample");
+  for (const Channel &ch : channels) {
+    if (ch.detailed.empty()) continue;
+    w.sample("thlogger_humidity_percent").label("channel", ch.cfg->name).value(ch.detailed.h[ch.detailed.newest()]);
+  }
+  w.family("thlogger_dew_point_celsius", "gauge", "Dew point of the latest sample");
+  for (const Channel &ch : channels) {
+    if (ch.detailed.empty()) continue;
+    size_t last = ch.detailed.newest();
+    w.sample("thlogger_dew_point_celsius").label("channel", ch.cfg->name).value(dewPoint(ch.detailed.t[last], ch.detailed.h[last]));
+  }
+  w.family("thlogger_sample_timestamp_seconds", "gauge", "Timestamp of the latest sample");
+  for (const Channel &ch : channels) {
+    if (ch.detailed.empty()) continue;
+    w.sample("thlogger_sample_timestamp_seconds").label("channel", ch.cfg->name).value(ch.detailed.ts[ch.detailed.newest()]);
+  }
+  
+  // Rolling statistics: "recent" over detailed samples, "hourly" over 5-minute means
+  addWindowFamily(w, "thlogger_window_mean", "Rolling mean", WINDOW_MEAN);
+  addWindowFamily(w, "thlogger_window_stddev", "Rolling standard deviation", WINDOW_STDDEV);
+  addWindowFamily(w, "thlogger_window_min", "Rolling minimum", WINDOW_MIN);
+  addWindowFamily(w, "thlogger_window_max", "Rolling maximum", WINDOW_MAX);
+  addWindowFamily(w, "thlogger_window_rate_per_minute", "Rolling rate of change per minute", WINDOW_RATE);
+  
+  w.family("thlogger_samples", "counter", "Samples stored since boot");
+  for (const Channel &ch : channels) {
+    w.sample("thlogger_samples", "_total").label("channel", ch.cfg->name).value(ch.totalSamples);
+  }
+  w.family("thlogger_missed_slots", "counter", "Sample slots missed since boot");
+  for (const Channel &ch : channels) {
+    w.sample("thlogger_missed_slots", "_total").label("channel", ch.cfg->name).value(ch.totalMissedSlots);
+  }
+  w.family("thlogger_rejected_readings", "counter", "Readings dropped as invalid or outlier since boot");
+  for (const Channel &ch : channels) {
+    w.sample("thlogger_rejected_readings", "_total").label("channel", ch.cfg->name).value(ch.totalRejected);
+  }
+  w.family("thlogger_sample_jitter_milliseconds", "gauge", "Slot jitter of the latest sample");
+  for (const Channel &ch : channels) {
+    w.sample("thlogger_sample_jitter_milliseconds").label("channel", ch.cfg->name).value(ch.lastJitterMs);
+  }
+  w.family("thlogger_buffer_entries", "gauge", "Samples held in RAM");
+  for (const Channel &ch : channels) {
+    w.sample("thlogger_buffer_entries").label("channel", ch.cfg->name).label("tier", "detailed").value((uint32_t)ch.detailed.size());
+    w.sample("thlogger_buffer_entries").label("channel", ch.cfg->name).label("tier", "aggregated").value((uint32_t)ch.aggregated.size());
+  }
+  w.family("thlogger_buffer_capacity", "gauge", "Sample capacity of the RAM tiers");
+  w.sample("thlogger_buffer_capacity").label("tier", "detailed").value((uint32_t)MAX_DETAILED_SAMPLES);
+  w.sample("thlogger_buffer_capacity").label("tier", "aggregated").value((uint32_t)MAX_AGGREGATE_SAMPLES);
+  
+  // Copy the rule table so the mutex is not held while formatting
+  AlertRule rules[MAX_ALERT_RULES];
+  AlertState states[MAX_ALERT_RULES];
+  xSemaphoreTake(alertMutex, portMAX_DELAY);
+  memcpy(rules, alertRules, sizeof(rules));
+  memcpy(states, alertStates, sizeof(states));
+  xSemaphoreGive(alertMutex);
+  w.family("thlogger_alert_active", "gauge", "Alert rule condition active");
+  for (uint8_t i = 0; i < MAX_ALERT_RULES; i++) {
+    if (!rules[i].used) continue;
+    w.sample("thlogger_alert_active").label("rule", i).label("name", rules[i].name)
+     .label("channel", channelName(rules[i].channel)).value(states[i].active);
+  }
+  w.family("thlogger_alert_acknowledged", "gauge", "Active alert acknowledged");
+  for (uint8_t i = 0; i < MAX_ALERT_RULES; i++) {
+    if (!rules[i].used) continue;
+    w.sample("thlogger_alert_acknowledged").label("rule", i).label("name", rules[i].name)
+     .label("channel", channelName(rules[i].channel)).value(states[i].acknowledged);
+  }
+  
+  // Plain counters owned by other tasks; a stale read is harmless
+  w.family("thlogger_notify_pending", "gauge", "Alert notifications waiting for delivery");
+  w.sample("thlogger_notify_pending").value((uint32_t)notifyQueue.size());
+  w.family("thlogger_telemetry_queued", "gauge", "Telemetry records staged in RAM");
+  w.sample("thlogger_telemetry_queued").value((uint32_t)telemetryQueue.size());
+  w.family("thlogger_telemetry_backlog", "gauge", "Telemetry records waiting in the flash backlog");
+  w.sample("thlogger_telemetry_backlog").value((uint32_t)telemetryLog.pending());
+  
+  w.family("thlogger_storage_mounted", "gauge", "Filesystem mounted");
+  w.sample("thlogger_storage_mounted").value(storageStatus.mounted);
+  w.family("thlogger_storage_used_bytes", "gauge", "Filesystem bytes in use");
+  w.sample("thlogger_storage_used_bytes").value((uint32_t)storageStatus.usedBytes);
+  w.family("thlogger_storage_total_bytes", "gauge", "Filesystem capacity");
+  w.sample("thlogger_storage_total_bytes").value((uint32_t)storageStatus.totalBytes);
+  w.family("thlogger_storage_write_errors", "counter", "Failed flash writes since boot");
+  w.sample("thlogger_storage_write_errors", "_total").value(storageStatus.writeErrors);
+  w.family("thlogger_storage_last_write_microseconds", "gauge", "Duration of the last flash write");
+  w.sample("thlogger_storage_last_write_microseconds").value(storageStatus.lastWriteUs);
+  
+  w.family("thlogger_heap_free_bytes", "gauge", "Free heap");
+  w.sample("thlogger_heap_free_bytes").value((uint32_t)ESP.getFreeHeap());
+  w.family("thlogger_heap_min_free_bytes", "gauge", "Lowest free heap since boot");
+  w.sample("thlogger_heap_min_free_bytes").value((uint32_t)ESP.getMinFreeHeap());
+  w.family("thlogger_emergency_mode", "gauge", "Emergency aggregation active");
+  w.sample("thlogger_emergency_mode").value(emergencyMode);
+  w.family("thlogger_uptime_seconds", "gauge", "Seconds since boot");
+  w.sample("thlogger_uptime_seconds").value((uint32_t)(millis() / 1000));
+  w.family("thlogger_metrics_render_microseconds", "gauge", "Render time of the previous scrape");
+  w.sample("thlogger_metrics_render_microseconds").value(metricsRenderUs);
+  w.eof();
+}
+
+void handleMetrics(AsyncWebServerRequest *req) {
+  if (metricsBusy && millis() - metricsBusySince < METRICS_BUSY_TIMEOUT_MS) {
+    req->send(503, "text/plain", "scrape in progress\n");
+    return;
+  }
+  uint32_t start = micros();
+  MetricsWriter w(metricsBuffer, sizeof(metricsBuffer));
+  renderMetrics(w);
+  metricsRenderUs = micros() - start;
+  if (w.overflowed()) {
+    LOGW("⚠️ /metrics output truncated at %u bytes\n", (unsigned)w.length());
+  }
+  metricsLength = w.length();
+  metricsBusy = true;
+  metricsBusySince = millis();
+  
+  // The filler runs on the AsyncTCP task as the socket drains
+  AsyncWebServerResponse *response = req->beginResponse(
+      "application/openmetrics-text; version=1.0.0; charset=utf-8", metricsLength,
+      [](uint8_t *buf, size_t maxLen, size_t index) -> size_t {
+        size_t n = metricsLength - index;
+        if (n > maxLen) n = maxLen;
+        memcpy(buf, metricsBuffer + index, n);
+        if (index + n >= metricsLength) metricsBusy = false;
+        return n;
+      });
+  req->send(response);
+}
+
+// ---------- Logging ----------
+// logTask() is the ring's only consumer: it prints every entry and keeps
+// the last LOG_RECENT for /api/logs (entries stay binary until rendered).
+LogEntry logRecent[LOG_RECENT];
+size_t logRecentNext = 0;
+size_t logRecentCount = 0;
+SemaphoreHandle_t logRecentMutex = nullptr;
+TaskHandle_t logTaskHandle = nullptr;
+
+void logTask(void *) {
+  LogEntry e;
+  char text[LOG_TEXT_MAX];
+  uint32_t droppedReported = 0;
+  for (;;) {
+    while (logRing.read(e)) {
+      size_t n = renderLogMessage(e, text, sizeof(text));
+      Serial.write((const uint8_t *)text, n);
+      xSemaphoreTake(logRecentMutex, portMAX_DELAY);
+      logRecent[logRecentNext] = e;
+      logRecentNext = (logRecentNext + 1) % LOG_RECENT;
+      if (logRecentCount < LOG_RECENT) logRecentCount++;
+      xSemaphoreGive(logRecentMutex);
+    }
+    uint32_t dropped = logRing.dropped();
+    if (dropped != droppedReported) {
+      Serial.printf("⚠️ Log ring full - %u entries dropped\n", (unsigned)(dropped - droppedReported));
+      droppedReported = dropped;
+    }
+    vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_MS));
+  }
+}
+
+// Lowest priority above idle, on the core without the sampler
+void startLogging() {
+  logRecentMutex = xSemaphoreCreateMutex();
+  xTaskCreatePinnedToCore(logTask, "log", 3072, nullptr, 1, &logTaskHandle, 0);
+}
+
+enum LogFormat : uint8_t { LOG_FORMAT_TEXT, LOG_FORMAT_NDJSON, LOG_FORMAT_BINARY };
+enum LogDumpStage : uint8_t { LOG_STAGE_HEADER, LOG_STAGE_FORMATS, LOG_STAGE_ENTRIES };
+
+// /api/logs works on a copy of the recent entries, so the drain task is
+// never held up by a slow client
+struct LogCursor {
+  char line[2 * LOG_TEXT_MAX + 96];       // Text, escaped JSON or one binary record
+  size_t lineLen;
+  size_t linePos;
+  size_t bytes;
+  LogFormat format;
+  LogDumpStage stage;
+  size_t count;
+  size_t pos;
+  size_t formatCount;
+  uint32_t dropped;
+  LogEntry entries[LOG_RECENT];
+  uint16_t formatIndex[LOG_RECENT];
+  const char *formats[LOG_RECENT];
+};
+
+bool nextLogLine(LogCursor &cur) {
+  cur.linePos = 0;
+  if (cur.format == LOG_FORMAT_BINARY) {
+    uint8_t *out = (uint8_t *)cur.line;
+    if (cur.stage == LOG_STAGE_HEADER) {
+      cur.lineLen = encodeLogDumpHeader(out, cur.count, cur.formatCount, cur.dropped);
+      cur.stage = LOG_STAGE_FORMATS;
+      cur.pos = 0;
+      return true;
+    }
+    if (cur.stage == LOG_STAGE_FORMATS) {
+      if (cur.pos < cur.formatCount) {
+        cur.lineLen = encodeLogDumpFormat(out, cur.formats[cur.pos++]);
+        return true;
+      }
+      cur.stage = LOG_STAGE_ENTRIES;
+      cur.pos = 0;
+    }
+    if (cur.pos >= cur.count) return false;
+    cur.lineLen = encodeLogDumpEntry(out, cur.entries[cur.pos], cur.formatIndex[cur.pos]);
+    cur.pos++;
+    return true;
+  }
+
+  if (cur.pos >= cur.count) return false;
+  const LogEntry &e = cur.entries[cur.pos++];
+  char text[LOG_TEXT_MAX];
+  size_t n = renderLogMessage(e, text, sizeof(text));
+  if (n > 0 && text[n - 1] == '\n') n--;
+  char *w = cur.line;
+  if (cur.format == LOG_FORMAT_TEXT) {
+    w += formatUint(w, e.ms);
+    *w++ = ' ';
+    w += formatStr(w, logLevelName(e.level));
+    *w++ = ' ';
+    memcpy(w, text, n);
+    w += n;
+  } else {
+    w += formatStr(w, "{\"seq\":");
+    w += formatUint(w, e.seq);
+    w += formatStr(w, ",\"ms\":");
+    w += formatUint(w, e.ms);
+    w += formatStr(w, ",\"level\":\"");
+    w += formatStr(w, logLevelName(e.level));
+    w += formatStr(w, "\",\"msg\":\"");
+    for (size_t i = 0; i < n; i++) {
+      char c = text[i];
+      if (c == '"' || c == '\\') {
+        *w++ = '\\';
+        *w++ = c;
+      } else if (c == '\n') {
+        *w++ = '\\';
+        *w++ = 'n';
+      } else if ((uint8_t)c >= 0x20) {
+        *w++ = c;
+      }
+    }
+    w += formatStr(w, "\"}");
+  }
+  *w++ = '\n';
+  cur.lineLen = w - cur.line;
+  return true;
+}
+
+void handleLogs(AsyncWebServerRequest *req) {
+  std::shared_ptr<LogCursor> cur(new (std::nothrow) LogCursor());
+  if (!cur) {
+    req->send(503, "application/json", "{\"error\":\"out of memory\"}");
+    return;
+  }
+  cur->format = LOG_FORMAT_TEXT;
+  if (req->hasParam("format")) {
+    const String &format = req->getParam("format")->value();
+    if (format == "ndjson") {
+      cur->format = LOG_FORMAT_NDJSON;
+    } else if (format == "bin") {
+      cur->format = LOG_FORMAT_BINARY;
+    } else if (format != "text") {
+      req->send(400, "application/json", "{\"error\":\"format must be text, ndjson or bin\"}");
+      return;
+    }
+  }
+  uint32_t limit = LOG_RECENT;
+  if (req->hasParam("n") && !parseUint(req->getParam("n")->value().c_str(), limit)) {
+    req->send(400, "application/json", "{\"error\":\"n must be a number\"}");
+    return;
+  }
+  uint8_t maxLevel = (uint8_t)LogLevel::Debug;
+  if (req->hasParam("level")) {
+    const String &level = req->getParam("level")->value();
+    maxLevel = 0;
+    for (uint8_t l = (uint8_t)LogLevel::Error; l <= (uint8_t)LogLevel::Debug; l++) {
+      if (level == logLevelName(l)) maxLevel = l;
+    }
+    if (maxLevel == 0) {
+      req->send(400, "application/json", "{\"error\":\"level must be error, warn, info or debug\"}");
+      return;
+    }
+  }
+
+  // Newest `limit` entries at or below the level, oldest first
+  xSemaphoreTake(logRecentMutex, portMAX_DELAY);
+  size_t matching = 0;
+  for (size_t i = 0; i < logRecentCount; i++) {
+    if (logRecent[(logRecentNext + LOG_RECENT - 1 - i) % LOG_RECENT].level <= maxLevel) matching++;
+  }
+  size_t skip = matching > limit ? matching - limit : 0;
+  for (size_t i = 0; i < logRecentCount; i++) {
+    const LogEntry &e = logRecent[(logRecentNext + LOG_RECENT - logRecentCount + i) % LOG_RECENT];
+    if (e.level > maxLevel) continue;
+    if (skip > 0) {
+      skip--;
+      continue;
+    }
+    cur->entries[cur->count++] = e;
+  }
+  xSemaphoreGive(logRecentMutex);
+  cur->dropped = logRing.dropped();
+
+  // Binary dumps carry each format text once
+  for (size_t i = 0; i < cur->count; i++) {
+    size_t f = 0;
+    while (f < cur->formatCount && cur->formats[f] != cur->entries[i].fmt) f++;
+    if (f == cur->formatCount) cur->formats[cur->formatCount++] = cur->entries[i].fmt;
+    cur->formatIndex[i] = f;
+  }
+
+  const char *type = cur->format == LOG_FORMAT_BINARY ? "application/octet-stream"
+                   : cur->format == LOG_FORMAT_NDJSON ? "application/x-ndjson"
+                                                      : "text/plain; charset=utf-8";
+  AsyncWebServerResponse *response = req->beginChunkedResponse(
+      type, [cur](uint8_t *buf, size_t maxLen, size_t index) -> size_t { return fillLines(*cur, nextLogLine, buf, maxLen); });
+  req->send(response);
 }
 
 void handleRoot(AsyncWebServerRequest *req) {
@@ -789,143 +4243,328 @@ void handleRoot(AsyncWebServerRequest *req) {
   req->send(200, "text/html", html);
 }
 
+// Driver objects are created once at boot and never freed
+SensorDriver *createSensorDriver(size_t c) {
+  const SensorConfig &cfg = SENSORS[c];
+#ifdef SIMULATED_SENSORS
+  return new SimulatedSensor(c + 1, cfg.intervalMs);
+#else
+  switch (cfg.type) {
+    case SENSOR_DHT11: return new DhtSensor(cfg.pin, DHT11);
+    case SENSOR_DHT22: return new DhtSensor(cfg.pin, DHT22);
+    case SENSOR_SHT3X: return new Sht3xSensor(cfg.pin);
+    default:           return new SimulatedSensor(c + 1, cfg.intervalMs);
+  }
+#endif
+}
+
+void initChannels() {
+  bool i2cStarted = false;
+  uint32_t stagger = 0;
+  
+  for (size_t c = 0; c < CHANNEL_COUNT; c++) {
+    Channel &ch = channels[c];
+    ch.cfg = &SENSORS[c];
+    ch.intervalMs = ch.cfg->intervalMs;
+    ch.staggerMs = stagger % ch.intervalMs;
+    ch.slotsPerBucket = AGGREGATE_INTERVAL_SEC * 1000 / ch.intervalMs;
+    ch.detailedLimit = DETAILED_PERIOD_SEC * 1000 / ch.intervalMs;
+    ch.recent.setWindow(ANALYTICS_WINDOW_SEC);
+    ch.hourly.setWindow(ANALYTICS_LONG_SEC);
+    stagger += minSampleMs() / CHANNEL_COUNT;
+    
+#ifndef SIMULATED_SENSORS
+    if (ch.cfg->type == SENSOR_SHT3X && !i2cStarted) {
+      Wire.begin(I2C_SDA_PIN, I2C_SCL_PIN);
+      Wire.setClock(400000);
+      i2cStarted = true;
+    }
+#endif
+    
+    ch.driver = createSensorDriver(c);
+    bool ok = ch.driver->begin();
+    ch.readyAtMs = millis() + ch.driver->warmupMs();
+    
+    // Readings of a burst are spaced by the sensor minimum and must fit the slot
+    ch.burstSpacingMs = ch.driver->minIntervalMs();
+    uint32_t fit = (ch.intervalMs - ch.intervalMs / 4) / ch.burstSpacingMs + 1;
+    ch.burstTarget = ch.cfg->oversample < fit ? ch.cfg->oversample : fit;
+    
+    Serial.printf("%s %s sensor '%s' (pin/addr %d, every %d s, %dx oversampling)\n", ok ? "✅" : "❌",
+                  ch.driver->model(), ch.cfg->name, ch.cfg->pin, ch.intervalMs / 1000, ch.burstTarget);
+  }
+  (void)i2cStarted;
+}
+
+#ifdef INGEST_BENCHMARK
+// Storage/rollup throughput: one simulated day at 1 Hz (30x the DHT11 rate)
+// through a detailed ring, the bucket accumulator and an aggregated ring.
+// Reports time per sample and heap change (must be 0) on the serial console.
+void runIngestBenchmark() {
+  static SampleRing<1800> detailed;
+  static SampleRing<MAX_AGGREGATE_SAMPLES> aggregated;
+  BucketAccumulator bucket;
+  SimulatedSensor sim(42, 1000);
+  constexpr uint32_t SAMPLES = 86400;
+  
+  uint32_t heapBefore = ESP.getFreeHeap();
+  uint32_t start = micros();
+  for (uint32_t ts = 0; ts < SAMPLES; ts++) {
+    float t, h;
+    sim.read(t, h);
+    if (bucket.n > 0 && ts / AGGREGATE_INTERVAL_SEC != bucket.bucketTs / AGGREGATE_INTERVAL_SEC) {
+      aggregated.push(bucket.bucketTs, bucket.sumT / bucket.n, bucket.sumH / bucket.n, bucket.n, 0, bucket.maxJitterMs);
+      bucket.reset(0);
+    }
+    detailed.push(ts, t, h, 1, 0, 0);
+    if (bucket.n == 0) bucket.reset((ts / AGGREGATE_INTERVAL_SEC) * AGGREGATE_INTERVAL_SEC);
+    bucket.add(t, h, 0);
+  }
+  uint32_t elapsed = micros() - start;
+  int32_t heapDelta = (int32_t)ESP.getFreeHeap() - (int32_t)heapBefore;
+  
+  Serial.printf("📈 Ingest benchmark: %d samples in %d us (%d ns/sample), %d aggregates, heap delta %d bytes\n",
+                SAMPLES, elapsed, (uint32_t)((uint64_t)elapsed * 1000 / SAMPLES), aggregated.size(), heapDelta);
+}
+#endif
+
+#ifdef STORAGE_BENCHMARK
+// Flash latency of the persistence paths on this unit: mount, one-record
+// appends (a closed aggregate) and 32 KB full-file rewrites (the hourly
+// history save), on the filesystem backend and on the raw log partition.
+// Build env:bench-littlefs and env:bench-spiffs to compare the backends.
+// Writes a scratch file (removed afterwards) and erases the raw partition.
+struct LatencyStats {
+  uint32_t n, totalUs, maxUs;
+  void add(uint32_t us) {
+    n++;
+    totalUs += us;
+    if (us > maxUs) maxUs = us;
+  }
+};
+
+void printLatency(const char *backend, const char *op, const LatencyStats &s) {
+  Serial.printf("   %-9s %-8s avg %7u us  max %7u us  (%u runs)\n",
+                backend, op, s.n ? s.totalUs / s.n : 0, s.maxUs, s.n);
+}
+
+void runStorageBenchmark() {
+  constexpr int MOUNTS = 3, APPENDS = 200, REWRITES = 5;
+  constexpr size_t REWRITE_BYTES = 32 * 1024;
+  const char *BENCH_FILE = "/bench.bin";
+  static HistoryRecord block[64];
+  for (size_t i = 0; i < 64; i++) block[i] = {1700000000u + (uint32_t)i * 300, 21.5f, 48.0f, 10, 0, 0, 0, 0};
+  
+  Serial.println("📊 Storage benchmark:");
+  LatencyStats mount = {}, append = {}, rewrite = {};
+  bool mounted = true;
+  for (int i = 0; i < MOUNTS && mounted; i++) {
+    storageBackend.unmount();
+    uint32_t t = micros();
+    mounted = storageBackend.mount();
+    mount.add(micros() - t);
+  }
+  if (mounted) {
+    for (int i = 0; i < APPENDS; i++) {
+      uint32_t t = micros();
+      File f = storageFs.open(BENCH_FILE, "a");
+      f.write((const uint8_t *)&block[i % 64], sizeof(HistoryRecord));
+      f.close();
+      append.add(micros() - t);
+    }
+    for (int i = 0; i < REWRITES; i++) {
+      uint32_t t = micros();
+      File f = storageFs.open(BENCH_FILE, "w");
+      for (size_t done = 0; done < REWRITE_BYTES; done += sizeof(block)) {
+        f.write((const uint8_t *)block, sizeof(block));
+      }
+      f.close();
+      rewrite.add(micros() - t);
+    }
+    storageFs.remove(BENCH_FILE);
+  } else {
+    storageStatus.mounted = false;
+    Serial.printf("   %s remount failed - filesystem results incomplete\n", storageBackend.name());
+  }
+  printLatency(storageBackend.name(), "mount", mount);
+  printLatency(storageBackend.name(), "append", append);
+  printLatency(storageBackend.name(), "rewrite", rewrite);
+  
+  PartitionRegion region(RAW_LOG_PARTITION);
+  if (!region.begin()) {
+    Serial.printf("   No \"%s\" partition - raw log skipped\n", RAW_LOG_PARTITION);
+    return;
+  }
+  RawLog<HistoryRecord> log(region);
+  LatencyStats rawMount = {}, rawAppend = {}, rawRewrite = {};
+  log.mount();
+  log.clear();
+  for (int i = 0; i < APPENDS; i++) {
+    uint32_t t = micros();
+    log.append(block[i % 64]);
+    rawAppend.add(micros() - t);
+  }
+  for (int i = 0; i < MOUNTS; i++) {
+    uint32_t t = micros();
+    log.mount();
+    rawMount.add(micros() - t);
+  }
+  // A rewrite is erase + append of the same volume
+  for (int i = 0; i < REWRITES; i++) {
+    uint32_t t = micros();
+    log.clear();
+    for (size_t done = 0; done < REWRITE_BYTES; done += sizeof(block)) log.append(block, 64);
+    rawRewrite.add(micros() - t);
+  }
+  log.clear();
+  printLatency("rawlog", "mount", rawMount);
+  printLatency("rawlog", "append", rawAppend);
+  printLatency("rawlog", "rewrite", rawRewrite);
+}
+#endif
+
 void setup() {
   Serial.begin(115200);
   delay(1000);
+  startLogging();
   
   Serial.println("ESP32 Temperature/Humidity Logger Starting...");
   
-  // Initialize DHT sensor
-  dht.begin();
-  Serial.println("DHT11 sensor initialized on GPIO4");
+  // Initialize the sensor driver of every channel
+  initChannels();
+  
+#ifdef INGEST_BENCHMARK
+  runIngestBenchmark();
+#endif
   
-  // Initialize SPIFFS for persistent data storage
-  if (!SPIFFS.begin(true)) {
-    Serial.println("❌ SPIFFS initialization failed - no persistent storage available");
+  // Built-in alert rules until the stored table is loaded
+  alertMutex = xSemaphoreCreateMutex();
+  notifyMutex = xSemaphoreCreateMutex();
+  telemetryMutex = xSemaphoreCreateMutex();
+  journalMutex = xSemaphoreCreateMutex();
+  storageMutex = xSemaphoreCreateMutex();
+  aggMutex = xSemaphoreCreateMutex();
+  setDefaultAlertRules();
+  rebuildAlertIndex();
+  
+  // Mount the filesystem once; a failure never formats (and wipes) the partition
+  if (!storageMount()) {
+    Serial.println("❌ Storage mount failed - no persistent storage, retrying in the background");
   } else {
-    Serial.println("✅ SPIFFS initialized - persistent storage ready");
-    
-    // Load previous data and configuration
-    loadFromPersistentStorage();
+    Serial.printf("✅ Storage (%s) mounted in %u us - %u of %u KB used\n", storageBackend.name(),
+                  storageStatus.mountUs, storageStatus.usedBytes / 1024, storageStatus.totalBytes / 1024);
+#ifdef STORAGE_BENCHMARK
+    runStorageBenchmark();
+#endif
+    onStorageMounted();
     
-    // Initialize memory tracking
+    // Initialize memory tracking (boot clock until NTP syncs)
     lastMemoryCheck = millis();
-    lastSPIFFSSave = getCurrentTimestamp();
+    lastStorageSave = millis() / 1000;
     
     Serial.printf("💾 Memory usage at startup: %d%% (%d KB free)\n", 
                   getMemoryUsagePercent(), ESP.getFreeHeap() / 1024);
   }
   
-  // Network initialization with discovery features
-  Serial.println("Connecting to network...");
+  // Closed aggregates are committed to the raw log partition, independent of the filesystem
+  beginAggregateLog();
+  beginEmergencySnapshot();
+  if (aggLogReady || snapshotReady) esp_register_shutdown_handler(onShutdownCommit);
+  
+  // Network initialization - links come up in the background
+  startNetwork();
   blinkStatusLED(2, 500); // 2 blinks = trying to connect
   
-  if (USE_ETH) {
-    Serial.println("Initializing Ethernet...");
-    ETH.begin();
-    
-    // Wait for Ethernet connection
-    int eth_timeout = 0;
-    while (ETH.linkUp() == false && eth_timeout < 20) {
-      delay(1000);
-      eth_timeout++;
-      Serial.print(".");
-    }
-    
-    if (ETH.linkUp()) {
-      Serial.println("\nEthernet connected!");
-      isConnected = true;
-      setupNetworkDiscovery();
-      printNetworkInfo();
-    } else {
-      Serial.println("\nEthernet failed, falling back to WiFi");
-      WiFi.setHostname(HOSTNAME);
-      WiFi.begin(SSID, PASS);
-      while (WiFi.status() != WL_CONNECTED) {
-        delay(1000);
-        Serial.print(".");
-      }
-      Serial.println("\nWiFi connected!");
-      isConnected = true;
-      setupNetworkDiscovery();
-      printNetworkInfo();
-    }
-  } else {
-    Serial.println("Using WiFi only...");
-    WiFi.setHostname(HOSTNAME);
-    WiFi.begin(SSID, PASS);
-    while (WiFi.status() != WL_CONNECTED) {
-      delay(1000);
-      Serial.print(".");
-    }
-    Serial.println("\nWiFi connected!");
-    isConnected = true;
-    setupNetworkDiscovery();
-    printNetworkInfo();
-  }
+  // Configuration writes never block a web handler or loop()
+  xTaskCreatePinnedToCore(configTask, "config", 4096, nullptr, 1, &configTaskHandle, 0);
+  
+  // Second core for large /api/history responses (the web server runs on core 1)
+  historyWorkerMutex = xSemaphoreCreateMutex();
+  historyJobDone = xSemaphoreCreateBinary();
+  xTaskCreatePinnedToCore(historyWorkerTask, "histfmt", 4096, nullptr, 2, &historyWorkerHandle, 0);
   
-  // Setup NTP time synchronization
-  setupNTP();
+  // Alert and telemetry delivery run on their own task so network timeouts never stall loop()
+  if (notifyTransportConfigured()) {
+    xTaskCreatePinnedToCore(uplinkTask, "uplink", 8192, nullptr, 1, &uplinkTaskHandle, 0);
+  }
   
   // Setup web server routes
   server.on("/", HTTP_GET, handleRoot);
   server.on("/api/current", HTTP_GET, handleCurrent);
   server.on("/api/history", HTTP_GET, handleHistory);
+  server.on("/api/export", HTTP_GET, handleExport);
   server.on("/api/alert/get", HTTP_GET, handleGetAlert);
   server.on("/api/alert/set", HTTP_POST, handleSetAlert);
   server.on("/api/alert/acknowledge", HTTP_POST, handleAckAlert);
   server.on("/api/humidity-alert/get", HTTP_GET, handleGetHumidityAlert);
   server.on("/api/humidity-alert/set", HTTP_POST, handleSetHumidityAlert);
   server.on("/api/humidity-alert/acknowledge", HTTP_POST, handleAckHumidityAlert);
+  server.on("/api/alerts/add", HTTP_POST, handleAddAlert);
+  server.on("/api/alerts/update", HTTP_POST, handleUpdateAlert);
+  server.on("/api/alerts/delete", HTTP_POST, handleDeleteAlert);
+  server.on("/api/alerts/ack", HTTP_POST, handleAckRule);
+  server.on("/api/alerts", HTTP_GET, handleListAlerts);
+  server.on("/api/notify", HTTP_GET, handleNotifyStatus);
+  server.on("/api/telemetry", HTTP_GET, handleTelemetryStatus);
+  server.on("/api/outage/replay", HTTP_GET, handleOutageReplay);
+  server.on("/api/outage/ack", HTTP_POST, handleOutageAck);
+  server.on("/api/outage", HTTP_GET, handleOutageStatus);
+  server.on("/api/storage/format", HTTP_POST, handleStorageFormat);
+  server.on("/api/storage", HTTP_GET, handleStorageStatus);
+  server.on("/metrics", HTTP_GET, handleMetrics);
+  server.on("/api/logs", HTTP_GET, handleLogs);
+  server.on("/api/settings", HTTP_GET, handleGetSettings);
+  server.on("/api/settings", HTTP_POST, handleSetSettings);
   server.on("/api/save", HTTP_POST, handleSaveData);
   
   // Start server
   server.begin();
-  Serial.println("Web server started");
-  
-  // Initial sensor reading
-  delay(2000);  // DHT needs time to stabilize
-  float t = dht.readTemperature();
-  float h = dht.readHumidity();
-  addReading(t, h);
+  bootToHttpReadyMs = millis();
+  Serial.printf("Web server started (%d ms after boot)\n", bootToHttpReadyMs);
   
-  Serial.println("Setup complete!");
+  // The first sample is taken from loop() once the sensors have warmed up
+  // (DHT: 2 s after begin), late in its slot rather than by waiting here
+  Serial.printf("Setup complete (%d ms after boot)\n", millis());
 }
 
 void loop() {
-  // Check network status periodically
-  if (millis() - lastNetworkCheck >= NETWORK_CHECK_MS) {
-    lastNetworkCheck = millis();
-    checkNetworkStatus();
-  }
+  // React to link changes reported by the network event callbacks
+  checkNetworkStatus();
+  checkTimeSync();
   
   // Check memory usage periodically (every 30 seconds)
   if (millis() - lastMemoryCheck >= 30000) {
     lastMemoryCheck = millis();
     checkMemoryUsage();
     
-    // Log memory status periodically
-    Serial.printf("📊 Memory: %d%% used (%d KB free), Buffers: %d detailed + %d aggregated\n",
-                  getMemoryUsagePercent(), ESP.getFreeHeap() / 1024, 
-                  detailedBuffer.size(), aggregatedBuffer.size());
+    // Log memory status now and then (/metrics has it continuously)
+    LOG_EVERY(LOG_REPEAT_MS, LOGI("📊 Memory: %d%% used (%d KB free), Buffers: %d detailed + %d aggregated (channel 0)\n",
+                                  getMemoryUsagePercent(), ESP.getFreeHeap() / 1024,
+                                  channels[0].detailed.size(), channels[0].aggregated.size()));
   }
   
-  // Take sensor readings
-  if (millis() - lastSample >= SAMPLE_MS) {
-    lastSample = millis();
-    
-    Serial.println("🌡️ Reading DHT sensor...");
-    float temperature = dht.readTemperature();
-    float humidity = dht.readHumidity();
-    
-    Serial.printf("🔍 Raw DHT values: T=%.2f°C, H=%.2f%%\n", temperature, humidity);
-    addReading(temperature, humidity);
-    
-    // Blink LED to show activity
-    if (isConnected) {
-      blinkStatusLED(1, 50); // Quick blink on successful reading
-    }
+  // Take sensor readings on (staggered) slot boundaries
+  if (runSampler() && isConnected) {
+    blinkStatusLED(1, 50); // Quick blink on sensor reading
   }
   
-  delay(100);  // Small delay to prevent watchdog issues
+  // Deferred history load, one bounded step per pass after the sampler
+  serviceHistoryLoad();
+  
+  // Data-absence rules and deferred notification queue writes
+  checkAbsenceAlerts();
+  flushNotifyQueue();
+  serviceOutageJournal();
+  serviceAggregateLog();
+  serviceEmergencySnapshot();
+  serviceStorage();
+  serviceStatusLED();
+  
+  // Sleep until the next channel or LED edge is due, at most 100 ms
+  // (watchdog friendly); just yield while the history is still loading
+  uint32_t untilNextSlot = msUntilNextSample();
+  uint32_t untilLed = msUntilStatusLED();
+  if (untilLed < untilNextSlot) untilNextSlot = untilLed;
+  if (historyLoadPending() && untilNextSlot > 1) untilNextSlot = 1;
+  delay(untilNextSlot < 100 ? untilNextSlot : 100);
 } 
\ No newline at end of file
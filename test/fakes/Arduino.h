@@ -0,0 +1,19 @@
+#pragma once
+
+// Host stand-in for the parts of Arduino.h the headers in include/ use.
+// Time is simulated: millis() only advances through delay() or
+// fakeAdvanceMs(), so timeouts run instantly and deterministically.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+inline uint32_t &fakeMillis() {
+  static uint32_t ms = 0;
+  return ms;
+}
+
+inline unsigned long millis() { return fakeMillis(); }
+inline void delay(unsigned long ms) { fakeMillis() += ms; }
+inline void fakeAdvanceMs(uint32_t ms) { fakeMillis() += ms; }
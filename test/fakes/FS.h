@@ -0,0 +1,147 @@
+#pragma once
+
+// Host stand-in for the Arduino FS API (fs::FS / File) backed by RAM.
+//
+// Each FS instance owns its files, so a test "reboots" by constructing new
+// objects over the same FS. powerCutAfter simulates a reset during a
+// write: once that many more bytes have been written, every further write
+// is lost (short or zero-length write), as are removes and truncating
+// opens. Files are otherwise exact byte vectors, so tests can also tear or
+// corrupt them directly through file().
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class FS;
+
+class File {
+ public:
+  File() {}
+  File(FS *owner, std::shared_ptr<std::vector<uint8_t>> data, size_t pos) : owner_(owner), data_(data), pos_(pos) {}
+
+  explicit operator bool() const { return (bool)data_; }
+  void close() { data_.reset(); }
+  size_t size() const { return data_ ? data_->size() : 0; }
+  size_t position() const { return pos_; }
+  int available() { return data_ && pos_ < data_->size() ? (int)(data_->size() - pos_) : 0; }
+  void flush() {}
+
+  bool seek(uint32_t pos, SeekMode mode = SeekSet) {
+    if (!data_) return false;
+    size_t base = mode == SeekSet ? 0 : mode == SeekCur ? pos_ : data_->size();
+    if (base + pos > data_->size()) return false;
+    pos_ = base + pos;
+    return true;
+  }
+
+  size_t read(uint8_t *buf, size_t len) {
+    if (!data_ || pos_ >= data_->size()) return 0;
+    size_t n = data_->size() - pos_ < len ? data_->size() - pos_ : len;
+    memcpy(buf, data_->data() + pos_, n);
+    pos_ += n;
+    return n;
+  }
+
+  int read() {
+    uint8_t b;
+    return read(&b, 1) == 1 ? b : -1;
+  }
+
+  inline size_t write(const uint8_t *buf, size_t len);
+  size_t write(uint8_t b) { return write(&b, 1); }
+
+ private:
+  FS *owner_ = nullptr;
+  std::shared_ptr<std::vector<uint8_t>> data_;
+  size_t pos_ = 0;
+};
+
+class FS {
+ public:
+  // Bytes that may still be written before the simulated power cut (-1 = never)
+  long powerCutAfter = -1;
+  size_t bytesWritten = 0;
+
+  bool poweredOff() const { return powerCutAfter == 0; }
+
+  File open(const char *path, const char *mode = "r") {
+    auto it = files_.find(path);
+    if (mode[0] == 'r') {
+      if (it == files_.end()) return File();
+      return File(this, it->second, 0);
+    }
+    if (it == files_.end()) {
+      if (poweredOff()) return File();
+      it = files_.emplace(path, std::make_shared<std::vector<uint8_t>>()).first;
+    } else if (mode[0] == 'w') {
+      if (poweredOff()) return File();
+      it->second->clear();
+    }
+    return File(this, it->second, mode[0] == 'a' ? it->second->size() : 0);
+  }
+
+  File open(const std::string &path, const char *mode = "r") { return open(path.c_str(), mode); }
+
+  bool exists(const char *path) const { return files_.count(path) > 0; }
+
+  bool remove(const char *path) {
+    if (poweredOff()) return false;
+    return files_.erase(path) > 0;
+  }
+
+  bool rename(const char *from, const char *to) {
+    if (poweredOff()) return false;
+    auto it = files_.find(from);
+    if (it == files_.end()) return false;
+    files_[to] = it->second;
+    files_.erase(from);
+    return true;
+  }
+
+  // Direct access for tests (nullptr if missing)
+  std::vector<uint8_t> *file(const char *path) {
+    auto it = files_.find(path);
+    return it == files_.end() ? nullptr : it->second.get();
+  }
+
+  size_t fileCount() const { return files_.size(); }
+  void clear() { files_.clear(); }
+
+  // Called by File::write(); returns how many of len bytes survive
+  size_t admit(size_t len) {
+    if (powerCutAfter >= 0 && (long)len > powerCutAfter) len = powerCutAfter;
+    if (powerCutAfter >= 0) powerCutAfter -= len;
+    bytesWritten += len;
+    return len;
+  }
+
+ private:
+  std::map<std::string, std::shared_ptr<std::vector<uint8_t>>> files_;
+};
+
+inline size_t File::write(const uint8_t *buf, size_t len) {
+  if (!data_) return 0;
+  len = owner_->admit(len);
+  if (data_->size() < pos_ + len) data_->resize(pos_ + len);
+  memcpy(data_->data() + pos_, buf, len);
+  pos_ += len;
+  return len;
+}
+
+}  // namespace fs
+
+using fs::File;
+using fs::FS;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
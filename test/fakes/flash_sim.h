@@ -0,0 +1,94 @@
+#pragma once
+
+// Simulated NOR flash behind the FlashRegion interface (raw_log.h) for host
+// tests of the raw partitions.
+//
+// Programming can only clear bits (like the ESP32's SPI flash), erase sets
+// whole sectors to 0xFF. powerCutAfter simulates a reset in the middle of
+// an operation: once that many more bytes have been programmed or erased,
+// the operation stops where it is and every later call fails until the
+// test "powers up" again (powerCutAfter = -1). The byte being programmed
+// when the power goes keeps a random subset of its new zero bits, and an
+// interrupted erase leaves the rest of the range with random bits set
+// instead of clean 0xFF. Counters feed a simple latency model of the
+// module's external flash.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+#include "raw_log.h"
+
+class SimFlash : public FlashRegion {
+ public:
+  explicit SimFlash(size_t bytes, uint8_t fill = 0xFF) : mem(bytes, fill) {}
+
+  std::vector<uint8_t> mem;
+  long powerCutAfter = -1;   // Bytes until the power cut (-1 = never)
+
+  // Operation counters since resetCounters()
+  size_t programs = 0, programmedBytes = 0, erasedSectors = 0, reads = 0, readBytes = 0;
+
+  size_t size() const override { return mem.size(); }
+
+  bool read(size_t offset, void *buf, size_t len) override {
+    if (powerCutAfter == 0 || offset + len > mem.size()) return false;
+    memcpy(buf, &mem[offset], len);
+    reads++;
+    readBytes += len;
+    return true;
+  }
+
+  bool write(size_t offset, const void *data, size_t len) override {
+    if (offset + len > mem.size()) return false;
+    const uint8_t *p = (const uint8_t *)data;
+    programs++;
+    for (size_t i = 0; i < len; i++) {
+      if (!spend()) {
+        mem[offset + i] &= p[i] | (uint8_t)noise();   // Torn byte
+        return false;
+      }
+      mem[offset + i] &= p[i];
+      programmedBytes++;
+    }
+    return true;
+  }
+
+  bool erase(size_t offset, size_t len) override {
+    if (offset % FLASH_SECTOR_SIZE || len % FLASH_SECTOR_SIZE || offset + len > mem.size()) return false;
+    for (size_t i = 0; i < len; i++) {
+      if (!spend()) {
+        for (; i < len; i++) mem[offset + i] |= (uint8_t)(noise() & noise());   // Partly erased
+        return false;
+      }
+      mem[offset + i] = 0xFF;
+    }
+    erasedSectors += len / FLASH_SECTOR_SIZE;
+    return true;
+  }
+
+  void resetCounters() { programs = programmedBytes = erasedSectors = reads = readBytes = 0; }
+
+  // Modelled time of the counted operations: 45 ms per sector erase, 0.7 ms
+  // per 256-byte page program (half a page of setup per call), 20 MB/s reads
+  double modelMs() const {
+    return erasedSectors * 45.0 + (programmedBytes / 256.0 + programs * 0.5) * 0.7 +
+           readBytes / 20000.0 + reads * 0.002;
+  }
+
+ private:
+  uint32_t noiseState_ = 0x9E3779B9;
+
+  uint32_t noise() {
+    noiseState_ ^= noiseState_ << 13;
+    noiseState_ ^= noiseState_ >> 17;
+    noiseState_ ^= noiseState_ << 5;
+    return noiseState_;
+  }
+
+  bool spend() {
+    if (powerCutAfter == 0) return false;
+    if (powerCutAfter > 0) powerCutAfter--;
+    return true;
+  }
+};
@@ -0,0 +1,134 @@
+// Rule evaluation: thresholds with hysteresis, debounce, rate and absence
+// rules, latching and acknowledgement
+#include <unity.h>
+#include "alert_rules.h"
+
+static AlertRule rule(RuleType type, float threshold, float hysteresis, uint32_t forSec, bool latch = false) {
+  AlertRule r = {true, true, latch, type, METRIC_T, 0, threshold, hysteresis, forSec, "test"};
+  return r;
+}
+
+static AlertState idle() {
+  AlertState s = {false, true, false, 0, 0, 0.0f};
+  return s;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_above_with_hysteresis() {
+  AlertRule r = rule(RULE_ABOVE, 30, 1, 0);
+  AlertState s = idle();
+  TEST_ASSERT_EQUAL(ALERT_NONE, evaluateRule(r, s, 30.0f, 0));      // Not strictly above
+  TEST_ASSERT_EQUAL(ALERT_RAISED, evaluateRule(r, s, 30.1f, 30));
+  TEST_ASSERT_TRUE(s.active);
+  TEST_ASSERT_FALSE(s.acknowledged);
+  TEST_ASSERT_EQUAL(30, s.since);
+  TEST_ASSERT_EQUAL(ALERT_NONE, evaluateRule(r, s, 29.5f, 60));     // Inside the band
+  TEST_ASSERT_EQUAL(ALERT_NONE, evaluateRule(r, s, 30.5f, 90));
+  TEST_ASSERT_EQUAL(ALERT_CLEARED, evaluateRule(r, s, 29.0f, 120));
+  TEST_ASSERT_FALSE(s.active);
+  TEST_ASSERT_EQUAL(120, s.since);
+  TEST_ASSERT_EQUAL_FLOAT(29.0f, s.lastValue);
+}
+
+void test_below_with_hysteresis() {
+  AlertRule r = rule(RULE_BELOW, 10, 2, 0);
+  AlertState s = idle();
+  TEST_ASSERT_EQUAL(ALERT_NONE, evaluateRule(r, s, 10.0f, 0));
+  TEST_ASSERT_EQUAL(ALERT_RAISED, evaluateRule(r, s, 9.9f, 1));
+  TEST_ASSERT_EQUAL(ALERT_NONE, evaluateRule(r, s, 11.9f, 2));
+  TEST_ASSERT_EQUAL(ALERT_CLEARED, evaluateRule(r, s, 12.0f, 3));
+}
+
+// "Above 35 for 5 minutes": any dip below restarts the timer
+void test_debounce() {
+  AlertRule r = rule(RULE_ABOVE, 35, 0.5f, 300);
+  AlertState s = idle();
+  TEST_ASSERT_EQUAL(ALERT_NONE, evaluateRule(r, s, 36, 0));
+  TEST_ASSERT_TRUE(s.pending);
+  TEST_ASSERT_EQUAL(ALERT_NONE, evaluateRule(r, s, 36, 270));
+  TEST_ASSERT_EQUAL(ALERT_NONE, evaluateRule(r, s, 34, 290));
+  TEST_ASSERT_FALSE(s.pending);
+  TEST_ASSERT_EQUAL(ALERT_NONE, evaluateRule(r, s, 36, 300));
+  TEST_ASSERT_EQUAL(300, s.pendingSince);
+  TEST_ASSERT_EQUAL(ALERT_NONE, evaluateRule(r, s, 36, 599));
+  TEST_ASSERT_EQUAL(ALERT_RAISED, evaluateRule(r, s, 36, 600));
+  TEST_ASSERT_FALSE(s.pending);
+}
+
+// Rate rules get the slope in °C/min; FALL trips on a steep negative slope
+void test_rise_and_fall() {
+  AlertRule rise = rule(RULE_RISE, 2, 0.5f, 0);
+  AlertState s = idle();
+  TEST_ASSERT_EQUAL(ALERT_NONE, evaluateRule(rise, s, 1.5f, 0));
+  TEST_ASSERT_EQUAL(ALERT_NONE, evaluateRule(rise, s, -3.0f, 1));
+  TEST_ASSERT_EQUAL(ALERT_RAISED, evaluateRule(rise, s, 2.5f, 2));
+  TEST_ASSERT_EQUAL(ALERT_CLEARED, evaluateRule(rise, s, 1.5f, 3));
+
+  AlertRule fall = rule(RULE_FALL, 2, 0.5f, 0);
+  s = idle();
+  TEST_ASSERT_EQUAL(ALERT_NONE, evaluateRule(fall, s, 3.0f, 0));
+  TEST_ASSERT_EQUAL(ALERT_RAISED, evaluateRule(fall, s, -2.5f, 1));
+  TEST_ASSERT_EQUAL(ALERT_NONE, evaluateRule(fall, s, -1.8f, 2));
+  TEST_ASSERT_EQUAL(ALERT_CLEARED, evaluateRule(fall, s, -1.5f, 3));
+}
+
+// ABSENT gets the seconds since the last valid sample
+void test_absent() {
+  AlertRule r = rule(RULE_ABSENT, 120, 0, 0);
+  AlertState s = idle();
+  TEST_ASSERT_EQUAL(ALERT_NONE, evaluateRule(r, s, 90, 0));
+  TEST_ASSERT_EQUAL(ALERT_RAISED, evaluateRule(r, s, 150, 60));
+  TEST_ASSERT_EQUAL(ALERT_CLEARED, evaluateRule(r, s, 0, 90));
+}
+
+// Latched alerts ignore the clear condition until acknowledged
+void test_latch_and_acknowledge() {
+  AlertRule r = rule(RULE_ABOVE, 30, 1, 0, true);
+  AlertState s = idle();
+  TEST_ASSERT_FALSE(acknowledgeRule(r, s, 0));
+  TEST_ASSERT_EQUAL(ALERT_RAISED, evaluateRule(r, s, 31, 10));
+  TEST_ASSERT_EQUAL(ALERT_NONE, evaluateRule(r, s, 20, 20));
+  TEST_ASSERT_TRUE(s.active);
+  TEST_ASSERT_TRUE(acknowledgeRule(r, s, 30));
+  TEST_ASSERT_FALSE(s.active);
+  TEST_ASSERT_TRUE(s.acknowledged);
+  TEST_ASSERT_EQUAL(30, s.since);
+  TEST_ASSERT_EQUAL(ALERT_RAISED, evaluateRule(r, s, 31, 40));
+  TEST_ASSERT_FALSE(s.acknowledged);
+}
+
+// Acknowledging a non-latched alert keeps it active until it clears
+void test_acknowledge_unlatched() {
+  AlertRule r = rule(RULE_ABOVE, 30, 1, 0);
+  AlertState s = idle();
+  evaluateRule(r, s, 31, 0);
+  TEST_ASSERT_TRUE(acknowledgeRule(r, s, 5));
+  TEST_ASSERT_TRUE(s.active);
+  TEST_ASSERT_TRUE(s.acknowledged);
+  TEST_ASSERT_EQUAL(ALERT_NONE, evaluateRule(r, s, 31, 10));
+  TEST_ASSERT_TRUE(s.acknowledged);
+  TEST_ASSERT_EQUAL(ALERT_CLEARED, evaluateRule(r, s, 28, 20));
+}
+
+void test_names() {
+  TEST_ASSERT_EQUAL_STRING("above", ruleTypeName(RULE_ABOVE));
+  TEST_ASSERT_EQUAL_STRING("absent", ruleTypeName(RULE_ABSENT));
+  TEST_ASSERT_EQUAL_STRING("?", ruleTypeName(RULE_TYPE_COUNT));
+  TEST_ASSERT_EQUAL_STRING("dp", ruleMetricName(METRIC_DP));
+  TEST_ASSERT_EQUAL_STRING("?", ruleMetricName(METRIC_COUNT));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_above_with_hysteresis);
+  RUN_TEST(test_below_with_hysteresis);
+  RUN_TEST(test_debounce);
+  RUN_TEST(test_rise_and_fall);
+  RUN_TEST(test_absent);
+  RUN_TEST(test_latch_and_acknowledge);
+  RUN_TEST(test_acknowledge_unlatched);
+  RUN_TEST(test_names);
+  return UNITY_END();
+}
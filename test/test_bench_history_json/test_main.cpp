@@ -0,0 +1,124 @@
+// /api/history body: formatHistorySlice() vs per-value printf formatting
+// (what ArduinoJson's serializer did per point), for range=all of the
+// standard profile (288 five-minute means + 120 detailed points). Host
+// timings; only the ratio carries over to the ESP32.
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "history_json.h"
+
+static const int ROUNDS = 2000;
+static const size_t AGGREGATED = 288, DETAILED = 120;
+
+static std::vector<HistoryPoint> points;
+static HistoryJsonOptions options = {TimeFormat::Local, true, false, true, 10};
+
+void setUp() {
+  setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
+  tzset();
+  points.clear();
+  uint32_t ts = 1705320000;
+  for (size_t i = 0; i < AGGREGATED; i++, ts += 300) {
+    points.push_back({ts, 15.0f + (i % 200) * 0.0731f, 30.0f + (i % 300) * 0.113f, 10, 0, 0, POINT_AGGREGATED, 0});
+  }
+  for (size_t i = 0; i < DETAILED; i++, ts += 30) {
+    points.push_back({ts, 21.0f + (i % 7) * 0.1f, 45.0f + (i % 11), 1, (uint16_t)(i % 40 == 0), 12, POINT_DETAILED, 0});
+  }
+}
+void tearDown() {}
+
+template <typename F>
+static double usPerRound(F body) {
+  auto t0 = std::chrono::steady_clock::now();
+  for (int r = 0; r < ROUNDS; r++) body();
+  auto t1 = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(t1 - t0).count() / ROUNDS;
+}
+
+static void report(const char *what, double us, double baseline) {
+  char msg[96];
+  snprintf(msg, sizeof(msg), "%-24s %8.1f us/response (%.1fx)", what, us, baseline / us);
+  TEST_MESSAGE(msg);
+}
+
+// Baseline: every value through the generic printf path
+static size_t baselinePoint(char *out, const HistoryPoint &p, DateFormatter &fmt) {
+  char dt[TIME_FORMAT_MAX];
+  fmt.format(p.ts, dt, TimeFormat::Local);
+  if (p.kind == POINT_AGGREGATED) {
+    return snprintf(out, 256, "{\"ts\":%u,\"t\":%.9g,\"h\":%.9g,\"datetime\":\"%s\",\"n\":%u,\"coverage\":%u,\"type\":\"aggregated\"}",
+                    p.ts, (double)p.t, (double)p.h, dt, p.n, p.n * 100u / options.slotsPerBucket);
+  }
+  return snprintf(out, 256, "{\"ts\":%u,\"t\":%.9g,\"h\":%.9g,\"datetime\":\"%s\",\"jitter_ms\":%u,\"type\":\"detailed\"}",
+                  p.ts, (double)p.t, (double)p.h, dt, p.jitterMs);
+}
+
+static std::string text(const TextChunks &c) {
+  std::string s(c.size(), '\0');
+  c.read(0, &s[0], s.size());
+  return s;
+}
+
+// The two halves handleHistory() formats on both cores join to the single-slice text
+void test_slices_join() {
+  TextChunks whole, first, second;
+  size_t split = points.size() / 2;
+  TEST_ASSERT_TRUE(formatHistorySlice(points.data(), points.size(), options, false, whole));
+  TEST_ASSERT_TRUE(formatHistorySlice(points.data(), split, options, false, first));
+  TEST_ASSERT_TRUE(formatHistorySlice(points.data() + split, points.size() - split, options, true, second));
+  TEST_ASSERT_TRUE(text(whole) == text(first) + text(second));
+  TEST_ASSERT_EQUAL('{', text(whole)[0]);
+  TEST_ASSERT_EQUAL('}', text(whole).back());
+}
+
+// Values round to the same 0.01 steps as "%.2f"
+void test_values_match_printf() {
+  DateFormatter fmt;
+  char out[HISTORY_POINT_JSON_MAX + 1], expect[32];
+  for (const HistoryPoint &p : points) {
+    out[formatHistoryPoint(out, p, options, fmt)] = '\0';
+    double t = atof(strstr(out, "\"t\":") + 4);
+    snprintf(expect, sizeof(expect), "%.2f", p.t);
+    TEST_ASSERT_TRUE(t == atof(expect));
+  }
+}
+
+void test_bench_range_all() {
+  volatile size_t sink = 0;
+  double ref = usPerRound([&] {
+    DateFormatter fmt;
+    char buf[300];
+    std::string s;
+    s.reserve(points.size() * 128);
+    for (size_t i = 0; i < points.size(); i++) {
+      if (i) s += ',';
+      s.append(buf, baselinePoint(buf, points[i], fmt));
+    }
+    sink += s.size();
+  });
+  double fast = usPerRound([&] {
+    TextChunks c;
+    formatHistorySlice(points.data(), points.size(), options, false, c);
+    sink += c.size();
+  });
+  double half = usPerRound([&] {
+    TextChunks c;
+    formatHistorySlice(points.data() + points.size() / 2, points.size() - points.size() / 2, options, true, c);
+    sink += c.size();
+  });
+  report("printf per value", ref, ref);
+  report("formatHistorySlice", fast, ref);
+  report("one half (per core)", half, ref);
+  TEST_ASSERT_GREATER_THAN(0, (size_t)sink);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_slices_join);
+  RUN_TEST(test_values_match_printf);
+  RUN_TEST(test_bench_range_all);
+  return UNITY_END();
+}
@@ -0,0 +1,134 @@
+// Ingest path of one channel (addReading() without I/O): detailed ring,
+// 5-minute bucket, aggregated ring and both rolling-stats windows, fed by
+// the simulated driver at the DHT11 rate and at 1 Hz (30x). Checks that
+// nothing allocates on the way and that the rollups match a direct
+// computation; prints the time per sample.
+#include <unity.h>
+#include <chrono>
+#include <math.h>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include "sample_store.h"
+#include "rolling_stats.h"
+#include "sensor_sim.h"
+
+// Every heap allocation in the process goes through here
+static size_t allocations = 0;
+void *operator new(size_t n) {
+  allocations++;
+  void *p = malloc(n ? n : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+static const uint32_t AGGREGATE_SEC = 300;
+static const uint32_t DAY = 86400;
+
+struct Channel {
+  SampleRing<1800> detailed;       // 30 min at 1 Hz
+  SampleRing<288> aggregated;      // 24 h of 5-minute means
+  BucketAccumulator bucket;
+  RollingStats<600> recent;        // 10 min at 1 Hz
+  RollingStats<12> hourly;         // 1 h of 5-minute means
+};
+
+static Channel ch;
+
+static void closeBucket(Channel &c) {
+  float t = c.bucket.sumT / c.bucket.n, h = c.bucket.sumH / c.bucket.n;
+  c.aggregated.push(c.bucket.bucketTs, t, h, c.bucket.n, 0, c.bucket.maxJitterMs);
+  c.hourly.push(c.bucket.bucketTs, t, h);
+  c.bucket.reset(0);
+}
+
+static void ingest(Channel &c, uint32_t ts, float t, float h) {
+  if (c.bucket.n > 0 && ts / AGGREGATE_SEC != c.bucket.bucketTs / AGGREGATE_SEC) closeBucket(c);
+  c.detailed.push(ts, t, h, 1, 0, 0);
+  if (c.bucket.n == 0) c.bucket.reset((ts / AGGREGATE_SEC) * AGGREGATE_SEC);
+  c.bucket.add(t, h, 0);
+  c.recent.push(ts, t, h);
+}
+
+// One simulated day at the given interval; returns ns per sample
+static double runDay(uint32_t intervalSec) {
+  ch = Channel();
+  ch.recent.setWindow(600);
+  ch.hourly.setWindow(3600);
+  SimulatedSensor sim(42, intervalSec * 1000);
+  const uint32_t start = 1705320000;
+  size_t allocsBefore = allocations;
+  auto t0 = std::chrono::steady_clock::now();
+  for (uint32_t ts = start; ts < start + DAY; ts += intervalSec) {
+    float t, h;
+    sim.read(t, h);
+    ingest(ch, ts, t, h);
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  TEST_ASSERT_EQUAL(allocsBefore, allocations);
+  return std::chrono::duration<double, std::nano>(t1 - t0).count() / (DAY / intervalSec);
+}
+
+// The newest aggregate and the rolling window against the detailed ring
+static void checkRollups(uint32_t intervalSec) {
+  TEST_ASSERT_EQUAL(288, ch.aggregated.size() + 1);   // The last bucket is still open
+  size_t perBucket = AGGREGATE_SEC / intervalSec;
+  size_t agg = ch.aggregated.newest();
+  TEST_ASSERT_EQUAL(perBucket, ch.aggregated.n[agg]);
+
+  double sumT = 0;
+  size_t found = 0;
+  for (size_t i = 0; i < ch.detailed.size(); i++) {
+    size_t idx = ch.detailed.at(i);
+    if (ch.detailed.ts[idx] >= ch.aggregated.ts[agg] && ch.detailed.ts[idx] < ch.aggregated.ts[agg] + AGGREGATE_SEC) {
+      sumT += ch.detailed.t[idx];
+      found++;
+    }
+  }
+  TEST_ASSERT_EQUAL(perBucket, found);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, sumT / found, ch.aggregated.t[agg]);
+
+  double sumRecent = 0;
+  size_t inWindow = 0;
+  uint32_t newestTs = ch.detailed.ts[ch.detailed.newest()];
+  for (size_t i = 0; i < ch.detailed.size(); i++) {
+    size_t idx = ch.detailed.at(i);
+    if (newestTs - ch.detailed.ts[idx] < 600) {
+      sumRecent += ch.detailed.t[idx];
+      inWindow++;
+    }
+  }
+  TEST_ASSERT_EQUAL(inWindow, ch.recent.size());
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, sumRecent / inWindow, ch.recent.mean(STAT_T));
+}
+
+static double nsDht = 0;
+
+void setUp() {}
+void tearDown() {}
+
+void test_bench_dht_rate() {
+  nsDht = runDay(30);
+  checkRollups(30);
+  char msg[96];
+  snprintf(msg, sizeof(msg), "30 s interval: %6.1f ns/sample, %u samples/day", nsDht, DAY / 30);
+  TEST_MESSAGE(msg);
+}
+
+void test_bench_one_hz() {
+  double ns = runDay(1);
+  checkRollups(1);
+  char msg[96];
+  snprintf(msg, sizeof(msg), " 1 s interval: %6.1f ns/sample, %u samples/day (%.3f ms CPU per day)",
+           ns, DAY, ns * DAY / 1e6);
+  TEST_MESSAGE(msg);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_bench_dht_rate);
+  RUN_TEST(test_bench_one_hz);
+  return UNITY_END();
+}
@@ -0,0 +1,86 @@
+// num_format.h vs snprintf()/strtof() per value, over the ranges the
+// firmware prints and parses (readings, aggregates, centi-units,
+// timestamps). Host timings; only the ratio carries over to the ESP32.
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "num_format.h"
+
+static const size_t VALUES = 1000000;
+
+static std::vector<float> temps, hums;
+static std::vector<int32_t> centi;
+static std::vector<std::vector<char> > texts;
+
+void setUp() {
+  if (!temps.empty()) return;
+  uint32_t x = 7;
+  for (size_t i = 0; i < VALUES; i++) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    temps.push_back(((int)(x % 1201) - 400) / 10.0f);     // -40.0 .. 80.0 °C
+    hums.push_back((x % 10001) / 100.0f);                  // 0.00 .. 100.00 %
+    centi.push_back((int32_t)(x % 12001) - 4000);
+    std::vector<char> t(16);
+    snprintf(t.data(), t.size(), "%.1f", temps.back());
+    texts.push_back(t);
+  }
+}
+void tearDown() {}
+
+template <typename F>
+static double nsPerValue(F body) {
+  auto t0 = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < VALUES; i++) body(i);
+  auto t1 = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(t1 - t0).count() / VALUES;
+}
+
+static void report(const char *what, double libc, double fast) {
+  char msg[96];
+  snprintf(msg, sizeof(msg), "%-20s libc %6.1f ns, num_format %6.1f ns (%.1fx)", what, libc, fast, libc / fast);
+  TEST_MESSAGE(msg);
+}
+
+void test_bench_format() {
+  char buf[64];
+  volatile size_t sink = 0;
+  double a = nsPerValue([&](size_t i) { sink += snprintf(buf, sizeof(buf), "%.1f", temps[i]); });
+  double b = nsPerValue([&](size_t i) { sink += formatFixed(buf, temps[i], 1, false); });
+  report("temperature %.1f", a, b);
+  a = nsPerValue([&](size_t i) { sink += snprintf(buf, sizeof(buf), "%.2f", hums[i]); });
+  b = nsPerValue([&](size_t i) { sink += formatFixed(buf, hums[i], 2, false); });
+  report("humidity %.2f", a, b);
+  a = nsPerValue([&](size_t i) {
+    int32_t v = centi[i];
+    sink += snprintf(buf, sizeof(buf), "%s%d.%02d", v < 0 ? "-" : "", abs(v) / 100, abs(v) % 100);
+  });
+  b = nsPerValue([&](size_t i) { sink += formatScaled(buf, centi[i], 2); });
+  report("centi-units", a, b);
+  a = nsPerValue([&](size_t i) { sink += snprintf(buf, sizeof(buf), "%u", (unsigned)(1705000000u + i)); });
+  b = nsPerValue([&](size_t i) { sink += formatUint(buf, 1705000000u + i); });
+  report("timestamp %u", a, b);
+  TEST_ASSERT_GREATER_THAN(0, (size_t)sink);
+}
+
+void test_bench_parse() {
+  volatile float sink = 0;
+  double a = nsPerValue([&](size_t i) { sink += strtof(texts[i].data(), nullptr); });
+  double b = nsPerValue([&](size_t i) {
+    float v = 0;
+    parseFixed(texts[i].data(), v);
+    sink += v;
+  });
+  report("parse %.1f text", a, b);
+  TEST_ASSERT_FALSE(isnan((float)sink));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_bench_format);
+  RUN_TEST(test_bench_parse);
+  return UNITY_END();
+}
@@ -0,0 +1,120 @@
+// Raw log partition vs whole-file rewrites on a simulated NOR flash: the
+// operations each persistence path issues, priced with the latency model in
+// flash_sim.h (erase 45 ms/sector, program 0.7 ms/page). The filesystem
+// backends themselves are measured on the device (env:bench-littlefs /
+// env:bench-spiffs); this covers the flash traffic the code generates and
+// the host CPU time of mount().
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include "flash_sim.h"
+#include "raw_log.h"
+
+static const size_t RAWLOG_BYTES = 64 * 1024;     // The rawlog partition
+static const size_t HISTORY_FILE_BYTES = 32768;   // The former hourly rewrite
+
+static HistoryRecord record(uint32_t i) {
+  HistoryRecord r = {};
+  r.ts = 1705320000 + i * 300;
+  r.t = 21.5f;
+  r.h = 48.0f;
+  r.n = 10;
+  return r;
+}
+
+static void report(const char *what, double ms, const SimFlash &f) {
+  char msg[128];
+  snprintf(msg, sizeof(msg), "%-30s %8.2f ms  (%zu erases, %zu programs, %zu bytes read)",
+           what, ms, f.erasedSectors, f.programs, f.readBytes);
+  TEST_MESSAGE(msg);
+}
+
+void setUp() {}
+void tearDown() {}
+
+// One closed aggregate at a time vs a page-sized group commit
+void test_bench_append() {
+  SimFlash flash(RAWLOG_BYTES);
+  RawLog<HistoryRecord> log(flash);
+  TEST_ASSERT_TRUE(log.mount());
+  for (uint32_t i = 0; i < 1000; i++) log.append(record(i));   // Steady state: sectors recycled
+
+  const int RUNS = 600;
+  flash.resetCounters();
+  for (int i = 0; i < RUNS; i++) TEST_ASSERT_TRUE(log.append(record(i)));
+  double single = flash.modelMs() / RUNS;
+  report("append 1 record (per record)", single, flash);
+
+  HistoryRecord batch[10];
+  for (int k = 0; k < 10; k++) batch[k] = record(k);
+  flash.resetCounters();
+  for (int i = 0; i < RUNS / 10; i++) TEST_ASSERT_TRUE(log.append(batch, 10));
+  double grouped = flash.modelMs() / RUNS;
+  report("append 10 records (per record)", grouped, flash);
+  TEST_ASSERT_LESS_THAN(single, grouped);
+}
+
+// What the hourly history save cost at least: 32 KB into freshly erased
+// sectors, written page by page (a filesystem adds its metadata on top)
+void test_bench_rewrite_vs_append() {
+  SimFlash flash(RAWLOG_BYTES);
+  static uint8_t file[HISTORY_FILE_BYTES];
+  memset(file, 0x5A, sizeof(file));
+  flash.resetCounters();
+  TEST_ASSERT_TRUE(flash.erase(0, HISTORY_FILE_BYTES));
+  for (size_t off = 0; off < HISTORY_FILE_BYTES; off += 256) TEST_ASSERT_TRUE(flash.write(off, file + off, 256));
+  double rewrite = flash.modelMs();
+  report("rewrite 32 KB (full history)", rewrite, flash);
+
+  // An hour of aggregates for 8 channels through the log, in group commits
+  SimFlash logFlash(RAWLOG_BYTES);
+  RawLog<HistoryRecord> log(logFlash);
+  TEST_ASSERT_TRUE(log.mount());
+  for (uint32_t i = 0; i < 1000; i++) log.append(record(i));
+  HistoryRecord batch[8];
+  for (int k = 0; k < 8; k++) batch[k] = record(k);
+  logFlash.resetCounters();
+  for (int bucket = 0; bucket < 12; bucket++) TEST_ASSERT_TRUE(log.append(batch, 8));
+  double hour = logFlash.modelMs();
+  report("one hour, 8 channels, appended", hour, logFlash);
+  TEST_ASSERT_LESS_THAN(rewrite, hour);
+}
+
+// mount() reads the sector headers plus one sector, however full the log is
+void test_bench_mount() {
+  SimFlash empty(RAWLOG_BYTES), full(RAWLOG_BYTES);
+  {
+    RawLog<HistoryRecord> log(full);
+    TEST_ASSERT_TRUE(log.mount());
+    for (uint32_t i = 0; i < 5000; i++) log.append(record(i));
+  }
+  empty.resetCounters();
+  full.resetCounters();
+  RawLog<HistoryRecord> a(empty), b(full);
+  TEST_ASSERT_TRUE(a.mount());
+  TEST_ASSERT_TRUE(b.mount());
+  report("mount (empty)", empty.modelMs(), empty);
+  report("mount (full)", full.modelMs(), full);
+  TEST_ASSERT_LESS_OR_EQUAL(2 * FLASH_SECTOR_SIZE, full.readBytes);   // Not the 64 KB behind it
+
+  const int RUNS = 2000;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < RUNS; i++) {
+    RawLog<HistoryRecord> log(full);
+    log.mount();
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  char msg[96];
+  snprintf(msg, sizeof(msg), "mount host CPU                 %8.2f us",
+           std::chrono::duration<double, std::micro>(t1 - t0).count() / RUNS);
+  TEST_MESSAGE(msg);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_bench_append);
+  RUN_TEST(test_bench_rewrite_vs_append);
+  RUN_TEST(test_bench_mount);
+  return UNITY_END();
+}
@@ -0,0 +1,75 @@
+// DateFormatter vs localtime_r() + strftime() per timestamp (the former
+// log and /api/history path). Host timings; only the ratio carries over to
+// the ESP32.
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "time_format.h"
+
+static const uint32_t CALLS = 2000000;
+static const uint32_t START = 1705325415;
+
+void setUp() {
+  setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
+  tzset();
+}
+void tearDown() {}
+
+template <typename F>
+static double nsPerCall(F body) {
+  auto t0 = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < CALLS; i++) body(i);
+  auto t1 = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(t1 - t0).count() / CALLS;
+}
+
+static void report(const char *what, double ns, double baseline) {
+  char msg[96];
+  snprintf(msg, sizeof(msg), "%-22s %7.1f ns/call (%.1fx)", what, ns, baseline / ns);
+  TEST_MESSAGE(msg);
+}
+
+// History is formatted in order, 30 s apart (the detailed tier)
+void test_bench_sequential() {
+  DateFormatter f;
+  char out[TIME_FORMAT_MAX];
+  volatile size_t sink = 0;
+  double ref = nsPerCall([&](uint32_t i) {
+    time_t t = START + i * 30;
+    struct tm tm;
+    localtime_r(&t, &tm);
+    sink += strftime(out, sizeof(out), "%Y-%m-%d %H:%M:%S", &tm);
+  });
+  double fast = nsPerCall([&](uint32_t i) { sink += f.format(START + i * 30, out); });
+  double iso = nsPerCall([&](uint32_t i) { sink += f.format(START + i * 30, out, TimeFormat::Iso8601); });
+  report("strftime", ref, ref);
+  report("DateFormatter local", fast, ref);
+  report("DateFormatter ISO", iso, ref);
+  TEST_ASSERT_GREATER_THAN(0, (size_t)sink);
+}
+
+// Worst case: every call in a different hour, so every call takes the slow path
+void test_bench_hour_jumps() {
+  DateFormatter f;
+  char out[TIME_FORMAT_MAX];
+  volatile size_t sink = 0;
+  double ref = nsPerCall([&](uint32_t i) {
+    time_t t = START + (i % 1000) * 3601;
+    struct tm tm;
+    localtime_r(&t, &tm);
+    sink += strftime(out, sizeof(out), "%Y-%m-%d %H:%M:%S", &tm);
+  });
+  double fast = nsPerCall([&](uint32_t i) { sink += f.format(START + (i % 1000) * 3601, out); });
+  report("strftime", ref, ref);
+  report("DateFormatter (miss)", fast, ref);
+  TEST_ASSERT_GREATER_THAN(0, (size_t)sink);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_bench_sequential);
+  RUN_TEST(test_bench_hour_jumps);
+  return UNITY_END();
+}
@@ -0,0 +1,239 @@
+// Flash retention: what a history save carries over from the previous file
+// (window, order rule, damaged blocks), and that repeated saves of a short
+// RAM ring build up the full retention window on flash.
+#include <unity.h>
+#include <vector>
+#include "history_retention.h"
+
+static const uint32_t T0 = 1705320000;
+static const uint32_t STEP = 300;
+
+struct VectorReader {
+  const std::vector<uint8_t> &data;
+  int failAfter;                       // Reads that succeed (-1 = all)
+  size_t size() { return data.size(); }
+  bool read(size_t offset, void *buf, size_t len) {
+    if (failAfter == 0 || offset + len > data.size()) return false;
+    if (failAfter > 0) failAfter--;
+    memcpy(buf, data.data() + offset, len);
+    return true;
+  }
+};
+
+static HistoryRecord record(uint8_t channel, uint32_t ts) {
+  HistoryRecord r = {};
+  r.ts = ts;
+  r.t = 20.0f + channel;
+  r.h = 50;
+  r.n = 10;
+  r.channel = channel;
+  return r;
+}
+
+// A v4 file with the records in the given order
+static std::vector<uint8_t> historyFile(const std::vector<HistoryRecord> &recs) {
+  HistoryHeader hdr = {};
+  hdr.magic = HISTORY_MAGIC;
+  hdr.version = HISTORY_VERSION;
+  hdr.recordSize = sizeof(HistoryRecord);
+  hdr.count = recs.size();
+  hdr.firstTs = UINT32_MAX;
+  for (const HistoryRecord &r : recs) {
+    if (r.ts < hdr.firstTs) hdr.firstTs = r.ts;
+    if (r.ts > hdr.lastTs) hdr.lastTs = r.ts;
+  }
+  if (recs.empty()) hdr.firstTs = 0;
+  hdr.crc = historyHeaderCrc(hdr);
+  std::vector<uint8_t> out((const uint8_t *)&hdr, (const uint8_t *)&hdr + sizeof(hdr));
+  for (size_t i = 0; i < recs.size(); i += HISTORY_BLOCK_RECORDS) {
+    size_t n = recs.size() - i < HISTORY_BLOCK_RECORDS ? recs.size() - i : HISTORY_BLOCK_RECORDS;
+    const uint8_t *p = (const uint8_t *)&recs[i];
+    out.insert(out.end(), p, p + n * sizeof(HistoryRecord));
+    uint32_t crc = crc32Update(0, &recs[i], n * sizeof(HistoryRecord));
+    out.insert(out.end(), (const uint8_t *)&crc, (const uint8_t *)&crc + sizeof(crc));
+  }
+  return out;
+}
+
+// Plans and copies; checks that copy() delivers exactly what plan() counted
+static std::vector<HistoryRecord> carryOver(const std::vector<uint8_t> &file, const uint32_t (&from)[2],
+                                            const uint32_t (&before)[2]) {
+  HistoryCarryOver<2> carry(from, before);
+  VectorReader reader = {file, -1};
+  carry.plan(reader);
+  std::vector<HistoryRecord> got;
+  TEST_ASSERT_TRUE(carry.copy(reader, [&](const HistoryRecord &r) { got.push_back(r); }));
+  TEST_ASSERT_EQUAL(carry.total(), got.size());
+  for (size_t c = 0; c < 2; c++) {
+    uint32_t n = 0, last = 0;
+    for (const HistoryRecord &r : got) {
+      if (r.channel != c) continue;
+      if (n++ == 0) TEST_ASSERT_EQUAL(carry.firstTs(c), r.ts);
+      last = r.ts;
+    }
+    TEST_ASSERT_EQUAL(carry.count(c), n);
+    if (n > 0) TEST_ASSERT_EQUAL(carry.lastTs(c), last);
+  }
+  return got;
+}
+
+void setUp() {}
+void tearDown() {}
+
+// Per channel only from <= ts < before is carried, in file order
+void test_carries_the_window_before_the_ring() {
+  std::vector<HistoryRecord> recs;
+  for (uint32_t i = 0; i < 100; i++) recs.push_back(record(0, T0 + i * STEP));
+  for (uint32_t i = 0; i < 50; i++) recs.push_back(record(1, T0 + i * STEP));
+  std::vector<uint8_t> file = historyFile(recs);
+
+  uint32_t from[2] = {T0 + 10 * STEP, T0};
+  uint32_t before[2] = {T0 + 90 * STEP, T0 + 20 * STEP};
+  std::vector<HistoryRecord> got = carryOver(file, from, before);
+  TEST_ASSERT_EQUAL(80 + 20, got.size());
+  for (size_t i = 0; i < got.size(); i++) {
+    uint8_t c = i < 80 ? 0 : 1;
+    uint32_t ts = i < 80 ? T0 + (10 + i) * STEP : T0 + (i - 80) * STEP;
+    TEST_ASSERT_EQUAL(c, got[i].channel);
+    TEST_ASSERT_EQUAL(ts, got[i].ts);
+    TEST_ASSERT_EQUAL_FLOAT(20.0f + c, got[i].t);
+  }
+}
+
+// Records that would break the file order are left out
+void test_drops_records_out_of_order() {
+  std::vector<HistoryRecord> recs;
+  recs.push_back(record(0, T0));
+  recs.push_back(record(0, T0 + STEP));
+  recs.push_back(record(0, T0 + STEP));        // Duplicate
+  recs.push_back(record(0, T0 - STEP));        // Older than its predecessor
+  recs.push_back(record(1, T0));
+  recs.push_back(record(0, T0 + 2 * STEP));    // Channel goes back
+  recs.push_back(record(7, T0 + 3 * STEP));    // Unknown channel
+  recs.push_back(record(1, T0 + STEP));
+  std::vector<uint8_t> file = historyFile(recs);
+
+  uint32_t from[2] = {0, 0};
+  uint32_t before[2] = {UINT32_MAX, UINT32_MAX};
+  std::vector<HistoryRecord> got = carryOver(file, from, before);
+  TEST_ASSERT_EQUAL(4, got.size());
+  TEST_ASSERT_EQUAL(T0, got[0].ts);
+  TEST_ASSERT_EQUAL(T0 + STEP, got[1].ts);
+  TEST_ASSERT_EQUAL(1, got[2].channel);
+  TEST_ASSERT_EQUAL(T0 + STEP, got[3].ts);
+}
+
+// A block failing its CRC is skipped in both passes
+void test_skips_damaged_blocks() {
+  std::vector<HistoryRecord> recs;
+  for (uint32_t i = 0; i < 3 * HISTORY_BLOCK_RECORDS; i++) recs.push_back(record(0, T0 + i * STEP));
+  std::vector<uint8_t> file = historyFile(recs);
+  file[sizeof(HistoryHeader) + HISTORY_BLOCK_RECORDS * sizeof(HistoryRecord) + 4 + 5] ^= 0x10;   // Block 1
+
+  uint32_t from[2] = {0, 0};
+  uint32_t before[2] = {UINT32_MAX, UINT32_MAX};
+  std::vector<HistoryRecord> got = carryOver(file, from, before);
+  TEST_ASSERT_EQUAL(2 * HISTORY_BLOCK_RECORDS, got.size());
+  TEST_ASSERT_EQUAL(T0 + (HISTORY_BLOCK_RECORDS - 1) * STEP, got[HISTORY_BLOCK_RECORDS - 1].ts);
+  TEST_ASSERT_EQUAL(T0 + 2 * HISTORY_BLOCK_RECORDS * STEP, got[HISTORY_BLOCK_RECORDS].ts);
+}
+
+// Anything but an intact v4 file carries nothing, and the save goes on
+void test_invalid_file_carries_nothing() {
+  std::vector<HistoryRecord> recs;
+  for (uint32_t i = 0; i < 40; i++) recs.push_back(record(0, T0 + i * STEP));
+  const std::vector<uint8_t> good = historyFile(recs);
+  uint32_t from[2] = {0, 0};
+  uint32_t before[2] = {UINT32_MAX, UINT32_MAX};
+
+  std::vector<uint8_t> torn(good.begin(), good.end() - 3);
+  std::vector<uint8_t> badHeader = good;
+  badHeader[8] ^= 1;
+  std::vector<uint8_t> empty;
+  const std::vector<uint8_t> *files[] = {&torn, &badHeader, &empty};
+  for (const std::vector<uint8_t> *file : files) {
+    std::vector<HistoryRecord> got = carryOver(*file, from, before);
+    TEST_ASSERT_EQUAL(0, got.size());
+  }
+}
+
+// A read error in the second pass fails the copy (the save is discarded)
+void test_copy_fails_on_read_error() {
+  std::vector<HistoryRecord> recs;
+  for (uint32_t i = 0; i < 100; i++) recs.push_back(record(0, T0 + i * STEP));
+  std::vector<uint8_t> file = historyFile(recs);
+  uint32_t from[2] = {0, 0};
+  uint32_t before[2] = {UINT32_MAX, UINT32_MAX};
+  HistoryCarryOver<2> carry(from, before);
+  VectorReader reader = {file, -1};
+  carry.plan(reader);
+  TEST_ASSERT_EQUAL(100, carry.total());
+  reader.failAfter = 4;   // Header and one block (records + CRC), then the flash goes away
+  uint32_t n = 0;
+  TEST_ASSERT_FALSE(carry.copy(reader, [&](const HistoryRecord &) { n++; }));
+  TEST_ASSERT_EQUAL(HISTORY_BLOCK_RECORDS, n);
+}
+
+// saveToPersistentStorage(): the rings behind the carried records, the
+// window ending at each channel's newest aggregate
+static std::vector<uint8_t> save(const std::vector<uint8_t> &previous, const std::vector<HistoryRecord> (&rings)[2],
+                                 uint32_t retentionSec) {
+  uint32_t from[2], before[2];
+  for (size_t c = 0; c < 2; c++) {
+    from[c] = 0;
+    before[c] = UINT32_MAX;
+    if (rings[c].empty()) continue;
+    before[c] = rings[c].front().ts;
+    if (rings[c].back().ts >= retentionSec) from[c] = rings[c].back().ts - retentionSec + 1;
+  }
+  HistoryCarryOver<2> carry(from, before);
+  VectorReader reader = {previous, -1};
+  carry.plan(reader);
+  std::vector<HistoryRecord> out;
+  size_t nextRing = 0;
+  auto addRings = [&](size_t upTo) {
+    for (; nextRing < upTo; nextRing++) out.insert(out.end(), rings[nextRing].begin(), rings[nextRing].end());
+  };
+  TEST_ASSERT_TRUE(carry.copy(reader, [&](const HistoryRecord &r) {
+    addRings(r.channel);
+    out.push_back(r);
+  }));
+  addRings(2);
+  TEST_ASSERT_EQUAL(carry.total() + rings[0].size() + rings[1].size(), out.size());
+  return historyFile(out);
+}
+
+// A 24-record ring saved every 10 aggregates fills a 100-record window
+void test_saves_build_up_the_retention_window() {
+  const size_t RING = 24, KEEP = 100, EVERY = 10;
+  std::vector<uint8_t> file;
+  std::vector<HistoryRecord> rings[2];
+  for (uint32_t i = 0; i < 300; i++) {
+    for (uint8_t c = 0; c < 2; c++) {
+      if (c == 1 && i < 150) continue;   // Second probe plugged in later
+      rings[c].push_back(record(c, T0 + i * STEP));
+      if (rings[c].size() > RING) rings[c].erase(rings[c].begin());
+    }
+    if ((i + 1) % EVERY == 0) file = save(file, rings, KEEP * STEP);
+  }
+
+  uint32_t from[2] = {0, 0};
+  uint32_t before[2] = {UINT32_MAX, UINT32_MAX};
+  std::vector<HistoryRecord> got = carryOver(file, from, before);
+  TEST_ASSERT_EQUAL(2 * KEEP, got.size());
+  for (size_t i = 0; i < got.size(); i++) {
+    TEST_ASSERT_EQUAL(i < KEEP ? 0 : 1, got[i].channel);
+    TEST_ASSERT_EQUAL(T0 + (200 + i % KEEP) * STEP, got[i].ts);   // The newest KEEP, no gaps
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_carries_the_window_before_the_ring);
+  RUN_TEST(test_drops_records_out_of_order);
+  RUN_TEST(test_skips_damaged_blocks);
+  RUN_TEST(test_invalid_file_carries_nothing);
+  RUN_TEST(test_copy_fails_on_read_error);
+  RUN_TEST(test_saves_build_up_the_retention_window);
+  return UNITY_END();
+}
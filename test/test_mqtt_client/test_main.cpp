@@ -0,0 +1,261 @@
+// MqttClient against an in-process broker that decodes the packets it is
+// sent and answers like a real one (CONNACK, PUBACK, PINGRESP)
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "mqtt_client.h"
+
+struct Published {
+  std::string topic;
+  std::string payload;
+  uint8_t qos;
+  bool retain;
+  uint16_t id;
+};
+
+class FakeBroker : public Client {
+ public:
+  // Behaviour knobs
+  uint8_t connackCode = 0;
+  bool answerConnect = true;
+  bool ackPublishes = true;
+  bool staleAckFirst = false;   // Send a PUBACK for another id before the right one
+  size_t writeChunk = 0;        // >0: accept at most this many bytes per write()
+
+  // What the client sent
+  bool up = false;
+  int connects = 0, pings = 0, disconnects = 0;
+  std::string clientId, user, pass;
+  uint8_t connectFlags = 0;
+  uint16_t keepAlive = 0;
+  std::vector<Published> published;
+
+  int connect(const char *, uint16_t) override {
+    up = true;
+    in_.clear();
+    out_.clear();
+    outPos_ = 0;
+    return 1;
+  }
+  size_t write(uint8_t b) override { return write(&b, 1); }
+  size_t write(const uint8_t *buf, size_t size) override {
+    if (!up) return 0;
+    if (writeChunk && size > writeChunk) size = writeChunk;
+    in_.insert(in_.end(), buf, buf + size);
+    parse();
+    return size;
+  }
+  int available() override { return (int)(out_.size() - outPos_); }
+  int read() override { return outPos_ < out_.size() ? out_[outPos_++] : -1; }
+  int read(uint8_t *buf, size_t size) override {
+    size_t n = 0;
+    while (n < size && outPos_ < out_.size()) buf[n++] = out_[outPos_++];
+    return (int)n;
+  }
+  void stop() override { up = false; }
+  uint8_t connected() override { return up; }
+
+ private:
+  std::vector<uint8_t> in_, out_;
+  size_t outPos_ = 0;
+
+  static uint16_t u16(const uint8_t *p) { return (uint16_t)(p[0] << 8 | p[1]); }
+  static std::string str(const uint8_t *&p) {
+    uint16_t n = u16(p);
+    std::string s((const char *)p + 2, n);
+    p += 2 + n;
+    return s;
+  }
+
+  // Handles every complete packet in the input buffer
+  void parse() {
+    while (true) {
+      if (in_.size() < 2) return;
+      size_t remaining = 0, pos = 1;
+      uint32_t mult = 1;
+      while (true) {
+        if (pos >= in_.size()) return;
+        uint8_t d = in_[pos++];
+        remaining += (d & 0x7F) * mult;
+        mult *= 128;
+        if (!(d & 0x80)) break;
+      }
+      if (in_.size() < pos + remaining) return;
+      handle(in_[0], &in_[pos], remaining);
+      in_.erase(in_.begin(), in_.begin() + pos + remaining);
+    }
+  }
+
+  void handle(uint8_t header, const uint8_t *body, size_t len) {
+    const uint8_t *p = body;
+    switch (header & 0xF0) {
+      case 0x10: {
+        connects++;
+        TEST_ASSERT_EQUAL_STRING("MQTT", str(p).c_str());
+        TEST_ASSERT_EQUAL(4, *p++);   // Protocol level 3.1.1
+        connectFlags = *p++;
+        keepAlive = u16(p);
+        p += 2;
+        clientId = str(p);
+        if (connectFlags & 0x80) user = str(p);
+        if (connectFlags & 0x40) pass = str(p);
+        TEST_ASSERT_EQUAL(len, (size_t)(p - body));
+        if (answerConnect) out_.insert(out_.end(), {0x20, 2, 0, connackCode});
+        break;
+      }
+      case 0x30: {
+        Published m;
+        m.qos = (header >> 1) & 3;
+        m.retain = header & 1;
+        m.topic = str(p);
+        m.id = 0;
+        if (m.qos) {
+          m.id = u16(p);
+          p += 2;
+        }
+        m.payload.assign((const char *)p, len - (p - body));
+        published.push_back(m);
+        if (m.qos && ackPublishes) {
+          if (staleAckFirst) out_.insert(out_.end(), {0x40, 2, 0xBE, 0xEF});
+          out_.insert(out_.end(), {0x40, 2, (uint8_t)(m.id >> 8), (uint8_t)(m.id & 0xFF)});
+        }
+        break;
+      }
+      case 0xC0:
+        pings++;
+        out_.insert(out_.end(), {0xD0, 0});
+        break;
+      case 0xE0:
+        disconnects++;
+        break;
+      default:
+        TEST_FAIL_MESSAGE("unexpected packet type");
+    }
+  }
+};
+
+static FakeBroker broker;
+
+void setUp() { broker = FakeBroker(); }
+void tearDown() {}
+
+static bool publishText(MqttClient &m, const char *topic, const std::string &payload, uint8_t qos = 1, bool retain = false) {
+  return m.publish(topic, (const uint8_t *)payload.data(), payload.size(), qos, retain);
+}
+
+void test_connect_with_credentials() {
+  MqttClient m(broker);
+  TEST_ASSERT_TRUE(m.connect("broker", 1883, "tr-cam1", "user", "secret", 30));
+  TEST_ASSERT_TRUE(m.connected());
+  TEST_ASSERT_EQUAL(1, broker.connects);
+  TEST_ASSERT_EQUAL(0xC2, broker.connectFlags);   // User, password, clean session
+  TEST_ASSERT_EQUAL(30, broker.keepAlive);
+  TEST_ASSERT_EQUAL_STRING("tr-cam1", broker.clientId.c_str());
+  TEST_ASSERT_EQUAL_STRING("user", broker.user.c_str());
+  TEST_ASSERT_EQUAL_STRING("secret", broker.pass.c_str());
+}
+
+void test_connect_anonymous() {
+  MqttClient m(broker);
+  TEST_ASSERT_TRUE(m.connect("broker", 1883, "dev", "", nullptr));
+  TEST_ASSERT_EQUAL(0x02, broker.connectFlags);
+}
+
+void test_connect_refused_and_timeout() {
+  MqttClient m(broker);
+  m.timeoutMs = 100;
+  broker.connackCode = 5;   // Not authorized
+  TEST_ASSERT_FALSE(m.connect("broker", 1883, "dev"));
+  TEST_ASSERT_EQUAL(5, m.lastReturnCode());
+  TEST_ASSERT_FALSE(m.connected());
+
+  broker.answerConnect = false;
+  uint32_t start = millis();
+  TEST_ASSERT_FALSE(m.connect("broker", 1883, "dev"));
+  TEST_ASSERT_EQUAL(0xFF, m.lastReturnCode());
+  TEST_ASSERT_GREATER_OR_EQUAL(100, millis() - start);
+}
+
+void test_publish_qos1_waits_for_its_ack() {
+  MqttClient m(broker);
+  TEST_ASSERT_TRUE(m.connect("broker", 1883, "dev"));
+  broker.staleAckFirst = true;
+  TEST_ASSERT_TRUE(publishText(m, "thlogger/dev/alerts", "{\"seq\":1}"));
+  TEST_ASSERT_TRUE(publishText(m, "thlogger/dev/alerts", "{\"seq\":2}"));
+  TEST_ASSERT_EQUAL(2, broker.published.size());
+  TEST_ASSERT_EQUAL_STRING("thlogger/dev/alerts", broker.published[0].topic.c_str());
+  TEST_ASSERT_EQUAL_STRING("{\"seq\":2}", broker.published[1].payload.c_str());
+  TEST_ASSERT_EQUAL(1, broker.published[0].qos);
+  TEST_ASSERT_TRUE(broker.published[0].id != broker.published[1].id);
+  TEST_ASSERT_TRUE(broker.published[0].id != 0);
+}
+
+void test_publish_qos0_and_retain() {
+  MqttClient m(broker);
+  TEST_ASSERT_TRUE(m.connect("broker", 1883, "dev"));
+  broker.ackPublishes = false;   // QoS 0 must not wait
+  TEST_ASSERT_TRUE(publishText(m, "t", "x", 0, true));
+  TEST_ASSERT_EQUAL(0, broker.published[0].qos);
+  TEST_ASSERT_TRUE(broker.published[0].retain);
+  TEST_ASSERT_TRUE(m.connected());
+}
+
+// Remaining length needs two and three bytes; partial writes are resumed
+void test_large_payloads() {
+  MqttClient m(broker);
+  TEST_ASSERT_TRUE(m.connect("broker", 1883, "dev"));
+  broker.writeChunk = 61;
+  std::string mid(300, 'a'), big(20000, 'b');
+  TEST_ASSERT_TRUE(publishText(m, "t/mid", mid));
+  TEST_ASSERT_TRUE(publishText(m, "t/big", big));
+  TEST_ASSERT_EQUAL(2, broker.published.size());
+  TEST_ASSERT_TRUE(broker.published[0].payload == mid);
+  TEST_ASSERT_TRUE(broker.published[1].payload == big);
+}
+
+// A missing PUBACK fails the publish and drops the connection for a retry
+void test_publish_without_ack_disconnects() {
+  MqttClient m(broker);
+  m.timeoutMs = 50;
+  TEST_ASSERT_TRUE(m.connect("broker", 1883, "dev"));
+  broker.ackPublishes = false;
+  TEST_ASSERT_FALSE(publishText(m, "t", "lost"));
+  TEST_ASSERT_FALSE(m.connected());
+  TEST_ASSERT_FALSE(publishText(m, "t", "not sent"));
+  TEST_ASSERT_EQUAL(1, broker.published.size());
+}
+
+void test_keepalive_ping() {
+  MqttClient m(broker);
+  TEST_ASSERT_TRUE(m.connect("broker", 1883, "dev", nullptr, nullptr, 10));
+  TEST_ASSERT_TRUE(m.poll());
+  TEST_ASSERT_EQUAL(0, broker.pings);
+  fakeAdvanceMs(5000);
+  TEST_ASSERT_TRUE(m.poll());
+  TEST_ASSERT_EQUAL(1, broker.pings);
+  TEST_ASSERT_TRUE(m.poll());
+  TEST_ASSERT_EQUAL(1, broker.pings);
+}
+
+void test_disconnect() {
+  MqttClient m(broker);
+  TEST_ASSERT_TRUE(m.connect("broker", 1883, "dev"));
+  m.disconnect();
+  TEST_ASSERT_EQUAL(1, broker.disconnects);
+  TEST_ASSERT_FALSE(m.connected());
+  TEST_ASSERT_FALSE(broker.up);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_connect_with_credentials);
+  RUN_TEST(test_connect_anonymous);
+  RUN_TEST(test_connect_refused_and_timeout);
+  RUN_TEST(test_publish_qos1_waits_for_its_ack);
+  RUN_TEST(test_publish_qos0_and_retain);
+  RUN_TEST(test_large_payloads);
+  RUN_TEST(test_publish_without_ack_disconnects);
+  RUN_TEST(test_keepalive_ping);
+  RUN_TEST(test_disconnect);
+  return UNITY_END();
+}
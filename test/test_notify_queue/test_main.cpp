@@ -0,0 +1,140 @@
+// Notification queue (drop-oldest, ack by seq, restore from flash) and the
+// JSON batch the webhook and MQTT transports send
+#include <unity.h>
+#include <math.h>
+#include "notify_queue.h"
+
+static Notification event(uint32_t ts, const char *name = "temperature") {
+  Notification n = {};
+  n.ts = ts;
+  n.value = 41.234f;
+  n.threshold = 40.0f;
+  n.event = NOTIFY_RAISED;
+  n.rule = 2;
+  n.channel = 0;
+  n.type = RULE_ABOVE;
+  n.metric = METRIC_T;
+  strncpy(n.name, name, sizeof(n.name) - 1);
+  return n;
+}
+
+static const char *channelName(uint8_t c) { return c == 0 ? "probe-1" : "probe-2"; }
+
+void setUp() {}
+void tearDown() {}
+
+void test_push_assigns_seq_and_drops_oldest() {
+  NotifyQueue<4> q;
+  TEST_ASSERT_TRUE(q.empty());
+  for (uint32_t i = 0; i < 6; i++) TEST_ASSERT_EQUAL(i + 1, q.push(event(1000 + i)));
+  TEST_ASSERT_EQUAL(4, q.size());
+  TEST_ASSERT_EQUAL(2, q.dropped());
+  TEST_ASSERT_EQUAL(3, q.at(0).seq);
+  TEST_ASSERT_EQUAL(1002, q.at(0).ts);
+  TEST_ASSERT_EQUAL(7, q.nextSeq());
+}
+
+// Delivered entries leave the queue only once acknowledged
+void test_peek_and_ack() {
+  NotifyQueue<8> q;
+  for (uint32_t i = 0; i < 5; i++) q.push(event(i));
+  Notification batch[3];
+  TEST_ASSERT_EQUAL(3, q.peek(batch, 3));
+  TEST_ASSERT_EQUAL(5, q.size());
+  TEST_ASSERT_EQUAL(1, batch[0].seq);
+  q.ackThrough(batch[2].seq);
+  TEST_ASSERT_EQUAL(2, q.size());
+  TEST_ASSERT_EQUAL(4, q.at(0).seq);
+  q.ackThrough(2);   // Stale ack: nothing to remove
+  TEST_ASSERT_EQUAL(2, q.size());
+  TEST_ASSERT_EQUAL(2, q.peek(batch, 3));
+  q.ackThrough(100);
+  TEST_ASSERT_TRUE(q.empty());
+}
+
+// Sequence numbers compare modulo 2^32
+void test_ack_across_seq_wrap() {
+  NotifyQueue<4> q;
+  q.restore(nullptr, 0, 0xFFFFFFFE);
+  q.push(event(1));
+  q.push(event(2));
+  q.push(event(3));
+  TEST_ASSERT_EQUAL(0, q.at(2).seq);
+  q.ackThrough(0xFFFFFFFF);
+  TEST_ASSERT_EQUAL(1, q.size());
+  TEST_ASSERT_EQUAL(0, q.at(0).seq);
+}
+
+// Restoring more entries than fit keeps the newest
+void test_restore() {
+  Notification saved[6];
+  for (uint32_t i = 0; i < 6; i++) {
+    saved[i] = event(i);
+    saved[i].seq = 10 + i;
+  }
+  NotifyQueue<4> q;
+  q.push(event(99));
+  q.restore(saved, 6, 16);
+  TEST_ASSERT_EQUAL(4, q.size());
+  TEST_ASSERT_EQUAL(12, q.at(0).seq);
+  TEST_ASSERT_EQUAL(15, q.at(3).seq);
+  TEST_ASSERT_EQUAL(16, q.push(event(100)));
+  TEST_ASSERT_EQUAL(13, q.at(0).seq);
+}
+
+void test_batch_json() {
+  Notification items[2] = {event(1705325415), event(1705325715)};
+  items[0].seq = 12;
+  items[1].seq = 13;
+  items[1].event = NOTIFY_CLEARED;
+  items[1].channel = 1;
+  items[1].metric = METRIC_DP;
+  items[1].type = RULE_BELOW;
+  items[1].value = -1.5f;
+  items[1].threshold = 2.0f;
+  char out[1024];
+  size_t len = formatNotifyBatch(out, sizeof(out), "tr-cam1", channelName, items, 2);
+  TEST_ASSERT_EQUAL(strlen(out), len);
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"device\":\"tr-cam1\",\"events\":["
+      "{\"seq\":12,\"ts\":1705325415,\"event\":\"raised\",\"rule\":2,\"name\":\"temperature\","
+      "\"channel\":\"probe-1\",\"metric\":\"t\",\"type\":\"above\",\"value\":41.23,\"threshold\":40.00},"
+      "{\"seq\":13,\"ts\":1705325715,\"event\":\"cleared\",\"rule\":2,\"name\":\"temperature\","
+      "\"channel\":\"probe-2\",\"metric\":\"dp\",\"type\":\"below\",\"value\":-1.50,\"threshold\":2.00}]}",
+      out);
+}
+
+// Names are escaped, control characters dropped, NaN becomes null
+void test_batch_escaping_and_nan() {
+  Notification n = event(1705325415, "a\"b\\c\nd");
+  n.seq = 1;
+  n.value = NAN;
+  char out[512];
+  TEST_ASSERT_GREATER_THAN(0, formatNotifyBatch(out, sizeof(out), "dev", channelName, &n, 1));
+  TEST_ASSERT_TRUE(strstr(out, "\"name\":\"a\\\"b\\\\cd\"") != nullptr);
+  TEST_ASSERT_TRUE(strstr(out, "\"value\":null,") != nullptr);
+}
+
+// A batch that does not fit is rejected, never truncated
+void test_batch_overflow() {
+  Notification items[3] = {event(1), event(2), event(3)};
+  char out[1024];
+  size_t full = formatNotifyBatch(out, sizeof(out), "dev", channelName, items, 3);
+  TEST_ASSERT_GREATER_THAN(0, full);
+  for (size_t cap = 1; cap <= full; cap++) {
+    TEST_ASSERT_EQUAL(0, formatNotifyBatch(out, cap, "dev", channelName, items, 3));
+  }
+  TEST_ASSERT_EQUAL(full, formatNotifyBatch(out, full + 1, "dev", channelName, items, 3));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_push_assigns_seq_and_drops_oldest);
+  RUN_TEST(test_peek_and_ack);
+  RUN_TEST(test_ack_across_seq_wrap);
+  RUN_TEST(test_restore);
+  RUN_TEST(test_batch_json);
+  RUN_TEST(test_batch_escaping_and_nan);
+  RUN_TEST(test_batch_overflow);
+  return UNITY_END();
+}
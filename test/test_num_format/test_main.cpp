@@ -0,0 +1,154 @@
+// num_format.h against libc: formatFixed()/formatScaled() must print what
+// printf("%.Nf") prints (except "-0") and parseFixed() must return the float
+// strtof() returns, over the sensor ranges and random values.
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include "num_format.h"
+
+static uint32_t rngState;
+static uint32_t rng() {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return rngState;
+}
+
+void setUp() { rngState = 2463534242u; }
+void tearDown() {}
+
+// printf() text with "-0", "-0.00" turned into "0", "0.00"
+static void printfFixed(char *out, size_t size, float v, int decimals) {
+  snprintf(out, size, "%.*f", decimals, v);
+  if (out[0] == '-' && strspn(out + 1, "0.") == strlen(out + 1)) memmove(out, out + 1, strlen(out));
+}
+
+static void assertFixed(float v, uint8_t decimals) {
+  char got[NUM_FORMAT_MAX + 1], expect[64], msg[96];
+  got[formatFixed(got, v, decimals, false)] = '\0';
+  printfFixed(expect, sizeof(expect), v, decimals);
+  snprintf(msg, sizeof(msg), "%.9g with %u decimals", v, decimals);
+  TEST_ASSERT_EQUAL_STRING_MESSAGE(expect, got, msg);
+}
+
+static const char *fixed(float v, uint8_t decimals, bool trim) {
+  static char s[NUM_FORMAT_MAX + 1];
+  s[formatFixed(s, v, decimals, trim)] = '\0';
+  return s;
+}
+
+void test_format_fixed_vectors() {
+  TEST_ASSERT_EQUAL_STRING("21.5", fixed(21.5f, 2, true));
+  TEST_ASSERT_EQUAL_STRING("21.50", fixed(21.5f, 2, false));
+  TEST_ASSERT_EQUAL_STRING("21", fixed(21.0f, 2, true));
+  TEST_ASSERT_EQUAL_STRING("0.0", fixed(-0.04f, 1, false));      // Never "-0.0"
+  TEST_ASSERT_EQUAL_STRING("0", fixed(-0.0f, 2, true));
+  TEST_ASSERT_EQUAL_STRING("-0.1", fixed(-0.05f, 1, false));     // -0.0500000007 rounds away
+  TEST_ASSERT_EQUAL_STRING("0.2", fixed(0.25f, 1, false));       // Exact tie: to even
+  TEST_ASSERT_EQUAL_STRING("0.3", fixed(0.35f, 1, false));       // 0.3499999940: no tie, rounds down
+  TEST_ASSERT_EQUAL_STRING("-40.0", fixed(-40.0f, 1, false));
+  TEST_ASSERT_EQUAL_STRING("100.00", fixed(100.0f, 2, false));
+  TEST_ASSERT_EQUAL_STRING("3.1416", fixed(3.14159265f, 9, false)); // Clamped to 4
+  TEST_ASSERT_EQUAL_UINT(0, formatFixed(nullptr, NAN, 1));
+  TEST_ASSERT_EQUAL_UINT(0, formatFixed(nullptr, INFINITY, 1));
+  assertFixed(1e15f, 2);                                         // snprintf fallback
+  assertFixed(-3e9f, 0);
+  TEST_ASSERT_EQUAL_STRING("", fixed(1e20f, 2, false));          // Longer than NUM_FORMAT_MAX
+  TEST_ASSERT_EQUAL_STRING("", fixed(-FLT_MAX, 4, false));
+  assertFixed(1e-30f, 4);                                        // Subnormal-ish, rounds to 0
+}
+
+// Readings (one decimal), aggregates (two), eighths (exact ties) and noise
+void test_format_fixed_matches_printf() {
+  for (int i = 0; i < 200000; i++) {
+    float v;
+    switch (i % 4) {
+      case 0: v = ((int)(rng() % 2000) - 500) / 10.0f; break;
+      case 1: v = ((int)(rng() % 20000) - 5000) / 100.0f; break;
+      case 2: v = ((int)(rng() % 8000) - 4000) / 8.0f; break;
+      default: v = ((float)(rng() % 1000000) / 1000000.0f - 0.5f) * 2e5f; break;
+    }
+    for (uint8_t d = 0; d <= 4; d++) assertFixed(v, d);
+  }
+}
+
+void test_format_integers() {
+  char s[NUM_FORMAT_MAX + 1];
+  s[formatUint(s, 0)] = '\0';
+  TEST_ASSERT_EQUAL_STRING("0", s);
+  s[formatUint(s, 4294967295u)] = '\0';
+  TEST_ASSERT_EQUAL_STRING("4294967295", s);
+  s[formatInt(s, -2147483647 - 1)] = '\0';
+  TEST_ASSERT_EQUAL_STRING("-2147483648", s);
+  for (int i = 0; i < 100000; i++) {
+    uint32_t v = rng() >> (rng() % 32);
+    char expect[16];
+    snprintf(expect, sizeof(expect), "%u", (unsigned)v);
+    s[formatUint(s, v)] = '\0';
+    TEST_ASSERT_EQUAL_STRING(expect, s);
+  }
+}
+
+void test_format_scaled() {
+  char s[NUM_FORMAT_MAX + 1], expect[32];
+  for (int32_t v = -100000; v <= 100000; v++) {
+    snprintf(expect, sizeof(expect), "%s%d.%02d", v < 0 ? "-" : "", abs(v) / 100, abs(v) % 100);
+    s[formatScaled(s, v, 2)] = '\0';
+    TEST_ASSERT_EQUAL_STRING(expect, s);
+  }
+  s[formatScaled(s, -512, 2, true)] = '\0';
+  TEST_ASSERT_EQUAL_STRING("-5.12", s);
+  s[formatScaled(s, 2150, 2, true)] = '\0';
+  TEST_ASSERT_EQUAL_STRING("21.5", s);
+  s[formatScaled(s, -2147483647 - 1, 0)] = '\0';
+  TEST_ASSERT_EQUAL_STRING("-2147483648", s);
+}
+
+void test_parse_fixed_matches_strtof() {
+  char txt[64];
+  for (int i = 0; i < 300000; i++) {
+    float v = ((float)(rng() % 4000001) / 10000.0f) - 200.0f;
+    snprintf(txt, sizeof(txt), "%.*f", i % 8, v);
+    float got;
+    TEST_ASSERT_TRUE_MESSAGE(parseFixed(txt, got), txt);
+    float expect = strtof(txt, nullptr);
+    TEST_ASSERT_EQUAL_MEMORY_MESSAGE(&expect, &got, sizeof(float), txt);
+  }
+}
+
+void test_parse_accepts_and_rejects() {
+  const char *accepts[] = {"5.", ".5", "+3", "-0.05", "00012.50", "123456789012", "0.000000000001", "-0"};
+  for (const char *s : accepts) {
+    float v;
+    TEST_ASSERT_TRUE_MESSAGE(parseFixed(s, v), s);
+    float expect = strtof(s, nullptr);
+    TEST_ASSERT_EQUAL_MEMORY_MESSAGE(&expect, &v, sizeof(float), s);
+  }
+  const char *rejects[] = {"", "-", ".", "1e3", "12a", " 1", "1 ", "1.2.3", "+-1", "abc", "0x10", "nan", "inf"};
+  for (const char *s : rejects) {
+    float v = 7;
+    TEST_ASSERT_FALSE_MESSAGE(parseFixed(s, v), s);
+    TEST_ASSERT_EQUAL_FLOAT(7, v);
+  }
+
+  uint32_t u = 0;
+  TEST_ASSERT_TRUE(parseUint("4294967295", u));
+  TEST_ASSERT_EQUAL_UINT32(4294967295u, u);
+  TEST_ASSERT_FALSE(parseUint("4294967296", u));
+  TEST_ASSERT_FALSE(parseUint("-1", u));
+  TEST_ASSERT_FALSE(parseUint("", u));
+  TEST_ASSERT_FALSE(parseUint("12 ", u));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_format_fixed_vectors);
+  RUN_TEST(test_format_fixed_matches_printf);
+  RUN_TEST(test_format_integers);
+  RUN_TEST(test_format_scaled);
+  RUN_TEST(test_parse_fixed_matches_strtof);
+  RUN_TEST(test_parse_accepts_and_rejects);
+  return UNITY_END();
+}
@@ -0,0 +1,285 @@
+// Fault injection for everything that writes persistent state: power is cut
+// at random points (or at every byte) while the raw log appends, the
+// power-fail snapshot is written or re-armed, the config store commits and
+// the history file is saved. After each simulated reboot the data must be
+// the old or the new state - never a torn mix - and writing must go on.
+#include <unity.h>
+#include <vector>
+#include "FS.h"
+#include "flash_sim.h"
+#include "raw_log.h"
+#include "emergency_snapshot.h"
+#include "config_store.h"
+#include "history_recovery.h"
+
+static uint32_t rngState = 12345;
+static uint32_t rng(uint32_t n) {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return rngState % n;
+}
+
+static HistoryRecord record(uint32_t ts) {
+  HistoryRecord r = {};
+  r.ts = ts;
+  r.t = ts * 0.01f;
+  r.h = 50;
+  r.n = 10;
+  return r;
+}
+
+void setUp() { rngState = 12345; }
+void tearDown() {}
+
+// ---- Raw log (aggregate group commits) ----
+
+static std::vector<uint32_t> logContents(SimFlash &flash) {
+  RawLog<HistoryRecord> log(flash);
+  TEST_ASSERT_TRUE(log.mount());
+  std::vector<uint32_t> ts;
+  log.forEach([&](const HistoryRecord &r) { ts.push_back(r.ts); });
+  return ts;
+}
+
+void test_raw_log_cut_during_append() {
+  SimFlash flash(16 * FLASH_SECTOR_SIZE, 0xA5);   // Starts out as foreign data
+  uint32_t committed = 0;                          // Newest ts of a completed append
+  for (int trial = 0; trial < 3000; trial++) {
+    std::vector<uint32_t> before = logContents(flash);
+    uint32_t next = before.empty() ? 1 : before.back() + 1;
+    HistoryRecord batch[12];
+    for (int k = 0; k < 12; k++) batch[k] = record(next + k);
+
+    RawLog<HistoryRecord> log(flash);
+    log.mount();
+    flash.powerCutAfter = rng(600);
+    if (log.append(batch, 12)) committed = next + 11;
+    flash.powerCutAfter = -1;
+
+    // Reboot: strictly increasing, nothing committed lost, appends work again
+    std::vector<uint32_t> after = logContents(flash);
+    TEST_ASSERT_FALSE(after.empty() && committed);
+    for (size_t i = 1; i < after.size(); i++) TEST_ASSERT_TRUE(after[i] > after[i - 1]);
+    if (committed) TEST_ASSERT_TRUE(after.back() >= committed);
+    RawLog<HistoryRecord> again(flash);
+    again.mount();
+    HistoryRecord probe = record((after.empty() ? 0 : after.back()) + 100);
+    TEST_ASSERT_TRUE(again.append(probe));
+    committed = probe.ts;
+    TEST_ASSERT_EQUAL(probe.ts, logContents(flash).back());
+  }
+}
+
+// ---- Power-fail snapshot ----
+
+typedef EmergencySnapshot<2, 60, 32> Snapshot;
+
+void test_snapshot_cut_during_write_and_rearm() {
+  static SimFlash flash(2 * FLASH_SECTOR_SIZE, 0x3C);
+  static Snapshot boot;
+  boot.begin(flash);
+  boot.prepare();
+  uint32_t base = 1000;
+  int recovered = 0;
+  for (int trial = 0; trial < 5000; trial++) {
+    static Snapshot s;
+    s = Snapshot();
+    s.begin(flash);
+    s.prepare();
+    for (uint32_t k = 0; k < 70; k++) s.sample(k & 1, base + k, 21.5f, 40.0f, 0, 0);
+    BucketAccumulator b;
+    b.reset(base);
+    b.add(21.5f, 40, 3);
+    s.bucket(0, b, 10);
+    HistoryRecord staged[3] = {record(base), record(base + 300), record(base + 600)};
+
+    // Cut during the snapshot, or during the re-arm erase after it
+    bool rearm = rng(3) == 0;
+    flash.powerCutAfter = rng(3000);
+    bool written = s.write(1, base, staged, 3);
+    if (written && rearm) s.prepare();
+    flash.powerCutAfter = -1;
+
+    static Snapshot r;
+    r = Snapshot();
+    r.begin(flash);
+    static Snapshot::Image img;
+    SnapshotHeader hdr;
+    if (r.load(img, hdr)) {
+      recovered++;
+      // Any snapshot found is complete and self-consistent
+      uint32_t last = 0;
+      img.forEachSample(1, [&](const SnapshotSample &x) { last = x.ts; });
+      uint32_t taken = last - 69;
+      TEST_ASSERT_EQUAL(3, hdr.staged);
+      TEST_ASSERT_EQUAL(taken, img.staged[0].ts);
+      TEST_ASSERT_EQUAL(taken + 600, img.staged[2].ts);
+      TEST_ASSERT_EQUAL(taken, img.channels[0].bucket.bucketTs);
+      TEST_ASSERT_EQUAL(1, img.channels[0].bucket.n);
+      // A finished snapshot that was not re-armed away is the one found
+      if (written && !rearm) TEST_ASSERT_EQUAL(base, taken);
+    } else {
+      TEST_ASSERT_FALSE(written && !rearm);
+    }
+    base += 100000;
+  }
+  TEST_ASSERT_GREATER_THAN(0, recovered);
+}
+
+// ---- Config store ----
+
+static std::string loadConfig(fs::FS &flash) {
+  ConfigStore store(flash, "/config_a.bin", "/config_b.bin");
+  char buf[256];
+  size_t n = store.load(buf, sizeof(buf));
+  return std::string(buf, n);
+}
+
+void test_config_cut_at_every_byte() {
+  const char *older = "{\"rules\":[1,2,3]}";
+  const char *newer = "{\"rules\":[1,2,3,4],\"log_level\":4}";
+  size_t commitBytes = sizeof(ConfigSlotHeader) + strlen(newer);
+  for (int history = 1; history <= 3; history++) {
+    for (size_t cut = 0; cut <= commitBytes; cut++) {
+      fs::FS flash;
+      {
+        ConfigStore store(flash, "/config_a.bin", "/config_b.bin");
+        char buf[256];
+        store.load(buf, sizeof(buf));
+        for (int i = 0; i < history; i++) TEST_ASSERT_TRUE(store.commit(older, strlen(older)));
+        flash.powerCutAfter = cut;
+        bool ok = store.commit(newer, strlen(newer));
+        TEST_ASSERT_EQUAL(cut == commitBytes, ok);
+      }
+      flash.powerCutAfter = -1;
+
+      std::string got = loadConfig(flash);
+      TEST_ASSERT_TRUE(got == (cut == commitBytes ? newer : older));
+
+      // The next commit must win over whatever the torn one left behind
+      {
+        ConfigStore store(flash, "/config_a.bin", "/config_b.bin");
+        char buf[256];
+        store.load(buf, sizeof(buf));
+        TEST_ASSERT_TRUE(store.commit("{}", 2));
+      }
+      TEST_ASSERT_EQUAL_STRING("{}", loadConfig(flash).c_str());
+    }
+  }
+}
+
+// ---- History file ----
+
+struct FileReader {
+  const std::vector<uint8_t> &data;
+  size_t size() { return data.size(); }
+  bool read(size_t offset, void *buf, size_t len) {
+    if (offset + len > data.size()) return false;
+    memcpy(buf, data.data() + offset, len);
+    return true;
+  }
+};
+
+// Writes a history file the way saveToPersistentStorage() does (header,
+// then blocks of records each followed by its CRC32)
+static void writeHistory(fs::FS &flash, const char *path, uint32_t count, uint32_t firstTs) {
+  HistoryHeader hdr = {};
+  hdr.magic = HISTORY_MAGIC;
+  hdr.version = HISTORY_VERSION;
+  hdr.recordSize = sizeof(HistoryRecord);
+  hdr.count = count;
+  hdr.firstTs = firstTs;
+  hdr.lastTs = firstTs + count - 1;
+  hdr.crc = historyHeaderCrc(hdr);
+  File f = flash.open(path, "w");
+  if (!f) return;
+  f.write((const uint8_t *)&hdr, sizeof(hdr));
+  HistoryRecord block[HISTORY_BLOCK_RECORDS];
+  size_t n = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    block[n++] = record(firstTs + i);
+    if (n == HISTORY_BLOCK_RECORDS || i + 1 == count) {
+      uint32_t crc = crc32Update(0, block, n * sizeof(HistoryRecord));
+      f.write((const uint8_t *)block, n * sizeof(HistoryRecord));
+      f.write((const uint8_t *)&crc, sizeof(crc));
+      n = 0;
+    }
+  }
+  f.close();
+}
+
+static std::vector<uint32_t> scan(const std::vector<uint8_t> &file, HistoryScanReport &report) {
+  FileReader reader = {file};
+  std::vector<uint32_t> ts;
+  report = scanHistory(reader, 1 << 20, [&](const HistoryRecord &r) { ts.push_back(r.ts); }, [] { return false; });
+  return ts;
+}
+
+// A save cut at any byte: exactly the complete blocks are recovered
+void test_history_cut_at_every_byte() {
+  const uint32_t COUNT = 100, FIRST = 1705320000;
+  const size_t blockBytes = HISTORY_BLOCK_RECORDS * sizeof(HistoryRecord) + sizeof(uint32_t);
+  size_t total = historyFileSize(HISTORY_VERSION, sizeof(HistoryRecord), COUNT);
+  for (size_t cut = 0; cut <= total; cut++) {
+    fs::FS flash;
+    flash.powerCutAfter = cut;
+    writeHistory(flash, "/history.bin", COUNT, FIRST);
+    flash.powerCutAfter = -1;
+    static const std::vector<uint8_t> none;
+    const std::vector<uint8_t> *file = flash.file("/history.bin");
+    if (!file) file = &none;   // Cut before the file was created
+
+    HistoryScanReport report;
+    std::vector<uint32_t> got = scan(*file, report);
+    size_t expect = 0;
+    for (size_t b = 0; b * HISTORY_BLOCK_RECORDS < COUNT; b++) {
+      size_t recs = COUNT - b * HISTORY_BLOCK_RECORDS < HISTORY_BLOCK_RECORDS ? COUNT - b * HISTORY_BLOCK_RECORDS
+                                                                              : HISTORY_BLOCK_RECORDS;
+      if (sizeof(HistoryHeader) + b * blockBytes + recs * sizeof(HistoryRecord) + 4 <= file->size()) expect += recs;
+    }
+    TEST_ASSERT_EQUAL(expect, got.size());
+    for (size_t i = 0; i < got.size(); i++) {
+      TEST_ASSERT_TRUE(got[i] >= FIRST && got[i] < FIRST + COUNT);
+      if (i) TEST_ASSERT_TRUE(got[i] < got[i - 1]);   // Newest first
+    }
+    TEST_ASSERT_EQUAL(cut < total, report.damaged());
+  }
+}
+
+// Random bit rot: damaged blocks are dropped, never delivered
+void test_history_bit_flips() {
+  const uint32_t COUNT = 300, FIRST = 1705320000;
+  const size_t blockBytes = HISTORY_BLOCK_RECORDS * sizeof(HistoryRecord) + sizeof(uint32_t);
+  fs::FS flash;
+  writeHistory(flash, "/history.bin", COUNT, FIRST);
+  const std::vector<uint8_t> original = *flash.file("/history.bin");
+  for (int trial = 0; trial < 2000; trial++) {
+    std::vector<uint8_t> file = original;
+    for (uint32_t k = 0, n = 1 + rng(4); k < n; k++) file[rng(file.size())] ^= 1 << rng(8);
+    std::vector<bool> hit((COUNT + HISTORY_BLOCK_RECORDS - 1) / HISTORY_BLOCK_RECORDS, false);
+    for (size_t o = sizeof(HistoryHeader); o < file.size(); o++) {
+      if (file[o] != original[o]) hit[(o - sizeof(HistoryHeader)) / blockBytes] = true;
+    }
+
+    HistoryScanReport report;
+    std::vector<uint32_t> got = scan(file, report);
+    size_t expect = 0;
+    for (size_t b = 0; b < hit.size(); b++) {
+      if (!hit[b]) expect += b + 1 < hit.size() ? HISTORY_BLOCK_RECORDS : COUNT - b * HISTORY_BLOCK_RECORDS;
+    }
+    TEST_ASSERT_EQUAL(expect, got.size());
+    for (uint32_t ts : got) TEST_ASSERT_FALSE(hit[(ts - FIRST) / HISTORY_BLOCK_RECORDS]);
+    TEST_ASSERT_TRUE(report.damaged() || file == original);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_raw_log_cut_during_append);
+  RUN_TEST(test_snapshot_cut_during_write_and_rearm);
+  RUN_TEST(test_config_cut_at_every_byte);
+  RUN_TEST(test_history_cut_at_every_byte);
+  RUN_TEST(test_history_bit_flips);
+  return UNITY_END();
+}
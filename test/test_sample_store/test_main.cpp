@@ -0,0 +1,111 @@
+// SampleRing (per-channel SoA history) and BucketAccumulator (5-minute rollup)
+#include <unity.h>
+#include "sample_store.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_push_until_full() {
+  SampleRing<4> r;
+  TEST_ASSERT_TRUE(r.empty());
+  TEST_ASSERT_EQUAL(4, SampleRing<4>::capacity());
+  for (uint32_t i = 0; i < 4; i++) {
+    size_t idx = r.push(100 + i, 20.0f + i, 50.0f + i, 1, i, 10 * i);
+    TEST_ASSERT_EQUAL(i, idx);
+    TEST_ASSERT_EQUAL(i + 1, r.size());
+  }
+  TEST_ASSERT_TRUE(r.full());
+  TEST_ASSERT_EQUAL(103, r.ts[r.newest()]);
+  TEST_ASSERT_EQUAL_FLOAT(22.0f, r.t[r.at(2)]);
+  TEST_ASSERT_EQUAL_FLOAT(52.0f, r.h[r.at(2)]);
+  TEST_ASSERT_EQUAL(2, r.missed[r.at(2)]);
+  TEST_ASSERT_EQUAL(20, r.jitterMs[r.at(2)]);
+}
+
+// A full ring overwrites its oldest entry and keeps the order oldest-first
+void test_overwrite_oldest() {
+  SampleRing<4> r;
+  for (uint32_t i = 0; i < 11; i++) r.push(i, (float)i, 0, 1, 0, 0);
+  TEST_ASSERT_EQUAL(4, r.size());
+  for (size_t i = 0; i < r.size(); i++) {
+    TEST_ASSERT_EQUAL(7 + i, r.ts[r.at(i)]);
+    TEST_ASSERT_EQUAL_FLOAT(7.0f + i, r.t[r.at(i)]);
+  }
+  TEST_ASSERT_EQUAL(10, r.ts[r.newest()]);
+}
+
+// The deferred history load prepends older records in front of live samples
+void test_push_front() {
+  SampleRing<5> r;
+  r.push(300, 3, 0, 1, 0, 0);
+  r.push(400, 4, 0, 1, 0, 0);
+  TEST_ASSERT_TRUE(r.pushFront(200, 2, 0, 1, 0, 0));
+  TEST_ASSERT_TRUE(r.pushFront(100, 1, 0, 1, 0, 0));
+  TEST_ASSERT_TRUE(r.pushFront(0, 0, 0, 1, 0, 0));
+  TEST_ASSERT_FALSE(r.pushFront(1, 1, 0, 1, 0, 0));
+  TEST_ASSERT_EQUAL(5, r.size());
+  for (size_t i = 0; i < r.size(); i++) TEST_ASSERT_EQUAL(i * 100, r.ts[r.at(i)]);
+
+  // Pushing on after prepending still drops the prepended oldest first
+  r.push(500, 5, 0, 1, 0, 0);
+  TEST_ASSERT_EQUAL(100, r.ts[r.at(0)]);
+  TEST_ASSERT_EQUAL(500, r.ts[r.newest()]);
+}
+
+void test_drop_oldest_and_clear() {
+  SampleRing<4> r;
+  for (uint32_t i = 0; i < 6; i++) r.push(i, 0, 0, 1, 0, 0);
+  r.dropOldest(1);
+  TEST_ASSERT_EQUAL(3, r.size());
+  TEST_ASSERT_EQUAL(3, r.ts[r.at(0)]);
+  r.dropOldest(10);
+  TEST_ASSERT_TRUE(r.empty());
+  r.push(42, 0, 0, 1, 0, 0);
+  TEST_ASSERT_EQUAL(42, r.ts[r.at(0)]);
+  r.clear();
+  TEST_ASSERT_EQUAL(0, r.size());
+  TEST_ASSERT_TRUE(r.pushFront(7, 0, 0, 1, 0, 0));
+  TEST_ASSERT_EQUAL(7, r.ts[r.newest()]);
+}
+
+void test_bucket_accumulator() {
+  BucketAccumulator b;
+  TEST_ASSERT_EQUAL(0, b.n);
+  b.reset(1705325400);
+  b.add(20.0f, 40.0f, 5);
+  b.add(22.0f, 44.0f, 120);
+  b.add(24.0f, 48.0f, 30);
+  TEST_ASSERT_EQUAL(1705325400, b.bucketTs);
+  TEST_ASSERT_EQUAL(3, b.n);
+  TEST_ASSERT_EQUAL_FLOAT(22.0f, b.sumT / b.n);
+  TEST_ASSERT_EQUAL_FLOAT(44.0f, b.sumH / b.n);
+  TEST_ASSERT_EQUAL(120, b.maxJitterMs);
+
+  b.reset(1705325700);
+  TEST_ASSERT_EQUAL(0, b.n);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, b.sumT);
+  TEST_ASSERT_EQUAL(0, b.maxJitterMs);
+}
+
+// Channels own separate arrays: a push to one never shows up in another
+void test_channels_independent() {
+  static SampleRing<8> rings[3];
+  for (uint32_t i = 0; i < 8; i++) rings[i % 3].push(i, (float)(i % 3), 0, 1, 0, 0);
+  TEST_ASSERT_EQUAL(3, rings[0].size());
+  TEST_ASSERT_EQUAL(3, rings[1].size());
+  TEST_ASSERT_EQUAL(2, rings[2].size());
+  for (size_t c = 0; c < 3; c++) {
+    for (size_t i = 0; i < rings[c].size(); i++) TEST_ASSERT_EQUAL_FLOAT((float)c, rings[c].t[rings[c].at(i)]);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_push_until_full);
+  RUN_TEST(test_overwrite_oldest);
+  RUN_TEST(test_push_front);
+  RUN_TEST(test_drop_oldest_and_clear);
+  RUN_TEST(test_bucket_accumulator);
+  RUN_TEST(test_channels_independent);
+  return UNITY_END();
+}
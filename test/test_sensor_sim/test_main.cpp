@@ -0,0 +1,62 @@
+// Simulated driver: reproducible per seed, plausible values, driver contract
+#include <unity.h>
+#include "sensor_sim.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_same_seed_same_readings() {
+  SimulatedSensor a(7), b(7), c(8);
+  bool differs = false;
+  for (int i = 0; i < 1000; i++) {
+    float ta, ha, tb, hb, tc, hc;
+    TEST_ASSERT_TRUE(a.read(ta, ha));
+    TEST_ASSERT_TRUE(b.read(tb, hb));
+    TEST_ASSERT_TRUE(c.read(tc, hc));
+    TEST_ASSERT_EQUAL_FLOAT(ta, tb);
+    TEST_ASSERT_EQUAL_FLOAT(ha, hb);
+    if (ta != tc) differs = true;
+  }
+  TEST_ASSERT_TRUE(differs);
+}
+
+// One full wave stays inside the plausibility window used by the sampler
+void test_values_plausible() {
+  SimulatedSensor s(42);
+  float minT = 100, maxT = -100;
+  for (int i = 0; i < 3600; i++) {
+    float t, h;
+    s.read(t, h);
+    TEST_ASSERT_TRUE(t >= 18.5f && t <= 25.5f);
+    TEST_ASSERT_TRUE(h >= 39.0f && h <= 61.0f);
+    if (t < minT) minT = t;
+    if (t > maxT) maxT = t;
+  }
+  TEST_ASSERT_GREATER_THAN(5.0f, maxT - minT);
+}
+
+void test_driver_contract() {
+  SimulatedSensor s(0, 250);
+  SensorDriver &d = s;
+  TEST_ASSERT_TRUE(d.begin());
+  TEST_ASSERT_EQUAL_STRING("SIM", d.model());
+  TEST_ASSERT_EQUAL(250, d.minIntervalMs());
+  TEST_ASSERT_EQUAL(0, d.warmupMs());
+
+  // Seed 0 would lock xorshift at zero; it is mapped to seed 1
+  SimulatedSensor one(1);
+  for (int i = 0; i < 10; i++) {
+    float t0, h0, t1, h1;
+    TEST_ASSERT_TRUE(d.read(t0, h0));
+    one.read(t1, h1);
+    TEST_ASSERT_EQUAL_FLOAT(t1, t0);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_same_seed_same_readings);
+  RUN_TEST(test_values_plausible);
+  RUN_TEST(test_driver_contract);
+  return UNITY_END();
+}
@@ -0,0 +1,256 @@
+// Telemetry staging queue, outage journal stage, flash backlog (segments,
+// reboot resume, seq reservation) and the JSON/binary payload encoders
+#include <unity.h>
+#include "telemetry.h"
+
+static fs::FS flash;
+
+static TelemetryRecord rec(uint32_t seq) {
+  TelemetryRecord r = {};
+  r.seq = seq;
+  r.ts = 1705325400 + seq * 30;
+  r.t = -123;
+  r.h = 4567;
+  r.n = 1;
+  r.channel = seq % 3;
+  r.kind = TELEMETRY_SAMPLE;
+  return r;
+}
+
+static bool appendRange(TelemetryLog &log, uint32_t first, uint32_t last) {
+  for (uint32_t s = first; s <= last; s++) {
+    TelemetryRecord r = rec(s);
+    if (!log.append(&r, 1)) return false;
+  }
+  return true;
+}
+
+// Reads everything left through peek/consume in batches; returns the last seq
+static uint32_t drain(TelemetryLog &log, uint32_t expectFirst) {
+  TelemetryRecord batch[4];
+  uint32_t expect = expectFirst;
+  size_t n;
+  while ((n = log.peek(batch, 4)) > 0) {
+    for (size_t i = 0; i < n; i++) TEST_ASSERT_EQUAL(expect++, batch[i].seq);
+    log.consume(n, batch[n - 1].seq);
+  }
+  TEST_ASSERT_EQUAL(0, log.pending());
+  return expect - 1;
+}
+
+void setUp() { flash = fs::FS(); }
+void tearDown() {}
+
+void test_queue_drops_oldest_and_pops_through() {
+  TelemetryQueue<4> q;
+  for (uint32_t s = 1; s <= 6; s++) q.push(rec(s));
+  TEST_ASSERT_EQUAL(4, q.size());
+  TEST_ASSERT_EQUAL(2, q.dropped());
+  TEST_ASSERT_EQUAL(3, q.at(0).seq);
+  TelemetryRecord out[2];
+  TEST_ASSERT_EQUAL(2, q.peek(out, 2));
+  q.popThrough(out[1].seq);
+  TEST_ASSERT_EQUAL(2, q.size());
+  TEST_ASSERT_EQUAL(5, q.at(0).seq);
+  q.popThrough(1);
+  TEST_ASSERT_EQUAL(2, q.size());
+}
+
+void test_log_rotates_and_drops_oldest_segment() {
+  TelemetryLog log(flash, "/tl_a.bin", "/tl_b.bin", "/tl_state.bin", 10);
+  log.begin();
+  TEST_ASSERT_EQUAL(0, log.pending());
+  TEST_ASSERT_EQUAL(1, log.resumeSeq());
+  TEST_ASSERT_TRUE(appendRange(log, 1, 25));
+  // Segments of 10: the third segment replaced the one holding 1..10
+  TEST_ASSERT_EQUAL(10, log.dropped());
+  TEST_ASSERT_EQUAL(15, log.pending());
+  TEST_ASSERT_EQUAL(25, log.lastSeq());
+  TEST_ASSERT_EQUAL(25, drain(log, 11));
+  TEST_ASSERT_EQUAL(1, flash.fileCount());   // Only the state file is left
+}
+
+// Acked position and reserved seq survive a reboot
+void test_log_resumes_after_reboot() {
+  {
+    TelemetryLog log(flash, "/tl_a.bin", "/tl_b.bin", "/tl_state.bin", 10);
+    log.begin();
+    TEST_ASSERT_TRUE(appendRange(log, 1, 14));
+    TelemetryRecord batch[6];
+    size_t n = log.peek(batch, 6);
+    TEST_ASSERT_EQUAL(6, n);
+    log.consume(n, batch[n - 1].seq);
+    log.reserve(40);
+  }
+  TelemetryLog log(flash, "/tl_a.bin", "/tl_b.bin", "/tl_state.bin", 10);
+  log.begin();
+  TEST_ASSERT_EQUAL(6, log.ackedSeq());
+  TEST_ASSERT_EQUAL(8, log.pending());
+  TEST_ASSERT_EQUAL(40, log.resumeSeq());   // Never reuse numbers handed out before the reset
+  TEST_ASSERT_EQUAL(14, drain(log, 7));
+}
+
+// A record torn by a power cut is ignored; numbering continues after it
+void test_log_ignores_torn_tail() {
+  {
+    TelemetryLog log(flash, "/tl_a.bin", "/tl_b.bin", "/tl_state.bin", 100);
+    log.begin();
+    TEST_ASSERT_TRUE(appendRange(log, 1, 5));
+    flash.powerCutAfter = sizeof(TelemetryRecord) / 2;
+    TelemetryRecord r = rec(6);
+    TEST_ASSERT_FALSE(log.append(&r, 1));
+  }
+  flash.powerCutAfter = -1;
+  TEST_ASSERT_EQUAL(5 * sizeof(TelemetryRecord) + sizeof(TelemetryRecord) / 2, flash.file("/tl_a.bin")->size());
+  TelemetryLog log(flash, "/tl_a.bin", "/tl_b.bin", "/tl_state.bin", 100);
+  log.begin();
+  TEST_ASSERT_EQUAL(5, log.pending());
+  TEST_ASSERT_EQUAL(6, log.resumeSeq());
+  TEST_ASSERT_EQUAL(5, drain(log, 1));
+}
+
+// Outage journal use: reads by seq without consuming, acks by seq
+void test_log_read_after_and_ack_through() {
+  TelemetryLog log(flash, "/oj_a.bin", "/oj_b.bin", "/oj_state.bin", 8);
+  log.begin();
+  TEST_ASSERT_TRUE(appendRange(log, 1, 12));
+  TelemetryRecord out[16];
+  TEST_ASSERT_EQUAL(7, log.readAfter(5, out, 16));
+  TEST_ASSERT_EQUAL(6, out[0].seq);
+  TEST_ASSERT_EQUAL(12, out[6].seq);
+  TEST_ASSERT_EQUAL(3, log.readAfter(0, out, 3));
+  TEST_ASSERT_EQUAL(1, out[0].seq);
+  TEST_ASSERT_EQUAL(12, log.pending());
+
+  log.ackThrough(9);   // Crosses from the first segment into the second
+  TEST_ASSERT_EQUAL(9, log.ackedSeq());
+  TEST_ASSERT_EQUAL(3, log.pending());
+  TEST_ASSERT_EQUAL(3, log.readAfter(0, out, 16));
+  TEST_ASSERT_EQUAL(10, out[0].seq);
+
+  log.ackThrough(1000);   // Clamped to the newest record
+  TEST_ASSERT_EQUAL(12, log.ackedSeq());
+  TEST_ASSERT_EQUAL(0, log.pending());
+  TEST_ASSERT_TRUE(appendRange(log, 13, 14));
+  TEST_ASSERT_EQUAL(2, log.readAfter(log.ackedSeq(), out, 16));
+}
+
+// Outage journal before NTP sync: boot-clock samples never reach flash;
+// after the rebase they are written and replay with wall-clock times
+void test_stage_holds_boot_clock_until_rebase() {
+  const uint32_t MIN_VALID = 1000000000;
+  TelemetryLog log(flash, "/oj_a.bin", "/oj_b.bin", "/oj_state.bin", 64);
+  log.begin();
+  TelemetryStage<8> stage(MIN_VALID);
+  for (uint32_t s = 1; s <= 5; s++) {
+    TelemetryRecord r = rec(s);
+    r.ts = 60 + s * 30;   // Seconds since boot
+    stage.add(r);
+  }
+  TEST_ASSERT_EQUAL(0, stage.ready());
+  TEST_ASSERT_TRUE(stage.flush(log));
+  TEST_ASSERT_EQUAL(5, stage.size());
+  TEST_ASSERT_EQUAL(0, log.pending());
+
+  // Clock set: the next sample has wall time, the staged ones still wait
+  const uint32_t offset = 1705325000;
+  TelemetryRecord r = rec(6);
+  r.ts = offset + 240;
+  stage.add(r);
+  TEST_ASSERT_EQUAL(0, stage.ready());
+
+  TEST_ASSERT_EQUAL(5, stage.rebase(offset));
+  TEST_ASSERT_EQUAL(6, stage.ready());
+  TEST_ASSERT_TRUE(stage.flush(log));
+  TEST_ASSERT_EQUAL(0, stage.size());
+
+  TelemetryRecord out[8];
+  TEST_ASSERT_EQUAL(6, log.readAfter(0, out, 8));
+  for (uint32_t i = 0; i < 6; i++) {
+    TEST_ASSERT_EQUAL(i + 1, out[i].seq);
+    TEST_ASSERT_EQUAL(offset + 90 + i * 30, out[i].ts);
+  }
+}
+
+// Without a sync the stage keeps the newest boot-clock samples
+void test_stage_drops_oldest_while_unsynced() {
+  TelemetryStage<4> stage(1000000000);
+  for (uint32_t s = 1; s <= 7; s++) {
+    TelemetryRecord r = rec(s);
+    r.ts = s * 30;
+    stage.add(r);
+  }
+  TEST_ASSERT_TRUE(stage.full());
+  TEST_ASSERT_EQUAL(3, stage.dropped());
+  TEST_ASSERT_EQUAL(4, stage.at(0).seq);
+  TEST_ASSERT_EQUAL(7, stage.at(3).seq);
+}
+
+void test_encode_json() {
+  TelemetryRecord items[3] = {rec(10), rec(11), rec(12)};
+  items[1].t = 2150;
+  items[1].h = 5000;
+  items[1].n = 10;
+  items[1].kind = TELEMETRY_ROLLUP;
+  uint8_t out[512];
+  size_t len = 0;
+  TEST_ASSERT_EQUAL(3, encodeTelemetry(TelemetryEncoding::Json, "dev", items, 3, out, sizeof(out), len));
+  TEST_ASSERT_EQUAL(strlen((char *)out), len);
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"dev\":\"dev\",\"seq\":10,\"rec\":["
+      "[1705325700,1,0,-1.23,45.67,1],[1705325730,2,1,21.50,50.00,10],[1705325760,0,0,-1.23,45.67,1]]}",
+      (char *)out);
+}
+
+// A seq gap ends the batch; a small buffer takes as many whole rows as fit
+void test_encode_json_gap_and_capacity() {
+  TelemetryRecord items[4] = {rec(1), rec(2), rec(3), rec(9)};
+  uint8_t out[512];
+  size_t len = 0;
+  TEST_ASSERT_EQUAL(3, encodeTelemetry(TelemetryEncoding::Json, "dev", items, 4, out, sizeof(out), len));
+  TEST_ASSERT_EQUAL(2, encodeTelemetry(TelemetryEncoding::Json, "dev", items, 4, out, 100, len));
+  TEST_ASSERT_LESS_THAN(100, len);
+  TEST_ASSERT_EQUAL('}', out[len - 1]);
+  TEST_ASSERT_EQUAL(0, encodeTelemetry(TelemetryEncoding::Json, "dev", items, 4, out, 40, len));
+}
+
+void test_encode_binary() {
+  TelemetryRecord items[2] = {rec(0x01020304), rec(0x01020305)};
+  uint8_t out[64];
+  size_t len = 0;
+  TEST_ASSERT_EQUAL(2, encodeTelemetry(TelemetryEncoding::Binary, "dev", items, 2, out, sizeof(out), len));
+  TEST_ASSERT_EQUAL(8 + 2 * 12, len);
+  const uint8_t header[] = {'T', 'L', 1, 2, 0x04, 0x03, 0x02, 0x01};
+  TEST_ASSERT_EQUAL_MEMORY(header, out, sizeof(header));
+  uint32_t ts;
+  int16_t t;
+  uint16_t h, n;
+  memcpy(&ts, out + 8, 4);
+  memcpy(&t, out + 12, 2);
+  memcpy(&h, out + 14, 2);
+  memcpy(&n, out + 16, 2);
+  TEST_ASSERT_EQUAL(items[0].ts, ts);
+  TEST_ASSERT_EQUAL(-123, t);
+  TEST_ASSERT_EQUAL(4567, h);
+  TEST_ASSERT_EQUAL(1, n);
+  TEST_ASSERT_EQUAL(items[0].channel, out[18]);
+  TEST_ASSERT_EQUAL(TELEMETRY_SAMPLE, out[19]);
+
+  TEST_ASSERT_EQUAL(1, encodeTelemetry(TelemetryEncoding::Binary, "dev", items, 2, out, 8 + 12 + 11, len));
+  TEST_ASSERT_EQUAL(0, encodeTelemetry(TelemetryEncoding::Binary, "dev", items, 2, out, 8 + 11, len));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_queue_drops_oldest_and_pops_through);
+  RUN_TEST(test_log_rotates_and_drops_oldest_segment);
+  RUN_TEST(test_log_resumes_after_reboot);
+  RUN_TEST(test_log_ignores_torn_tail);
+  RUN_TEST(test_log_read_after_and_ack_through);
+  RUN_TEST(test_stage_holds_boot_clock_until_rebase);
+  RUN_TEST(test_stage_drops_oldest_while_unsynced);
+  RUN_TEST(test_encode_json);
+  RUN_TEST(test_encode_json_gap_and_capacity);
+  RUN_TEST(test_encode_binary);
+  return UNITY_END();
+}
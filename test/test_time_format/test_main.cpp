@@ -0,0 +1,126 @@
+// DateFormatter against localtime_r()/strftime() in several timezones
+#include <unity.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "time_format.h"
+
+static const char *ZONES[] = {
+  "CET-1CEST,M3.5.0,M10.5.0/3",   // The device default
+  "IST-5:30",                     // Half-hour offset
+  "UTC0",
+  "EST5EDT,M3.2.0,M11.1.0",       // Negative offset
+};
+
+static void setZone(const char *tz) {
+  setenv("TZ", tz, 1);
+  tzset();
+}
+
+static void reference(uint32_t ts, const char *fmt, char *out, size_t len) {
+  time_t t = ts;
+  struct tm tm;
+  localtime_r(&t, &tm);
+  strftime(out, len, fmt, &tm);
+}
+
+void setUp() {}
+void tearDown() { setZone("UTC0"); }
+
+// Over a year in odd steps, so every hour window and both DST switches are hit
+void test_local_matches_strftime() {
+  for (const char *tz : ZONES) {
+    setZone(tz);
+    DateFormatter f;
+    for (uint32_t ts = 1700000000; ts < 1700000000 + 400 * 86400; ts += 997) {
+      char got[TIME_FORMAT_MAX], want[64];
+      f.format(ts, got);
+      reference(ts, "%Y-%m-%d %H:%M:%S", want, sizeof(want));
+      TEST_ASSERT_EQUAL_STRING_MESSAGE(want, got, tz);
+    }
+  }
+}
+
+// Second by second across the CET spring and autumn switches
+void test_dst_switch() {
+  setZone(ZONES[0]);
+  const uint32_t switches[] = {1711846800, 1729990800};   // 2024-03-31 / 2024-10-27 01:00 UTC
+  for (uint32_t sw : switches) {
+    DateFormatter f;
+    for (uint32_t ts = sw - 7200; ts < sw + 7200; ts++) {
+      char got[TIME_FORMAT_MAX], want[64];
+      f.format(ts, got);
+      reference(ts, "%Y-%m-%d %H:%M:%S", want, sizeof(want));
+      TEST_ASSERT_EQUAL_STRING(want, got);
+    }
+  }
+}
+
+// Out-of-order timestamps (e.g. /api/history mixing tiers) refresh the cache
+void test_backwards_timestamps() {
+  setZone(ZONES[0]);
+  DateFormatter f;
+  for (uint32_t ts = 1705330000; ts > 1705330000 - 3 * 86400; ts -= 1201) {
+    char got[TIME_FORMAT_MAX], want[64];
+    f.format(ts, got);
+    reference(ts, "%Y-%m-%d %H:%M:%S", want, sizeof(want));
+    TEST_ASSERT_EQUAL_STRING(want, got);
+  }
+}
+
+void test_iso8601_offset() {
+  char out[TIME_FORMAT_MAX];
+  DateFormatter f;
+  setZone(ZONES[0]);
+  TEST_ASSERT_EQUAL(25, f.format(1705325415, out, TimeFormat::Iso8601));
+  TEST_ASSERT_EQUAL_STRING("2024-01-15T14:30:15+01:00", out);
+  f.format(1720000000, out, TimeFormat::Iso8601);
+  TEST_ASSERT_EQUAL_STRING("2024-07-03T11:46:40+02:00", out);
+
+  setZone(ZONES[1]);
+  f.invalidate();
+  f.format(1705325415, out, TimeFormat::Iso8601);
+  TEST_ASSERT_EQUAL_STRING("2024-01-15T19:00:15+05:30", out);
+
+  setZone(ZONES[3]);
+  f.invalidate();
+  f.format(1705325415, out, TimeFormat::Iso8601);
+  TEST_ASSERT_EQUAL_STRING("2024-01-15T08:30:15-05:00", out);
+}
+
+void test_epoch_and_boot_clock() {
+  char out[TIME_FORMAT_MAX];
+  DateFormatter f;
+  TEST_ASSERT_EQUAL(10, f.format(1705325415, out, TimeFormat::Epoch));
+  TEST_ASSERT_EQUAL_STRING("1705325415", out);
+  TEST_ASSERT_EQUAL(9, f.format(123, out));
+  TEST_ASSERT_EQUAL_STRING("Boot+123s", out);
+  f.format(0, out, TimeFormat::Iso8601);
+  TEST_ASSERT_EQUAL_STRING("Boot+0s", out);
+  f.format(TIME_FORMAT_MIN_EPOCH - 1, out, TimeFormat::Epoch);
+  TEST_ASSERT_EQUAL_STRING("Boot+999999999s", out);
+}
+
+// A timezone change takes effect only after invalidate(), like configTime()
+void test_invalidate_rereads_timezone() {
+  char out[TIME_FORMAT_MAX];
+  DateFormatter f;
+  setZone("UTC0");
+  f.format(1705325415, out);
+  TEST_ASSERT_EQUAL_STRING("2024-01-15 13:30:15", out);
+  setZone(ZONES[0]);
+  f.invalidate();
+  f.format(1705325415, out);
+  TEST_ASSERT_EQUAL_STRING("2024-01-15 14:30:15", out);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_local_matches_strftime);
+  RUN_TEST(test_dst_switch);
+  RUN_TEST(test_backwards_timestamps);
+  RUN_TEST(test_iso8601_offset);
+  RUN_TEST(test_epoch_and_boot_clock);
+  RUN_TEST(test_invalidate_rereads_timezone);
+  return UNITY_END();
+}
@@ -0,0 +1,46 @@
+"""PlatformIO post-build check: the firmware image must fit every app slot.
+
+partitions.csv gives app1 (the second OTA slot) 72 KB less than app0, for
+the raw log and power-fail snapshot partitions. PlatformIO only compares
+the image against one size, so an image that still fits app0 could be
+flashed fine over USB and then fail the first OTA update into app1. This
+script reads the partition table the env uses and fails the build when
+firmware.bin is larger than the smallest app partition.
+
+Used from platformio.ini: extra_scripts = post:tools/check_app_size.py
+"""
+
+import os
+
+Import("env")  # noqa: F821 (provided by SCons)
+
+
+def parse_size(text):
+    text = text.strip().upper()
+    for suffix, scale in (("K", 1024), ("M", 1024 * 1024)):
+        if text.endswith(suffix):
+            return int(text[:-1], 0) * scale
+    return int(text, 0)
+
+
+def app_partitions(path):
+    apps = []
+    with open(path) as f:
+        for line in f:
+            cols = [c.strip() for c in line.split("#", 1)[0].split(",")]
+            if len(cols) >= 5 and cols[1] == "app":
+                apps.append((cols[0], parse_size(cols[4])))
+    return apps
+
+
+def check_app_size(source, target, env):
+    table = os.path.join(env.subst("$PROJECT_DIR"), env.GetProjectOption("board_build.partitions"))
+    name, limit = min(app_partitions(table), key=lambda p: p[1])
+    size = os.path.getsize(target[0].get_abspath())
+    print("App image: %d of %d bytes (%.1f%% of %s)" % (size, limit, 100.0 * size / limit, name))
+    if size > limit:
+        print("Error: the image is %d bytes larger than partition %s in %s" % (size - limit, name, table))
+        env.Exit(1)
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.bin", check_app_size)  # noqa: F821
@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+"""Decode a binary log dump from /api/logs?format=bin.
+
+    curl -s "http://<hostname>.local/api/logs?format=bin" | python3 tools/log_decode.py
+    python3 tools/log_decode.py dump.bin
+
+Prints one line per entry: milliseconds since boot, level, message.
+Layout (little-endian, see include/log_ring.h):
+    "LGB1", u16 entries, u16 formats, u32 dropped
+    formats: u8 length + text
+    entries: u32 seq, u32 ms, u8 level, u8 flags, u16 format, u8 length + payload
+    payload: per argument a tag ('i' int32, 'u' uint32, 'f' float, 's' u8 length + bytes)
+"""
+
+import re
+import struct
+import sys
+
+LEVELS = {1: "error", 2: "warn", 3: "info", 4: "debug"}
+TRUNCATED = 0x01
+SPEC = re.compile(r"%([-+ #0]*\d*(?:\.\d+)?)(?:hh|h|ll|l|z|j|t|L)?([diouxXeEfFgGcs%])")
+
+
+def decode_args(payload):
+    args, pos = [], 0
+    while pos < len(payload):
+        tag = chr(payload[pos])
+        if tag == "s":
+            n = payload[pos + 1]
+            args.append(payload[pos + 2:pos + 2 + n].decode("utf-8", "replace"))
+            pos += 2 + n
+        elif tag in "iuf":
+            fmt = {"i": "<i", "u": "<I", "f": "<f"}[tag]
+            args.append(struct.unpack_from(fmt, payload, pos + 1)[0])
+            pos += 5
+        else:
+            raise ValueError("unknown argument tag %r" % tag)
+    return args
+
+
+def render(fmt, args):
+    it = iter(args)
+
+    def one(m):
+        flags, conv = m.group(1), m.group(2)
+        if conv == "%":
+            return "%"
+        try:
+            value = next(it)
+        except StopIteration:
+            return "?"
+        if conv == "u":
+            conv = "d"
+        if conv in "dioxXc" and isinstance(value, float):
+            value = int(value)
+        if conv == "s" and not isinstance(value, str):
+            value = str(value)
+        if conv != "s" and isinstance(value, str):
+            return "?"
+        return ("%" + flags + conv) % value
+
+    return SPEC.sub(one, fmt)
+
+
+def decode(data):
+    magic, count, nformats, dropped = struct.unpack_from("<4sHHI", data, 0)
+    if magic != b"LGB1":
+        raise ValueError("not a log dump (magic %r)" % magic)
+    pos = 12
+    formats = []
+    for _ in range(nformats):
+        n = data[pos]
+        formats.append(data[pos + 1:pos + 1 + n].decode("utf-8", "replace"))
+        pos += 1 + n
+    entries = []
+    for _ in range(count):
+        seq, ms, level, flags, fmt, n = struct.unpack_from("<IIBBHB", data, pos)
+        payload = data[pos + 13:pos + 13 + n]
+        pos += 13 + n
+        text = render(formats[fmt], decode_args(payload)).rstrip("\n")
+        if flags & TRUNCATED:
+            text += " ..."
+        entries.append((seq, ms, LEVELS.get(level, "?"), text))
+    return dropped, entries
+
+
+def main():
+    data = open(sys.argv[1], "rb").read() if len(sys.argv) > 1 else sys.stdin.buffer.read()
+    dropped, entries = decode(data)
+    for seq, ms, level, text in entries:
+        print("%10u %-5s %s" % (ms, level, text))
+    if dropped:
+        print("(%u entries dropped on the device since boot)" % dropped, file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
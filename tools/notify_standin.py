@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+"""Local stand-in for the alert webhook receiver and the MQTT broker.
+
+    python3 tools/notify_standin.py                      # HTTP :8080, MQTT :1883
+    python3 tools/notify_standin.py --fail 0.3           # Reject 30 % of deliveries
+
+Point NOTIFY_WEBHOOK_URL at http://<pc-ip>:8080/alerts and/or MQTT_BROKER at
+<pc-ip> (src/main.cpp), flash, and trigger a rule. Every webhook POST and
+every MQTT PUBLISH is printed with its events; duplicate alert seq numbers
+(redeliveries after a failure) are marked. --fail answers a share of the
+webhook POSTs with 503 and drops a share of the QoS 1 publishes without a
+PUBACK, to exercise the firmware's retry and backoff.
+
+The MQTT side implements only what include/mqtt_client.h sends: CONNECT,
+PUBLISH (QoS 0/1), PINGREQ and DISCONNECT. Binary telemetry batches are
+printed as a byte count (see README "MQTT Telemetry" for the layout).
+"""
+
+import argparse
+import http.server
+import json
+import random
+import socketserver
+import struct
+import sys
+import threading
+import time
+
+seen = set()
+lock = threading.Lock()
+
+
+def log(source, text):
+    with lock:
+        print("%s %-5s %s" % (time.strftime("%H:%M:%S"), source, text), flush=True)
+
+
+def report_events(source, body):
+    try:
+        doc = json.loads(body)
+    except ValueError:
+        log(source, "%d bytes (not JSON)" % len(body))
+        return
+    events = doc.get("events")
+    if events is None:
+        log(source, json.dumps(doc)[:200])
+        return
+    for e in events:
+        key = (doc.get("device"), e.get("seq"))
+        dup = " (duplicate)" if key in seen else ""
+        seen.add(key)
+        log(source, "%s #%s %s %s/%s value=%s threshold=%s%s" % (
+            doc.get("device"), e.get("seq"), e.get("event"), e.get("name"),
+            e.get("channel"), e.get("value"), e.get("threshold"), dup))
+
+
+class WebhookHandler(http.server.BaseHTTPRequestHandler):
+    fail = 0.0
+
+    def do_POST(self):
+        body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+        if random.random() < self.fail:
+            log("http", "rejecting POST %s (simulated failure)" % self.path)
+            self.send_response(503)
+            self.end_headers()
+            return
+        report_events("http", body)
+        self.send_response(200)
+        self.send_header("Content-Length", "0")
+        self.end_headers()
+
+    def log_message(self, fmt, *args):
+        pass
+
+
+class MqttHandler(socketserver.BaseRequestHandler):
+    fail = 0.0
+
+    def read_exact(self, n):
+        data = b""
+        while len(data) < n:
+            chunk = self.request.recv(n - len(data))
+            if not chunk:
+                raise ConnectionError
+            data += chunk
+        return data
+
+    def read_packet(self):
+        header = self.read_exact(1)[0]
+        remaining, mult = 0, 1
+        for _ in range(4):
+            digit = self.read_exact(1)[0]
+            remaining += (digit & 0x7F) * mult
+            mult *= 128
+            if not digit & 0x80:
+                break
+        return header, self.read_exact(remaining)
+
+    def handle(self):
+        peer = "%s:%d" % self.client_address
+        try:
+            while True:
+                header, body = self.read_packet()
+                kind = header >> 4
+                if kind == 1:
+                    pos = 2 + struct.unpack_from(">H", body, 0)[0] + 4
+                    n = struct.unpack_from(">H", body, pos)[0]
+                    log("mqtt", "CONNECT %s from %s" % (body[pos + 2:pos + 2 + n].decode(), peer))
+                    self.request.sendall(b"\x20\x02\x00\x00")
+                elif kind == 3:
+                    qos = (header >> 1) & 3
+                    n = struct.unpack_from(">H", body, 0)[0]
+                    topic = body[2:2 + n].decode()
+                    pos = 2 + n
+                    packet_id = None
+                    if qos:
+                        packet_id = struct.unpack_from(">H", body, pos)[0]
+                        pos += 2
+                    payload = body[pos:]
+                    if qos and random.random() < self.fail:
+                        log("mqtt", "dropping %s without PUBACK (simulated failure)" % topic)
+                        return
+                    if topic.endswith("/alerts"):
+                        report_events("mqtt", payload)
+                    elif payload[:1] == b"{":
+                        log("mqtt", "%s %s" % (topic, payload.decode("utf-8", "replace")[:200]))
+                    else:
+                        log("mqtt", "%s %d bytes binary" % (topic, len(payload)))
+                    if qos:
+                        self.request.sendall(struct.pack(">BBH", 0x40, 2, packet_id))
+                elif kind == 12:
+                    self.request.sendall(b"\xd0\x00")
+                elif kind == 14:
+                    log("mqtt", "DISCONNECT %s" % peer)
+                    return
+        except ConnectionError:
+            log("mqtt", "connection from %s closed" % peer)
+
+
+class ThreadingTCPServer(socketserver.ThreadingTCPServer):
+    allow_reuse_address = True
+    daemon_threads = True
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--http-port", type=int, default=8080)
+    parser.add_argument("--mqtt-port", type=int, default=1883)
+    parser.add_argument("--fail", type=float, default=0.0, help="share of deliveries to reject (0-1)")
+    args = parser.parse_args()
+
+    WebhookHandler.fail = MqttHandler.fail = args.fail
+    http_server = http.server.ThreadingHTTPServer(("", args.http_port), WebhookHandler)
+    mqtt_server = ThreadingTCPServer(("", args.mqtt_port), MqttHandler)
+    threading.Thread(target=mqtt_server.serve_forever, daemon=True).start()
+    log("info", "webhook on :%d, MQTT on :%d" % (args.http_port, args.mqtt_port))
+    try:
+        http_server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())